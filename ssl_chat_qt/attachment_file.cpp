@@ -0,0 +1,77 @@
+/**
+ * @file attachment_file.cpp
+ * @brief Реализация чтения и записи файлов вложений частями.
+ */
+
+#include "attachment_file.h"
+#include <openssl/evp.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+namespace fs = std::filesystem;
+
+std::optional<std::string> file_sha256(const std::string& path, std::size_t chunk_bytes) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return std::nullopt;
+    }
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    EVP_DigestInit_ex(context.get(), EVP_sha256(), nullptr);
+    std::string chunk(chunk_bytes, '\0');
+    while (in) {
+        in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        EVP_DigestUpdate(context.get(), chunk.data(), static_cast<std::size_t>(in.gcount()));
+    }
+    if (in.bad()) {
+        return std::nullopt;
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(context.get(), digest, &length);
+
+    static constexpr char kHex[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned int i = 0; i < length; ++i) {
+        hex.push_back(kHex[digest[i] >> 4]);
+        hex.push_back(kHex[digest[i] & 0xf]);
+    }
+    return hex;
+}
+
+bool read_file_chunk(const std::string& path, uint64_t offset, std::size_t max_bytes, std::string& out) {
+    out.clear();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    in.seekg(static_cast<std::streamoff>(offset));
+    out.resize(max_bytes);
+    in.read(out.data(), static_cast<std::streamsize>(max_bytes));
+    out.resize(static_cast<std::size_t>(in.gcount()));
+    return !in.bad();
+}
+
+bool write_file_chunk(const std::string& path, uint64_t offset, std::string_view data) {
+    std::error_code error;
+    uint64_t size = file_size_or_zero(path);
+    if (offset > size) {
+        return false;
+    }
+    if (offset < size) {
+        // Докачка с более раннего места: хвост от прошлой попытки перезаписывается.
+        fs::resize_file(path, offset, error);
+        if (error) {
+            return false;
+        }
+    }
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(out);
+}
+
+uint64_t file_size_or_zero(const std::string& path) {
+    std::error_code error;
+    uint64_t size = fs::file_size(path, error);
+    return error ? 0 : size;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file attachment_file.h
+ * @brief Чтение и запись файлов вложений частями: в памяти клиента не больше одной части.
+ */
+
+#ifndef ATTACHMENT_FILE_H
+#define ATTACHMENT_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief SHA-256 файла в шестнадцатеричном виде - идентификатор вложения на сервере.
+ *
+ * Файл читается частями по chunk_bytes.
+ * @return nullopt, если файл нельзя прочитать.
+ */
+std::optional<std::string> file_sha256(const std::string& path, std::size_t chunk_bytes = 64 * 1024);
+
+/**
+ * @brief Читает не больше max_bytes байт файла с offset.
+ * @param out Заполняется прочитанными байтами; пуст за концом файла.
+ * @return Ложь, если файл нельзя открыть.
+ */
+bool read_file_chunk(const std::string& path, uint64_t offset, std::size_t max_bytes, std::string& out);
+
+/**
+ * @brief Записывает часть в файл с offset, создавая файл при необходимости; всё после части отбрасывается.
+ *
+ * Часть с offset больше текущего размера не пишется: между частями не остаётся дыр.
+ * @return Ложь при ошибке записи или разрыве.
+ */
+bool write_file_chunk(const std::string& path, uint64_t offset, std::string_view data);
+
+/**
+ * @brief Размер файла или 0, если его нет.
+ */
+uint64_t file_size_or_zero(const std::string& path);
+
+#endif // ATTACHMENT_FILE_H
@@ -0,0 +1,184 @@
+/**
+ * @file bench_client.cpp
+ * @brief Замеры пути приёма клиента: HttpClient::receive() -> обработчик сообщений -> MainWindow::updateUI.
+ *
+ * Окно создаётся без диалога входа и без сервера (адрес недоступен), сообщения подаются в
+ * HttpClient так, как пришли бы по сети, и считаются показанными, когда появились в окне.
+ * Для каждого объёма печатается строка "messages=... rate=.../s frame_mean=...ms frame_max=...ms
+ * repaint=...ms rss_per_1k=...KiB": сообщений в секунду, время одного прохода цикла событий
+ * (сколько окно не отвечает), время перерисовки окна со всей историей и прирост памяти на
+ * тысячу сообщений. Без экрана работает с QT_QPA_PLATFORM=offscreen (задаётся, если не указан).
+ *
+ * Запуск: bench_client [функция[:объём]], например bench_client receivePath:10k.
+ */
+
+#include "mainwindow.h"
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTextBrowser>
+#include <QtTest>
+#include <algorithm>
+#include <vector>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace {
+
+const QString kUser = "bench"; ///< Имя пользователя замеров; его кэш удаляется перед каждым замером.
+constexpr qint64 kTimeoutMs = 10 * 60 * 1000; ///< Предел ожидания показа всех сообщений.
+
+/**
+ * @brief Путь к кэшу пользователя замеров (тот же, что выбирает MainWindow).
+ */
+QString cachePath() {
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath(cacheFileName(kUser, "127.0.0.1", "1"));
+}
+
+/**
+ * @brief Объём резидентной памяти процесса в байтах; 0, если его не узнать.
+ */
+qint64 residentBytes() {
+#ifdef Q_OS_LINUX
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief Текст сообщения номер i: одна строка, как записи журнала сервера.
+ */
+QString messageText(int i) {
+    return QString("user%1: сообщение %2, немного текста для типичной длины строки чата").arg(i % 50).arg(i);
+}
+
+/**
+ * @brief Ответ сервера с записью журнала номер i.
+ */
+http::response<http::string_body> chatFrame(int i) {
+    http::response<http::string_body> res{http::status::ok, 11};
+    res.set("X-Log-Offset", std::to_string(i));
+    res.body() = messageText(i).toStdString();
+    return res;
+}
+
+/**
+ * @brief Сколько сообщений показано в окне (каждое - отдельный абзац).
+ */
+int shownMessages(QTextBrowser* view) {
+    return view->document()->isEmpty() ? 0 : view->document()->blockCount();
+}
+
+} // namespace
+
+/**
+ * @class BenchClient
+ * @brief Набор замеров QtTest.
+ */
+class BenchClient : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase() {
+        QStandardPaths::setTestModeEnabled(true); // Кэш пишется в тестовый каталог, а не в данные пользователя
+    }
+
+    void receivePath_data() {
+        QTest::addColumn<int>("messages");
+        QTest::newRow("10k") << 10000;
+        QTest::newRow("100k") << 100000;
+        QTest::newRow("1M") << 1000000;
+    }
+
+    /**
+     * @brief Пачка сообщений (как история после входа) от HttpClient до показа в окне.
+     */
+    void receivePath() {
+        QFETCH(int, messages);
+        QFile::remove(cachePath());
+        MainWindow w(kUser, kUser, "127.0.0.1", "1");
+        w.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&w));
+        auto* view = w.findChild<QTextBrowser*>("textBrowser");
+        QVERIFY(view);
+
+        qint64 rssBefore = residentBytes();
+        std::vector<qint64> frames;
+        QElapsedTimer total;
+        total.start();
+        QBENCHMARK_ONCE {
+            for (int i = 0; i < messages; ++i) {
+                w.client->receive(chatFrame(i));
+            }
+            while (shownMessages(view) < messages) {
+                QVERIFY2(total.elapsed() < kTimeoutMs, "messages were not shown in time");
+                QElapsedTimer frame;
+                frame.start();
+                QCoreApplication::processEvents(QEventLoop::AllEvents, 16);
+                frames.push_back(frame.nsecsElapsed());
+            }
+        }
+        double seconds = total.nsecsElapsed() / 1e9;
+        qint64 rssGrowth = residentBytes() - rssBefore;
+
+        QElapsedTimer paint;
+        paint.start();
+        w.repaint();
+        double repaintMs = paint.nsecsElapsed() / 1e6;
+
+        double frameMean = 0, frameMax = 0;
+        if (!frames.empty()) {
+            qint64 sum = 0;
+            for (qint64 ns : frames) {
+                sum += ns;
+            }
+            frameMean = sum / 1e6 / frames.size();
+            frameMax = *std::max_element(frames.begin(), frames.end()) / 1e6;
+        }
+        qInfo().noquote() << QString("messages=%1 rate=%2/s frame_mean=%3ms frame_max=%4ms repaint=%5ms rss_per_1k=%6KiB")
+                                 .arg(messages)
+                                 .arg(messages / seconds, 0, 'f', 0)
+                                 .arg(frameMean, 0, 'f', 2)
+                                 .arg(frameMax, 0, 'f', 2)
+                                 .arg(repaintMs, 0, 'f', 2)
+                                 .arg(rssGrowth / 1024.0 / (messages / 1000.0), 0, 'f', 1);
+        QCOMPARE(shownMessages(view), messages);
+    }
+
+    /**
+     * @brief Стоимость одного вызова updateUI при растущей истории.
+     */
+    void updateUI() {
+        QFile::remove(cachePath());
+        MainWindow w(kUser, kUser, "127.0.0.1", "1");
+        w.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&w));
+        int i = 0;
+        QBENCHMARK {
+            QMetaObject::invokeMethod(&w, "updateUI", Qt::DirectConnection, Q_ARG(QString, messageText(i++)));
+        }
+    }
+
+    void cleanupTestCase() {
+        QFile::remove(cachePath());
+    }
+};
+
+int main(int argc, char *argv[]) {
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    BenchClient bench;
+    return QTest::qExec(&bench, argc, argv);
+}
+
+#include "bench_client.moc"
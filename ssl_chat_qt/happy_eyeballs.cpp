@@ -0,0 +1,126 @@
+/**
+ * @file happy_eyeballs.cpp
+ * @brief Реализация параллельного подключения к нескольким адресам.
+ */
+
+#include "happy_eyeballs.h"
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+namespace {
+
+/**
+ * @brief Состояние одного подключения; живёт, пока есть незавершённые операции.
+ */
+class ConnectRace : public std::enable_shared_from_this<ConnectRace> {
+public:
+    ConnectRace(asio::io_context& ioc, std::vector<tcp::endpoint> endpoints, std::chrono::milliseconds attempt_delay, ConnectHandler handler)
+        : ioc_(ioc), endpoints_(std::move(endpoints)), sockets_(endpoints_.size()), attempt_delay_(attempt_delay),
+          stagger_(ioc), deadline_(ioc), handler_(std::move(handler)) {}
+
+    void start(std::chrono::milliseconds timeout) {
+        if (endpoints_.empty()) {
+            asio::post(ioc_, [self = shared_from_this()] { self->finish(asio::error::host_not_found, nullptr); });
+            return;
+        }
+        deadline_.expires_after(timeout);
+        deadline_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+            if (!ec) {
+                self->finish(asio::error::timed_out, nullptr);
+            }
+        });
+        launch();
+    }
+
+private:
+    asio::io_context& ioc_;
+    std::vector<tcp::endpoint> endpoints_;
+    std::vector<std::unique_ptr<tcp::socket>> sockets_;
+    std::chrono::milliseconds attempt_delay_;
+    asio::steady_timer stagger_;
+    asio::steady_timer deadline_;
+    ConnectHandler handler_;
+    std::size_t next_ = 0;
+    std::size_t running_ = 0;
+    boost::system::error_code last_error_ = asio::error::host_unreachable;
+    bool done_ = false;
+
+    void launch() {
+        if (done_ || next_ == endpoints_.size()) {
+            return;
+        }
+        std::size_t index = next_++;
+        sockets_[index] = std::make_unique<tcp::socket>(ioc_);
+        ++running_;
+        sockets_[index]->async_connect(endpoints_[index], [self = shared_from_this(), index](boost::system::error_code ec) {
+            --self->running_;
+            if (self->done_) {
+                return;
+            }
+            if (!ec) {
+                self->finish({}, std::move(self->sockets_[index]));
+                return;
+            }
+            self->last_error_ = ec;
+            self->sockets_[index].reset();
+            if (self->running_ == 0 && self->next_ == self->endpoints_.size()) {
+                self->finish(self->last_error_, nullptr);
+            } else {
+                self->launch(); // Неудача не ждёт паузы: следующий адрес пробуется сразу
+            }
+        });
+        // Перевзвод таймера отменяет прежнее ожидание
+        stagger_.expires_after(attempt_delay_);
+        stagger_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+            if (!ec) {
+                self->launch();
+            }
+        });
+    }
+
+    void finish(boost::system::error_code ec, std::unique_ptr<tcp::socket> socket) {
+        if (done_) {
+            return;
+        }
+        done_ = true;
+        stagger_.cancel();
+        deadline_.cancel();
+        for (auto& other : sockets_) {
+            if (other) {
+                boost::system::error_code ignored;
+                other->close(ignored);
+            }
+        }
+        handler_(ec, std::move(socket));
+    }
+};
+
+} // namespace
+
+std::vector<tcp::endpoint> interleave_families(const std::vector<tcp::endpoint>& endpoints) {
+    if (endpoints.empty()) {
+        return {};
+    }
+    std::vector<tcp::endpoint> first, second;
+    bool v6_first = endpoints.front().address().is_v6();
+    for (const auto& endpoint : endpoints) {
+        (endpoint.address().is_v6() == v6_first ? first : second).push_back(endpoint);
+    }
+    std::vector<tcp::endpoint> ordered;
+    ordered.reserve(endpoints.size());
+    for (std::size_t i = 0; i < first.size() || i < second.size(); ++i) {
+        if (i < first.size()) {
+            ordered.push_back(first[i]);
+        }
+        if (i < second.size()) {
+            ordered.push_back(second[i]);
+        }
+    }
+    return ordered;
+}
+
+void async_connect_racing(asio::io_context& ioc, std::vector<tcp::endpoint> endpoints,
+                          std::chrono::milliseconds attempt_delay, std::chrono::milliseconds timeout, ConnectHandler handler) {
+    std::make_shared<ConnectRace>(ioc, std::move(endpoints), attempt_delay, std::move(handler))->start(timeout);
+}
@@ -0,0 +1,46 @@
+/**
+ * @file happy_eyeballs.h
+ * @brief Параллельное подключение к нескольким адресам сервера (Happy Eyeballs, RFC 8305).
+ */
+
+#ifndef HAPPY_EYEBALLS_H
+#define HAPPY_EYEBALLS_H
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Обработчик завершения подключения: ошибка или подключённый сокет.
+ */
+using ConnectHandler = std::function<void(boost::system::error_code, std::unique_ptr<boost::asio::ip::tcp::socket>)>;
+
+/**
+ * @brief Упорядочивает адреса для подключения, чередуя IPv6 и IPv4.
+ *
+ * Первым остаётся первый адрес от резолвера, дальше семейства чередуются: если одно из них
+ * недоступно, вторая попытка уже идёт по другому.
+ * @param endpoints Адреса в порядке, который вернул резолвер.
+ * @return Адреса в порядке попыток.
+ */
+std::vector<boost::asio::ip::tcp::endpoint> interleave_families(const std::vector<boost::asio::ip::tcp::endpoint>& endpoints);
+
+/**
+ * @brief Подключается к первому ответившему адресу.
+ *
+ * Попытки начинаются по очереди с интервалом attempt_delay, следующая - сразу после неудачи
+ * предыдущей; первая успешная побеждает, остальные закрываются. Обработчик вызывается ровно
+ * один раз в потоке io_context: с сокетом, с ошибкой последней попытки или с timed_out,
+ * если за timeout ни одна попытка не удалась.
+ * @param ioc Контекст, в котором выполняются подключения.
+ * @param endpoints Адреса в порядке попыток (см. interleave_families).
+ * @param attempt_delay Пауза перед следующей попыткой, пока текущая не завершилась.
+ * @param timeout Общее время на подключение.
+ * @param handler Обработчик результата.
+ */
+void async_connect_racing(boost::asio::io_context& ioc, std::vector<boost::asio::ip::tcp::endpoint> endpoints,
+                          std::chrono::milliseconds attempt_delay, std::chrono::milliseconds timeout, ConnectHandler handler);
+
+#endif // HAPPY_EYEBALLS_H
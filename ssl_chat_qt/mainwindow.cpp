@@ -5,16 +5,28 @@
 
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
+#include "happy_eyeballs.h"
+#include "attachment_file.h"
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <boost/asio/ssl.hpp>
 #include <iostream>
 #include <functional>
 #include <thread>
+#include <algorithm>
+#include <charconv>
+#include <random>
+#include <filesystem>
 #include <QInputDialog>
 #include <QDir>
 #include <QMessageBox>
 #include <QTimer>
+#include <QStatusBar>
+#include <QTextEdit>
+#include <QStandardPaths>
+#include <QFileInfo>
+#include <QTextCursor>
+#include <QTextDocument>
 
 #include <QDialog>
 #include <QFormLayout>
@@ -22,6 +34,7 @@
 #include <QPushButton>
 #include <QLabel>
 #include <QCryptographicHash>
+#include <zlib.h>
 
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -39,6 +52,11 @@ QString stringToMD5(const QString &input) {
     return hash.result().toHex();
 }
 
+QString cacheFileName(const QString& username, const std::string& host, const std::string& port) {
+    QString key = QString::fromStdString(host + ":" + port + "/") + username;
+    return QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha256).toHex()) + ".cache";
+}
+
 bool containsSpace(const std::string& str) {
     return str.find(' ') != std::string::npos;
 }
@@ -239,59 +257,483 @@ void LoginDialog::validateInput() {
     }
 }
 
-HttpClient::HttpClient(const std::string& host, const std::string& port, const std::string& uname, const std::string& upass, MessageHandler handler, const std::string& path)
-    : ssl_context(ssl::context::tlsv12_client), stream(ioc, ssl_context), messageHandler(handler) {
+HttpClient::HttpClient(const std::string& host, const std::string& port, const std::string& uname, const std::string& upass, MessageHandler handler, const std::string& path, PresenceHandler presenceHandler, std::shared_ptr<MessageCache> cache, StatusHandler statusHandler)
+    : ssl_context(ssl::context::tlsv12_client), resolver(ioc), connectTimer(ioc), messageHandler(handler), presenceHandler(presenceHandler),
+      statusHandler(std::move(statusHandler)), cache(std::move(cache)),
+      host(host), port(port), credentials(uname + " " + stringToMD5(QString::fromStdString(upass)).toStdString()), loginPath(path),
+      reconnectTimer(ioc) {
     ssl_context.set_default_verify_paths();
     ssl_context.set_verify_mode(ssl::verify_peer);
 
-    tcp::resolver resolver(ioc);
-    auto const results = resolver.resolve(host, port);
-    asio::connect(stream.next_layer(), results.begin(), results.end());
-    stream.handshake(ssl_stream::client);
-    sendRequest(uname + " " + stringToMD5(QString::fromStdString(upass)).toStdString(), path);
-    startListening();
+    if (this->cache) {
+        received = ReceivedOffsets(this->cache->resume_offset()); // Остальное уже есть в кэше
+    }
+    // Окно не ждёт сети: подключение идёт в потоке io_context
+    asio::post(ioc, [this]() { connect(); });
     std::thread([this]() { ioc.run(); }).detach(); // Запускаем io_context в отдельном потоке
 }
 
 HttpClient::~HttpClient() {
+    closing = true;
+    reconnectTimer.cancel();
     try {
-        stream.shutdown();
-        stream.next_layer().close();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stream) {
+            stream->shutdown();
+            stream->next_layer().close();
+        }
     } catch (std::exception const& e) {
         std::cerr << "Error closing socket: " << e.what() << std::endl;
     }
     ioc.stop();
 }
 
+void HttpClient::connect() {
+    reportStatus("Поиск сервера...");
+    connectTimer.expires_after(kResolveTimeout);
+    connectTimer.async_wait([this](beast::error_code ec) {
+        if (!ec) {
+            resolver.cancel();
+        }
+    });
+    resolver.async_resolve(host, port, [this](beast::error_code ec, tcp::resolver::results_type results) {
+        bool expired = connectTimer.expiry() <= asio::steady_timer::clock_type::now();
+        connectTimer.cancel();
+        if (ec) {
+            connectFailed(expired ? asio::error::timed_out : ec);
+            return;
+        }
+        std::vector<tcp::endpoint> endpoints;
+        for (const auto& entry : results) {
+            endpoints.push_back(entry.endpoint());
+        }
+        reportStatus("Подключение...");
+        // Недоступный адрес не задерживает вход: следующий пробуется через kAttemptDelay, не дожидаясь тайм-аута
+        async_connect_racing(ioc, interleave_families(endpoints), kAttemptDelay, kConnectTimeout,
+                             [this](beast::error_code ec, std::unique_ptr<tcp::socket> socket) {
+                                 if (ec) {
+                                     connectFailed(ec);
+                                     return;
+                                 }
+                                 handshake(std::move(*socket));
+                             });
+    });
+}
+
+void HttpClient::handshake(tcp::socket socket) {
+    reportStatus("Защищённое соединение...");
+    handshaking = std::make_unique<ssl_stream>(std::move(socket), ssl_context);
+    connectTimer.expires_after(kHandshakeTimeout);
+    connectTimer.async_wait([this](beast::error_code ec) {
+        if (!ec && handshaking) {
+            beast::error_code ignored;
+            handshaking->next_layer().close(ignored); // Прерывает рукопожатие
+        }
+    });
+    handshaking->async_handshake(ssl_stream::client, [this](beast::error_code ec) {
+        bool expired = connectTimer.expiry() <= asio::steady_timer::clock_type::now();
+        connectTimer.cancel();
+        if (ec) {
+            handshaking.reset();
+            connectFailed(expired ? asio::error::timed_out : ec);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stream = std::move(handshaking);
+            // Неподтверждённые сообщения, дошедшие до сервера, придут в истории после received.next()
+            pending.clear();
+        }
+        buffer.consume(buffer.size());
+        reportStatus("Вход...");
+        login();
+        startListening();
+    });
+}
+
+void HttpClient::login() {
+    std::lock_guard<std::mutex> lock(mutex);
+    http::request<http::string_body> req(http::verb::post, loginPath, 11);
+    req.set("X-Accept-Encoding", "deflate"); // Крупные ответы и история придут сжатыми
+    if (received.next() > 0) {
+        req.set("X-History-Offset", std::to_string(received.next())); // Сервер пришлёт только пропущенное
+    }
+    req.body() = credentials;
+    loginSent = true;
+    writeLocked(req);
+    // Набранное до подключения уходит сразу за входом, в том же порядке
+    for (auto& text : outbox) {
+        http::request<http::string_body> message(http::verb::post, "/", 11);
+        message.body() = text;
+        pending.push_back(std::move(text));
+        writeLocked(message);
+    }
+    outbox.clear();
+    // Прерванные передачи продолжаются с места, известного серверу (загрузка) или записанного на диск (скачивание)
+    if (upload) {
+        sendUploadChunkLocked(true);
+    }
+    if (download) {
+        requestDownloadLocked();
+    }
+}
+
+void HttpClient::connectFailed(beast::error_code ec) {
+    if (closing) {
+        return;
+    }
+    std::cerr << "Connect error: " << ec.message() << std::endl;
+    if (loginPath != "/") {
+        // Регистрация не повторяется сама: пользователь видит ошибку и может нажать кнопку ещё раз
+        messageHandler("Не удалось подключиться к серверу: " + ec.message());
+        return;
+    }
+    reportStatus("Нет соединения с сервером: " + ec.message());
+    scheduleReconnect();
+}
+
+void HttpClient::reportStatus(const std::string& status) {
+    if (statusHandler) {
+        statusHandler(status);
+    }
+}
+
+void HttpClient::scheduleReconnect() {
+    static thread_local std::mt19937 rng(std::random_device{}());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loginSent = false; // До нового входа сообщения копятся в outbox
+    }
+    std::chrono::milliseconds delay = reconnectDelay;
+    delay = std::chrono::milliseconds(std::uniform_int_distribution<long long>(delay.count() / 2, delay.count())(rng));
+    if (reconnectHint) {
+        delay = *reconnectHint;
+        reconnectHint.reset();
+    }
+    reconnectDelay = std::min(reconnectDelay * 2, std::chrono::seconds(30));
+    reconnectTimer.expires_after(delay);
+    reconnectTimer.async_wait([this](beast::error_code ec) {
+        if (ec || closing) {
+            return;
+        }
+        connect();
+    });
+}
+
 void HttpClient::sendRequest(const std::string& message, const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!loginSent) {
+        // Соединение ещё устанавливается; подтверждения и уведомления к новому входу устареют
+        if (path == "/" && !message.empty()) {
+            outbox.push_back(message);
+        }
+        return;
+    }
+    if (path == "/" && !message.empty()) {
+        pending.push_back(message); // Ждёт номера от сервера (заголовок X-Ack)
+    }
     http::request<http::string_body> req(http::verb::post, path, 11);
-    req.set(http::field::host, "185.178.45.18");
-    req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
     req.body() = message;
+    writeLocked(req);
+}
+
+void HttpClient::writeLocked(http::request<http::string_body>& req) {
+    req.set(http::field::host, host);
+    req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
     req.prepare_payload();
-    http::write(stream, req);
+    try {
+        http::write(*stream, req);
+    } catch (beast::system_error const& e) {
+        // Разрыв обнаружит чтение и запустит переподключение
+        std::cerr << "Write error: " << e.what() << std::endl;
+    }
+}
+
+void HttpClient::uploadFile(const std::string& path) {
+    // Хеш большого файла считается в потоке io_context, а не в потоке интерфейса
+    asio::post(ioc, [this, path] {
+        std::optional<std::string> id = file_sha256(path);
+        if (!id || file_size_or_zero(path) == 0) {
+            messageHandler("[!]\tНе удалось прочитать файл или он пуст: " + path);
+            return;
+        }
+        Transfer transfer{*id, path, std::filesystem::path(path).filename().string().substr(0, 255), file_size_or_zero(path), 0};
+        std::replace_if(transfer.name.begin(), transfer.name.end(), [](char c) { return c == '\n' || c == '\r' || c == '\t'; }, ' ');
+        std::lock_guard<std::mutex> lock(mutex);
+        if (upload) {
+            messageHandler("[!]\tДождитесь окончания загрузки " + upload->name);
+            return;
+        }
+        upload = std::move(transfer);
+        if (loginSent) {
+            sendUploadChunkLocked(true);
+        }
+    });
+}
+
+void HttpClient::downloadFile(const std::string& id, const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (download) {
+        messageHandler("[!]\tДождитесь окончания скачивания " + download->path);
+        return;
+    }
+    download = Transfer{id, path, "", 0, file_size_or_zero(path)};
+    if (loginSent) {
+        requestDownloadLocked();
+    }
+}
+
+void HttpClient::sendUploadChunkLocked(bool query) {
+    http::request<http::string_body> req(http::verb::post, "/upload", 11);
+    req.set("X-Blob", upload->id);
+    req.set("X-Blob-Size", std::to_string(upload->size));
+    req.set("X-Blob-Offset", std::to_string(upload->offset));
+    req.set("X-File-Name", upload->name);
+    if (!query && !read_file_chunk(upload->path, upload->offset, chunkBytes, req.body())) {
+        messageHandler("[!]\tНе удалось прочитать файл: " + upload->path);
+        upload.reset();
+        return;
+    }
+    writeLocked(req);
+}
+
+void HttpClient::requestDownloadLocked() {
+    http::request<http::string_body> req(http::verb::post, "/download", 11);
+    req.set("X-Blob-Offset", std::to_string(download->offset));
+    req.body() = download->id;
+    writeLocked(req);
+}
+
+void HttpClient::handleUploadReply() {
+    std::string status(res["X-Upload-Status"]);
+    std::string offset(res["X-Blob-Offset"]);
+    std::string chunk(res["X-Chunk-Size"]);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!upload || upload->id != std::string(res["X-Upload"])) {
+            return; // Ответ на загрузку, прерванную раньше
+        }
+        if (auto size = parseHeaderNumber(chunk); size && *size > 0) {
+            chunkBytes = *size;
+        }
+        // Без понятного смещения продолжать некуда: загрузка прекращается, как при отказе
+        if (auto stored = parseHeaderNumber(offset); status == "partial" && stored) {
+            upload->offset = *stored;
+            sendUploadChunkLocked(false);
+            return;
+        }
+        // Принятый файл сервер объявит сообщением в чат; при отказе тело ответа - уведомление
+        upload.reset();
+    }
+    if (!res.body().empty()) {
+        messageHandler(res.body());
+    }
+}
+
+void HttpClient::handleAttachmentChunk() {
+    auto parsedOffset = parseHeaderNumber(std::string(res["X-Blob-Offset"]));
+    auto parsedSize = parseHeaderNumber(std::string(res["X-Blob-Size"]));
+    if (!parsedOffset || !parsedSize) {
+        return; // Испорченный кадр пропускается; загрузка продолжится с подтверждённого места
+    }
+    uint64_t offset = *parsedOffset;
+    uint64_t size = *parsedSize;
+    std::string message;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!download || download->id != std::string(res["X-Blob"])) {
+            return;
+        }
+        if (offset != download->offset || !write_file_chunk(download->path, offset, res.body())) {
+            message = "[!]\tНе удалось сохранить файл: " + download->path;
+            download.reset();
+        } else {
+            download->offset += res.body().size();
+            if (download->offset >= size) {
+                message = "[файл] Сохранён: " + download->path;
+                download.reset();
+            }
+        }
+    }
+    if (!message.empty()) {
+        messageHandler(message);
+    }
+}
+
+void HttpClient::confirmSent(const std::string& ack) {
+    std::string text;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty()) {
+            return;
+        }
+        text = std::move(pending.front());
+        pending.pop_front();
+    }
+    auto parsed = parseHeaderNumber(ack);
+    if (!parsed) {
+        return; // "dropped": сервер отбросил сообщение и прислал уведомление
+    }
+    uint64_t seq = *parsed;
+    if (received.receive(seq, seq) && cache) {
+        cache->append("You: " + text, cachedOffset(seq));
+    }
 }
 
 void HttpClient::startListening() {
-    http::async_read(stream, buffer, res,
+    http::async_read(*stream, buffer, res,
                      [this](beast::error_code ec, std::size_t bytes_transferred) {
                          if (!ec) {
-                             messageHandler(res.body());
+                             handleResponse();
                              res = {}; // Очищаем ответ для следующего чтения
                              startListening(); // Слушаем следующее сообщение
-                         } else {
+                         } else if (!closing) {
                              std::cerr << "Read error: " << ec.message() << std::endl;
+                             if (established && loginPath == "/") {
+                                 messageHandler("[!]\tСоединение потеряно, переподключение...");
+                                 res = {};
+                                 scheduleReconnect();
+                             }
                          }
                      });
 }
 
+void HttpClient::handleResponse() {
+    if (res[http::field::content_encoding] == "deflate") {
+        std::string body;
+        if (!inflateFrame(res.body(), compressionDictionary, body)) {
+            std::cerr << "Inflate error" << std::endl;
+        }
+        res.body() = std::move(body);
+    }
+    auto presence = res["X-Presence"];
+    auto ack = res["X-Ack"];
+    if (!res["X-Compression-Dictionary-Id"].empty()) {
+        compressionDictionary = res.body(); // Словарь не показывается пользователю
+    } else if (!res["X-Reconnect"].empty()) {
+        // Сервер перезапускается: соединение закроется, переподключаться через указанное время
+        if (auto delay = parseHeaderNumber(std::string(res["X-Reconnect"])); delay && *delay <= 24 * 3600 * 1000) {
+            reconnectHint = std::chrono::milliseconds(*delay);
+        }
+    } else if (!res["X-Upload"].empty()) {
+        handleUploadReply();
+    } else if (!res["X-Blob"].empty()) {
+        handleAttachmentChunk(); // Части вложения не показываются и не кэшируются
+    } else if (res["X-Heartbeat"] == "ping") {
+        // Сервер проверяет, что соединение живо; ответ подтверждает последнее полученное сообщение
+        sendRequest(received.next() > 0 ? std::to_string(received.next() - 1) : "", "/pong");
+    } else if (!presence.empty()) {
+        if (presence == "snapshot") {
+            established = true; // Вход выполнен: после разрыва можно переподключаться
+            reconnectDelay = std::chrono::seconds(1);
+            reportStatus("");
+        }
+        if (presenceHandler) {
+            presenceHandler(std::string(presence), res.body());
+        }
+    } else {
+        if (!ack.empty()) {
+            confirmSent(std::string(ack));
+        }
+        // Сохраняются только записи журнала сервера; уведомления и ошибки в кэш не попадают
+        auto offset = res["X-Log-Offset"];
+        if (!offset.empty()) {
+            auto parsed = parseHeaderNumber(std::string(offset));
+            if (!parsed) {
+                return; // Запись с испорченным смещением не показывается и не кэшируется
+            }
+            uint64_t seq = *parsed;
+            // Пачка истории несёт и первый номер, который она покрывает
+            uint64_t from = seq;
+            if (auto first = res["X-Log-From"]; !first.empty()) {
+                auto value = parseHeaderNumber(std::string(first));
+                if (!value || *value > seq) {
+                    return;
+                }
+                from = *value;
+            }
+            if (!received.receive(from, seq)) {
+                return; // Уже получено: рассылка, пришедшая во время истории, или повтор после переподключения
+            }
+            if (cache && !res.body().empty()) {
+                cache->append(res.body(), cachedOffset(seq));
+            }
+            // Подтверждается непрерывный префикс: пропущенное сервер пришлёт снова при переподключении
+            if (++unacked >= kAckEvery && received.next() > 0) {
+                unacked = 0;
+                sendRequest(std::to_string(received.next() - 1), "/ack");
+            }
+        }
+        if (!res.body().empty()) {
+            messageHandler(res.body());
+        }
+    }
+}
+
+void HttpClient::receive(http::response<http::string_body> response) {
+    asio::post(ioc, [this, response = std::move(response)]() mutable {
+        res = std::move(response);
+        handleResponse();
+        res = {};
+    });
+}
+
+std::optional<uint64_t> HttpClient::cachedOffset(uint64_t seq) const {
+    // Сообщение после пропуска пишется без номера: если пропуск не закроется, сервер пришлёт его снова
+    if (!received.contiguous(seq)) {
+        return std::nullopt;
+    }
+    return received.next() - 1;
+}
+
+std::optional<uint64_t> parseHeaderNumber(std::string_view text) {
+    uint64_t value = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || ec != std::errc() || end != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+bool inflateFrame(const std::string& input, const std::string& dictionary, std::string& output) {
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) {
+        return false;
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+
+    output.clear();
+    int rc = Z_OK;
+    while (rc != Z_STREAM_END) {
+        if (stream.avail_out == 0) {
+            size_t used = output.size();
+            output.resize(std::max<size_t>(used * 2, input.size() * 4 + 64));
+            stream.next_out = reinterpret_cast<Bytef*>(&output[used]);
+            stream.avail_out = static_cast<uInt>(output.size() - used);
+        }
+        rc = inflate(&stream, Z_NO_FLUSH);
+        if (rc == Z_NEED_DICT) {
+            rc = inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dictionary.data()), static_cast<uInt>(dictionary.size()));
+        }
+        if (rc != Z_OK && rc != Z_STREAM_END && !(rc == Z_BUF_ERROR && stream.avail_out == 0)) {
+            inflateEnd(&stream);
+            return false;
+        }
+    }
+    output.resize(stream.total_out);
+    inflateEnd(&stream);
+    return true;
+}
+
 /**
  * @brief Конструктор главного окна.
  * @param parent Родительский виджет.
  */
 MainWindow::MainWindow(QWidget *parent) :
-    QMainWindow(parent), ui(new Ui::MainWindow) {
+    QMainWindow(parent), ui(new Ui::MainWindow), onlineLabel(new QLabel(this)) {
     ui->setupUi(this);
+    statusBar()->addPermanentWidget(onlineLabel);
 
     // Отображаем диалог входа
     LoginDialog loginDialog(this);
@@ -301,16 +743,9 @@ MainWindow::MainWindow(QWidget *parent) :
         QString username = loginDialog.getUsername();
         QString password = loginDialog.getPassword();
 
-        // Инициализация клиента с использованием полученных данных
-        client = std::make_unique<HttpClient>("185.178.45.18", "3202",
-                                               username.toStdString(), password.toStdString(),
-                                               [this](const std::string& message) {
-                                                    QMetaObject::invokeMethod(this, "updateUI", Qt::QueuedConnection,
-                                                                Q_ARG(QString, QString::fromStdString(message)));
-                                               }
-        );
-
+        startSession(username, password, "185.178.45.18", "3202");
         connect(ui->pushButton, &QPushButton::clicked, this, &MainWindow::onButtonClicked);
+        connect(ui->textEdit, &QTextEdit::textChanged, this, &MainWindow::onTextChanged);
     } else {
         // Если диалог был отменен или не успешен
         QMessageBox::warning(this, tr("Ошибка входа"), tr("Вход в систему не выполнен."));
@@ -318,6 +753,50 @@ MainWindow::MainWindow(QWidget *parent) :
     }
 }
 
+/**
+ * @brief Конструктор главного окна без диалога входа.
+ */
+MainWindow::MainWindow(const QString& username, const QString& password, const std::string& host, const std::string& port, QWidget *parent) :
+    QMainWindow(parent), ui(new Ui::MainWindow), onlineLabel(new QLabel(this)) {
+    ui->setupUi(this);
+    statusBar()->addPermanentWidget(onlineLabel);
+    startSession(username, password, host, port);
+    connect(ui->pushButton, &QPushButton::clicked, this, &MainWindow::onButtonClicked);
+    connect(ui->textEdit, &QTextEdit::textChanged, this, &MainWindow::onTextChanged);
+}
+
+/**
+ * @brief Читает кэш и создаёт клиент.
+ */
+void MainWindow::startSession(const QString& username, const QString& password, const std::string& host, const std::string& port) {
+    // Кэш читается сразу ради смещения для входа, но показывается только после входа:
+    // неверный пароль не должен открывать чужую историю
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(cacheDir);
+    cache = std::make_shared<MessageCache>(QDir(cacheDir).filePath(cacheFileName(username, host, port)).toStdString());
+    cachedHistory = cache->load();
+
+    // Инициализация клиента с использованием полученных данных
+    client = std::make_unique<HttpClient>(host, port,
+                                           username.toStdString(), password.toStdString(),
+                                           [this](const std::string& message) {
+                                                QMetaObject::invokeMethod(this, "updateUI", Qt::QueuedConnection,
+                                                            Q_ARG(QString, QString::fromStdString(message)));
+                                           },
+                                           "/",
+                                           [this](const std::string& kind, const std::string& body) {
+                                                QMetaObject::invokeMethod(this, "updatePresence", Qt::QueuedConnection,
+                                                            Q_ARG(QString, QString::fromStdString(kind)),
+                                                            Q_ARG(QString, QString::fromStdString(body)));
+                                           },
+                                           cache,
+                                           [this](const std::string& status) {
+                                                QMetaObject::invokeMethod(this, "updateStatus", Qt::QueuedConnection,
+                                                            Q_ARG(QString, QString::fromStdString(status)));
+                                           }
+    );
+}
+
 /**
  * @brief Деструктор главного окна.
  */
@@ -334,6 +813,9 @@ void MainWindow::updateUI(QString message) {
         QMessageBox::warning(this, tr("Ошибка доступа"), tr("Ошибка в учетных данных. Зарегистрируйтесь при сдующем входе!"));
         //QMessageBox::warning(this, tr("Ошибка доступа"), tr("قضيب"));
         QTimer::singleShot(0, this, &QWidget::close); // Запланировать закрытие окна
+    } else if (message == "Server busy.") {
+        QMessageBox::warning(this, tr("Ошибка доступа"), tr("Сервер перегружен, попробуйте войти позже."));
+        QTimer::singleShot(0, this, &QWidget::close); // Запланировать закрытие окна
     } else if (message == "Username already taken.") {
         QMessageBox::warning(this, tr("Ошибка доступа"), tr("Имя пользователя уже занято."));
         QTimer::singleShot(0, this, &QWidget::close); // Запланировать закрытие окна
@@ -342,12 +824,117 @@ void MainWindow::updateUI(QString message) {
     }
 }
 
+/**
+ * @brief Обновление списка пользователей в сети.
+ * @param kind Вид сообщения: "snapshot" или "delta".
+ * @param body Тело сообщения о присутствии.
+ */
+void MainWindow::updatePresence(QString kind, QString body) {
+    const QStringList lines = body.split('\n', Qt::SkipEmptyParts);
+    QStringList typing;
+
+    if (kind == "snapshot") {
+        showCachedHistory(); // Снимок приходит после истории: вход выполнен
+        onlineUsers = lines;
+    } else {
+        for (const QString& line : lines) {
+            QString name = line.mid(1);
+            if (line.startsWith('+') && !onlineUsers.contains(name)) {
+                onlineUsers.append(name);
+            } else if (line.startsWith('-')) {
+                onlineUsers.removeAll(name);
+            } else if (line.startsWith('~')) {
+                typing.append(name);
+            }
+        }
+    }
+
+    onlineUsers.sort();
+    onlineLabel->setText(tr("В сети (%1): %2").arg(onlineUsers.size()).arg(onlineUsers.join(", ")));
+    if (!typing.isEmpty()) {
+        statusBar()->showMessage(tr("%1 печатает...").arg(typing.join(", ")), 3000);
+    }
+}
+
+/**
+ * @brief Показывает сообщения из кэша над уже полученными.
+ */
+void MainWindow::showCachedHistory() {
+    if (cachedHistory.empty()) {
+        return;
+    }
+    // История с сервера уже показана, а она новее кэша: кэш вставляется в начало
+    QTextCursor cursor(ui->textBrowser->document());
+    cursor.movePosition(QTextCursor::Start);
+    bool emptyView = ui->textBrowser->document()->isEmpty();
+    for (std::size_t i = 0; i < cachedHistory.size(); ++i) {
+        if (i > 0) {
+            cursor.insertBlock();
+        }
+        cursor.insertText(QString::fromStdString(cachedHistory[i].text));
+    }
+    if (!emptyView) {
+        cursor.insertBlock();
+    }
+    cachedHistory.clear();
+    cachedHistory.shrink_to_fit();
+}
+
+/**
+ * @brief Показывает ход подключения в строке состояния.
+ * @param status Текст; пустой убирает сообщение.
+ */
+void MainWindow::updateStatus(QString status) {
+    if (status.isEmpty()) {
+        statusBar()->clearMessage();
+    } else {
+        statusBar()->showMessage(status);
+    }
+}
+
+/**
+ * @brief Уведомляет сервер о наборе текста не чаще раза в три секунды.
+ */
+void MainWindow::onTextChanged() {
+    if (client && !ui->textEdit->toPlainText().isEmpty() &&
+        (!typingSent.isValid() || typingSent.elapsed() > 3000)) {
+        client->sendRequest("", "/typing");
+        typingSent.start();
+    }
+}
+
 /**
  * @brief Обработчик нажатия кнопки отправки сообщения.
  */
 void MainWindow::onButtonClicked() {
     QString text = ui->textEdit->toPlainText();
-    if (!text.isEmpty()) {
+    if (text.startsWith("/search ")) {
+        // Результаты поиска приходят от сервера страницей строк "смещение имя: текст"
+        client->sendRequest(text.mid(8).toStdString(), "/search");
+        ui->textEdit->clear();
+    } else if (text.startsWith("/dm ")) {
+        // Личное сообщение "/dm имя текст" видят только сессии получателя и другие устройства отправителя
+        QString body = text.mid(4).trimmed();
+        int space = body.indexOf(' ');
+        if (space > 0) {
+            client->sendRequest(body.toStdString(), "/dm");
+            ui->textBrowser->append("You -> " + body.left(space) + ": " + body.mid(space + 1));
+        }
+        ui->textEdit->clear();
+    } else if (text.startsWith("/upload ")) {
+        // Файл уходит частями; когда сервер его примет, в чат придёт "[файл] имя (размер байт) хеш"
+        client->uploadFile(text.mid(8).trimmed().toStdString());
+        ui->textEdit->clear();
+    } else if (text.startsWith("/download ")) {
+        // "/download хеш [имя]" сохраняет вложение в папку загрузок
+        QStringList args = text.mid(10).trimmed().split(' ', Qt::SkipEmptyParts);
+        if (!args.isEmpty()) {
+            QString dir = QStandardPaths::writableLocation(QStandardPaths::DownloadLocation);
+            QString name = args.size() > 1 ? QStringList(args.mid(1)).join(' ') : args.front();
+            client->downloadFile(args.front().toStdString(), QDir(dir).filePath(QFileInfo(name).fileName()).toStdString());
+        }
+        ui->textEdit->clear();
+    } else if (!text.isEmpty()) {
         client->sendRequest(text.toStdString());
         ui->textBrowser->append("You: " + text);
         ui->textEdit->clear();
@@ -10,6 +10,12 @@
 #include <memory>
 #include <functional>
 #include <string>
+#include <string_view>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <optional>
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <boost/asio/ssl.hpp>
@@ -19,6 +25,10 @@
 #include <QPushButton>
 #include <QFormLayout>
 #include <QMessageBox>
+#include <QLabel>
+#include <QStringList>
+#include <QElapsedTimer>
+#include "message_cache.h"
 
 /**
  * @brief Возвращает MD5-хеш входной строки.
@@ -28,6 +38,18 @@
  */
 QString stringToMD5(const QString &input);
 
+/**
+ * @brief Имя файла кэша сообщений для пользователя на сервере host:port.
+ *
+ * Кэш у каждого сервера свой: смещения журнала одного сервера ничего не значат для другого.
+ * Имя - SHA-256 от адреса и имени пользователя, поэтому имя пользователя не попадает в путь.
+ * @param username Имя пользователя.
+ * @param host Хост сервера.
+ * @param port Порт сервера.
+ * @return Имя файла вида "<hex>.cache".
+ */
+QString cacheFileName(const QString& username, const std::string& host, const std::string& port);
+
 /**
  * @brief Проверяет наличие пробелов в строке.
  *
@@ -60,6 +82,24 @@ bool containsDigit(const QString& str);
  */
 bool containsSpecialCharacter(const QString& str);
 
+/**
+ * @brief Распаковывает тело ответа, сжатое сервером deflate с общим словарём.
+ *
+ * @param input Сжатое тело (формат zlib).
+ * @param dictionary Словарь, полученный от сервера при входе.
+ * @param output Распакованное тело.
+ * @return bool Возвращает false, если данные повреждены или словарь не подходит.
+ */
+bool inflateFrame(const std::string& input, const std::string& dictionary, std::string& output);
+
+/**
+ * @brief Разбирает числовой заголовок ответа сервера.
+ *
+ * @param text Значение заголовка.
+ * @return Число или std::nullopt, если значение пустое, не десятичное или не помещается в uint64_t.
+ */
+std::optional<uint64_t> parseHeaderNumber(std::string_view text);
+
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class MainWindow;
@@ -69,6 +109,16 @@ QT_END_NAMESPACE
 // Предварительное объявление MessageHandler
 using MessageHandler = std::function<void(const std::string&)>;
 
+/**
+ * @brief Обработчик сообщений о присутствии: вид ("snapshot" или "delta") и тело.
+ */
+using PresenceHandler = std::function<void(const std::string& kind, const std::string& body)>;
+
+/**
+ * @brief Обработчик хода подключения: текст для строки состояния, пустой - соединение установлено.
+ */
+using StatusHandler = std::function<void(const std::string& status)>;
+
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace asio = boost::asio;
@@ -91,8 +141,15 @@ public:
      * @param port Порт сервера.
      * @param uname Имя пользователя.
      * @param handler Функция-обработчик сообщений.
+     * @param path Путь первого запроса ("/" для входа, "/reg" для регистрации).
+     * @param presenceHandler Обработчик списка пользователей в сети и его изменений.
+     * @param cache Локальный кэш: с сервера запрашиваются только сообщения после сохранённых, новые дописываются в кэш.
+     * @param statusHandler Обработчик хода подключения (вызывается в потоке io_context).
+     *
+     * Конструктор не ждёт сети: разрешение имени, подключение, рукопожатие TLS и вход
+     * выполняются асинхронно в потоке io_context.
      */
-    HttpClient(const std::string& host, const std::string& port, const std::string& uname, const std::string& upass, MessageHandler handler, const std::string& path = "/");
+    HttpClient(const std::string& host, const std::string& port, const std::string& uname, const std::string& upass, MessageHandler handler, const std::string& path = "/", PresenceHandler presenceHandler = nullptr, std::shared_ptr<MessageCache> cache = nullptr, StatusHandler statusHandler = nullptr);
 
     /**
      * @brief Деструктор класса HttpClient.
@@ -101,6 +158,8 @@ public:
 
     /**
      * @brief Отправка HTTP запроса.
+     *
+     * До входа сообщения чата откладываются и уходят сразу после него, служебные запросы отбрасываются.
      * @param message Сообщение для отправки на сервер.
      */
     virtual void sendRequest(const std::string& message, const std::string& path = "/");
@@ -110,17 +169,167 @@ public:
      */
     virtual void startListening();
 
+    /**
+     * @brief Отправляет файл вложением; хеш считается в потоке io_context, затем файл уходит частями.
+     *
+     * Следующая часть отправляется после ответа сервера на предыдущую, поэтому в памяти не больше
+     * одной части. После разрыва загрузка продолжается с места, принятого сервером. Одновременно -
+     * одна загрузка. Когда файл принят, сервер рассылает сообщение "[файл] имя (размер байт) хеш".
+     * @param path Путь к файлу.
+     */
+    void uploadFile(const std::string& path);
+
+    /**
+     * @brief Скачивает вложение; части пишутся в файл по мере получения.
+     *
+     * Если файл уже есть (прерванное скачивание), докачивается с его конца. Одновременно - одно скачивание.
+     * @param id Хеш вложения из сообщения "[файл] ...".
+     * @param path Куда сохранить.
+     */
+    void downloadFile(const std::string& id, const std::string& path);
+
+    /**
+     * @brief Обрабатывает ответ так же, как прочитанный из соединения; выполняется в потоке io_context.
+     *
+     * Позволяет подавать сообщения на путь приёма без сервера (замеры bench_client), пока
+     * соединение не установлено.
+     * @param response Ответ сервера с заголовками, как он пришёл бы по сети.
+     */
+    void receive(http::response<http::string_body> response);
+
     void handleMessage(const std::string& message) {
         messageHandler(message);
     }
 
 private:
+    static constexpr size_t kAckEvery = 32; ///< Через сколько полученных сообщений клиент подтверждает номер.
+    static constexpr std::chrono::seconds kResolveTimeout{5}; ///< Время на разрешение имени сервера.
+    static constexpr std::chrono::seconds kConnectTimeout{10}; ///< Время на подключение ко всем адресам.
+    static constexpr std::chrono::seconds kHandshakeTimeout{10}; ///< Время на рукопожатие TLS.
+    static constexpr std::chrono::milliseconds kAttemptDelay{250}; ///< Пауза перед подключением к следующему адресу (RFC 8305).
+
     asio::io_context ioc;
     ssl::context ssl_context;
-    ssl_stream stream;
+    std::unique_ptr<ssl_stream> stream; ///< Пересоздаётся при переподключении; пуст до первого подключения.
+    std::unique_ptr<ssl_stream> handshaking; ///< Соединение, ещё не завершившее рукопожатие.
+    tcp::resolver resolver;
+    asio::steady_timer connectTimer; ///< Ограничивает разрешение имени и рукопожатие.
     beast::flat_buffer buffer;
     MessageHandler messageHandler;
+    PresenceHandler presenceHandler;
+    StatusHandler statusHandler;
+    std::shared_ptr<MessageCache> cache;
     http::response<http::string_body> res;
+    std::string compressionDictionary; ///< Словарь deflate, присланный сервером.
+    std::string host;
+    std::string port;
+    std::string credentials; ///< Тело запроса входа: имя и хеш пароля.
+    std::string loginPath;
+    std::mutex mutex; ///< Защищает запись в поток, его замену и очереди pending и outbox.
+    bool loginSent = false; ///< Запрос входа уже отправлен (в нём согласуется сжатие и номер, с которого нужна история).
+    std::deque<std::string> pending; ///< Отправленные сообщения, ещё не получившие номер от сервера.
+    std::deque<std::string> outbox; ///< Сообщения, набранные до входа.
+    ReceivedOffsets received; ///< Полученные номера; история запрашивается с received.next().
+    size_t unacked = 0; ///< Сообщения, полученные после последнего подтверждения.
+    bool established = false; ///< Вход выполнен хотя бы раз.
+    std::atomic<bool> closing{false};
+    asio::steady_timer reconnectTimer;
+    std::chrono::seconds reconnectDelay{1};
+    std::optional<std::chrono::milliseconds> reconnectHint; ///< Задержка, назначенная сервером при перезапуске (X-Reconnect).
+
+    /**
+     * @brief Передаваемое вложение.
+     */
+    struct Transfer {
+        std::string id;      ///< SHA-256 файла.
+        std::string path;    ///< Локальный файл.
+        std::string name;    ///< Имя для сообщения в чат.
+        uint64_t size = 0;
+        uint64_t offset = 0; ///< Принятый сервером (загрузка) или записанный на диск (скачивание) объём.
+    };
+    std::optional<Transfer> upload;   ///< Под mutex.
+    std::optional<Transfer> download; ///< Под mutex.
+    size_t chunkBytes = 64 * 1024;    ///< Размер части, назначенный сервером (X-Chunk-Size); под mutex.
+
+    /**
+     * @brief Начинает подключение: разрешение имени, затем подключение ко всем адресам наперегонки.
+     */
+    void connect();
+
+    /**
+     * @brief Выполняет рукопожатие TLS на подключённом сокете, затем вход.
+     * @param socket Сокет, подключённый к серверу.
+     */
+    void handshake(tcp::socket socket);
+
+    /**
+     * @brief Отправляет запрос входа, запрашивая историю с received.next(), и отложенные сообщения.
+     */
+    void login();
+
+    /**
+     * @brief Обрабатывает неудачу подключения: вход повторяется, регистрация сообщает об ошибке.
+     * @param ec Причина неудачи.
+     */
+    void connectFailed(beast::error_code ec);
+
+    /**
+     * @brief Записывает запрос в поток; вызывается под mutex.
+     * @param req Запрос.
+     */
+    void writeLocked(http::request<http::string_body>& req);
+
+    /**
+     * @brief Передаёт ход подключения обработчику, если он задан.
+     * @param status Текст для строки состояния.
+     */
+    void reportStatus(const std::string& status);
+
+    /**
+     * @brief Переподключается после паузы, удваивая её при каждой неудаче (до 30 секунд).
+     *
+     * Пауза выбирается случайно между половиной и полным значением, чтобы клиенты, потерявшие
+     * связь одновременно, не возвращались одной волной. Задержка из X-Reconnect заменяет паузу.
+     */
+    void scheduleReconnect();
+
+    /**
+     * @brief Отправляет часть загружаемого файла с upload->offset; вызывается под mutex.
+     * @param query Отправить пустую часть, чтобы узнать, с какого места продолжать.
+     */
+    void sendUploadChunkLocked(bool query);
+
+    /**
+     * @brief Запрашивает вложение с download->offset; вызывается под mutex.
+     */
+    void requestDownloadLocked();
+
+    /**
+     * @brief Разбирает ответ из res по заголовкам и передаёт его обработчикам.
+     */
+    void handleResponse();
+
+    /**
+     * @brief Обрабатывает ответ на часть загрузки (X-Upload): отправляет следующую или завершает загрузку.
+     */
+    void handleUploadReply();
+
+    /**
+     * @brief Дописывает полученную часть вложения (X-Blob) в файл.
+     */
+    void handleAttachmentChunk();
+
+    /**
+     * @brief Обрабатывает подтверждение сервера (X-Ack) для самого старого отправленного сообщения.
+     * @param ack Номер сообщения или "dropped", если сервер его отбросил.
+     */
+    void confirmSent(const std::string& ack);
+
+    /**
+     * @brief Смещение для записи сообщения с номером seq в кэш.
+     * @return Конец непрерывного префикса или пусто, если до seq ещё есть пропуск.
+     */
+    std::optional<uint64_t> cachedOffset(uint64_t seq) const;
 };
 
 /**
@@ -133,12 +342,25 @@ class MainWindow : public QMainWindow
 
 public:
     std::unique_ptr<HttpClient> client = nullptr; ///< Уникальный указатель на экземпляр HttpClient, используемый для общения с сервером.
+    std::shared_ptr<MessageCache> cache = nullptr; ///< Локальный кэш сообщений текущего пользователя.
     /**
      * @brief Конструктор главного окна.
      * @param parent Родительский виджет.
      */
     MainWindow(QWidget *parent = nullptr);
 
+    /**
+     * @brief Конструктор главного окна без диалога входа: клиент сразу подключается к host:port.
+     *
+     * Используется замерами bench_client: с недоступным адресом сообщения подаются через HttpClient::receive().
+     * @param username Имя пользователя.
+     * @param password Пароль.
+     * @param host Хост сервера.
+     * @param port Порт сервера.
+     * @param parent Родительский виджет.
+     */
+    MainWindow(const QString& username, const QString& password, const std::string& host, const std::string& port, QWidget *parent = nullptr);
+
     /**
      * @brief Деструктор главного окна.
      */
@@ -151,13 +373,45 @@ private slots:
      */
     void updateUI(QString message);
 
+    /**
+     * @brief Обновление списка пользователей в сети.
+     * @param kind "snapshot" - полный список, "delta" - изменения строками "+имя", "-имя", "~имя".
+     * @param body Тело сообщения о присутствии.
+     */
+    void updatePresence(QString kind, QString body);
+
+    /**
+     * @brief Показывает ход подключения в строке состояния.
+     * @param status Текст; пустой убирает сообщение.
+     */
+    void updateStatus(QString status);
+
+    /**
+     * @brief Сообщает серверу, что пользователь набирает текст (не чаще раза в несколько секунд).
+     */
+    void onTextChanged();
+
     /**
      * @brief Обработчик нажатия кнопки отправки сообщения.
      */
     void onButtonClicked();
 
 private:
+    /**
+     * @brief Читает кэш пользователя для этого сервера и создаёт клиент, подключающийся к host:port.
+     */
+    void startSession(const QString& username, const QString& password, const std::string& host, const std::string& port);
+
+    /**
+     * @brief Показывает сообщения из кэша над уже полученными; вызывается, когда вход выполнен.
+     */
+    void showCachedHistory();
+
     Ui::MainWindow *ui; ///< Указатель на пользовательский интерфейс.
+    QLabel *onlineLabel; ///< Список пользователей в сети в строке состояния.
+    QStringList onlineUsers; ///< Пользователи в сети.
+    QElapsedTimer typingSent; ///< Время последнего уведомления о наборе текста.
+    std::vector<CachedMessage> cachedHistory; ///< Сообщения из кэша, ждущие успешного входа.
 };
 
 /**
@@ -5,6 +5,11 @@
 #include "gmock/gmock.h"
 #include <boost/asio.hpp>
 #include <memory>
+#include <cstdio>
+#include <fstream>
+#include "message_cache.h"
+#include "happy_eyeballs.h"
+#include "attachment_file.h"
 
 // Test case for stringToMD5 function
 TEST(MD5Test, HandlesEmptyString) {
@@ -16,6 +21,22 @@ TEST(MD5Test, HandlesSimpleString) {
     EXPECT_EQ(stringToMD5(input), QString(QCryptographicHash::hash(input.toUtf8(), QCryptographicHash::Md5).toHex()));
 }
 
+// Test cases for cacheFileName function
+TEST(CacheFileNameTest, SeparatesServersAndUsers) {
+    QString name = cacheFileName("alice", "example.org", "3202");
+    EXPECT_EQ(name, cacheFileName("alice", "example.org", "3202"));
+    EXPECT_NE(name, cacheFileName("alice", "example.org", "3203"));
+    EXPECT_NE(name, cacheFileName("alice", "example.net", "3202"));
+    EXPECT_NE(name, cacheFileName("bob", "example.org", "3202"));
+}
+
+TEST(CacheFileNameTest, KeepsUserNameOutOfPath) {
+    QString name = cacheFileName("../../etc/passwd", "example.org", "3202");
+    EXPECT_FALSE(name.contains('/'));
+    EXPECT_FALSE(name.contains("passwd"));
+    EXPECT_TRUE(name.endsWith(".cache"));
+}
+
 // Test cases for containsSpace function
 TEST(ContainsSpaceTest, HandlesNoSpace) {
     EXPECT_FALSE(containsSpace("HelloWorld"));
@@ -52,6 +73,193 @@ TEST(ContainsSpecialCharacterTest, HandlesSpecialCharacter) {
     EXPECT_TRUE(containsSpecialCharacter("Hello@World"));
 }
 
+// Test cases for parseHeaderNumber
+TEST(ParseHeaderNumberTest, AcceptsOnlyWholeDecimalNumbers) {
+    EXPECT_EQ(parseHeaderNumber("0"), 0u);
+    EXPECT_EQ(parseHeaderNumber("18446744073709551615"), UINT64_MAX);
+    EXPECT_FALSE(parseHeaderNumber(""));
+    EXPECT_FALSE(parseHeaderNumber("dropped"));
+    EXPECT_FALSE(parseHeaderNumber("12abc"));
+    EXPECT_FALSE(parseHeaderNumber("-1"));
+    EXPECT_FALSE(parseHeaderNumber("18446744073709551616"));
+}
+
+// Test cases for MessageCache
+class MessageCacheTest : public ::testing::Test {
+protected:
+    std::string path = ::testing::TempDir() + "message_cache_test.cache";
+
+    void SetUp() override { std::remove(path.c_str()); }
+    void TearDown() override { std::remove(path.c_str()); }
+};
+
+TEST_F(MessageCacheTest, ReloadsMessagesAndResumesAfterLastOffset) {
+    {
+        MessageCache cache(path);
+        EXPECT_TRUE(cache.load().empty());
+        EXPECT_EQ(cache.resume_offset(), 0u);
+        cache.append("alice: hi\nbob: multi\nline", 4);
+        cache.append("You: hello", std::nullopt);
+        cache.append("bob: again", 7);
+    }
+    MessageCache cache(path);
+    auto messages = cache.load();
+    ASSERT_EQ(messages.size(), 3u);
+    EXPECT_EQ(messages[0].text, "alice: hi\nbob: multi\nline");
+    EXPECT_FALSE(messages[1].offset.has_value());
+    EXPECT_EQ(messages[2].offset, 7u);
+    EXPECT_EQ(cache.resume_offset(), 8u);
+}
+
+TEST_F(MessageCacheTest, DropsUnconfirmedTailAndTornRecord) {
+    {
+        MessageCache cache(path);
+        cache.load();
+        cache.append("bob: one", 2);
+        cache.append("You: replayed by server", std::nullopt);
+    }
+    {
+        std::ofstream torn(path, std::ios::binary | std::ios::app);
+        torn << "9 100\npartial";
+    }
+    MessageCache cache(path);
+    auto messages = cache.load();
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0].text, "bob: one");
+    cache.append("bob: two", 3);
+
+    MessageCache reopened(path);
+    EXPECT_EQ(reopened.load().size(), 2u);
+    EXPECT_EQ(reopened.resume_offset(), 4u);
+}
+
+TEST_F(MessageCacheTest, ResumesAfterHighestOffsetWhenAckArrivesLate) {
+    {
+        MessageCache cache(path);
+        cache.load();
+        cache.append("bob: after mine", 5);
+        cache.append("You: mine", 4); // Подтверждение пришло после следующего сообщения
+        EXPECT_EQ(cache.resume_offset(), 6u);
+    }
+    MessageCache cache(path);
+    EXPECT_EQ(cache.load().size(), 2u);
+    EXPECT_EQ(cache.resume_offset(), 6u);
+}
+
+TEST_F(MessageCacheTest, KeepsOnlyLatestMessages) {
+    {
+        MessageCache cache(path);
+        cache.load();
+        for (uint64_t i = 0; i < 10; ++i) {
+            cache.append("m" + std::to_string(i), i);
+        }
+    }
+    MessageCache cache(path, 3);
+    auto messages = cache.load();
+    ASSERT_EQ(messages.size(), 3u);
+    EXPECT_EQ(messages[0].text, "m7");
+    EXPECT_EQ(cache.resume_offset(), 10u);
+
+    // Сокращённый кэш заменил прежний файл целиком, временный файл не остался.
+    std::ifstream temp(path + ".tmp");
+    EXPECT_FALSE(temp.is_open());
+    MessageCache reopened(path, 3);
+    EXPECT_EQ(reopened.load().size(), 3u);
+}
+
+TEST(ReceivedOffsetsTest, DropsRepeatsAndAdvancesOnlyContiguously) {
+    ReceivedOffsets received(10);
+    EXPECT_FALSE(received.receive(9, 9)); // Уже есть в кэше
+    EXPECT_TRUE(received.receive(12, 12)); // Рассылка обогнала историю
+    EXPECT_EQ(received.next(), 10u);
+    EXPECT_FALSE(received.contiguous(12));
+    EXPECT_TRUE(received.receive(10, 11)); // Пачка истории закрывает пропуск
+    EXPECT_EQ(received.next(), 13u);
+    EXPECT_FALSE(received.receive(12, 12));
+}
+
+TEST(ReceivedOffsetsTest, LateAckKeepsResumeBeforeOwnMessage) {
+    ReceivedOffsets received(4);
+    EXPECT_TRUE(received.receive(5, 5)); // Сообщение чата раньше подтверждения своего
+    EXPECT_TRUE(received.receive(6, 6));
+    EXPECT_EQ(received.next(), 4u);
+    EXPECT_TRUE(received.receive(4, 4));
+    EXPECT_EQ(received.next(), 7u);
+    EXPECT_FALSE(received.receive(5, 5));
+}
+
+// Test cases for async_connect_racing
+namespace {
+
+boost::asio::ip::tcp::endpoint closedLoopbackEndpoint() {
+    // Порт только что был занят и освобождён: подключение к нему отклоняется
+    boost::asio::io_context ioc;
+    boost::asio::ip::tcp::acceptor acceptor(ioc, {boost::asio::ip::address_v4::loopback(), 0});
+    return acceptor.local_endpoint();
+}
+
+} // namespace
+
+TEST(HappyEyeballsTest, InterleavesAddressFamilies) {
+    using boost::asio::ip::make_address;
+    std::vector<boost::asio::ip::tcp::endpoint> resolved{
+        {make_address("::1"), 1}, {make_address("::2"), 2}, {make_address("::3"), 3},
+        {make_address("10.0.0.1"), 4}, {make_address("10.0.0.2"), 5}};
+    auto ordered = interleave_families(resolved);
+    std::vector<unsigned short> ports;
+    for (const auto& endpoint : ordered) {
+        ports.push_back(endpoint.port());
+    }
+    EXPECT_EQ(ports, (std::vector<unsigned short>{1, 4, 2, 5, 3}));
+}
+
+TEST(HappyEyeballsTest, SkipsRefusedEndpointAndConnectsToNext) {
+    boost::asio::io_context ioc;
+    boost::asio::ip::tcp::acceptor acceptor(ioc, {boost::asio::ip::address_v4::loopback(), 0});
+    boost::system::error_code result = boost::asio::error::would_block;
+    std::unique_ptr<boost::asio::ip::tcp::socket> connected;
+    auto started = std::chrono::steady_clock::now();
+    async_connect_racing(ioc, {closedLoopbackEndpoint(), acceptor.local_endpoint()},
+                         std::chrono::seconds(5), std::chrono::seconds(10),
+                         [&](boost::system::error_code ec, std::unique_ptr<boost::asio::ip::tcp::socket> socket) {
+                             result = ec;
+                             connected = std::move(socket);
+                         });
+    ioc.run();
+    EXPECT_FALSE(result);
+    ASSERT_TRUE(connected);
+    EXPECT_EQ(connected->remote_endpoint(), acceptor.local_endpoint());
+    // Отказ первого адреса не ждёт паузы между попытками
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(5));
+}
+
+TEST(HappyEyeballsTest, ReportsErrorWhenAllEndpointsFail) {
+    boost::asio::io_context ioc;
+    boost::system::error_code result;
+    bool called = false;
+    async_connect_racing(ioc, {closedLoopbackEndpoint(), closedLoopbackEndpoint()},
+                         std::chrono::milliseconds(250), std::chrono::seconds(10),
+                         [&](boost::system::error_code ec, std::unique_ptr<boost::asio::ip::tcp::socket> socket) {
+                             EXPECT_FALSE(called);
+                             called = true;
+                             result = ec;
+                             EXPECT_FALSE(socket);
+                         });
+    ioc.run();
+    EXPECT_TRUE(called);
+    EXPECT_EQ(result, boost::asio::error::connection_refused);
+
+    called = false;
+    ioc.restart();
+    async_connect_racing(ioc, {}, std::chrono::milliseconds(250), std::chrono::seconds(10),
+                         [&](boost::system::error_code ec, std::unique_ptr<boost::asio::ip::tcp::socket>) {
+                             called = true;
+                             result = ec;
+                         });
+    ioc.run();
+    EXPECT_TRUE(called);
+    EXPECT_EQ(result, boost::asio::error::host_not_found);
+}
 
 using namespace testing;
 namespace asio = boost::asio;
@@ -164,3 +372,30 @@ int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
+
+TEST(AttachmentFileTest, HashesAndCopiesFileInChunks) {
+    std::string source = "attachment_test_source.bin";
+    std::string copy = "attachment_test_copy.bin";
+    std::remove(copy.c_str());
+    {
+        std::ofstream out(source, std::ios::binary);
+        out << "abc";
+    }
+    // SHA-256("abc") из FIPS 180-2.
+    EXPECT_EQ(file_sha256(source, 2), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    EXPECT_FALSE(file_sha256("no_such_attachment.bin").has_value());
+
+    std::string chunk;
+    for (uint64_t offset = 0; read_file_chunk(source, offset, 2, chunk) && !chunk.empty(); offset += chunk.size()) {
+        EXPECT_TRUE(write_file_chunk(copy, offset, chunk));
+    }
+    EXPECT_EQ(file_size_or_zero(copy), 3u);
+    EXPECT_FALSE(write_file_chunk(copy, 10, "x")); // Дыра между частями
+    EXPECT_TRUE(write_file_chunk(copy, 1, "Z"));   // Повтор с раннего места отбрасывает хвост
+    std::ifstream in(copy, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(data, "aZ");
+
+    std::remove(source.c_str());
+    std::remove(copy.c_str());
+}
@@ -0,0 +1,137 @@
+/**
+ * @file message_cache.cpp
+ * @brief Реализация локального кэша сообщений.
+ */
+
+#include "message_cache.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <iterator>
+#include <sstream>
+
+MessageCache::MessageCache(std::string path, std::size_t max_messages)
+    : path_(std::move(path)), max_messages_(max_messages) {}
+
+std::vector<CachedMessage> MessageCache::load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<CachedMessage> messages;
+    std::size_t confirmed = 0; // Число сообщений до последнего сохранённого смещения включительно
+    bool damaged = false;
+    {
+        std::ifstream in(path_, std::ios::binary);
+        std::string header;
+        while (std::getline(in, header)) {
+            std::istringstream fields(header);
+            std::string offset;
+            std::size_t size = 0;
+            if (!(fields >> offset >> size)) {
+                damaged = true;
+                break;
+            }
+            CachedMessage message;
+            if (offset != "-") {
+                uint64_t value = 0;
+                auto [end, ec] = std::from_chars(offset.data(), offset.data() + offset.size(), value);
+                if (ec != std::errc() || end != offset.data() + offset.size()) {
+                    damaged = true;
+                    break;
+                }
+                message.offset = value;
+            }
+            message.text.resize(size);
+            if (!in.read(message.text.data(), static_cast<std::streamsize>(size)) || in.get() != '\n') {
+                damaged = true;
+                break;
+            }
+            messages.push_back(std::move(message));
+            if (messages.back().offset) {
+                confirmed = messages.size();
+            }
+        }
+    }
+
+    bool trimmed = damaged || confirmed != messages.size();
+    messages.resize(confirmed);
+    if (messages.size() > max_messages_) {
+        messages.erase(messages.begin(), messages.end() - static_cast<std::ptrdiff_t>(max_messages_));
+        trimmed = true;
+    }
+    // Клиент пишет непрерывно полученный префикс, он не убывает; наибольшее смещение берётся на случай старых файлов
+    last_offset_.reset();
+    for (const auto& message : messages) {
+        if (message.offset && (!last_offset_ || *message.offset > *last_offset_)) {
+            last_offset_ = message.offset;
+        }
+    }
+
+    if (trimmed) {
+        rewrite(messages);
+    }
+    out_.close();
+    out_.open(path_, std::ios::binary | std::ios::app);
+    return messages;
+}
+
+void MessageCache::append(const std::string& text, std::optional<uint64_t> offset) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!out_.is_open()) {
+        out_.open(path_, std::ios::binary | std::ios::app);
+    }
+    write_record(out_, {offset, text});
+    out_.flush(); // Запись не должна потеряться при аварийном завершении клиента
+    if (offset && (!last_offset_ || *offset > *last_offset_)) {
+        last_offset_ = offset;
+    }
+}
+
+uint64_t MessageCache::resume_offset() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_offset_ ? *last_offset_ + 1 : 0;
+}
+
+void MessageCache::rewrite(const std::vector<CachedMessage>& messages) {
+    // Новый файл пишется рядом и подменяет старый, чтобы сбой посередине не испортил кэш.
+    // rename заменяет файл атомарно, поэтому прежний кэш не удаляется заранее.
+    std::string temp = path_ + ".tmp";
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    for (const auto& message : messages) {
+        write_record(out, message);
+    }
+    out.close();
+    if (out.fail() || std::rename(temp.c_str(), path_.c_str()) != 0) {
+        std::remove(temp.c_str()); // Остаётся прежний кэш
+    }
+}
+
+void MessageCache::write_record(std::ostream& out, const CachedMessage& message) {
+    if (message.offset) {
+        out << *message.offset;
+    } else {
+        out << '-';
+    }
+    out << ' ' << message.text.size() << '\n';
+    out.write(message.text.data(), static_cast<std::streamsize>(message.text.size()));
+    out << '\n';
+}
+
+bool ReceivedOffsets::receive(uint64_t from, uint64_t to) {
+    if (to < next_) {
+        return false;
+    }
+    auto after = ahead_.upper_bound(to);
+    if (after != ahead_.begin() && std::prev(after)->second >= to) {
+        return false;
+    }
+    if (from > next_) {
+        ahead_[from] = to;
+        return true;
+    }
+    next_ = to + 1;
+    // Пропуск закрыт: диапазоны, пришедшие раньше, присоединяются к префиксу.
+    while (!ahead_.empty() && ahead_.begin()->first <= next_) {
+        next_ = std::max(next_, ahead_.begin()->second + 1);
+        ahead_.erase(ahead_.begin());
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file message_cache.h
+ * @brief Локальный кэш полученных сообщений для мгновенного показа истории при запуске.
+ */
+
+#ifndef MESSAGE_CACHE_H
+#define MESSAGE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Сообщение из кэша.
+ */
+struct CachedMessage {
+    std::optional<uint64_t> offset; ///< Все записи журнала сервера до этого смещения включительно получены; может быть пусто.
+    std::string text;               ///< Текст в том виде, в котором он был показан.
+};
+
+/**
+ * @class MessageCache
+ * @brief Файл только для дозаписи с сообщениями и смещениями журнала сервера.
+ *
+ * При запуске кэш показывается сразу, а у сервера запрашиваются только записи после последнего
+ * сохранённого смещения. Каждая запись - строка "смещение длина" (или "- длина" для своего
+ * сообщения, смещение которого неизвестно) и текст указанной длины.
+ */
+class MessageCache {
+public:
+    /**
+     * @brief Открывает кэш; файл создаётся при первой записи.
+     * @param path Путь к файлу кэша.
+     * @param max_messages Сколько последних сообщений сохраняется при загрузке.
+     */
+    explicit MessageCache(std::string path, std::size_t max_messages = 5000);
+
+    /**
+     * @brief Читает кэш и подготавливает его к дозаписи.
+     *
+     * Оборванная последняя запись и свои сообщения после последнего смещения отбрасываются:
+     * сервер пришлёт их снова вместе с остальными записями после этого смещения.
+     * @return Сообщения в порядке получения.
+     */
+    std::vector<CachedMessage> load();
+
+    /**
+     * @brief Дописывает сообщение в кэш.
+     * @param text Текст сообщения.
+     * @param offset Смещение, до которого включительно получены все записи журнала (ReceivedOffsets::next() - 1);
+     * пусто для своих сообщений без номера и сообщений, пришедших после пропуска.
+     */
+    void append(const std::string& text, std::optional<uint64_t> offset);
+
+    /**
+     * @brief Смещение, с которого нужно запросить историю у сервера (0 - вся история).
+     */
+    uint64_t resume_offset() const;
+
+private:
+    std::string path_;
+    std::size_t max_messages_;
+    mutable std::mutex mutex_;
+    std::ofstream out_;
+    std::optional<uint64_t> last_offset_;
+
+    void rewrite(const std::vector<CachedMessage>& messages);
+    void write_record(std::ostream& out, const CachedMessage& message);
+};
+
+/**
+ * @class ReceivedOffsets
+ * @brief Номера записей журнала сервера, полученные клиентом.
+ *
+ * Хранит непрерывно полученный префикс и диапазоны, пришедшие после пропуска: рассылка может
+ * обогнать пачку истории, а подтверждение своего сообщения - следующие сообщения чата.
+ * Возобновление и подтверждения используют только непрерывный префикс, поэтому пропущенная
+ * запись будет запрошена снова, а повторно присланная - распознана и отброшена.
+ */
+class ReceivedOffsets {
+public:
+    /**
+     * @param next Номер первой ещё не полученной записи.
+     */
+    explicit ReceivedOffsets(uint64_t next = 0) : next_(next) {}
+
+    /**
+     * @brief Отмечает полученными записи с from по to включительно.
+     * @return Ложь, если запись to уже была получена: сообщение - повтор.
+     */
+    bool receive(uint64_t from, uint64_t to);
+
+    /**
+     * @brief Номер первой записи, которой ещё нет в непрерывном префиксе.
+     */
+    uint64_t next() const { return next_; }
+
+    /**
+     * @brief Получены ли все записи до to включительно.
+     */
+    bool contiguous(uint64_t to) const { return to < next_; }
+
+private:
+    uint64_t next_;
+    std::map<uint64_t, uint64_t> ahead_; ///< Диапазоны после пропуска: начало -> конец.
+};
+
+#endif // MESSAGE_CACHE_H
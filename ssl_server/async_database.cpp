@@ -0,0 +1,300 @@
+/**
+ * @file async_database.cpp
+ * @brief Реализация неблокирующего клиента PostgreSQL.
+ */
+
+#include "async_database.h"
+#include "logger.h"
+#include <stdexcept>
+
+namespace asio = boost::asio;
+
+namespace {
+
+// Наибольшее время переподключения; libpq не ограничивает его сама, когда подключение ведёт приложение.
+constexpr std::chrono::seconds kReconnectTimeout{10};
+
+// Переводит соединение в неблокирующий режим конвейера.
+bool enter_pipeline(PGconn* conn) {
+    return PQsetnonblocking(conn, 1) == 0 && PQenterPipelineMode(conn) == 1;
+}
+
+} // namespace
+
+AsyncDatabase::AsyncDatabase(asio::io_context& ioc, const std::string& conninfo)
+    : strand_(asio::make_strand(ioc)),
+      socket_(ioc),
+      reconnect_timer_(strand_),
+      conninfo_(conninfo),
+      query_seconds_(MetricsRegistry::instance().histogram("chat_db_async_query_seconds",
+                                                           "Pipelined query latency from submission to result", latency_buckets())) {
+    conn_ = PQconnectdb(conninfo_.c_str());
+    if (PQstatus(conn_) != CONNECTION_OK || !enter_pipeline(conn_)) {
+        std::string error = PQerrorMessage(conn_);
+        PQfinish(conn_);
+        throw std::runtime_error("Can't open database: " + error);
+    }
+    attach_socket();
+    Logger::instance().log(LogLevel::info, "db_async_connected", {{"db", PQdb(conn_)}});
+}
+
+AsyncDatabase::~AsyncDatabase() {
+    // Дескриптор принадлежит libpq и закрывается в PQfinish.
+    socket_.release();
+    PQfinish(conn_);
+}
+
+void AsyncDatabase::prepare(const std::string& name, const std::string& sql, Handler handler) {
+    submit({Kind::prepare, name, sql, {}, std::move(handler), {}, {}});
+}
+
+void AsyncDatabase::execute(const std::string& sql, std::vector<std::string> params, Handler handler) {
+    submit({Kind::query, sql, {}, std::move(params), std::move(handler), {}, {}});
+}
+
+void AsyncDatabase::execute_prepared(const std::string& name, std::vector<std::string> params, Handler handler) {
+    submit({Kind::prepared, name, {}, std::move(params), std::move(handler), {}, {}});
+}
+
+void AsyncDatabase::submit(Request request) {
+    in_flight_.fetch_add(1, std::memory_order_relaxed);
+    request.submitted = std::chrono::steady_clock::now();
+    // Все вызовы libpq выполняются в strand_, поэтому соединение не требует мьютекса.
+    asio::post(strand_, [this, request = std::move(request)]() mutable {
+        if (request.kind == Kind::prepare) {
+            statements_[request.text] = request.sql;
+        }
+        if (!connecting_ && PQstatus(conn_) != CONNECTION_OK) {
+            reconnect();
+        }
+        if (connecting_) {
+            waiting_.push_back(std::move(request));
+            return;
+        }
+        send(request);
+    });
+}
+
+void AsyncDatabase::send(Request& request) {
+    std::vector<const char*> values;
+    values.reserve(request.params.size());
+    for (const auto& param : request.params) {
+        values.push_back(param.c_str());
+    }
+    int count = static_cast<int>(values.size());
+
+    int sent = 0;
+    switch (request.kind) {
+    case Kind::prepare:
+        sent = PQsendPrepare(conn_, request.text.c_str(), request.sql.c_str(), 0, nullptr);
+        break;
+    case Kind::query:
+        sent = PQsendQueryParams(conn_, request.text.c_str(), count, nullptr, values.data(), nullptr, nullptr, 0);
+        break;
+    case Kind::prepared:
+        sent = PQsendQueryPrepared(conn_, request.text.c_str(), count, values.data(), nullptr, nullptr, 0);
+        break;
+    }
+    // Точка синхронизации после каждого запроса: у каждого запроса своя неявная транзакция.
+    if (!sent || !PQpipelineSync(conn_)) {
+        request.result.error = PQerrorMessage(conn_);
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        if (request.handler) {
+            request.handler(request.result);
+        }
+        return;
+    }
+    sent_.push_back(std::move(request));
+    flush();
+    wait_readable();
+}
+
+void AsyncDatabase::flush() {
+    if (writing_) {
+        return;
+    }
+    int rc = PQflush(conn_);
+    if (rc == 1) {
+        // Буфер сокета заполнен: остаток уйдёт, когда сокет станет доступен для записи.
+        writing_ = true;
+        socket_.async_wait(asio::posix::stream_descriptor::wait_write,
+                           asio::bind_executor(strand_, [this](boost::system::error_code ec) {
+                               if (ec) {
+                                   return;
+                               }
+                               writing_ = false;
+                               flush();
+                           }));
+    } else if (rc == -1) {
+        fail_all(PQerrorMessage(conn_));
+    }
+}
+
+void AsyncDatabase::wait_readable() {
+    if (reading_ || sent_.empty()) {
+        return;
+    }
+    reading_ = true;
+    socket_.async_wait(asio::posix::stream_descriptor::wait_read,
+                       asio::bind_executor(strand_, [this](boost::system::error_code ec) {
+                           if (ec) {
+                               return;
+                           }
+                           reading_ = false;
+                           on_readable();
+                       }));
+}
+
+void AsyncDatabase::on_readable() {
+    if (!PQconsumeInput(conn_)) {
+        fail_all(PQerrorMessage(conn_));
+        return;
+    }
+
+    // Результаты запроса идут подряд и завершаются nullptr, затем приходит его точка синхронизации.
+    int empty_in_row = 0;
+    while (!sent_.empty() && !PQisBusy(conn_)) {
+        PGresult* res = PQgetResult(conn_);
+        if (!res) {
+            if (++empty_in_row > 1) {
+                break;
+            }
+            continue;
+        }
+        empty_in_row = 0;
+
+        Request& front = sent_.front();
+        switch (PQresultStatus(res)) {
+        case PGRES_PIPELINE_SYNC: {
+            Request done = std::move(front);
+            sent_.pop_front();
+            in_flight_.fetch_sub(1, std::memory_order_relaxed);
+            query_seconds_.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - done.submitted).count());
+            if (done.handler) {
+                done.handler(done.result);
+            }
+            break;
+        }
+        case PGRES_TUPLES_OK: {
+            int rows = PQntuples(res);
+            int columns = PQnfields(res);
+            for (int row = 0; row < rows; ++row) {
+                std::vector<std::string> values;
+                values.reserve(columns);
+                for (int column = 0; column < columns; ++column) {
+                    values.emplace_back(PQgetvalue(res, row, column), PQgetlength(res, row, column));
+                }
+                front.result.rows.push_back(std::move(values));
+            }
+            break;
+        }
+        case PGRES_COMMAND_OK: {
+            const char* affected = PQcmdTuples(res);
+            front.result.affected = *affected ? std::stoull(affected) : 0;
+            break;
+        }
+        case PGRES_PIPELINE_ABORTED:
+            front.result.error = "pipeline aborted";
+            break;
+        default:
+            front.result.error = PQresultErrorMessage(res);
+            break;
+        }
+        PQclear(res);
+    }
+    if (!sent_.empty()) {
+        wait_readable();
+    }
+}
+
+void AsyncDatabase::fail_all(const std::string& error) {
+    Logger::instance().log(LogLevel::warn, "db_async_failed", {{"error", error}, {"pending", sent_.size()}});
+    std::deque<Request> failed;
+    failed.swap(sent_);
+    for (auto& request : failed) {
+        request.result.error = error;
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        if (request.handler) {
+            request.handler(request.result);
+        }
+    }
+}
+
+void AsyncDatabase::reconnect() {
+    // Ожидания на старом дескрипторе отменяются; их обработчики увидят ошибку и ничего не сделают.
+    socket_.release();
+    reading_ = false;
+    writing_ = false;
+    connecting_ = true;
+    ++connect_attempt_;
+    if (!PQresetStart(conn_)) {
+        finish_reconnect(false);
+        return;
+    }
+    reconnect_timer_.expires_after(kReconnectTimeout);
+    reconnect_timer_.async_wait([this, attempt = connect_attempt_](boost::system::error_code ec) {
+        if (ec || !connecting_ || attempt != connect_attempt_) {
+            return;
+        }
+        socket_.release();
+        finish_reconnect(false);
+    });
+    poll_reconnect(PGRES_POLLING_WRITING);
+}
+
+void AsyncDatabase::poll_reconnect(PostgresPollingStatusType status) {
+    if (status == PGRES_POLLING_OK || status == PGRES_POLLING_FAILED) {
+        reconnect_timer_.cancel();
+        finish_reconnect(status == PGRES_POLLING_OK);
+        return;
+    }
+    // libpq может сменить сокет на любом шаге (например, перейти к следующему адресу), поэтому
+    // дескриптор подключается заново перед каждым ожиданием.
+    socket_.release();
+    socket_.assign(PQsocket(conn_));
+    auto wait = status == PGRES_POLLING_READING ? asio::posix::stream_descriptor::wait_read
+                                                : asio::posix::stream_descriptor::wait_write;
+    socket_.async_wait(wait, asio::bind_executor(strand_, [this, attempt = connect_attempt_](boost::system::error_code ec) {
+        if (ec || !connecting_ || attempt != connect_attempt_) {
+            return;
+        }
+        poll_reconnect(PQresetPoll(conn_));
+    }));
+}
+
+void AsyncDatabase::finish_reconnect(bool connected) {
+    connecting_ = false;
+    std::deque<Request> waiting;
+    waiting.swap(waiting_);
+    if (!connected || !enter_pipeline(conn_)) {
+        socket_.release();
+        std::string error = *PQerrorMessage(conn_) ? PQerrorMessage(conn_) : "database reconnect timed out";
+        Logger::instance().log(LogLevel::warn, "db_async_reconnect_failed", {{"error", error}, {"pending", waiting.size()}});
+        // Ждавшие запросы завершаются ошибкой; следующий запрос начнёт новую попытку.
+        for (auto& request : waiting) {
+            request.result.error = error;
+            in_flight_.fetch_sub(1, std::memory_order_relaxed);
+            if (request.handler) {
+                request.handler(request.result);
+            }
+        }
+        return;
+    }
+    socket_.release();
+    attach_socket();
+    Logger::instance().log(LogLevel::info, "db_async_reconnected", {{"db", PQdb(conn_)}});
+
+    // Подготовленные запросы живут в сессии сервера и после переподключения регистрируются заново.
+    for (const auto& [name, sql] : statements_) {
+        in_flight_.fetch_add(1, std::memory_order_relaxed);
+        Request request{Kind::prepare, name, sql, {}, nullptr, std::chrono::steady_clock::now(), {}};
+        send(request);
+    }
+    for (auto& request : waiting) {
+        send(request);
+    }
+}
+
+void AsyncDatabase::attach_socket() {
+    socket_.assign(PQsocket(conn_));
+}
@@ -0,0 +1,140 @@
+/**
+ * @file async_database.h
+ * @brief Неблокирующий клиент PostgreSQL на libpq, работающий в цикле asio::io_context.
+ */
+
+#ifndef ASYNC_DATABASE_H
+#define ASYNC_DATABASE_H
+
+#include <utility> // Boost 1.74 использует std::exchange в awaitable.hpp, не подключая <utility>
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <libpq-fe.h>
+#include "metrics.h"
+
+/**
+ * @brief Результат запроса.
+ */
+struct QueryResult {
+    std::string error;                          ///< Текст ошибки; пустой при успехе.
+    std::vector<std::vector<std::string>> rows; ///< Строки результата; NULL передаётся пустой строкой.
+    uint64_t affected = 0;                      ///< Число затронутых строк для INSERT/UPDATE/DELETE.
+
+    bool ok() const { return error.empty(); }
+};
+
+/**
+ * @brief Клиент PostgreSQL, не блокирующий вызывающий поток.
+ *
+ * Запросы отправляются через асинхронный API libpq в режиме конвейера (pipeline mode):
+ * следующий запрос уходит, не дожидаясь ответа на предыдущий, и на одном соединении
+ * одновременно выполняется много запросов. Готовность сокета ожидается в io_context,
+ * обработчики завершения вызываются в его потоке в порядке отправки запросов.
+ *
+ * После каждого запроса отправляется точка синхронизации, поэтому каждый запрос выполняется
+ * в своей неявной транзакции и ошибка одного не отменяет остальные.
+ * Разорванное соединение восстанавливается так же, по готовности сокета (PQresetStart/PQresetPoll):
+ * пока сервер базы недоступен, поток io_context не блокируется, а новые запросы ждут в очереди.
+ * Методы можно вызывать из любого потока.
+ */
+class AsyncDatabase {
+public:
+    /**
+     * @brief Обработчик завершения запроса. Вызывается в потоке io_context и не должен бросать исключений.
+     */
+    using Handler = std::function<void(const QueryResult&)>;
+
+    /**
+     * @brief Подключается к базе (подключение синхронное) и переводит соединение в режим конвейера.
+     * @param ioc Цикл событий, в котором ожидается готовность сокета.
+     * @param conninfo Строка подключения libpq.
+     * @throws std::runtime_error если подключиться не удалось.
+     */
+    AsyncDatabase(boost::asio::io_context& ioc, const std::string& conninfo);
+
+    /**
+     * @brief Закрывает соединение. Обработчики незавершённых запросов не вызываются.
+     */
+    ~AsyncDatabase();
+
+    AsyncDatabase(const AsyncDatabase&) = delete;
+    AsyncDatabase& operator=(const AsyncDatabase&) = delete;
+
+    /**
+     * @brief Регистрирует подготовленный запрос; после переподключения он регистрируется снова.
+     * @param name Имя подготовленного запроса.
+     * @param sql SQL-запрос с параметрами $1, $2, ...
+     * @param handler Обработчик завершения (необязателен).
+     */
+    void prepare(const std::string& name, const std::string& sql, Handler handler = nullptr);
+
+    /**
+     * @brief Выполняет запрос с параметрами.
+     * @param sql SQL-запрос с параметрами $1, $2, ...
+     * @param params Значения параметров в текстовом виде.
+     * @param handler Обработчик завершения (необязателен).
+     */
+    void execute(const std::string& sql, std::vector<std::string> params, Handler handler = nullptr);
+
+    /**
+     * @brief Выполняет подготовленный запрос.
+     * @param name Имя подготовленного запроса.
+     * @param params Значения параметров в текстовом виде.
+     * @param handler Обработчик завершения (необязателен).
+     */
+    void execute_prepared(const std::string& name, std::vector<std::string> params, Handler handler = nullptr);
+
+    /**
+     * @brief Число отправленных или ожидающих отправки запросов без результата.
+     */
+    std::size_t in_flight() const { return in_flight_.load(std::memory_order_relaxed); }
+
+private:
+    enum class Kind { query, prepared, prepare };
+
+    struct Request {
+        Kind kind;
+        std::string text; ///< SQL или имя подготовленного запроса.
+        std::string sql;  ///< SQL для Kind::prepare.
+        std::vector<std::string> params;
+        Handler handler;
+        std::chrono::steady_clock::time_point submitted;
+        QueryResult result;
+    };
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    boost::asio::posix::stream_descriptor socket_;
+    boost::asio::steady_timer reconnect_timer_;
+    std::string conninfo_;
+    PGconn* conn_ = nullptr;
+    std::map<std::string, std::string> statements_; ///< Подготовленные запросы для повторной регистрации.
+    std::deque<Request> sent_;                      ///< Запросы в конвейере в порядке отправки.
+    std::deque<Request> waiting_;                   ///< Запросы, ждущие окончания переподключения.
+    bool reading_ = false;
+    bool writing_ = false;
+    bool connecting_ = false;                       ///< Идёт переподключение (PQresetStart/PQresetPoll).
+    uint64_t connect_attempt_ = 0;                  ///< Номер переподключения: ожидания прежних попыток игнорируются.
+    std::atomic<std::size_t> in_flight_{0};
+    Histogram& query_seconds_;
+
+    void submit(Request request);
+    void send(Request& request);
+    void flush();
+    void wait_readable();
+    void on_readable();
+    void fail_all(const std::string& error);
+    void reconnect();
+    void poll_reconnect(PostgresPollingStatusType status);
+    void finish_reconnect(bool connected);
+    void attach_socket();
+};
+
+#endif // ASYNC_DATABASE_H
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include "async_database.h"
+#include <algorithm>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <thread>
+
+namespace {
+
+// Тесты работают с настоящим сервером PostgreSQL, строка подключения задаётся переменной окружения.
+const char* test_database() {
+    return std::getenv("CHAT_TEST_DATABASE");
+}
+
+class AsyncDatabaseTest : public ::testing::Test {
+protected:
+    boost::asio::io_context ioc;
+    std::unique_ptr<AsyncDatabase> db;
+    std::thread runner;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{ioc.get_executor()};
+
+    void SetUp() override {
+        if (!test_database()) {
+            GTEST_SKIP() << "CHAT_TEST_DATABASE is not set";
+        }
+        db = std::make_unique<AsyncDatabase>(ioc, test_database());
+        runner = std::thread([this] { ioc.run(); });
+    }
+
+    void TearDown() override {
+        if (runner.joinable()) {
+            work.reset();
+            ioc.stop();
+            runner.join();
+        }
+    }
+
+    QueryResult run(const std::string& sql, std::vector<std::string> params = {}) {
+        std::promise<QueryResult> done;
+        db->execute(sql, std::move(params), [&done](const QueryResult& result) { done.set_value(result); });
+        return done.get_future().get();
+    }
+};
+
+} // namespace
+
+TEST_F(AsyncDatabaseTest, PipelinesQueriesAndCompletesInOrder) {
+    ASSERT_TRUE(run("CREATE TEMP TABLE pipeline_test (n integer)").ok());
+
+    constexpr int kQueries = 200;
+    std::vector<int> order;
+    std::promise<void> all;
+    for (int i = 0; i < kQueries; ++i) {
+        db->execute("INSERT INTO pipeline_test VALUES ($1)", {std::to_string(i)}, [&, i](const QueryResult& result) {
+            EXPECT_TRUE(result.ok()) << result.error;
+            EXPECT_EQ(result.affected, 1u);
+            order.push_back(i);
+            if (i == kQueries - 1) {
+                all.set_value();
+            }
+        });
+    }
+    all.get_future().wait();
+    ASSERT_EQ(order.size(), static_cast<std::size_t>(kQueries));
+    EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+
+    QueryResult count = run("SELECT count(*) FROM pipeline_test");
+    ASSERT_EQ(count.rows.size(), 1u);
+    EXPECT_EQ(count.rows[0][0], std::to_string(kQueries));
+}
+
+TEST_F(AsyncDatabaseTest, FailedQueryDoesNotAbortOthers) {
+    std::promise<QueryResult> bad;
+    db->execute("SELECT * FROM no_such_table", {}, [&bad](const QueryResult& result) { bad.set_value(result); });
+    QueryResult good = run("SELECT $1::text", {"ok"});
+
+    EXPECT_FALSE(bad.get_future().get().ok());
+    ASSERT_TRUE(good.ok()) << good.error;
+    EXPECT_EQ(good.rows[0][0], "ok");
+}
+
+TEST_F(AsyncDatabaseTest, RunsPreparedStatements) {
+    db->prepare("async_test_add", "SELECT $1::int + $2::int");
+    std::promise<QueryResult> sum;
+    db->execute_prepared("async_test_add", {"2", "3"}, [&sum](const QueryResult& result) { sum.set_value(result); });
+    QueryResult result = sum.get_future().get();
+    ASSERT_TRUE(result.ok()) << result.error;
+    EXPECT_EQ(result.rows[0][0], "5");
+    EXPECT_EQ(db->in_flight(), 0u);
+}
+
+TEST_F(AsyncDatabaseTest, ReconnectsAfterConnectionLoss) {
+    db->prepare("async_test_echo", "SELECT $1::text");
+    EXPECT_FALSE(run("SELECT pg_terminate_backend(pg_backend_pid())").ok());
+
+    // Запросы, отправленные во время переподключения, ждут его и выполняются после повторной подготовки.
+    std::promise<QueryResult> echo;
+    db->execute_prepared("async_test_echo", {"again"}, [&echo](const QueryResult& result) { echo.set_value(result); });
+    QueryResult plain = run("SELECT 1");
+    QueryResult result = echo.get_future().get();
+    ASSERT_TRUE(result.ok()) << result.error;
+    EXPECT_EQ(result.rows[0][0], "again");
+    EXPECT_TRUE(plain.ok()) << plain.error;
+    EXPECT_EQ(db->in_flight(), 0u);
+}
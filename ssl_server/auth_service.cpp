@@ -0,0 +1,209 @@
+/**
+ * @file auth_service.cpp
+ * @brief Реализация сервиса аутентификации и кеша подтверждённых входов.
+ */
+
+#include "auth_service.h"
+#include "logger.h"
+#include <openssl/evp.h>
+
+namespace asio = boost::asio;
+
+CredentialCache::CredentialCache(std::size_t capacity, std::chrono::milliseconds ttl)
+    : capacity_(capacity), ttl_(ttl) {}
+
+bool CredentialCache::contains(const std::string& login, const std::string& digest) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(login);
+    if (it == index_.end()) {
+        return false;
+    }
+    if (it->second->expires <= clock::now()) {
+        lru_.erase(it->second);
+        index_.erase(it);
+        return false;
+    }
+    if (it->second->digest != digest) {
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return true;
+}
+
+void CredentialCache::insert(const std::string& login, const std::string& digest) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0) {
+        return;
+    }
+    auto expires = clock::now() + ttl_;
+    auto it = index_.find(login);
+    if (it != index_.end()) {
+        it->second->digest = digest;
+        it->second->expires = expires;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+    if (lru_.size() >= capacity_) {
+        index_.erase(lru_.back().login);
+        lru_.pop_back();
+    }
+    lru_.push_front({login, digest, expires});
+    index_[login] = lru_.begin();
+}
+
+void CredentialCache::invalidate(const std::string& login) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(login);
+    if (it != index_.end()) {
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+}
+
+std::size_t CredentialCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
+
+std::string credential_digest(const std::string& login, const std::string& password) {
+    std::string input = login + '\n' + password;
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_Digest(input.data(), input.size(), digest, &length, EVP_sha256(), nullptr);
+    return std::string(reinterpret_cast<const char*>(digest), length);
+}
+
+AuthService::AuthService(DatabaseManager& db, HashWorkerPool& pool, asio::thread_pool& db_pool, std::size_t cache_capacity,
+                         std::chrono::milliseconds ttl, ScryptParams params)
+    : db_(db), pool_(pool), db_pool_(db_pool), cache_(cache_capacity, ttl), params_(params),
+      verify_seconds_(MetricsRegistry::instance().histogram(
+          "chat_auth_verify_seconds", "Password verification latency including hash pool queueing", latency_buckets())),
+      busy_total_(MetricsRegistry::instance().counter(
+          "chat_auth_busy_total", "Logins and registrations rejected because the hash pool queue was full")) {
+    db_.prepare("auth_user_exists", "SELECT EXISTS (SELECT 1 FROM users WHERE name = $1)");
+    db_.prepare("auth_fetch_password", "SELECT password FROM users WHERE name = $1");
+    db_.prepare("auth_register", "INSERT INTO users (name, password) VALUES ($1, $2) ON CONFLICT DO NOTHING");
+    db_.prepare("auth_upgrade_password", "UPDATE users SET password = $2 WHERE name = $1 AND password = $3");
+}
+
+template <typename F>
+asio::awaitable<std::invoke_result_t<F>> AuthService::on_db(F task) {
+    co_return co_await asio::co_spawn(db_pool_, [task = std::move(task)]() mutable
+            -> asio::awaitable<std::invoke_result_t<F>> { co_return task(); }, asio::use_awaitable);
+}
+
+template <typename F>
+asio::awaitable<std::optional<std::invoke_result_t<F>>> AuthService::on_hash_pool(F task) {
+    using R = std::invoke_result_t<F>;
+    auto executor = co_await asio::this_coro::executor;
+    co_return co_await asio::async_initiate<const asio::use_awaitable_t<>&, void(std::exception_ptr, std::optional<R>)>(
+        [this, &task, executor](auto handler) {
+            // Очередь пула хранит копируемые задачи, а обработчик корутины только перемещается.
+            auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+            auto resume = [shared, executor](std::exception_ptr error, std::optional<R> result) {
+                asio::post(executor, [shared, error, result = std::move(result)]() mutable {
+                    std::move(*shared)(error, std::move(result));
+                });
+            };
+            if (!pool_.try_submit(std::move(task), [resume](std::exception_ptr error, R result) { resume(error, std::move(result)); })) {
+                busy_total_.inc();
+                resume(nullptr, std::nullopt);
+            }
+        },
+        asio::use_awaitable);
+}
+
+AuthStatus AuthService::db_failed(const std::string& login, const std::exception& error) {
+    Logger::instance().log(LogLevel::warn, "auth_db_failed", {{"user", login}, {"error", error.what()}});
+    return AuthStatus::unavailable;
+}
+
+asio::awaitable<AuthStatus> AuthService::verify(std::string login, std::string password) {
+    if (login.empty()) {
+        co_return AuthStatus::rejected;
+    }
+    std::string digest = credential_digest(login, password);
+    if (cache_.contains(login, digest)) {
+        co_return AuthStatus::ok;
+    }
+    std::optional<std::string> stored;
+    try {
+        stored = co_await on_db([this, login]() -> std::optional<std::string> {
+            auto result = db_.fetch_prepared("auth_fetch_password", login);
+            if (result.empty()) {
+                return std::nullopt;
+            }
+            return result[0][0].as<std::string>();
+        });
+    } catch (const pqxx::failure& e) {
+        co_return db_failed(login, e);
+    }
+    if (!stored) {
+        co_return AuthStatus::rejected;
+    }
+
+    std::optional<bool> matches;
+    {
+        ScopedTimer timer(verify_seconds_);
+        matches = co_await on_hash_pool([password, stored = *stored] { return verify_password(password, stored); });
+    }
+    if (!matches) {
+        co_return AuthStatus::busy;
+    }
+    if (!*matches) {
+        co_return AuthStatus::rejected;
+    }
+
+    if (!is_password_hash(*stored)) {
+        // Перехеширование - не обязательный шаг: при перегрузке пула или ошибке базы оно случится при следующем входе.
+        if (auto upgraded = co_await on_hash_pool([password, params = params_] { return hash_password(password, params); })) {
+            try {
+                co_await on_db([this, login, upgraded = *upgraded, old = *stored] {
+                    db_.execute_prepared("auth_upgrade_password", login, upgraded, old);
+                });
+            } catch (const pqxx::failure& e) {
+                db_failed(login, e);
+            }
+        }
+    }
+    cache_.insert(login, digest);
+    co_return AuthStatus::ok;
+}
+
+bool AuthService::user_exists(const std::string& login) {
+    auto result = db_.fetch_prepared("auth_user_exists", login);
+    return !result.empty() && result[0][0].as<bool>();
+}
+
+asio::awaitable<AuthStatus> AuthService::register_user(std::string login, std::string password) {
+    // Занятое имя отклоняется до хеширования: повторные попытки не тратят время пула.
+    try {
+        if (co_await on_db([this, login] { return user_exists(login); })) {
+            co_return AuthStatus::rejected;
+        }
+    } catch (const pqxx::failure& e) {
+        co_return db_failed(login, e);
+    }
+    auto hash = co_await on_hash_pool([password, params = params_] { return hash_password(password, params); });
+    if (!hash) {
+        co_return AuthStatus::busy;
+    }
+    // Имя могли занять, пока считался хеш: тогда строка не вставляется.
+    bool inserted = false;
+    try {
+        inserted = co_await on_db([this, login, hash = *hash] {
+            return db_.execute_prepared("auth_register", login, hash).affected_rows() != 0;
+        });
+    } catch (const pqxx::failure& e) {
+        co_return db_failed(login, e);
+    }
+    if (!inserted) {
+        co_return AuthStatus::rejected;
+    }
+    cache_.invalidate(login);
+    co_return AuthStatus::ok;
+}
+
+void AuthService::invalidate(const std::string& login) {
+    cache_.invalidate(login);
+}
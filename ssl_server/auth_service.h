@@ -0,0 +1,173 @@
+/**
+ * @file auth_service.h
+ * @brief Проверка учётных данных пользователей с кешем недавно подтверждённых входов.
+ */
+
+#ifndef AUTH_SERVICE_H
+#define AUTH_SERVICE_H
+
+#include <utility> // Boost 1.74 использует std::exchange в awaitable.hpp, не подключая <utility>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include "database_manager.h"
+#include "password_hasher.h"
+#include "metrics.h"
+
+/**
+ * @brief LRU-кеш подтверждённых учётных данных с ограниченным временем жизни записей.
+ *
+ * Для каждого логина хранится только дайджест пары логин/пароль, сам пароль в памяти не остаётся.
+ */
+class CredentialCache {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Конструктор кеша.
+     * @param capacity Максимальное число хранимых логинов.
+     * @param ttl Время, в течение которого подтверждённый вход считается действительным.
+     */
+    CredentialCache(std::size_t capacity, std::chrono::milliseconds ttl);
+
+    /**
+     * @brief Проверяет, был ли этот дайджест недавно подтверждён для логина.
+     * @param login Имя пользователя.
+     * @param digest Дайджест учётных данных.
+     * @return Истина, если запись есть в кеше и не устарела.
+     */
+    bool contains(const std::string& login, const std::string& digest);
+
+    /**
+     * @brief Запоминает подтверждённые учётные данные, вытесняя самую старую запись при переполнении.
+     * @param login Имя пользователя.
+     * @param digest Дайджест учётных данных.
+     */
+    void insert(const std::string& login, const std::string& digest);
+
+    /**
+     * @brief Удаляет запись пользователя из кеша.
+     * @param login Имя пользователя.
+     */
+    void invalidate(const std::string& login);
+
+    /**
+     * @brief Текущее число записей в кеше.
+     */
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        std::string login;
+        std::string digest;
+        clock::time_point expires;
+    };
+
+    std::size_t capacity_;
+    std::chrono::milliseconds ttl_;
+    std::list<Entry> lru_; ///< Начало списка - последние использованные записи.
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    mutable std::mutex mutex_;
+};
+
+/**
+ * @brief Результат операции аутентификации.
+ */
+enum class AuthStatus {
+    ok,       ///< Операция выполнена.
+    rejected, ///< Неверные учётные данные или имя уже занято.
+    busy,       ///< Очередь хеширования заполнена, клиенту следует повторить попытку позже.
+    unavailable ///< База данных не ответила; клиенту следует повторить попытку позже.
+};
+
+/**
+ * @brief Сервис аутентификации: подготовленные параметризованные запросы к таблице users и кеш входов.
+ *
+ * Пароли хранятся в виде scrypt-хешей. Хеширование выполняется в отдельном пуле потоков,
+ * чтобы наплыв входов не отнимал процессор у потоков, доставляющих сообщения. Проверка и
+ * регистрация - корутины: запросы к базе уходят в пул блокирующих вызовов, а результат хеширования
+ * возвращается в исполнитель вызывающей корутины, так что ни один поток не ждёт пул хеширования.
+ */
+class AuthService {
+public:
+    /**
+     * @brief Конструктор сервиса, регистрирующий подготовленные запросы на соединении.
+     * @param db Менеджер базы данных.
+     * @param pool Пул потоков для хеширования паролей.
+     * @param db_pool Пул, в котором выполняются блокирующие запросы к db.
+     * @param cache_capacity Размер кеша подтверждённых входов.
+     * @param ttl Время жизни записи в кеше.
+     * @param params Параметры scrypt для новых хешей.
+     */
+    AuthService(DatabaseManager& db, HashWorkerPool& pool, boost::asio::thread_pool& db_pool,
+                std::size_t cache_capacity = 4096, std::chrono::milliseconds ttl = std::chrono::minutes(5),
+                ScryptParams params = {});
+
+    /**
+     * @brief Проверяет пару логин/пароль, обращаясь к базе и scrypt только при промахе кеша.
+     *
+     * Пароль старого формата после успешной проверки перехешируется scrypt.
+     * @param login Имя пользователя.
+     * @param password Пароль, присланный клиентом.
+     * @return ok, rejected, busy (очередь хеширования заполнена) или unavailable.
+     */
+    boost::asio::awaitable<AuthStatus> verify(std::string login, std::string password);
+
+    /**
+     * @brief Проверяет, зарегистрирован ли пользователь. Блокирует поток на запрос к базе.
+     * @param login Имя пользователя.
+     */
+    bool user_exists(const std::string& login);
+
+    /**
+     * @brief Регистрирует нового пользователя.
+     *
+     * Одновременная регистрация того же имени не приводит к ошибке: вставка с ON CONFLICT DO NOTHING
+     * не добавляет строку, и второй запрос получает rejected.
+     * @param login Имя пользователя.
+     * @param password Пароль, присланный клиентом.
+     * @return rejected, если имя уже занято; busy или unavailable при перегрузке или ошибке базы.
+     */
+    boost::asio::awaitable<AuthStatus> register_user(std::string login, std::string password);
+
+    /**
+     * @brief Удаляет пользователя из кеша подтверждённых входов.
+     * @param login Имя пользователя.
+     */
+    void invalidate(const std::string& login);
+
+private:
+    DatabaseManager& db_;
+    HashWorkerPool& pool_;
+    boost::asio::thread_pool& db_pool_;
+    CredentialCache cache_;
+    ScryptParams params_;
+
+    Histogram& verify_seconds_; ///< Длительность проверки scrypt, включая ожидание в очереди пула.
+    Counter& busy_total_;       ///< Отказы из-за переполненной очереди пула.
+
+    template <typename F>
+    boost::asio::awaitable<std::invoke_result_t<F>> on_db(F task);
+
+    template <typename F>
+    boost::asio::awaitable<std::optional<std::invoke_result_t<F>>> on_hash_pool(F task);
+
+    AuthStatus db_failed(const std::string& login, const std::exception& error);
+};
+
+/**
+ * @brief Вычисляет дайджест SHA-256 пары логин/пароль для хранения в кеше.
+ * @param login Имя пользователя.
+ * @param password Пароль.
+ * @return Дайджест в двоичном виде.
+ */
+std::string credential_digest(const std::string& login, const std::string& password);
+
+#endif // AUTH_SERVICE_H
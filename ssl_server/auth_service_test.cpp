@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include "auth_service.h"
+#include <chrono>
+#include <thread>
+
+TEST(CredentialCacheTest, RemembersVerifiedCredentials) {
+    CredentialCache cache(4, std::chrono::minutes(1));
+    cache.insert("alice", credential_digest("alice", "secret"));
+
+    EXPECT_TRUE(cache.contains("alice", credential_digest("alice", "secret")));
+    EXPECT_FALSE(cache.contains("alice", credential_digest("alice", "wrong")));
+    EXPECT_FALSE(cache.contains("bob", credential_digest("bob", "secret")));
+}
+
+TEST(CredentialCacheTest, EvictsLeastRecentlyUsed) {
+    CredentialCache cache(2, std::chrono::minutes(1));
+    cache.insert("alice", "a");
+    cache.insert("bob", "b");
+    EXPECT_TRUE(cache.contains("alice", "a")); // alice становится самой свежей записью
+    cache.insert("carol", "c");
+
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_TRUE(cache.contains("alice", "a"));
+    EXPECT_FALSE(cache.contains("bob", "b"));
+    EXPECT_TRUE(cache.contains("carol", "c"));
+}
+
+TEST(CredentialCacheTest, ExpiresAfterTtl) {
+    CredentialCache cache(4, std::chrono::milliseconds(10));
+    cache.insert("alice", "a");
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    EXPECT_FALSE(cache.contains("alice", "a"));
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(CredentialCacheTest, InvalidateRemovesEntry) {
+    CredentialCache cache(4, std::chrono::minutes(1));
+    cache.insert("alice", "a");
+    cache.invalidate("alice");
+
+    EXPECT_FALSE(cache.contains("alice", "a"));
+}
+
+TEST(CredentialDigestTest, DependsOnLoginAndPassword) {
+    EXPECT_EQ(credential_digest("alice", "secret"), credential_digest("alice", "secret"));
+    EXPECT_NE(credential_digest("alice", "secret"), credential_digest("bob", "secret"));
+    EXPECT_EQ(credential_digest("alice", "secret").size(), 32u);
+}
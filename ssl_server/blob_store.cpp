@@ -0,0 +1,265 @@
+/**
+ * @file blob_store.cpp
+ * @brief Реализация хранилища вложений.
+ */
+
+#include "blob_store.h"
+#include <boost/beast/core/file.hpp>
+#include <openssl/evp.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief Хеширует файл по частям размера chunk_bytes.
+ * @return Хеш в шестнадцатеричном виде или пустая строка при ошибке чтения.
+ */
+std::string file_sha256(const fs::path& path, std::size_t chunk_bytes) {
+    beast::error_code ec;
+    beast::file file;
+    file.open(path.c_str(), beast::file_mode::scan, ec);
+    if (ec) {
+        return {};
+    }
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    EVP_DigestInit_ex(context.get(), EVP_sha256(), nullptr);
+    std::string chunk(chunk_bytes, '\0');
+    while (true) {
+        std::size_t n = file.read(chunk.data(), chunk.size(), ec);
+        if (ec) {
+            return {};
+        }
+        if (n == 0) {
+            break;
+        }
+        EVP_DigestUpdate(context.get(), chunk.data(), n);
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(context.get(), digest, &length);
+
+    static constexpr char kHex[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned int i = 0; i < length; ++i) {
+        hex.push_back(kHex[digest[i] >> 4]);
+        hex.push_back(kHex[digest[i] & 0xf]);
+    }
+    return hex;
+}
+
+} // namespace
+
+BlobStore::BlobStore(fs::path root, std::size_t chunk_bytes, uint64_t max_bytes, uint64_t capacity_bytes,
+                     std::chrono::seconds partial_ttl)
+    : root_(std::move(root)), partial_(root_ / "partial"), chunk_bytes_(chunk_bytes), max_bytes_(max_bytes),
+      capacity_bytes_(capacity_bytes), partial_ttl_(partial_ttl) {
+    fs::create_directories(partial_);
+    for (const fs::path& directory : {root_, partial_}) {
+        for (const auto& entry : fs::directory_iterator(directory)) {
+            std::error_code error;
+            if (entry.is_regular_file(error)) {
+                used_ += entry.file_size(error);
+            }
+        }
+    }
+    expire_partial();
+}
+
+BlobStore::IdGuard::IdGuard(BlobStore& store, std::string id) : store_(store), id_(std::move(id)) {
+    {
+        std::lock_guard<std::mutex> lock(store_.mutex_);
+        IdLock& entry = store_.ids_[id_];
+        ++entry.users;
+        // Элементы unordered_map не переезжают при рехешировании, поэтому указатель остаётся верным.
+        mutex_ = &entry.mutex;
+    }
+    mutex_->lock();
+}
+
+BlobStore::IdGuard::~IdGuard() {
+    mutex_->unlock();
+    std::lock_guard<std::mutex> lock(store_.mutex_);
+    auto entry = store_.ids_.find(id_);
+    if (--entry->second.users == 0) {
+        store_.ids_.erase(entry);
+    }
+}
+
+bool BlobStore::valid_id(std::string_view id) {
+    return id.size() == 64 && id.find_first_not_of("0123456789abcdef") == std::string_view::npos;
+}
+
+UploadState BlobStore::append(std::string_view id, uint64_t size, uint64_t offset, std::string_view chunk) {
+    if (!valid_id(id) || size == 0 || size > max_bytes_ || chunk.size() > chunk_bytes_) {
+        return {UploadStatus::rejected, 0};
+    }
+    // Просроченные файлы ищутся до захвата своего идентификатора: поток держит не больше одного IdGuard.
+    if (offset == 0 && !chunk.empty()) {
+        bool sweep = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sweep = ++started_ % kSweepEvery == 0;
+        }
+        if (sweep) {
+            expire_partial();
+        }
+    }
+    IdGuard guard(*this, std::string(id));
+    std::error_code error;
+    fs::path ready = root_ / std::string(id);
+    if (fs::exists(ready, error)) {
+        return {UploadStatus::complete, size};
+    }
+
+    fs::path partial = partial_ / std::string(id);
+    uint64_t stored = fs::exists(partial, error) ? fs::file_size(partial, error) : 0;
+    if (error || stored > size) {
+        if (fs::remove(partial, error)) {
+            release(stored);
+        }
+        return {UploadStatus::rejected, 0};
+    }
+    // Часть не с того места (повтор после разрыва или запрос состояния) не пишется: клиент продолжит со stored.
+    if (offset == stored && !chunk.empty()) {
+        if (offset + chunk.size() > size) {
+            return {UploadStatus::rejected, stored};
+        }
+        if (!reserve(chunk.size())) {
+            return {UploadStatus::busy, stored};
+        }
+        beast::error_code ec;
+        beast::file file;
+        // Режимы beast::file не дописывают сами (append обрезает файл), поэтому запись идёт с явного смещения.
+        file.open(partial.c_str(), stored == 0 ? beast::file_mode::write : beast::file_mode::append_existing, ec);
+        if (!ec) {
+            file.seek(stored, ec);
+        }
+        if (!ec) {
+            file.write(chunk.data(), chunk.size(), ec);
+        }
+        if (ec) {
+            // Часть могла записаться не вся: учёт сверяется с размером файла.
+            release(chunk.size());
+            uint64_t written = fs::file_size(partial, error);
+            if (!error && written > stored) {
+                reserve(written - stored);
+            }
+            return {UploadStatus::rejected, stored};
+        }
+        stored += chunk.size();
+    }
+    if (stored < size) {
+        return {UploadStatus::partial, stored};
+    }
+    if (!finish(partial, id, size)) {
+        return {UploadStatus::rejected, 0};
+    }
+    return {UploadStatus::complete, size};
+}
+
+bool BlobStore::finish(const fs::path& partial, std::string_view id, uint64_t size) {
+    std::error_code error;
+    if (file_sha256(partial, chunk_bytes_) != id) {
+        // Содержимое не совпало с хешем: докачивать нечего, загрузка начнётся заново.
+        if (fs::remove(partial, error)) {
+            release(size);
+        }
+        return false;
+    }
+    // Тот же файл уже готов (его объявили вне этого хранилища или каталог восстановлен): копия не нужна.
+    fs::path ready = root_ / std::string(id);
+    if (fs::exists(ready, error)) {
+        if (fs::remove(partial, error)) {
+            release(size);
+        }
+        return true;
+    }
+    // rename атомарен: читатели видят либо отсутствие файла, либо файл целиком.
+    fs::rename(partial, ready, error);
+    return !error;
+}
+
+std::size_t BlobStore::expire_partial() {
+    auto cutoff = fs::file_time_type::clock::now() - partial_ttl_;
+    std::vector<std::string> stale;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(partial_, error)) {
+        std::error_code entry_error;
+        if (entry.is_regular_file(entry_error) && entry.last_write_time(entry_error) < cutoff && !entry_error) {
+            stale.push_back(entry.path().filename().string());
+        }
+    }
+    std::size_t removed = 0;
+    for (const std::string& id : stale) {
+        // Под блокировкой идентификатора время проверяется снова: загрузку могли продолжить.
+        IdGuard guard(*this, id);
+        fs::path partial = partial_ / id;
+        auto modified = fs::last_write_time(partial, error);
+        if (error || modified >= cutoff) {
+            continue;
+        }
+        uint64_t bytes = fs::file_size(partial, error);
+        if (!error && fs::remove(partial, error)) {
+            release(bytes);
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+uint64_t BlobStore::used_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+}
+
+bool BlobStore::reserve(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bytes > capacity_bytes_ - std::min(used_, capacity_bytes_)) {
+        return false;
+    }
+    used_ += bytes;
+    return true;
+}
+
+void BlobStore::release(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_ -= std::min(used_, bytes);
+}
+
+std::optional<uint64_t> BlobStore::size(std::string_view id) const {
+    if (!valid_id(id)) {
+        return std::nullopt;
+    }
+    std::error_code error;
+    uint64_t bytes = fs::file_size(root_ / std::string(id), error);
+    if (error) {
+        return std::nullopt;
+    }
+    return bytes;
+}
+
+bool BlobStore::read(std::string_view id, uint64_t offset, std::string& out) const {
+    out.clear();
+    if (!valid_id(id)) {
+        return false;
+    }
+    beast::error_code ec;
+    beast::file file;
+    file.open((root_ / std::string(id)).c_str(), beast::file_mode::scan, ec);
+    if (ec) {
+        return false;
+    }
+    file.seek(offset, ec);
+    if (ec) {
+        return false;
+    }
+    out.resize(chunk_bytes_);
+    std::size_t n = file.read(out.data(), out.size(), ec);
+    out.resize(ec ? 0 : n);
+    return !ec;
+}
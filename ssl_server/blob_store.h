@@ -0,0 +1,163 @@
+/**
+ * @file blob_store.h
+ * @brief Хранилище вложений на диске, адресуемых по SHA-256 содержимого, с докачкой по частям.
+ */
+
+#ifndef BLOB_STORE_H
+#define BLOB_STORE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @brief Итог приёма части вложения.
+ */
+enum class UploadStatus {
+    partial,  ///< Принято stored байт; ждём часть с этого смещения.
+    complete, ///< Вложение целиком на диске и совпадает с заявленным хешем.
+    rejected, ///< Неверный идентификатор, размер или часть; загрузку нужно начать заново.
+    busy,     ///< Хранилище заполнено; принятое остаётся на диске до истечения срока, продолжить можно позже.
+};
+
+/**
+ * @brief Состояние загрузки после приёма части.
+ */
+struct UploadState {
+    UploadStatus status = UploadStatus::partial;
+    uint64_t stored = 0; ///< Сколько байт уже на диске: смещение следующей части.
+};
+
+/**
+ * @brief Вложения в каталоге root: готовые - в файлах с именем хеша, недогруженные - в root/partial.
+ *
+ * Клиент присылает вложение частями не длиннее chunk_bytes, каждая - со смещением. Часть,
+ * смещение которой не совпадает с уже принятым объёмом, не записывается: клиент узнаёт
+ * из ответа, с какого места продолжать, поэтому разрыв соединения не требует загружать
+ * файл заново. Когда принят весь объём, файл читается по частям, сверяется с хешем и
+ * переносится к готовым. Одинаковые файлы хранятся один раз. Ни приём, ни отдача
+ * не держат в памяти больше одной части. Методы потокобезопасны и обращаются к диску,
+ * поэтому сервер вызывает append() в blocking_pool.
+ *
+ * Загрузки разных файлов блокируют только свой идентификатор: сверка хеша большого файла
+ * не задерживает остальных. Общий объём готовых и недогруженных файлов ограничен
+ * capacity_bytes, а недогруженные файлы, не менявшиеся дольше partial_ttl, удаляются.
+ */
+class BlobStore {
+public:
+    /**
+     * @param root Каталог хранилища (создаётся при необходимости).
+     * @param chunk_bytes Наибольший размер части при приёме и отдаче.
+     * @param max_bytes Наибольший размер вложения.
+     * @param capacity_bytes Наибольший объём всех файлов хранилища.
+     * @param partial_ttl Через сколько без новых частей недогруженный файл удаляется.
+     * @throws std::filesystem::filesystem_error, если каталог нельзя создать.
+     */
+    BlobStore(std::filesystem::path root, std::size_t chunk_bytes, uint64_t max_bytes,
+              uint64_t capacity_bytes = std::numeric_limits<uint64_t>::max(),
+              std::chrono::seconds partial_ttl = std::chrono::hours(24));
+
+    /**
+     * @brief Идентификатор вложения: SHA-256 содержимого, 64 шестнадцатеричные цифры в нижнем регистре.
+     */
+    static bool valid_id(std::string_view id);
+
+    /**
+     * @brief Принимает часть вложения.
+     * @param id Заявленный хеш вложения.
+     * @param size Заявленный размер вложения.
+     * @param offset Смещение части.
+     * @param chunk Данные части; пустая часть только сообщает, с какого места продолжать.
+     */
+    UploadState append(std::string_view id, uint64_t size, uint64_t offset, std::string_view chunk);
+
+    /**
+     * @brief Размер готового вложения или nullopt, если его нет.
+     */
+    std::optional<uint64_t> size(std::string_view id) const;
+
+    /**
+     * @brief Читает часть готового вложения.
+     * @param out Заполняется не более чем chunk_bytes байтами с offset; пуст за концом файла.
+     * @return Ложь, если вложения нет.
+     */
+    bool read(std::string_view id, uint64_t offset, std::string& out) const;
+
+    /**
+     * @brief Удаляет недогруженные файлы, не менявшиеся дольше partial_ttl.
+     *
+     * Вызывается при создании хранилища и из append() каждые kSweepEvery новых загрузок.
+     * @return Число удалённых файлов.
+     */
+    std::size_t expire_partial();
+
+    /**
+     * @brief Объём готовых и недогруженных файлов, байт.
+     */
+    uint64_t used_bytes() const;
+
+    std::size_t chunk_bytes() const { return chunk_bytes_; }
+
+    /**
+     * @brief Через сколько начатых загрузок append() ищет просроченные недогруженные файлы.
+     */
+    static constexpr std::size_t kSweepEvery = 64;
+
+private:
+    /**
+     * @brief Блокировка одного идентификатора на время приёма части или удаления.
+     */
+    class IdGuard {
+    public:
+        IdGuard(BlobStore& store, std::string id);
+        ~IdGuard();
+
+        IdGuard(const IdGuard&) = delete;
+        IdGuard& operator=(const IdGuard&) = delete;
+
+    private:
+        BlobStore& store_;
+        std::string id_;
+        std::mutex* mutex_;
+    };
+
+    /**
+     * @brief Мьютекс идентификатора и число его ожидающих и владельцев.
+     */
+    struct IdLock {
+        std::mutex mutex;
+        std::size_t users = 0;
+    };
+
+    std::filesystem::path root_;
+    std::filesystem::path partial_;
+    std::size_t chunk_bytes_;
+    uint64_t max_bytes_;
+    uint64_t capacity_bytes_;
+    std::chrono::seconds partial_ttl_;
+    mutable std::mutex mutex_; ///< Защищает ids_, used_ и started_; диск под ним не трогается.
+    std::unordered_map<std::string, IdLock> ids_;
+    uint64_t used_ = 0;
+    std::size_t started_ = 0;
+
+    /**
+     * @brief Занимает bytes из общего объёма.
+     * @return Ложь, если хранилище заполнено.
+     */
+    bool reserve(uint64_t bytes);
+    void release(uint64_t bytes);
+
+    /**
+     * @brief Сверяет недогруженный файл с хешем и переносит его к готовым; вызывается под IdGuard.
+     */
+    bool finish(const std::filesystem::path& partial, std::string_view id, uint64_t size);
+};
+
+#endif // BLOB_STORE_H
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include "blob_store.h"
+#include <openssl/sha.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+class BlobStoreTest : public ::testing::Test {
+protected:
+    fs::path dir;
+
+    void SetUp() override {
+        dir = fs::temp_directory_path() / ("blob_store_test_" + std::to_string(::getpid()));
+        fs::remove_all(dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    static std::string sha256_hex(const std::string& data) {
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), digest);
+        std::string hex;
+        for (unsigned char byte : digest) {
+            hex.push_back("0123456789abcdef"[byte >> 4]);
+            hex.push_back("0123456789abcdef"[byte & 0xf]);
+        }
+        return hex;
+    }
+
+    static std::string content(std::size_t size) {
+        std::string data(size, '\0');
+        for (std::size_t i = 0; i < size; ++i) {
+            data[i] = static_cast<char>('a' + i % 26);
+        }
+        return data;
+    }
+};
+
+TEST_F(BlobStoreTest, ResumesFromStoredOffsetAndVerifiesHash) {
+    BlobStore store(dir, 4096, 1 << 20);
+    std::string data = content(10000);
+    std::string id = sha256_hex(data);
+    std::string_view view(data);
+
+    UploadState state = store.append(id, data.size(), 0, view.substr(0, 4096));
+    EXPECT_EQ(state.status, UploadStatus::partial);
+    EXPECT_EQ(state.stored, 4096u);
+
+    // После разрыва клиент спрашивает, с какого места продолжать; повтор уже принятой части не пишется.
+    EXPECT_EQ(store.append(id, data.size(), 0, {}).stored, 4096u);
+    EXPECT_EQ(store.append(id, data.size(), 0, view.substr(0, 4096)).stored, 4096u);
+    EXPECT_FALSE(store.size(id).has_value());
+
+    EXPECT_EQ(store.append(id, data.size(), 4096, view.substr(4096, 4096)).stored, 8192u);
+    state = store.append(id, data.size(), 8192, view.substr(8192));
+    EXPECT_EQ(state.status, UploadStatus::complete);
+    EXPECT_EQ(store.size(id), data.size());
+
+    // Отдача идёт частями не длиннее chunk_bytes.
+    std::string received, chunk;
+    while (store.read(id, received.size(), chunk) && !chunk.empty()) {
+        EXPECT_LE(chunk.size(), 4096u);
+        received += chunk;
+    }
+    EXPECT_TRUE(received == data);
+
+    // Тот же файл второй раз не загружается.
+    EXPECT_EQ(store.append(id, data.size(), 0, {}).status, UploadStatus::complete);
+}
+
+TEST_F(BlobStoreTest, RejectsMismatchedContentAndInvalidRequests) {
+    BlobStore store(dir, 4096, 8192);
+    std::string data = content(100);
+    std::string wrong_id = sha256_hex("other");
+
+    EXPECT_EQ(store.append(wrong_id, data.size(), 0, data).status, UploadStatus::rejected);
+    EXPECT_EQ(store.append(wrong_id, data.size(), 0, {}).stored, 0u); // Недогруженный файл удалён
+    EXPECT_FALSE(store.size(wrong_id).has_value());
+
+    std::string id = sha256_hex(data);
+    EXPECT_EQ(store.append("../" + id.substr(3), data.size(), 0, data).status, UploadStatus::rejected);
+    EXPECT_EQ(store.append(id, 10000, 0, data).status, UploadStatus::rejected);           // Больше max_bytes
+    EXPECT_EQ(store.append(id, 50, 0, data).status, UploadStatus::rejected);              // Часть за концом файла
+    EXPECT_EQ(store.append(id, 8192, 0, content(5000)).status, UploadStatus::rejected);   // Часть больше chunk_bytes
+    std::string chunk;
+    EXPECT_FALSE(store.read(id, 0, chunk));
+}
+
+TEST_F(BlobStoreTest, RefusesChunksBeyondCapacityAndExpiresStalePartialFiles) {
+    std::string data = content(6000);
+    std::string id = sha256_hex(data);
+    std::string_view view(data);
+    {
+        BlobStore store(dir, 4096, 1 << 20, 8000);
+        EXPECT_EQ(store.append(id, data.size(), 0, view.substr(0, 4096)).status, UploadStatus::partial);
+        std::string other = content(5000);
+        UploadState state = store.append(sha256_hex(other), other.size(), 0, std::string_view(other).substr(0, 4096));
+        EXPECT_EQ(state.status, UploadStatus::busy);
+        EXPECT_EQ(state.stored, 0u);
+        EXPECT_EQ(store.used_bytes(), 4096u);
+        EXPECT_EQ(store.append(id, data.size(), 4096, view.substr(4096)).status, UploadStatus::complete);
+        EXPECT_EQ(store.used_bytes(), data.size());
+
+        // Повтор готового файла объём не занимает.
+        EXPECT_EQ(store.append(id, data.size(), 0, view.substr(0, 4096)).status, UploadStatus::complete);
+        EXPECT_EQ(store.used_bytes(), data.size());
+        EXPECT_EQ(store.append(sha256_hex(other), other.size(), 0, std::string_view(other).substr(0, 1000)).status,
+                  UploadStatus::partial);
+    }
+
+    // При открытии хранилище учитывает файлы на диске, а недогруженные старше срока удаляет.
+    BlobStore reopened(dir, 4096, 1 << 20, 8000, std::chrono::seconds(0));
+    EXPECT_EQ(reopened.used_bytes(), data.size());
+    EXPECT_EQ(reopened.size(id), data.size());
+    EXPECT_EQ(reopened.expire_partial(), 0u);
+}
+
+TEST_F(BlobStoreTest, ConcurrentUploadsOfOneFileStoreItOnce) {
+    BlobStore store(dir, 4096, 1 << 20);
+    std::string data = content(3000);
+    std::string id = sha256_hex(data);
+    std::vector<std::thread> uploaders;
+    std::vector<UploadStatus> results(8);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        uploaders.emplace_back([&, i] { results[i] = store.append(id, data.size(), 0, data).status; });
+    }
+    for (auto& uploader : uploaders) {
+        uploader.join();
+    }
+    for (UploadStatus status : results) {
+        EXPECT_EQ(status, UploadStatus::complete);
+    }
+    EXPECT_EQ(store.size(id), data.size());
+    EXPECT_EQ(store.used_bytes(), data.size());
+}
@@ -0,0 +1,32 @@
+/**
+ * @file chat_broker.cpp
+ * @brief Брокер кластера: пересылает рассылки каждого узла ssl_server остальным.
+ *
+ * Запуск: chat_broker [адрес], адрес - "unix:/путь" или "tcp:петлевой_адрес:порт" (по умолчанию unix:ssl_server.bus).
+ * Узлы подключаются к нему, если запущены с переменной окружения CHAT_CLUSTER с тем же адресом.
+ * Завершается по SIGINT или SIGTERM.
+ */
+
+#include "cluster_bus.h"
+#include <csignal>
+#include <exception>
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+    const char* address = argc > 1 ? argv[1] : "unix:ssl_server.bus";
+    try {
+        boost::asio::io_context ioc;
+        ClusterBroker broker(ioc, address);
+        broker.start();
+
+        boost::asio::signal_set signals(ioc, SIGINT, SIGTERM);
+        signals.async_wait([&](const boost::system::error_code&, int) { broker.stop(); });
+
+        std::cout << "chat_broker: " << address << std::endl;
+        ioc.run();
+    } catch (const std::exception& e) {
+        std::cerr << "chat_broker: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
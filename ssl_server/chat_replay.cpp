@@ -0,0 +1,465 @@
+/**
+ * @file chat_replay.cpp
+ * @brief Воспроизведение трассы, записанной сервером с CHAT_CAPTURE, на локальном ssl_server.
+ *
+ * Запуск: chat_replay трасса [скорость] [адрес:порт] [--password пароль] [--save файл]
+ *                    [--baseline файл] [--tolerance доля]
+ * Скорость - 1 (как записано, по умолчанию), N (в N раз быстрее) или max (без пауз); адрес по
+ * умолчанию 127.0.0.1:3202. Каждая сессия трассы подключается, входит и отправляет свои запросы
+ * в записанные моменты, поделённые на скорость; порядок запросов сессии сохраняется при любой
+ * скорости. Пользователи трассы сначала регистрируются с паролем --password (по умолчанию
+ * replay): в трассе паролей нет. История при входе не запрашивается - её объём зависит от
+ * журнала сервера, а не от трассы.
+ *
+ * Итог - подтверждённые сообщения и доставленные записи журнала в секунду, гистограммы задержки
+ * от отправки сообщения до X-Ack и от входа до списка пользователей в сети. --save сохраняет итог
+ * как базовый, --baseline сравнивает с базовым (допустимое ухудшение --tolerance, по умолчанию 0.1)
+ * и завершается с кодом 2, если есть ухудшения.
+ */
+
+#include "traffic_trace.h"
+#include "send_queue.h"
+#include "metrics.h"
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace ssl = asio::ssl;
+using tcp = asio::ip::tcp;
+using ssl_socket = ssl::stream<tcp::socket>;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::chrono::seconds kLoginTimeout{30};  ///< Сколько ждать списка пользователей после входа.
+constexpr std::chrono::seconds kAckTimeout{10};    ///< Сколько ждать подтверждений перед отключением.
+constexpr std::size_t kRegistrationWorkers = 32;   ///< Одновременных регистраций.
+
+/**
+ * @brief Запрос сессии в трассе.
+ */
+struct Step {
+    std::chrono::microseconds time;
+    std::string target;
+    std::string body;
+};
+
+/**
+ * @brief Всё, что сессия трассы делает: вход, запросы и отключение.
+ */
+struct Script {
+    std::string user;
+    bool compress = false;
+    std::chrono::microseconds login{0};
+    std::vector<Step> steps;
+    std::optional<std::chrono::microseconds> disconnect;
+};
+
+/**
+ * @brief Параметры и общие итоги прогона.
+ */
+struct Replay {
+    tcp::endpoint endpoint;
+    ssl::context tls{ssl::context::tlsv12_client};
+    std::string password = "replay";
+    std::optional<double> speed = 1.0; ///< nullopt - без пауз.
+    clock_type::time_point start;
+
+    std::mutex mutex; ///< Защищает report и finished.
+    ReplayReport report{latency_buckets()};
+    clock_type::time_point finished;
+
+    /**
+     * @brief Момент воспроизведения записи со временем time от начала трассы.
+     */
+    clock_type::time_point at(std::chrono::microseconds time) const {
+        if (!speed) {
+            return start;
+        }
+        return start + std::chrono::duration_cast<clock_type::duration>(time / *speed);
+    }
+};
+
+/**
+ * @brief Состояние сессии воспроизведения; только в strand сессии.
+ */
+struct SessionState {
+    enum class Login { waiting, ok, failed };
+
+    explicit SessionState(SendQueue::executor_type strand) : changed(strand) {}
+
+    Login login = Login::waiting;
+    bool closed = false;
+    clock_type::time_point login_sent;
+    std::deque<clock_type::time_point> pending; ///< Моменты отправки сообщений без X-Ack.
+    std::string last_seq = "0";                 ///< Последний X-Log-Offset, для ответа на ping.
+    uint64_t sent = 0, acks = 0, dropped = 0, frames = 0;
+    LatencyHistogram ack_latency{latency_buckets()};
+    LatencyHistogram login_latency{latency_buckets()};
+    asio::steady_timer changed; ///< Отменяется, когда меняется вход, очередь подтверждений или соединение закрыто.
+
+    /**
+     * @brief Ждёт изменения состояния, но не дольше timeout.
+     */
+    asio::awaitable<void> wait(clock_type::duration timeout) {
+        changed.expires_after(timeout);
+        beast::error_code ec;
+        co_await changed.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+
+    /**
+     * @brief Учитывает ответ сервера.
+     */
+    void on_response(const http::response<http::string_body>& res, SendQueue& queue) {
+        auto now = clock_type::now();
+        auto ack = res["X-Ack"];
+        if (!ack.empty() && !pending.empty()) {
+            if (ack == "dropped") {
+                ++dropped;
+            } else {
+                ++acks;
+                ack_latency.observe(std::chrono::duration<double>(now - pending.front()).count());
+            }
+            pending.pop_front();
+            changed.cancel();
+        }
+        if (auto offset = res["X-Log-Offset"]; !offset.empty()) {
+            ++frames;
+            last_seq = std::string(offset);
+        }
+        if (res["X-Heartbeat"] == "ping") {
+            http::request<http::string_body> pong(http::verb::post, "/pong", 11);
+            pong.body() = last_seq;
+            pong.prepare_payload();
+            queue.enqueue(make_frame(pong), SendQueue::Lane::control);
+        }
+        if (login == Login::waiting) {
+            // Вход завершён, когда пришёл снимок присутствия; отказ приходит с кодом ошибки.
+            if (res["X-Presence"] == "snapshot") {
+                login = Login::ok;
+                login_latency.observe(std::chrono::duration<double>(now - login_sent).count());
+                changed.cancel();
+            } else if (res.result() != http::status::ok) {
+                login = Login::failed;
+                changed.cancel();
+            }
+        }
+    }
+};
+
+asio::awaitable<void> wait_until(asio::steady_timer& timer, clock_type::time_point when) {
+    if (when <= clock_type::now()) {
+        co_return;
+    }
+    timer.expires_at(when);
+    beast::error_code ec;
+    co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+}
+
+asio::awaitable<void> write_loop(std::shared_ptr<ssl_socket> socket, std::shared_ptr<SendQueue> queue) {
+    std::vector<SendQueue::Frame> batch;
+    std::string buffer;
+    try {
+        while (co_await queue->pop_batch(batch, 64 * 1024)) {
+            co_await write_frames(*socket, batch, buffer);
+        }
+    } catch (const beast::system_error&) {
+    }
+    queue->close();
+    beast::error_code ec;
+    socket->lowest_layer().shutdown(tcp::socket::shutdown_both, ec);
+}
+
+asio::awaitable<void> read_loop(std::shared_ptr<ssl_socket> socket, std::shared_ptr<SessionState> state,
+                                std::shared_ptr<SendQueue> queue) {
+    beast::flat_buffer buffer;
+    try {
+        while (true) {
+            http::response<http::string_body> res;
+            co_await http::async_read(*socket, buffer, res, asio::use_awaitable);
+            state->on_response(res, *queue);
+        }
+    } catch (const beast::system_error&) {
+    }
+    state->closed = true;
+    if (state->login == SessionState::Login::waiting) {
+        state->login = SessionState::Login::failed;
+    }
+    state->changed.cancel();
+    queue->close();
+}
+
+asio::awaitable<void> register_users(Replay& replay, const std::vector<std::string>& users, std::size_t& next) {
+    auto executor = co_await asio::this_coro::executor;
+    while (next < users.size()) {
+        const std::string& user = users[next++];
+        // Уже зарегистрированный пользователь получает отказ; вход покажет, подходит ли пароль.
+        try {
+            ssl_socket socket(executor, replay.tls);
+            co_await socket.next_layer().async_connect(replay.endpoint, asio::use_awaitable);
+            co_await socket.async_handshake(ssl::stream_base::client, asio::use_awaitable);
+            http::request<http::string_body> req(http::verb::post, "/reg", 11);
+            req.body() = user + " " + replay.password;
+            req.prepare_payload();
+            co_await http::async_write(socket, req, asio::use_awaitable);
+            beast::flat_buffer buffer;
+            http::response<http::string_body> res;
+            co_await http::async_read(socket, buffer, res, asio::use_awaitable);
+        } catch (const beast::system_error& e) {
+            std::cerr << "chat_replay: registration of " << user << " failed: " << e.what() << '\n';
+        }
+    }
+}
+
+asio::awaitable<void> replay_session(const Script& script, Replay& replay, SendQueue::executor_type strand) {
+    asio::steady_timer timer(strand);
+    auto state = std::make_shared<SessionState>(strand);
+    co_await wait_until(timer, replay.at(script.login));
+    try {
+        auto socket = std::make_shared<ssl_socket>(strand, replay.tls);
+        co_await socket->next_layer().async_connect(replay.endpoint, asio::use_awaitable);
+        co_await socket->async_handshake(ssl::stream_base::client, asio::use_awaitable);
+        auto queue = std::make_shared<SendQueue>(strand);
+        asio::co_spawn(strand, write_loop(socket, queue), asio::detached);
+        asio::co_spawn(strand, read_loop(socket, state, queue), asio::detached);
+
+        http::request<http::string_body> login(http::verb::post, "/", 11);
+        if (script.compress) {
+            login.set("X-Accept-Encoding", "deflate");
+        }
+        login.set("X-History-Offset", std::to_string(std::numeric_limits<uint64_t>::max()));
+        login.body() = script.user + " " + replay.password;
+        login.prepare_payload();
+        state->login_sent = clock_type::now();
+        queue->enqueue(make_frame(login), SendQueue::Lane::control);
+        auto deadline = clock_type::now() + kLoginTimeout;
+        while (state->login == SessionState::Login::waiting && clock_type::now() < deadline) {
+            co_await state->wait(deadline - clock_type::now());
+        }
+
+        if (state->login == SessionState::Login::ok) {
+            for (const Step& step : script.steps) {
+                co_await wait_until(timer, replay.at(step.time));
+                if (state->closed) {
+                    break;
+                }
+                http::request<http::string_body> req(http::verb::post, step.target, 11);
+                req.body() = step.body;
+                req.prepare_payload();
+                if (step.target == "/") {
+                    state->pending.push_back(clock_type::now());
+                    ++state->sent;
+                }
+                // push() ждёт, пока сервер читает: без пауз очередь не растёт без предела.
+                co_await queue->push(make_frame(req));
+            }
+            if (script.disconnect) {
+                co_await wait_until(timer, replay.at(*script.disconnect));
+            }
+            // Последние сообщения ещё без подтверждения: отключение подождёт их.
+            deadline = clock_type::now() + kAckTimeout;
+            while (!state->pending.empty() && !state->closed && clock_type::now() < deadline) {
+                co_await state->wait(deadline - clock_type::now());
+            }
+        }
+        queue->finish();
+    } catch (const beast::system_error& e) {
+        std::cerr << "chat_replay: session of " << script.user << ": " << e.what() << '\n';
+    }
+
+    std::lock_guard<std::mutex> lock(replay.mutex);
+    ReplayReport& report = replay.report;
+    if (state->login != SessionState::Login::ok) {
+        ++report.login_failures;
+    }
+    report.messages_sent += state->sent;
+    report.acks += state->acks;
+    report.dropped += state->dropped;
+    report.frames_received += state->frames;
+    report.ack_latency.merge(state->ack_latency);
+    report.login_latency.merge(state->login_latency);
+    replay.finished = std::max(replay.finished, clock_type::now());
+}
+
+/**
+ * @brief Раскладывает трассу по сессиям.
+ */
+std::map<uint32_t, Script> load_scripts(const std::string& path) {
+    TraceReader reader(path);
+    std::map<uint32_t, Script> scripts;
+    while (auto record = reader.next()) {
+        if (record->event == TraceEvent::login) {
+            Script& script = scripts[record->session];
+            script.user = std::move(record->user);
+            script.compress = record->compress;
+            script.login = record->time;
+            continue;
+        }
+        auto it = scripts.find(record->session);
+        if (it == scripts.end()) {
+            continue; // Вход не попал в трассу (предел размера)
+        }
+        if (record->event == TraceEvent::request) {
+            it->second.steps.push_back({record->time, std::move(record->target), std::move(record->body)});
+        } else {
+            it->second.disconnect = record->time;
+        }
+    }
+    if (reader.truncated()) {
+        std::cerr << "chat_replay: trace ends with a truncated record, replaying what precedes it\n";
+    }
+    return scripts;
+}
+
+/**
+ * @brief Выполняет корутины в пуле потоков по числу ядер, пока они не завершатся.
+ */
+void run(asio::io_context& ioc) {
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < std::max(1u, std::thread::hardware_concurrency()); ++i) {
+        threads.emplace_back([&ioc] { ioc.run(); });
+    }
+    ioc.run();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ioc.restart();
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream out;
+    out << in.rdbuf();
+    return out.str();
+}
+
+void print_report(const ReplayReport& report) {
+    std::cout << "sessions " << report.sessions << ", login failures " << report.login_failures
+              << ", messages " << report.messages_sent << " (acked " << report.acks << ", dropped " << report.dropped
+              << "), " << report.seconds << " s\n"
+              << report.messages_per_second() << " messages/s, " << report.frames_per_second() << " delivered frames/s\n"
+              << "ack latency p50 " << report.ack_latency.quantile(0.5) * 1000 << " ms, p99 "
+              << report.ack_latency.quantile(0.99) * 1000 << " ms; login latency p50 "
+              << report.login_latency.quantile(0.5) * 1000 << " ms, p99 " << report.login_latency.quantile(0.99) * 1000
+              << " ms\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    std::string save, baseline;
+    double tolerance = 0.1;
+    Replay replay;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) == 0 && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "--password") {
+                replay.password = value;
+            } else if (arg == "--save") {
+                save = value;
+            } else if (arg == "--baseline") {
+                baseline = value;
+            } else if (arg == "--tolerance") {
+                tolerance = std::strtod(value.c_str(), nullptr);
+            } else {
+                positional.clear();
+                break;
+            }
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty() || positional.size() > 3) {
+        std::cerr << "usage: chat_replay trace [1|N|max] [host:port] [--password p] [--save file] "
+                     "[--baseline file] [--tolerance share]\n";
+        return EXIT_FAILURE;
+    }
+
+    try {
+        if (positional.size() > 1 && positional[1] == "max") {
+            replay.speed.reset();
+        } else if (positional.size() > 1) {
+            replay.speed = std::strtod(positional[1].c_str(), nullptr);
+            if (!(*replay.speed > 0)) {
+                throw std::invalid_argument("speed must be positive or max");
+            }
+        }
+        std::string address = positional.size() > 2 ? positional[2] : "127.0.0.1:3202";
+        auto colon = address.rfind(':');
+        if (colon == std::string::npos) {
+            throw std::invalid_argument("address must be host:port");
+        }
+        asio::io_context ioc;
+        tcp::resolver resolver(ioc);
+        replay.endpoint = *resolver.resolve(address.substr(0, colon), address.substr(colon + 1)).begin();
+        replay.tls.set_verify_mode(ssl::verify_none); // Локальный сервер с самоподписанным сертификатом
+
+        std::map<uint32_t, Script> scripts = load_scripts(positional[0]);
+        std::set<std::string> names;
+        for (const auto& [session, script] : scripts) {
+            names.insert(script.user);
+        }
+        std::vector<std::string> users(names.begin(), names.end());
+        std::size_t next_user = 0;
+        for (std::size_t i = 0; i < std::min(kRegistrationWorkers, users.size()); ++i) {
+            asio::co_spawn(asio::make_strand(ioc), register_users(replay, users, next_user), asio::detached);
+        }
+        // Регистрация идёт в одном потоке: счётчик next_user общий для всех регистраторов.
+        ioc.run();
+        ioc.restart();
+
+        replay.report.sessions = scripts.size();
+        replay.start = clock_type::now();
+        replay.finished = replay.start;
+        for (const auto& [session, script] : scripts) {
+            auto strand = asio::make_strand(ioc);
+            asio::co_spawn(strand, replay_session(script, replay, strand), asio::detached);
+        }
+        run(ioc);
+        replay.report.seconds = std::chrono::duration<double>(replay.finished - replay.start).count();
+    } catch (const std::exception& e) {
+        std::cerr << "chat_replay: " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    print_report(replay.report);
+    if (!save.empty()) {
+        std::ofstream(save) << replay.report.to_text();
+    }
+    if (!baseline.empty()) {
+        std::optional<ReplayReport> base = ReplayReport::parse(read_file(baseline));
+        if (!base) {
+            std::cerr << "chat_replay: cannot read baseline " << baseline << '\n';
+            return EXIT_FAILURE;
+        }
+        std::vector<std::string> regressions = compare_replay(*base, replay.report, tolerance);
+        for (const auto& regression : regressions) {
+            std::cout << "regression: " << regression << '\n';
+        }
+        if (!regressions.empty()) {
+            return 2;
+        }
+        std::cout << "no regressions against " << baseline << '\n';
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file client_registry.cpp
+ * @brief Реализация списка подключенных клиентов.
+ */
+
+#include "client_registry.h"
+#include <algorithm>
+
+uint64_t ClientRegistry::add(Client client) {
+    client.id = next_id_++;
+    position_.emplace(client.id, clients_.size());
+    by_name_[client.name].push_back(client.id);
+    clients_.push_back(std::move(client));
+    return clients_.back().id;
+}
+
+void ClientRegistry::remove(uint64_t id) {
+    auto it = position_.find(id);
+    if (it == position_.end()) {
+        return;
+    }
+    std::size_t index = it->second;
+    position_.erase(it);
+
+    auto sessions = by_name_.find(clients_[index].name);
+    auto& ids = sessions->second;
+    ids.erase(std::find(ids.begin(), ids.end(), id));
+    if (ids.empty()) {
+        by_name_.erase(sessions);
+    }
+
+    if (index + 1 != clients_.size()) {
+        clients_[index] = std::move(clients_.back());
+        position_[clients_[index].id] = index;
+    }
+    clients_.pop_back();
+}
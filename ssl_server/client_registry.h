@@ -0,0 +1,95 @@
+/**
+ * @file client_registry.h
+ * @brief Подключенные клиенты с индексом по имени для личных сообщений.
+ */
+
+#ifndef CLIENT_REGISTRY_H
+#define CLIENT_REGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "send_queue.h"
+#include "session_monitor.h"
+
+/**
+ * @brief Структура для хранения информации о подключенном клиенте.
+ */
+struct Client {
+    std::shared_ptr<SendQueue> queue; ///< Очередь кадров, которую разбирает корутина записи сессии.
+    std::string name;
+    std::shared_ptr<SessionWatch> watch;
+    bool compress = false; ///< Клиент согласовал сжатие кадров.
+    uint64_t id = 0; ///< Номер сессии, назначается ClientRegistry::add.
+};
+
+/**
+ * @brief Список подключенных клиентов и индекс имя -> сессии.
+ *
+ * Клиенты лежат подряд в векторе, чтобы рассылка всем проходила по непрерывной памяти;
+ * поиск сессий пользователя (у одного имени их может быть несколько - по числу устройств)
+ * стоит O(1) от числа клиентов в сети. Удаление переносит последний элемент на место удалённого.
+ * Не потокобезопасен: на сервере защищён clients_mutex.
+ */
+class ClientRegistry {
+public:
+    /**
+     * @brief Добавляет клиента и назначает ему номер сессии.
+     * @param client Клиент; поле id перезаписывается.
+     * @return Номер сессии.
+     */
+    uint64_t add(Client client);
+
+    /**
+     * @brief Удаляет сессию; неизвестный номер игнорируется.
+     * @param id Номер сессии.
+     */
+    void remove(uint64_t id);
+
+    /**
+     * @brief Все подключенные клиенты в произвольном порядке.
+     */
+    const std::vector<Client>& all() const { return clients_; }
+
+    /**
+     * @brief Вызывает f для каждой сессии пользователя.
+     * @param name Имя пользователя.
+     * @param f Функция, принимающая const Client&.
+     * @return Число сессий пользователя.
+     */
+    template <typename F>
+    std::size_t for_each_session(std::string_view name, F&& f) const {
+        auto it = by_name_.find(name);
+        if (it == by_name_.end()) {
+            return 0;
+        }
+        for (uint64_t id : it->second) {
+            f(clients_[position_.at(id)]);
+        }
+        return it->second.size();
+    }
+
+    std::size_t size() const { return clients_.size(); }
+    bool empty() const { return clients_.empty(); }
+
+private:
+    /**
+     * @brief Хеш, позволяющий искать по string_view без создания строки.
+     */
+    struct NameHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    std::vector<Client> clients_;
+    std::unordered_map<uint64_t, std::size_t> position_; ///< Номер сессии -> индекс в clients_.
+    std::unordered_map<std::string, std::vector<uint64_t>, NameHash, std::equal_to<>> by_name_;
+    uint64_t next_id_ = 1;
+};
+
+#endif // CLIENT_REGISTRY_H
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "client_registry.h"
+#include <algorithm>
+
+namespace {
+
+Client named(std::string name) {
+    Client client;
+    client.name = std::move(name);
+    return client;
+}
+
+std::vector<uint64_t> sessions_of(const ClientRegistry& registry, std::string_view name) {
+    std::vector<uint64_t> ids;
+    registry.for_each_session(name, [&](const Client& client) {
+        EXPECT_EQ(client.name, name);
+        ids.push_back(client.id);
+    });
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+} // namespace
+
+TEST(ClientRegistryTest, FindsEverySessionOfUser) {
+    ClientRegistry registry;
+    uint64_t phone = registry.add(named("alice"));
+    uint64_t bob = registry.add(named("bob"));
+    uint64_t laptop = registry.add(named("alice"));
+
+    EXPECT_NE(phone, laptop);
+    EXPECT_EQ(registry.size(), 3u);
+    EXPECT_EQ(sessions_of(registry, "alice"), (std::vector<uint64_t>{phone, laptop}));
+    EXPECT_EQ(sessions_of(registry, "bob"), (std::vector<uint64_t>{bob}));
+    EXPECT_EQ(registry.for_each_session("carol", [](const Client&) { FAIL(); }), 0u);
+}
+
+TEST(ClientRegistryTest, KeepsIndexConsistentAfterRemoval) {
+    ClientRegistry registry;
+    uint64_t first = registry.add(named("alice"));
+    uint64_t second = registry.add(named("bob"));
+    uint64_t third = registry.add(named("alice"));
+
+    // Удаление из середины переносит последнего клиента на освободившееся место.
+    registry.remove(first);
+    registry.remove(first);
+    EXPECT_EQ(registry.size(), 2u);
+    EXPECT_EQ(sessions_of(registry, "alice"), (std::vector<uint64_t>{third}));
+    EXPECT_EQ(sessions_of(registry, "bob"), (std::vector<uint64_t>{second}));
+
+    registry.remove(third);
+    EXPECT_EQ(registry.for_each_session("alice", [](const Client&) {}), 0u);
+    registry.remove(second);
+    EXPECT_TRUE(registry.empty());
+    EXPECT_TRUE(registry.all().empty());
+}
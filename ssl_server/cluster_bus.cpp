@@ -0,0 +1,398 @@
+/**
+ * @file cluster_bus.cpp
+ * @brief Реализация связи узлов через брокер публикаций.
+ */
+
+#include "cluster_bus.h"
+#include <algorithm>
+#include <charconv>
+#include <random>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace asio = boost::asio;
+using generic_stream = asio::generic::stream_protocol;
+
+namespace {
+
+constexpr std::size_t kHeaderBytes = 4;                ///< Длина записи без этих 4 байт.
+constexpr std::size_t kFixedBytes = 8 + 8 + 1 + 2;     ///< Источник, номер, вид, длина имени.
+constexpr std::size_t kMaxRecordBytes = 16 * 1024 * 1024;
+constexpr std::size_t kReadChunk = 64 * 1024;
+constexpr std::size_t kWriteBatchBytes = 256 * 1024;   ///< Наибольшая склеенная запись узлу или брокеру.
+constexpr std::size_t kQueueLimit = 64 * 1024 * 1024;  ///< Выше - получатель не успевает читать и отключается.
+
+void put(std::string& out, uint64_t value, int bytes) {
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<char>((value >> shift) & 0xff));
+    }
+}
+
+uint64_t get(std::string_view data, std::size_t at, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value = (value << 8) | static_cast<unsigned char>(data[at + i]);
+    }
+    return value;
+}
+
+/**
+ * @brief Длина записи, начинающейся с at, вместе с заголовком; 0 - запись пришла не целиком.
+ */
+std::optional<std::size_t> record_size(std::string_view data, std::size_t at) {
+    if (data.size() - at < kHeaderBytes) {
+        return 0;
+    }
+    std::size_t length = get(data, at, kHeaderBytes);
+    if (length < kFixedBytes || length > kMaxRecordBytes) {
+        return std::nullopt;
+    }
+    if (data.size() - at < kHeaderBytes + length) {
+        return 0;
+    }
+    return kHeaderBytes + length;
+}
+
+/**
+ * @brief Случайный ненулевой номер узла: перезапущенный узел нумерует сообщения заново под новым номером.
+ */
+uint64_t random_node_id() {
+    std::mt19937_64 rng(std::random_device{}());
+    return std::uniform_int_distribution<uint64_t>(1)(rng);
+}
+
+/**
+ * @brief Отправляет кадры очереди в сокет, пока очередь не закроется или запись не сорвётся.
+ */
+asio::awaitable<void> write_loop(std::shared_ptr<generic_stream::socket> socket, std::shared_ptr<SendQueue> queue) {
+    std::vector<SendQueue::Frame> batch;
+    std::string buffer;
+    try {
+        while (co_await queue->pop_batch(batch, kWriteBatchBytes)) {
+            co_await write_frames(*socket, batch, buffer);
+        }
+    } catch (const boost::system::system_error&) {
+    }
+    // Закрытие сокета прерывает чтение, и владелец соединения его заменит.
+    queue->close();
+    boost::system::error_code ec;
+    socket->close(ec);
+}
+
+} // namespace
+
+std::string encode_cluster_message(const ClusterMessage& message) {
+    std::string out;
+    out.reserve(kHeaderBytes + kFixedBytes + message.sender.size() + message.body.size());
+    put(out, kFixedBytes + message.sender.size() + message.body.size(), kHeaderBytes);
+    put(out, message.origin, 8);
+    put(out, message.seq, 8);
+    put(out, static_cast<uint8_t>(message.kind), 1);
+    put(out, message.sender.size(), 2);
+    out.append(message.sender).append(message.body);
+    return out;
+}
+
+std::optional<std::size_t> decode_cluster_messages(std::string_view data, std::vector<ClusterMessage>& out) {
+    std::size_t at = 0;
+    while (true) {
+        auto size = record_size(data, at);
+        if (!size) {
+            return std::nullopt;
+        }
+        if (*size == 0) {
+            return at;
+        }
+        std::size_t field = at + kHeaderBytes;
+        std::size_t sender_size = get(data, field + 17, 2);
+        if (kHeaderBytes + kFixedBytes + sender_size > *size) {
+            return std::nullopt;
+        }
+        ClusterMessage message;
+        message.origin = get(data, field, 8);
+        message.seq = get(data, field + 8, 8);
+        message.kind = static_cast<ClusterKind>(get(data, field + 16, 1));
+        message.sender.assign(data.substr(field + kFixedBytes, sender_size));
+        message.body.assign(data.substr(field + kFixedBytes + sender_size, *size - kHeaderBytes - kFixedBytes - sender_size));
+        out.push_back(std::move(message));
+        at += *size;
+    }
+}
+
+std::optional<std::size_t> complete_cluster_records(std::string_view data) {
+    std::size_t at = 0;
+    while (true) {
+        auto size = record_size(data, at);
+        if (!size) {
+            return std::nullopt;
+        }
+        if (*size == 0) {
+            return at;
+        }
+        at += *size;
+    }
+}
+
+generic_stream::endpoint parse_bus_address(std::string_view address) {
+    if (address.substr(0, 5) == "unix:" && address.size() > 5) {
+        return asio::local::stream_protocol::endpoint(std::string(address.substr(5)));
+    }
+    if (address.substr(0, 4) == "tcp:") {
+        std::string_view rest = address.substr(4);
+        auto colon = rest.rfind(':');
+        unsigned short port = 0;
+        if (colon != std::string_view::npos) {
+            auto [end, ec] = std::from_chars(rest.data() + colon + 1, rest.data() + rest.size(), port);
+            boost::system::error_code bad;
+            auto ip = asio::ip::make_address(std::string(rest.substr(0, colon)), bad);
+            // Шина не проверяет собеседника: по TCP она слушает и подключается только на петлевом адресе,
+            // связь между машинами идёт через защищённый туннель к нему.
+            if (ec == std::errc() && end == rest.data() + rest.size() && !bad && ip.is_loopback()) {
+                return asio::ip::tcp::endpoint(ip, port);
+            }
+        }
+    }
+    throw std::invalid_argument("cluster bus address: " + std::string(address));
+}
+
+bool ClusterDeduplicator::accept(uint64_t origin, uint64_t seq) {
+    uint64_t& last = last_[origin];
+    if (seq <= last) {
+        return false;
+    }
+    last = seq;
+    return true;
+}
+
+BrokerBus::BrokerBus(asio::io_context& ioc, std::string_view address, Deliver deliver,
+                     std::size_t replay_records, std::chrono::milliseconds retry_delay)
+    : strand_(asio::make_strand(ioc)), endpoint_(parse_bus_address(address)), deliver_(std::move(deliver)),
+      node_id_(random_node_id()), replay_limit_(replay_records), retry_delay_(retry_delay), retry_(strand_) {}
+
+void BrokerBus::start() {
+    asio::co_spawn(strand_, run(), asio::detached);
+}
+
+void BrokerBus::stop() {
+    stopped_ = true;
+    asio::post(strand_, [this] {
+        retry_.cancel();
+        if (socket_) {
+            boost::system::error_code ec;
+            socket_->close(ec);
+        }
+    });
+}
+
+bool BrokerBus::publish(ClusterKind kind, std::string_view sender, std::string_view body) {
+    ClusterMessage message;
+    message.origin = node_id_;
+    message.kind = kind;
+    message.sender = sender;
+    message.body = body;
+    std::lock_guard<std::mutex> lock(mutex_);
+    message.seq = ++seq_;
+    auto frame = std::make_shared<const std::string>(encode_cluster_message(message));
+    replay_.push_back(frame);
+    if (replay_.size() > replay_limit_) {
+        replay_.pop_front();
+    }
+    return queue_ && queue_->enqueue(std::move(frame));
+}
+
+bool BrokerBus::connected() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_ != nullptr;
+}
+
+asio::awaitable<void> BrokerBus::run() {
+    while (!stopped_) {
+        auto socket = std::make_shared<Socket>(strand_);
+        socket_ = socket;
+        boost::system::error_code ec;
+        co_await socket->async_connect(endpoint_, asio::redirect_error(asio::use_awaitable, ec));
+        if (!ec && !stopped_) {
+            auto queue = std::make_shared<SendQueue>(strand_, kQueueLimit, kQueueLimit);
+            ClusterMessage hello;
+            hello.origin = node_id_;
+            hello.kind = ClusterKind::hello;
+            hello.body = resume_ ? "resume" : "";
+            resume_ = true;
+            queue->enqueue(std::make_shared<const std::string>(encode_cluster_message(hello)));
+            {
+                // Повтор идёт раньше новых сообщений: номера источника остаются возрастающими.
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto& frame : replay_) {
+                    queue->enqueue(frame);
+                }
+                queue_ = queue;
+            }
+            asio::co_spawn(strand_, write_loop(socket, queue), asio::detached);
+            co_await read_loop(*socket);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_.reset();
+            }
+            queue->close();
+        }
+        socket->close(ec);
+        socket_.reset();
+        if (stopped_) {
+            break;
+        }
+        retry_.expires_after(retry_delay_);
+        co_await retry_.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+}
+
+asio::awaitable<void> BrokerBus::read_loop(Socket& socket) {
+    std::string buffer;
+    std::vector<ClusterMessage> batch;
+    while (true) {
+        std::size_t old_size = buffer.size();
+        buffer.resize(old_size + kReadChunk);
+        boost::system::error_code ec;
+        std::size_t n = co_await socket.async_read_some(asio::buffer(buffer.data() + old_size, kReadChunk),
+                                                        asio::redirect_error(asio::use_awaitable, ec));
+        buffer.resize(old_size + n);
+        if (ec) {
+            co_return;
+        }
+        batch.clear();
+        auto used = decode_cluster_messages(buffer, batch);
+        if (!used) {
+            co_return; // Повреждённый поток: соединение пересоздаётся
+        }
+        buffer.erase(0, *used);
+        std::erase_if(batch, [this](const ClusterMessage& message) {
+            return message.origin == node_id_ || message.kind == ClusterKind::hello ||
+                   !dedup_.accept(message.origin, message.seq);
+        });
+        // Всё, что пришло одним чтением, доставляется одной пачкой.
+        if (!batch.empty()) {
+            deliver_(batch);
+        }
+    }
+}
+
+ClusterBroker::ClusterBroker(asio::io_context& ioc, std::string_view address, std::size_t replay_bytes)
+    : strand_(asio::make_strand(ioc)), acceptor_(strand_), replay_limit_(replay_bytes) {
+    auto endpoint = parse_bus_address(address);
+    if (address.substr(0, 5) == "unix:") {
+        unix_path_ = std::string(address.substr(5));
+        // Файл остался от брокера, который уже завершился.
+        unlink(unix_path_.c_str());
+    }
+    acceptor_.open(endpoint.protocol());
+    if (unix_path_.empty()) {
+        acceptor_.set_option(asio::socket_base::reuse_address(true));
+    }
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+}
+
+ClusterBroker::~ClusterBroker() {
+    if (!unix_path_.empty()) {
+        unlink(unix_path_.c_str());
+    }
+}
+
+void ClusterBroker::start() {
+    asio::co_spawn(strand_, accept_loop(), asio::detached);
+}
+
+void ClusterBroker::stop() {
+    asio::post(strand_, [this] {
+        boost::system::error_code ec;
+        acceptor_.close(ec);
+        for (const auto& node : nodes_) {
+            node->socket->close(ec);
+        }
+    });
+}
+
+asio::awaitable<void> ClusterBroker::accept_loop() {
+    while (acceptor_.is_open()) {
+        auto socket = std::make_shared<Socket>(strand_);
+        boost::system::error_code ec;
+        co_await acceptor_.async_accept(*socket, asio::redirect_error(asio::use_awaitable, ec));
+        if (ec == asio::error::operation_aborted || !acceptor_.is_open()) {
+            co_return;
+        }
+        if (ec) {
+            continue;
+        }
+        auto node = std::make_shared<Node>(Node{socket, std::make_shared<SendQueue>(strand_, kQueueLimit, kQueueLimit)});
+        nodes_.push_back(node);
+        asio::co_spawn(strand_, write_loop(socket, node->queue), asio::detached);
+        asio::co_spawn(strand_, serve(node), asio::detached);
+    }
+}
+
+asio::awaitable<void> ClusterBroker::serve(std::shared_ptr<Node> node) {
+    std::string buffer;
+    while (true) {
+        std::size_t old_size = buffer.size();
+        buffer.resize(old_size + kReadChunk);
+        boost::system::error_code ec;
+        std::size_t n = co_await node->socket->async_read_some(asio::buffer(buffer.data() + old_size, kReadChunk),
+                                                               asio::redirect_error(asio::use_awaitable, ec));
+        buffer.resize(old_size + n);
+        if (ec) {
+            break;
+        }
+        auto complete = complete_cluster_records(buffer);
+        if (!complete) {
+            break;
+        }
+        if (*complete == 0) {
+            continue;
+        }
+        std::size_t forward = *complete;
+        if (!node->greeted) {
+            // Повтор уходит узлу раньше, чем он начнёт получать новые записи: номера остаются возрастающими.
+            std::vector<ClusterMessage> first;
+            std::size_t hello_size = kHeaderBytes + get(buffer, 0, kHeaderBytes);
+            decode_cluster_messages(std::string_view(buffer).substr(0, hello_size), first);
+            if (first.empty() || first.front().kind != ClusterKind::hello) {
+                break;
+            }
+            if (first.front().body == "resume") {
+                for (const auto& frame : replay_) {
+                    node->queue->enqueue(frame);
+                }
+            }
+            node->greeted = true;
+            count_nodes();
+            buffer.erase(0, hello_size);
+            forward -= hello_size;
+            if (forward == 0) {
+                continue;
+            }
+        }
+        // Один кадр на чтение, общий для всех получателей.
+        auto frame = std::make_shared<const std::string>(buffer, 0, forward);
+        buffer.erase(0, forward);
+        for (const auto& other : nodes_) {
+            if (other != node && other->greeted) {
+                other->queue->enqueue(frame);
+            }
+        }
+        replay_bytes_ += frame->size();
+        replay_.push_back(std::move(frame));
+        while (replay_bytes_ > replay_limit_) {
+            replay_bytes_ -= replay_.front()->size();
+            replay_.pop_front();
+        }
+    }
+    node->queue->close();
+    boost::system::error_code ec;
+    node->socket->close(ec);
+    std::erase(nodes_, node);
+    count_nodes();
+}
+
+void ClusterBroker::count_nodes() {
+    node_count_.store(std::count_if(nodes_.begin(), nodes_.end(), [](const auto& node) { return node->greeted; }),
+                      std::memory_order_relaxed);
+}
@@ -0,0 +1,251 @@
+/**
+ * @file cluster_bus.h
+ * @brief Обмен рассылками между узлами сервера через брокер публикаций.
+ */
+
+#ifndef CLUSTER_BUS_H
+#define CLUSTER_BUS_H
+
+#include <utility> // Boost 1.74 использует std::exchange в awaitable.hpp, не подключая <utility>
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "send_queue.h"
+
+/**
+ * @brief Вид сообщения между узлами.
+ */
+enum class ClusterKind : uint8_t {
+    hello = 0,  ///< Первая запись соединения с брокером; тело "resume" просит повтор недавних записей.
+    chat = 1,   ///< Сообщение общего чата.
+    direct = 2, ///< Личное сообщение; тело - "получатель текст".
+};
+
+/**
+ * @brief Сообщение, которое узел публикует для остальных узлов.
+ */
+struct ClusterMessage {
+    uint64_t origin = 0; ///< Узел-источник.
+    uint64_t seq = 0;    ///< Номер у источника, начиная с 1.
+    ClusterKind kind = ClusterKind::chat;
+    std::string sender;
+    std::string body;
+};
+
+/**
+ * @brief Кодирует сообщение записью "длина (4 байта) источник номер вид длина_имени имя тело".
+ */
+std::string encode_cluster_message(const ClusterMessage& message);
+
+/**
+ * @brief Разбирает целые записи в начале data.
+ * @param data Принятые байты; неполная последняя запись остаётся на следующий раз.
+ * @param out Дополняется разобранными сообщениями.
+ * @return Число разобранных байт или nullopt, если данные повреждены.
+ */
+std::optional<std::size_t> decode_cluster_messages(std::string_view data, std::vector<ClusterMessage>& out);
+
+/**
+ * @brief Длина начала data, состоящего из целых записей; брокер пересылает его, не разбирая.
+ * @return Длина или nullopt, если данные повреждены.
+ */
+std::optional<std::size_t> complete_cluster_records(std::string_view data);
+
+/**
+ * @brief Адрес брокера: "unix:/путь" или "tcp:адрес:порт".
+ *
+ * Записи шины не аутентифицируются, поэтому TCP допускается только на петлевом адресе
+ * (127.0.0.0/8, ::1); узлы на других машинах подключаются через туннель (SSH, stunnel, WireGuard).
+ * @throws std::invalid_argument, если адрес не распознан или не петлевой.
+ */
+boost::asio::generic::stream_protocol::endpoint parse_bus_address(std::string_view address);
+
+/**
+ * @brief Отбрасывает повторно доставленные сообщения.
+ *
+ * Номера одного источника приходят по возрастанию, поэтому достаточно помнить последний
+ * принятый номер каждого источника.
+ */
+class ClusterDeduplicator {
+public:
+    /**
+     * @return Истина, если сообщение ещё не встречалось.
+     */
+    bool accept(uint64_t origin, uint64_t seq);
+
+private:
+    std::unordered_map<uint64_t, uint64_t> last_;
+};
+
+/**
+ * @brief Связь узла с остальными узлами кластера.
+ *
+ * Реализация доставляет опубликованное сообщение всем остальным узлам, по порядку
+ * публикации для каждого источника и без повторов.
+ */
+class ClusterBus {
+public:
+    /**
+     * @brief Обработчик пачки сообщений от других узлов; вызывается в strand связи.
+     */
+    using Deliver = std::function<void(std::vector<ClusterMessage>& batch)>;
+
+    virtual ~ClusterBus() = default;
+
+    /**
+     * @brief Публикует сообщение для остальных узлов. Потокобезопасен.
+     * @return Ложь, если связи сейчас нет: сообщение уйдёт после переподключения, если не вытеснится из буфера повтора.
+     */
+    virtual bool publish(ClusterKind kind, std::string_view sender, std::string_view body) = 0;
+
+    /**
+     * @brief Номер этого узла, случайный при каждом запуске.
+     */
+    virtual uint64_t node_id() const = 0;
+};
+
+/**
+ * @brief Связь через ClusterBroker.
+ *
+ * Сообщения, опубликованные, пока идёт запись, уходят брокеру одной записью. Последние
+ * replay_records сообщений хранятся и повторяются после переподключения, а сам узел при
+ * переподключении просит у брокера недавние записи других узлов: так разрыв или перезапуск
+ * брокера не теряет сообщений, а повторы отбрасывает ClusterDeduplicator. Первое подключение
+ * повтора не просит: узел, запущенный заново, уже хранит историю в своём журнале.
+ * Уничтожается после остановки io_context.
+ */
+class BrokerBus : public ClusterBus {
+public:
+    /**
+     * @param ioc Контекст, в котором работает связь.
+     * @param address Адрес брокера, см. parse_bus_address().
+     * @param deliver Обработчик сообщений от других узлов.
+     * @param replay_records Сколько последних сообщений повторяется после переподключения.
+     * @param retry_delay Пауза перед повторным подключением.
+     */
+    BrokerBus(boost::asio::io_context& ioc, std::string_view address, Deliver deliver,
+              std::size_t replay_records = 4096, std::chrono::milliseconds retry_delay = std::chrono::seconds(1));
+
+    /**
+     * @brief Подключается к брокеру и переподключается после разрывов до stop().
+     */
+    void start();
+
+    /**
+     * @brief Закрывает соединение с брокером. Потокобезопасен.
+     */
+    void stop();
+
+    bool publish(ClusterKind kind, std::string_view sender, std::string_view body) override;
+    uint64_t node_id() const override { return node_id_; }
+
+    /**
+     * @brief Есть ли сейчас соединение с брокером.
+     */
+    bool connected() const;
+
+private:
+    using Socket = boost::asio::generic::stream_protocol::socket;
+
+    SendQueue::executor_type strand_;
+    boost::asio::generic::stream_protocol::endpoint endpoint_;
+    Deliver deliver_;
+    uint64_t node_id_;
+    std::size_t replay_limit_;
+    std::chrono::milliseconds retry_delay_;
+    boost::asio::steady_timer retry_;
+    std::atomic<bool> stopped_{false};
+    std::shared_ptr<Socket> socket_; ///< Только в strand_.
+    ClusterDeduplicator dedup_;      ///< Только в strand_.
+    bool resume_ = false;            ///< Уже подключался; только в strand_.
+
+    mutable std::mutex mutex_; ///< Защищает номер, буфер повтора и очередь: номера уходят в очередь по порядку.
+    uint64_t seq_ = 0;
+    std::deque<SendQueue::Frame> replay_;
+    std::shared_ptr<SendQueue> queue_; ///< Очередь текущего соединения; пуста без соединения.
+
+    boost::asio::awaitable<void> run();
+    boost::asio::awaitable<void> read_loop(Socket& socket);
+};
+
+/**
+ * @brief Брокер: пересылает записи каждого узла всем остальным.
+ *
+ * Записи не разбираются: целые записи, пришедшие одним чтением, уходят остальным узлам
+ * одним общим кадром, а кадры, накопившиеся за время записи узлу, склеиваются в одну
+ * запись. Последние replay_bytes пересланных данных хранятся и отдаются переподключившемуся
+ * узлу раньше новых. Узел, не успевающий читать, отключается и при переподключении получает
+ * повтор. Запускается отдельной программой chat_broker.
+ */
+class ClusterBroker {
+public:
+    /**
+     * @param ioc Контекст, в котором работает брокер.
+     * @param address Адрес, на котором брокер принимает узлы, см. parse_bus_address().
+     * @param replay_bytes Объём недавних записей для переподключившихся узлов.
+     * @throws boost::system::system_error, если адрес занят.
+     */
+    ClusterBroker(boost::asio::io_context& ioc, std::string_view address, std::size_t replay_bytes = 4 * 1024 * 1024);
+
+    /**
+     * @brief Удаляет файл Unix-сокета. Уничтожается после остановки io_context.
+     */
+    ~ClusterBroker();
+
+    ClusterBroker(const ClusterBroker&) = delete;
+    ClusterBroker& operator=(const ClusterBroker&) = delete;
+
+    /**
+     * @brief Начинает принимать узлы.
+     */
+    void start();
+
+    /**
+     * @brief Закрывает слушающий сокет и соединения узлов. Потокобезопасен.
+     */
+    void stop();
+
+    /**
+     * @brief Число подключенных узлов, приславших приветствие.
+     */
+    std::size_t nodes() const { return node_count_.load(std::memory_order_relaxed); }
+
+private:
+    using Socket = boost::asio::generic::stream_protocol::socket;
+
+    /**
+     * @brief Подключенный узел.
+     */
+    struct Node {
+        std::shared_ptr<Socket> socket;
+        std::shared_ptr<SendQueue> queue;
+        bool greeted = false; ///< Приветствие получено: узлу пересылаются записи.
+    };
+
+    SendQueue::executor_type strand_;
+    boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol> acceptor_;
+    std::string unix_path_;
+    std::vector<std::shared_ptr<Node>> nodes_; ///< Только в strand_.
+    std::atomic<std::size_t> node_count_{0};
+    std::size_t replay_limit_;
+    std::deque<SendQueue::Frame> replay_; ///< Недавние пересланные кадры; только в strand_.
+    std::size_t replay_bytes_ = 0;
+
+    void count_nodes();
+
+    boost::asio::awaitable<void> accept_loop();
+    boost::asio::awaitable<void> serve(std::shared_ptr<Node> node);
+};
+
+#endif // CLUSTER_BUS_H
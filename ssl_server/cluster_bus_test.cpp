@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+#include "cluster_bus.h"
+#include <chrono>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string test_address(const char* name) {
+    return "unix:/tmp/chat_bus_" + std::to_string(getpid()) + "_" + name;
+}
+
+/**
+ * @brief Сообщения, доставленные узлу; ожидание идёт из потока теста.
+ */
+struct Inbox {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<ClusterMessage> messages;
+    std::size_t batches = 0;
+
+    ClusterBus::Deliver deliver() {
+        return [this](std::vector<ClusterMessage>& batch) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++batches;
+            for (auto& message : batch) {
+                messages.push_back(std::move(message));
+            }
+            changed.notify_all();
+        };
+    }
+
+    bool wait_for(std::size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, 5s, [&] { return messages.size() >= count; });
+    }
+};
+
+template <typename Predicate>
+bool eventually(Predicate predicate) {
+    for (int i = 0; i < 500 && !predicate(); ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    return predicate();
+}
+
+} // namespace
+
+TEST(ClusterBusTest, EncodesRecordsAndWaitsForPartialOnes) {
+    ClusterMessage first{7, 1, ClusterKind::chat, "alice", "hello"};
+    ClusterMessage second{7, 2, ClusterKind::direct, "bob", "alice hi"};
+    std::string data = encode_cluster_message(first) + encode_cluster_message(second);
+
+    std::vector<ClusterMessage> out;
+    auto used = decode_cluster_messages(std::string_view(data).substr(0, data.size() - 1), out);
+    ASSERT_TRUE(used.has_value());
+    EXPECT_EQ(*used, encode_cluster_message(first).size());
+    EXPECT_EQ(complete_cluster_records(std::string_view(data).substr(0, data.size() - 1)), used);
+
+    out.clear();
+    EXPECT_EQ(decode_cluster_messages(data, out), data.size());
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[1].origin, 7u);
+    EXPECT_EQ(out[1].seq, 2u);
+    EXPECT_EQ(out[1].kind, ClusterKind::direct);
+    EXPECT_EQ(out[1].sender, "bob");
+    EXPECT_EQ(out[1].body, "alice hi");
+
+    std::string corrupt("\xff\xff\xff\xff", 4);
+    EXPECT_FALSE(decode_cluster_messages(corrupt, out).has_value());
+    EXPECT_FALSE(complete_cluster_records(corrupt).has_value());
+    EXPECT_THROW(parse_bus_address("udp:1.2.3.4:5"), std::invalid_argument);
+    EXPECT_NO_THROW(parse_bus_address("tcp:127.0.0.1:7000"));
+    EXPECT_NO_THROW(parse_bus_address("tcp:::1:7000"));
+    // Без аутентификации шина не выходит за пределы машины.
+    EXPECT_THROW(parse_bus_address("tcp:0.0.0.0:7000"), std::invalid_argument);
+    EXPECT_THROW(parse_bus_address("tcp:10.0.0.5:7000"), std::invalid_argument);
+}
+
+TEST(ClusterBusTest, DeduplicatesPerOrigin) {
+    ClusterDeduplicator dedup;
+    EXPECT_TRUE(dedup.accept(1, 1));
+    EXPECT_TRUE(dedup.accept(1, 2));
+    EXPECT_FALSE(dedup.accept(1, 2));
+    EXPECT_FALSE(dedup.accept(1, 1));
+    EXPECT_TRUE(dedup.accept(2, 1));
+    EXPECT_TRUE(dedup.accept(1, 5));
+}
+
+TEST(ClusterBusTest, BrokerFansOutToOtherNodesInOrder) {
+    std::string address = test_address("fanout");
+    boost::asio::io_context ioc;
+    ClusterBroker broker(ioc, address);
+    broker.start();
+    Inbox a, b, c;
+    BrokerBus node_a(ioc, address, a.deliver());
+    BrokerBus node_b(ioc, address, b.deliver());
+    BrokerBus node_c(ioc, address, c.deliver());
+    node_a.start();
+    node_b.start();
+    node_c.start();
+    std::thread thread([&] { ioc.run(); });
+
+    ASSERT_TRUE(eventually([&] { return broker.nodes() == 3; }));
+    constexpr std::size_t kMessages = 1000;
+    for (std::size_t i = 0; i < kMessages; ++i) {
+        node_a.publish(ClusterKind::chat, "alice", "m" + std::to_string(i));
+    }
+    node_c.publish(ClusterKind::direct, "carol", "alice hi");
+
+    EXPECT_TRUE(b.wait_for(kMessages + 1));
+    EXPECT_TRUE(c.wait_for(kMessages));
+    EXPECT_TRUE(a.wait_for(1));
+
+    node_a.stop();
+    node_b.stop();
+    node_c.stop();
+    broker.stop();
+    ioc.stop();
+    thread.join();
+
+    ASSERT_EQ(a.messages.size(), 1u);
+    EXPECT_EQ(a.messages[0].sender, "carol");
+    EXPECT_EQ(c.messages.size(), kMessages);
+    std::vector<std::string> from_a;
+    for (const auto& message : b.messages) {
+        if (message.origin == node_a.node_id()) {
+            from_a.push_back(message.body);
+        }
+    }
+    ASSERT_EQ(from_a.size(), kMessages);
+    for (std::size_t i = 0; i < kMessages; ++i) {
+        EXPECT_EQ(from_a[i], "m" + std::to_string(i));
+    }
+    // Сообщения, опубликованные подряд, приходят пачками, а не по одному.
+    EXPECT_LT(b.batches, kMessages);
+}
+
+TEST(ClusterBusTest, ReplaysAfterBrokerRestartWithoutDuplicates) {
+    std::string address = test_address("replay");
+    // У брокера свой контекст: его можно остановить и пересоздать, не трогая узлы.
+    boost::asio::io_context broker_ioc;
+    auto broker = std::make_unique<ClusterBroker>(broker_ioc, address);
+    broker->start();
+    std::thread broker_thread([&] { broker_ioc.run(); });
+
+    boost::asio::io_context ioc;
+    Inbox a, b;
+    BrokerBus node_a(ioc, address, a.deliver(), 16, 20ms);
+    BrokerBus node_b(ioc, address, b.deliver(), 16, 20ms);
+    node_a.start();
+    node_b.start();
+    std::thread thread([&] { ioc.run(); });
+
+    ASSERT_TRUE(eventually([&] { return broker->nodes() == 2; }));
+    for (int i = 0; i < 3; ++i) {
+        node_a.publish(ClusterKind::chat, "alice", "before" + std::to_string(i));
+    }
+    ASSERT_TRUE(b.wait_for(3));
+
+    // Брокер перезапускается; пока его нет, сообщение только запоминается.
+    broker->stop();
+    ASSERT_TRUE(eventually([&] { return !node_a.connected() && !node_b.connected(); }));
+    broker_ioc.stop();
+    broker_thread.join();
+    broker.reset();
+    EXPECT_FALSE(node_a.publish(ClusterKind::chat, "alice", "during"));
+    broker_ioc.restart();
+    broker = std::make_unique<ClusterBroker>(broker_ioc, address);
+    broker->start();
+    broker_thread = std::thread([&] { broker_ioc.run(); });
+
+    // Узел A повторяет все последние сообщения, узел B принимает только новое.
+    ASSERT_TRUE(eventually([&] { return broker->nodes() == 2 && node_a.connected() && node_b.connected(); }));
+    EXPECT_TRUE(b.wait_for(4));
+    node_a.publish(ClusterKind::chat, "alice", "after");
+    EXPECT_TRUE(b.wait_for(5));
+
+    // Заново запущенный узел повтора не просит: история уже в его журнале.
+    Inbox fresh;
+    BrokerBus node_c(ioc, address, fresh.deliver());
+    node_c.start();
+    ASSERT_TRUE(eventually([&] { return broker->nodes() == 3; }));
+    std::this_thread::sleep_for(100ms);
+
+    node_a.stop();
+    node_b.stop();
+    node_c.stop();
+    ioc.stop();
+    thread.join();
+    broker->stop();
+    broker_ioc.stop();
+    broker_thread.join();
+
+    std::vector<std::string> bodies;
+    for (const auto& message : b.messages) {
+        bodies.push_back(message.body);
+    }
+    EXPECT_EQ(bodies, (std::vector<std::string>{"before0", "before1", "before2", "during", "after"}));
+    EXPECT_TRUE(fresh.messages.empty());
+}
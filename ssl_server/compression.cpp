@@ -0,0 +1,183 @@
+/**
+ * @file compression.cpp
+ * @brief Реализация сжатия кадров и обучения словаря.
+ */
+
+#include "compression.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <zlib.h>
+
+namespace {
+
+/**
+ * @brief Поток deflate, переиспользуемый потоком выполнения: инициализация zlib выделяет сотни килобайт.
+ */
+class DeflateStream {
+public:
+    ~DeflateStream() {
+        if (level_ >= 0) {
+            deflateEnd(&stream_);
+        }
+    }
+
+    z_stream& reset(int level) {
+        if (level_ < 0) {
+            if (deflateInit(&stream_, level) != Z_OK) {
+                throw std::runtime_error("deflateInit failed");
+            }
+            level_ = level;
+        } else {
+            deflateReset(&stream_);
+            if (level_ != level) {
+                deflateParams(&stream_, level, Z_DEFAULT_STRATEGY);
+                level_ = level;
+            }
+        }
+        return stream_;
+    }
+
+private:
+    z_stream stream_{};
+    int level_ = -1;
+};
+
+const Bytef* bytes(std::string_view data) {
+    return reinterpret_cast<const Bytef*>(data.data());
+}
+
+} // namespace
+
+std::string train_dictionary(const std::vector<std::string_view>& samples, std::size_t max_size) {
+    max_size = std::min<std::size_t>(max_size, 32 * 1024);
+
+    // Кандидаты - слова и пары соседних слов вместе с разделяющим пробелом.
+    std::unordered_map<std::string, std::size_t> counts;
+    for (std::string_view sample : samples) {
+        std::string_view previous;
+        std::size_t pos = 0;
+        while (pos < sample.size()) {
+            std::size_t end = sample.find(' ', pos);
+            end = end == std::string_view::npos ? sample.size() : end + 1;
+            std::string_view word = sample.substr(pos, end - pos);
+            if (word.size() > 2) {
+                ++counts[std::string(word)];
+            }
+            if (!previous.empty()) {
+                ++counts[std::string(previous.data(), previous.size() + word.size())];
+            }
+            previous = word;
+            pos = end;
+        }
+    }
+
+    // Выгода фрагмента - сколько байт он может заменить во всех образцах.
+    std::vector<std::pair<std::size_t, std::string>> scored;
+    for (auto& [fragment, count] : counts) {
+        if (count > 1) {
+            scored.emplace_back(count * fragment.size(), fragment);
+        }
+    }
+    std::sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    std::vector<const std::string*> chosen;
+    std::size_t size = 0;
+    for (const auto& [score, fragment] : scored) {
+        if (size + fragment.size() > max_size) {
+            continue;
+        }
+        chosen.push_back(&fragment);
+        size += fragment.size();
+    }
+
+    std::string dictionary;
+    dictionary.reserve(size);
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+        dictionary.append(**it);
+    }
+    return dictionary;
+}
+
+uint32_t dictionary_id(std::string_view dictionary) {
+    return static_cast<uint32_t>(adler32(adler32(0, nullptr, 0), bytes(dictionary), static_cast<uInt>(dictionary.size())));
+}
+
+DeflateCodec::DeflateCodec(std::size_t threshold, int level)
+    : threshold_(threshold),
+      level_(level),
+      compress_seconds_(MetricsRegistry::instance().histogram("chat_compress_seconds", "Time spent compressing frames", latency_buckets())),
+      bytes_in_(MetricsRegistry::instance().counter("chat_compress_bytes_in_total", "Bytes passed to the compressor")),
+      bytes_out_(MetricsRegistry::instance().counter("chat_compress_bytes_out_total", "Bytes produced by the compressor")),
+      skipped_(MetricsRegistry::instance().counter("chat_compress_skipped_total", "Frames sent uncompressed: below threshold or incompressible")) {}
+
+void DeflateCodec::set_dictionary(std::string dictionary) {
+    dictionary_ = std::move(dictionary);
+}
+
+bool DeflateCodec::compress(std::string_view input, std::string& output) const {
+    if (input.size() < threshold_) {
+        skipped_.inc();
+        return false;
+    }
+
+    ScopedTimer timer(compress_seconds_);
+    thread_local DeflateStream deflater;
+    z_stream& stream = deflater.reset(level_);
+    if (!dictionary_.empty() &&
+        deflateSetDictionary(&stream, bytes(dictionary_), static_cast<uInt>(dictionary_.size())) != Z_OK) {
+        throw std::runtime_error("deflateSetDictionary failed");
+    }
+
+    output.resize(deflateBound(&stream, static_cast<uLong>(input.size())));
+    stream.next_in = const_cast<Bytef*>(bytes(input));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(output.data());
+    stream.avail_out = static_cast<uInt>(output.size());
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        throw std::runtime_error("deflate failed");
+    }
+    output.resize(stream.total_out);
+
+    bytes_in_.inc(input.size());
+    bytes_out_.inc(output.size());
+    if (output.size() >= input.size()) {
+        skipped_.inc();
+        return false;
+    }
+    return true;
+}
+
+bool DeflateCodec::decompress(std::string_view input, std::string_view dictionary, std::string& output) {
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) {
+        return false;
+    }
+    stream.next_in = const_cast<Bytef*>(bytes(input));
+    stream.avail_in = static_cast<uInt>(input.size());
+
+    output.clear();
+    int rc = Z_OK;
+    while (rc != Z_STREAM_END) {
+        if (stream.avail_out == 0) {
+            std::size_t used = output.size();
+            output.resize(std::max<std::size_t>(used * 2, input.size() * 4 + 64));
+            stream.next_out = reinterpret_cast<Bytef*>(output.data() + used);
+            stream.avail_out = static_cast<uInt>(output.size() - used);
+        }
+        rc = inflate(&stream, Z_NO_FLUSH);
+        if (rc == Z_NEED_DICT) {
+            rc = inflateSetDictionary(&stream, bytes(dictionary), static_cast<uInt>(dictionary.size()));
+        }
+        if (rc != Z_OK && rc != Z_STREAM_END && !(rc == Z_BUF_ERROR && stream.avail_out == 0)) {
+            inflateEnd(&stream);
+            return false;
+        }
+    }
+    output.resize(stream.total_out);
+    inflateEnd(&stream);
+    return true;
+}
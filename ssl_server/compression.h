@@ -0,0 +1,82 @@
+/**
+ * @file compression.h
+ * @brief Сжатие тел ответов deflate с общим словарём, обученным на истории чата.
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "metrics.h"
+
+/**
+ * @brief Строит словарь deflate из частых слов и пар слов образцов.
+ *
+ * Самые выгодные фрагменты помещаются в конец словаря, ближе всего к сжимаемым данным.
+ * @param samples Образцы текста (например, последние сообщения из журнала).
+ * @param max_size Максимальный размер словаря (не больше окна deflate, 32 КиБ).
+ * @return Словарь; пустой, если образцов нет.
+ */
+std::string train_dictionary(const std::vector<std::string_view>& samples, std::size_t max_size = 16 * 1024);
+
+/**
+ * @brief Идентификатор словаря: контрольная сумма Adler-32, которую zlib пишет в сжатый поток.
+ */
+uint32_t dictionary_id(std::string_view dictionary);
+
+/**
+ * @brief Сжатие отдельных кадров в формате zlib с предустановленным словарём.
+ *
+ * Каждый кадр сжимается независимо, поэтому один сжатый ответ рассылки можно отправить
+ * всем клиентам, согласовавшим сжатие. Короткие кадры не сжимаются.
+ */
+class DeflateCodec {
+public:
+    /**
+     * @param threshold Минимальный размер кадра для сжатия.
+     * @param level Уровень сжатия zlib.
+     */
+    explicit DeflateCodec(std::size_t threshold = 512, int level = 6);
+
+    /**
+     * @brief Задаёт словарь. Вызывается до начала обслуживания клиентов.
+     */
+    void set_dictionary(std::string dictionary);
+
+    const std::string& dictionary() const { return dictionary_; }
+
+    std::size_t threshold() const { return threshold_; }
+
+    /**
+     * @brief Сжимает кадр, если он не короче порога и сжатие выгодно.
+     * @param input Исходные данные.
+     * @param output Сжатые данные.
+     * @return Истина, если output нужно отправить вместо input.
+     * @throws std::runtime_error при ошибке zlib.
+     */
+    bool compress(std::string_view input, std::string& output) const;
+
+    /**
+     * @brief Распаковывает кадр, сжатый compress.
+     * @param input Сжатые данные.
+     * @param dictionary Словарь, с которым сжимался кадр.
+     * @param output Распакованные данные.
+     * @return Ложь, если данные повреждены или словарь не подходит.
+     */
+    static bool decompress(std::string_view input, std::string_view dictionary, std::string& output);
+
+private:
+    std::size_t threshold_;
+    int level_;
+    std::string dictionary_;
+    Histogram& compress_seconds_;
+    Counter& bytes_in_;
+    Counter& bytes_out_;
+    Counter& skipped_;
+};
+
+#endif // COMPRESSION_H
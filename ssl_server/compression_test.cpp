@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "compression.h"
+
+namespace {
+
+std::vector<std::string> chat_lines() {
+    std::vector<std::string> lines;
+    for (int i = 0; i < 200; ++i) {
+        lines.push_back("alice: привет, как дела? сегодня встречаемся в " + std::to_string(i % 24) + " часов");
+        lines.push_back("bob: отлично, буду вовремя, захвачу ноутбук и зарядку");
+    }
+    return lines;
+}
+
+} // namespace
+
+TEST(CompressionTest, RoundTripsWithDictionary) {
+    auto lines = chat_lines();
+    std::vector<std::string_view> samples(lines.begin(), lines.end());
+    DeflateCodec codec(16);
+    codec.set_dictionary(train_dictionary(samples));
+    ASSERT_FALSE(codec.dictionary().empty());
+
+    std::string input = "carol: привет, как дела? буду вовремя";
+    std::string compressed;
+    ASSERT_TRUE(codec.compress(input, compressed));
+    EXPECT_LT(compressed.size(), input.size());
+
+    std::string restored;
+    ASSERT_TRUE(DeflateCodec::decompress(compressed, codec.dictionary(), restored));
+    EXPECT_EQ(restored, input);
+
+    // Без словаря кадр не распаковывается.
+    EXPECT_FALSE(DeflateCodec::decompress(compressed, "", restored));
+}
+
+TEST(CompressionTest, DictionaryImprovesSmallMessages) {
+    auto lines = chat_lines();
+    std::vector<std::string_view> samples(lines.begin(), lines.end());
+    DeflateCodec plain(1);
+    DeflateCodec trained(1);
+    trained.set_dictionary(train_dictionary(samples));
+
+    std::string input = "dave: отлично, сегодня встречаемся, захвачу ноутбук";
+    std::string without_dictionary, with_dictionary;
+    plain.compress(input, without_dictionary);
+    ASSERT_TRUE(trained.compress(input, with_dictionary));
+    EXPECT_LT(with_dictionary.size(), without_dictionary.size());
+}
+
+TEST(CompressionTest, SkipsShortAndIncompressibleFrames) {
+    DeflateCodec codec(64);
+    std::string output;
+    EXPECT_FALSE(codec.compress("короткое сообщение", output));
+
+    std::string noise;
+    for (int i = 0; i < 256; ++i) {
+        noise.push_back(static_cast<char>((i * 7919 + 13) % 251));
+    }
+    EXPECT_FALSE(codec.compress(noise, output));
+}
+
+TEST(CompressionTest, HandlesLargeHistoryBatches) {
+    DeflateCodec codec;
+    std::string batch;
+    for (const auto& line : chat_lines()) {
+        batch.append(line).append("\n");
+    }
+    std::string compressed, restored;
+    ASSERT_TRUE(codec.compress(batch, compressed));
+    EXPECT_LT(compressed.size() * 10, batch.size());
+    ASSERT_TRUE(DeflateCodec::decompress(compressed, codec.dictionary(), restored));
+    EXPECT_EQ(restored, batch);
+    EXPECT_EQ(dictionary_id(""), 1u);
+}
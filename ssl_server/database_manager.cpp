@@ -0,0 +1,41 @@
+/**
+ * @file database_manager.cpp
+ * @brief Реализация класса для работы с базой данных PostgreSQL.
+ */
+
+#include "database_manager.h"
+#include "logger.h"
+#include <stdexcept>
+
+DatabaseManager::DatabaseManager(const std::string& conn_str)
+    : conn(conn_str),
+      query_seconds(MetricsRegistry::instance().histogram("chat_db_query_seconds", "Database query latency", latency_buckets())) {
+    if (conn.is_open()) {
+        Logger::instance().log(LogLevel::info, "db_connected", {{"db", conn.dbname()}});
+    } else {
+        throw std::runtime_error("Can't open database");
+    }
+}
+
+pqxx::result DatabaseManager::execute(const std::string& query) {
+    PendingQuery in_flight(pending);
+    std::lock_guard<std::mutex> lock(mutex);
+    ScopedTimer timer(query_seconds);
+    pqxx::work W(conn);
+    pqxx::result result = W.exec(query);
+    W.commit();
+    return result;
+}
+
+pqxx::result DatabaseManager::fetch(const std::string& query) {
+    PendingQuery in_flight(pending);
+    std::lock_guard<std::mutex> lock(mutex);
+    ScopedTimer timer(query_seconds);
+    pqxx::nontransaction N(conn);
+    return N.exec(query);
+}
+
+void DatabaseManager::prepare(const std::string& name, const std::string& query) {
+    std::lock_guard<std::mutex> lock(mutex);
+    conn.prepare(name, query);
+}
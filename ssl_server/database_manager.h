@@ -0,0 +1,106 @@
+/**
+ * @file database_manager.h
+ * @brief Класс для управления подключением к базе данных PostgreSQL.
+ */
+
+#ifndef DATABASE_MANAGER_H
+#define DATABASE_MANAGER_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <pqxx/pqxx>
+#include "metrics.h"
+
+/**
+ * @brief Класс для управления подключением к базе данных PostgreSQL.
+ *
+ * Соединение pqxx не потокобезопасно, поэтому все обращения к нему сериализуются мьютексом.
+ */
+class DatabaseManager {
+private:
+    pqxx::connection conn;
+    std::mutex mutex;
+    Histogram& query_seconds;
+    std::atomic<std::size_t> pending{0};
+
+    /**
+     * @brief Учитывает запрос в backlog() на время его ожидания и выполнения.
+     */
+    class PendingQuery {
+    public:
+        explicit PendingQuery(std::atomic<std::size_t>& counter) : counter_(counter) { counter_.fetch_add(1, std::memory_order_relaxed); }
+        ~PendingQuery() { counter_.fetch_sub(1, std::memory_order_relaxed); }
+
+    private:
+        std::atomic<std::size_t>& counter_;
+    };
+
+public:
+    /**
+     * @brief Конструктор класса DatabaseManager.
+     * @param conn_str Строка подключения к базе данных.
+    */
+    DatabaseManager(const std::string& conn_str);
+
+    /**
+     * @brief Выполняет запрос к базе данных.
+     * @param query SQL-запрос.
+    */
+    pqxx::result execute(const std::string& query);
+
+    /**
+     * @brief Выполняет запрос к базе данных и возвращает результат.
+     * @param query SQL-запрос.
+     * @return Результат выполнения запроса.
+    */
+    pqxx::result fetch(const std::string& query);
+
+    /**
+     * @brief Регистрирует подготовленный запрос на соединении.
+     * @param name Имя подготовленного запроса.
+     * @param query SQL-запрос с параметрами $1, $2, ...
+     */
+    void prepare(const std::string& name, const std::string& query);
+
+    /**
+     * @brief Число запросов, ожидающих соединения или выполняющихся на нём.
+     */
+    std::size_t backlog() const { return pending.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Выполняет подготовленный запрос в транзакции на запись.
+     * @param name Имя подготовленного запроса.
+     * @param args Параметры запроса.
+     * @return Результат выполнения запроса.
+     */
+    template <typename... Args>
+    pqxx::result execute_prepared(const std::string& name, Args&&... args) {
+        PendingQuery in_flight(pending);
+        std::lock_guard<std::mutex> lock(mutex);
+        ScopedTimer timer(query_seconds);
+        pqxx::work W(conn);
+        pqxx::result result = W.exec_prepared(name, std::forward<Args>(args)...);
+        W.commit();
+        return result;
+    }
+
+    /**
+     * @brief Выполняет подготовленный запрос в транзакции только на чтение.
+     * @param name Имя подготовленного запроса.
+     * @param args Параметры запроса.
+     * @return Результат выполнения запроса.
+     */
+    template <typename... Args>
+    pqxx::result fetch_prepared(const std::string& name, Args&&... args) {
+        PendingQuery in_flight(pending);
+        std::lock_guard<std::mutex> lock(mutex);
+        ScopedTimer timer(query_seconds);
+        pqxx::read_transaction R(conn);
+        return R.exec_prepared(name, std::forward<Args>(args)...);
+    }
+};
+
+#endif // DATABASE_MANAGER_H
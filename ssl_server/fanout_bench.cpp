@@ -0,0 +1,161 @@
+/**
+ * @file fanout_bench.cpp
+ * @brief Нагрузочный тест рассылки: сообщения в секунду, процессор и число записей на сообщение.
+ *
+ * Запуск из каталога сборки: fanout_bench [клиентов] [сообщений] [размер пачки записи].
+ * Сервер держит по SendQueue и корутине записи на клиента, как ssl_server; поток-производитель
+ * кладёт каждое сообщение во все очереди. Размер пачки 1 соответствует записи по кадру.
+ * Реактор - epoll или io_uring, если сборка сделана с CHAT_IO_URING.
+ */
+
+#include "send_queue.h"
+#include <boost/asio/ssl.hpp>
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace ssl = asio::ssl;
+using tcp = asio::ip::tcp;
+using ssl_socket = ssl::stream<tcp::socket>;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double cpu_seconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto seconds = [](const timeval& t) { return static_cast<double>(t.tv_sec) + t.tv_usec / 1e6; };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+std::string find_certificate_dir() {
+    for (std::string dir : {"../", "./", "../../"}) {
+        if (std::ifstream(dir + "server.pem") && std::ifstream(dir + "server.key")) {
+            return dir;
+        }
+    }
+    return {};
+}
+
+const char* reactor_name() {
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    return "io_uring";
+#else
+    return "epoll";
+#endif
+}
+
+struct Session {
+    std::shared_ptr<ssl_socket> socket;
+    std::shared_ptr<SendQueue> queue;
+};
+
+std::atomic<std::size_t> writes{0};
+
+asio::awaitable<void> writer(Session session, std::size_t batch_bytes) {
+    std::vector<SendQueue::Frame> batch;
+    std::string buffer;
+    while (co_await session.queue->pop_batch(batch, batch_bytes)) {
+        co_await write_frames(*session.socket, batch, buffer);
+        writes.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+asio::awaitable<void> reader(ssl_socket& stream, std::size_t expected, std::atomic<std::size_t>& done) {
+    std::string buffer(64 * 1024, '\0');
+    std::size_t received = 0;
+    while (received < expected) {
+        received += co_await stream.async_read_some(asio::buffer(buffer), asio::use_awaitable);
+    }
+    done.fetch_add(1);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::size_t client_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100;
+    std::size_t messages = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+    std::size_t batch_bytes = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 64 * 1024;
+    std::string dir = find_certificate_dir();
+    if (dir.empty()) {
+        std::cerr << "server.pem and server.key not found\n";
+        return EXIT_FAILURE;
+    }
+
+    ssl::context server_context(ssl::context::tlsv12_server);
+    server_context.use_certificate_chain_file(dir + "server.pem");
+    server_context.use_private_key_file(dir + "server.key", ssl::context::pem);
+    ssl::context client_context(ssl::context::tlsv12_client);
+    client_context.set_verify_mode(ssl::verify_none);
+
+    // Сообщение рассылки: ответ HTTP с именем и текстом, около 100 байт, как в живом чате.
+    auto frame = std::make_shared<const std::string>(
+        "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nX-Log-Offset: 123456\r\nContent-Length: 24\r\n\r\n"
+        "alice: hello everyone!!!");
+
+    asio::io_context server_ioc;
+    asio::io_context client_ioc;
+    tcp::acceptor acceptor(server_ioc, {asio::ip::address_v4::loopback(), 0});
+    std::vector<Session> sessions;
+    std::vector<std::unique_ptr<ssl_socket>> clients;
+    std::atomic<std::size_t> done{0};
+    for (std::size_t i = 0; i < client_count; ++i) {
+        auto strand = asio::make_strand(server_ioc);
+        auto socket = std::make_shared<ssl_socket>(strand, server_context);
+        auto client = std::make_unique<ssl_socket>(client_ioc, client_context);
+        client->next_layer().connect(acceptor.local_endpoint());
+        acceptor.accept(socket->next_layer());
+        std::thread handshake([&] { client->handshake(ssl::stream_base::client); });
+        socket->handshake(ssl::stream_base::server);
+        handshake.join();
+        // Предел очереди не ограничивает: производитель не должен отключать медленных клиентов.
+        Session session{socket, std::make_shared<SendQueue>(strand, 256 * 1024, std::size_t(-1))};
+        asio::co_spawn(strand, writer(session, batch_bytes), asio::detached);
+        asio::co_spawn(client_ioc, reader(*client, messages * frame->size(), done), asio::detached);
+        sessions.push_back(session);
+        clients.push_back(std::move(client));
+    }
+
+    auto server_work = asio::make_work_guard(server_ioc);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i) {
+        threads.emplace_back([&] { server_ioc.run(); });
+    }
+    std::thread client_thread([&] { client_ioc.run(); });
+
+    double cpu_start = cpu_seconds();
+    auto start = clock_type::now();
+    for (std::size_t m = 0; m < messages; ++m) {
+        for (auto& session : sessions) {
+            session.queue->enqueue(frame);
+        }
+    }
+    client_thread.join();
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+    double cpu = cpu_seconds() - cpu_start;
+
+    for (auto& session : sessions) {
+        session.queue->close();
+    }
+    server_work.reset();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    double delivered = static_cast<double>(messages * client_count);
+    std::cout << reactor_name() << ", batch " << batch_bytes << " B, " << client_count << " clients: "
+              << static_cast<std::size_t>(delivered / elapsed) << " messages/s, "
+              << cpu / delivered * 1e6 << " us CPU per message, "
+              << static_cast<double>(writes.load()) / delivered << " writes per message"
+              << " (" << done.load() << " clients done)\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,231 @@
+/**
+ * @file handoff.cpp
+ * @brief Реализация передачи слушающего сокета.
+ */
+
+#include "handoff.h"
+#include "logger.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits.h>
+#include <string_view>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+
+sockaddr_un unix_address(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::system_error(ENAMETOOLONG, std::generic_category(), path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Путь исполняемого файла процесса; у заменённого файла ядро дописывает " (deleted)".
+std::string executable(const std::string& proc_link) {
+    char buffer[PATH_MAX];
+    ssize_t length = readlink(proc_link.c_str(), buffer, sizeof(buffer));
+    if (length <= 0) {
+        return {};
+    }
+    std::string path(buffer, static_cast<std::size_t>(length));
+    constexpr std::string_view kDeleted = " (deleted)";
+    if (path.size() > kDeleted.size() && path.compare(path.size() - kDeleted.size(), kDeleted.size(), kDeleted) == 0) {
+        path.resize(path.size() - kDeleted.size());
+    }
+    return path;
+}
+
+// Описание узла передаётся строкой с завершающим нулём.
+constexpr std::size_t kMaxIdentity = 1024;
+
+bool send_identity(int channel, const std::string& identity) {
+    std::string message = identity + '\0';
+    return send(channel, message.data(), message.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(message.size());
+}
+
+std::optional<std::string> receive_identity(int channel) {
+    // Собеседник уже проверен trusted_peer; срок лишь не даёт зависшему процессу занять поток ожидания.
+    timeval timeout{2, 0};
+    setsockopt(channel, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string identity;
+    char byte = 0;
+    while (identity.size() <= kMaxIdentity) {
+        if (recv(channel, &byte, 1, 0) != 1) {
+            return std::nullopt;
+        }
+        if (byte == '\0') {
+            return identity;
+        }
+        identity.push_back(byte);
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+bool trusted_peer(int channel) {
+    ucred peer{};
+    socklen_t length = sizeof(peer);
+    if (getsockopt(channel, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || peer.uid != geteuid()) {
+        return false;
+    }
+    std::string own = executable("/proc/self/exe");
+    return !own.empty() && executable("/proc/" + std::to_string(peer.pid) + "/exe") == own;
+}
+
+std::string handoff_path(const std::string& name) {
+    if (const char* runtime = std::getenv("XDG_RUNTIME_DIR"); runtime && *runtime) {
+        return std::string(runtime) + "/" + name;
+    }
+    std::string directory = "/tmp/ssl_server-" + std::to_string(geteuid());
+    if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        throw std::system_error(errno, std::generic_category(), "handoff directory " + directory);
+    }
+    // Каталог в общем /tmp мог создать кто-то другой: подходит только свой и закрытый от остальных.
+    struct stat info{};
+    if (lstat(directory.c_str(), &info) != 0) {
+        throw std::system_error(errno, std::generic_category(), "handoff directory " + directory);
+    }
+    if (!S_ISDIR(info.st_mode) || info.st_uid != geteuid() || (info.st_mode & 077) != 0) {
+        throw std::system_error(EPERM, std::generic_category(), "handoff directory " + directory + " is not private");
+    }
+    return directory + "/" + name;
+}
+
+bool send_descriptor(int channel, int fd) {
+    char byte = 'L';
+    iovec data{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    return sendmsg(channel, &message, MSG_NOSIGNAL) == 1;
+}
+
+int receive_descriptor(int channel) {
+    char byte = 0;
+    iovec data{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(channel, &message, MSG_CMSG_CLOEXEC) != 1) {
+        return -1;
+    }
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+    int fd = -1;
+    std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+    return fd;
+}
+
+std::optional<int> take_listener(const std::string& path, const std::string& identity) {
+    int channel = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (channel < 0) {
+        return std::nullopt;
+    }
+    sockaddr_un address = unix_address(path);
+    std::optional<int> listener;
+    bool refused = false;
+    if (connect(channel, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 && trusted_peer(channel)) {
+        if (int fd = send_identity(channel, identity) ? receive_descriptor(channel) : -1; fd >= 0) {
+            listener = fd;
+        } else {
+            refused = true;
+        }
+    }
+    close(channel);
+    // Свой процесс ждёт на этом пути, но сокет не отдал: запускаться рядом с ним нельзя, иначе
+    // новый процесс занял бы путь передачи чужого узла.
+    if (refused) {
+        throw std::system_error(EPERM, std::generic_category(), "listener handoff refused by " + path);
+    }
+    return listener;
+}
+
+ListenerHandoff::ListenerHandoff(std::string path, int listener, std::string identity, Handoff on_release,
+                                 Handoff on_handoff)
+    : path_(std::move(path)), listener_(listener), identity_(std::move(identity)), on_release_(std::move(on_release)),
+      on_handoff_(std::move(on_handoff)) {
+    sockaddr_un address = unix_address(path_);
+    socket_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "handoff socket");
+    }
+    // Файл остался от процесса, который уже отдал сокет или завершился.
+    unlink(path_.c_str());
+    // Права ставятся до listen: подключиться до chmod нельзя.
+    if (bind(socket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || chmod(path_.c_str(), 0600) != 0 ||
+        listen(socket_, 1) != 0) {
+        int error = errno;
+        close(socket_);
+        throw std::system_error(error, std::generic_category(), "handoff bind " + path_);
+    }
+    thread_ = std::thread([this] { wait(); });
+}
+
+ListenerHandoff::~ListenerHandoff() {
+    // shutdown прерывает accept в потоке ожидания.
+    shutdown(socket_, SHUT_RDWR);
+    thread_.join();
+    close(socket_);
+    // После передачи путь уже занят новым процессом.
+    if (!handed_off_) {
+        unlink(path_.c_str());
+    }
+}
+
+void ListenerHandoff::wait() {
+    while (true) {
+        int channel = accept4(socket_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (channel < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+        // Слушающий сокет получает только новый процесс того же сервера.
+        if (!trusted_peer(channel)) {
+            Logger::instance().log(LogLevel::warn, "handoff_peer_rejected", {{"path", path_}});
+            close(channel);
+            continue;
+        }
+        // Процесс другого узла (другой брокер, имя или порт) сокет не получает.
+        std::optional<std::string> identity = receive_identity(channel);
+        if (identity != identity_) {
+            Logger::instance().log(LogLevel::warn, "handoff_identity_mismatch",
+                                   {{"path", path_}, {"node", identity_}, {"peer", identity.value_or("")}});
+            close(channel);
+            continue;
+        }
+        // Новый процесс открывает журнал, получив сокет, поэтому прежний отпускает его до отправки.
+        on_release_();
+        bool sent = send_descriptor(channel, listener_);
+        close(channel);
+        if (sent) {
+            handed_off_ = true;
+            on_handoff_();
+            return;
+        }
+    }
+}
@@ -0,0 +1,105 @@
+/**
+ * @file handoff.h
+ * @brief Передача слушающего сокета новому процессу сервера через Unix-сокет (SCM_RIGHTS).
+ */
+
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Отправляет дескриптор по Unix-сокету (вместе с одним байтом данных).
+ * @param channel Подключённый Unix-сокет.
+ * @param fd Передаваемый дескриптор.
+ * @return Ложь при ошибке отправки.
+ */
+bool send_descriptor(int channel, int fd);
+
+/**
+ * @brief Принимает дескриптор, отправленный send_descriptor.
+ * @param channel Подключённый Unix-сокет.
+ * @return Полученный дескриптор или -1.
+ */
+int receive_descriptor(int channel);
+
+/**
+ * @brief Проверяет собеседника по Unix-сокету (SO_PEERCRED): тот же пользователь и тот же исполняемый файл.
+ *
+ * Исполняемый файл сравнивается по пути: файл, заменённый при обновлении, остаётся своим.
+ * @param channel Подключённый Unix-сокет.
+ */
+bool trusted_peer(int channel);
+
+/**
+ * @brief Путь сокета передачи в личном каталоге пользователя.
+ *
+ * Это $XDG_RUNTIME_DIR/name, а без него /tmp/ssl_server-<uid>/name. Каталог в /tmp создаётся
+ * с правами 0700; чужой или доступный другим каталог не используется.
+ * @param name Имя файла сокета.
+ * @throws std::system_error, если каталог не создать или он небезопасен.
+ */
+std::string handoff_path(const std::string& name);
+
+/**
+ * @brief Забирает слушающий сокет у работающего процесса сервера.
+ *
+ * Сначала отправляет прежнему процессу identity: сокет отдаётся только процессу того же узла.
+ * @param path Путь Unix-сокета передачи.
+ * @param identity Описание узла (адрес брокера кластера, имя узла, порт).
+ * @return Дескриптор слушающего сокета; пусто, если по пути никто не ждёт (первый запуск)
+ *         или ждёт чужой процесс.
+ * @throws std::system_error, если прежний процесс принадлежит другому узлу и отказал в передаче.
+ */
+std::optional<int> take_listener(const std::string& path, const std::string& identity);
+
+/**
+ * @brief Ждёт на Unix-сокете новый процесс сервера и отдаёт ему слушающий сокет.
+ *
+ * Перед отправкой вызывается on_release: старый процесс отпускает то, что новый откроет сразу после
+ * получения сокета (журнал сообщений). После передачи вызывается on_handoff: старый процесс прекращает
+ * приём и разгружает сессии, а новые соединения уже принимает новый процесс на том же сокете без паузы.
+ * Ожидание идёт в отдельном потоке; передача выполняется не более одного раза.
+ * Файл сокета доступен только владельцу (0600), а сокет отдаётся только процессу, прошедшему trusted_peer
+ * и приславшему то же описание узла: второй узел на том же хосте не заберёт чужой порт.
+ */
+class ListenerHandoff {
+public:
+    using Handoff = std::function<void()>;
+
+    /**
+     * @param path Путь Unix-сокета; оставшийся от прежнего процесса файл заменяется.
+     * @param listener Дескриптор слушающего сокета (остаётся во владении вызывающего).
+     * @param identity Описание узла; процессу с другим описанием сокет не отдаётся.
+     * @param on_release Вызывается из потока ожидания перед отправкой сокета проверенному процессу;
+     *                   если отправка не удалась, вызывается снова перед следующей.
+     * @param on_handoff Вызывается из потока ожидания после передачи.
+     * @throws std::system_error, если путь не удалось занять.
+     */
+    ListenerHandoff(std::string path, int listener, std::string identity, Handoff on_release, Handoff on_handoff);
+
+    /**
+     * @brief Прекращает ожидание; удаляет файл сокета, если передачи не было.
+     */
+    ~ListenerHandoff();
+
+    ListenerHandoff(const ListenerHandoff&) = delete;
+    ListenerHandoff& operator=(const ListenerHandoff&) = delete;
+
+private:
+    std::string path_;
+    int listener_;
+    std::string identity_;
+    int socket_ = -1;
+    bool handed_off_ = false;
+    Handoff on_release_;
+    Handoff on_handoff_;
+    std::thread thread_;
+
+    void wait();
+};
+
+#endif // HANDOFF_H
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include "handoff.h"
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+std::string test_path(const char* name) {
+    return "/tmp/chat_handoff_" + std::to_string(getpid()) + "_" + name;
+}
+
+int listening_socket(sockaddr_in& address) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    listen(fd, 8);
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    return fd;
+}
+
+} // namespace
+
+TEST(HandoffTest, DescriptorPassesOverUnixSocket) {
+    int channel[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+    int pipe_fds[2];
+    ASSERT_EQ(pipe(pipe_fds), 0);
+
+    ASSERT_TRUE(send_descriptor(channel[0], pipe_fds[1]));
+    int received = receive_descriptor(channel[1]);
+    ASSERT_GE(received, 0);
+    EXPECT_NE(received, pipe_fds[1]);
+
+    // Полученный дескриптор ссылается на тот же канал.
+    ASSERT_EQ(write(received, "x", 1), 1);
+    char byte = 0;
+    ASSERT_EQ(read(pipe_fds[0], &byte, 1), 1);
+    EXPECT_EQ(byte, 'x');
+
+    for (int fd : {channel[0], channel[1], pipe_fds[0], pipe_fds[1], received}) {
+        close(fd);
+    }
+}
+
+TEST(HandoffTest, NewProcessTakesListenerAndOldOneIsNotified) {
+    std::string path = test_path("listener");
+    sockaddr_in address{};
+    int listener = listening_socket(address);
+    std::atomic<bool> released{false};
+    std::atomic<bool> handed_off{false};
+    {
+        ListenerHandoff handoff(path, listener, "node-a", [&] { released = true; }, [&] { handed_off = true; });
+
+        std::optional<int> inherited = take_listener(path, "node-a");
+        ASSERT_TRUE(inherited);
+        // Прежний процесс отпускает журнал до того, как новый получит сокет.
+        EXPECT_TRUE(released);
+        // Соединение, принятое через унаследованный дескриптор, пришло на исходный порт.
+        int client = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+        int accepted = accept(*inherited, nullptr, nullptr);
+        EXPECT_GE(accepted, 0);
+        close(accepted);
+        close(client);
+        close(*inherited);
+
+        for (int i = 0; i < 100 && !handed_off; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_TRUE(handed_off);
+    }
+    close(listener);
+    unlink(path.c_str());
+}
+
+TEST(HandoffTest, ProcessOfAnotherNodeIsRefused) {
+    std::string path = test_path("other_node");
+    sockaddr_in address{};
+    int listener = listening_socket(address);
+    std::atomic<bool> released{false};
+    std::atomic<bool> handed_off{false};
+    {
+        ListenerHandoff handoff(path, listener, "tcp:broker:7000/node-a/3202", [&] { released = true; },
+                                [&] { handed_off = true; });
+        EXPECT_THROW(take_listener(path, "tcp:broker:7000/node-b/3203"), std::system_error);
+        EXPECT_FALSE(released);
+        // Отказ не завершает ожидание: свой узел по-прежнему забирает сокет.
+        std::optional<int> inherited = take_listener(path, "tcp:broker:7000/node-a/3202");
+        ASSERT_TRUE(inherited);
+        close(*inherited);
+        for (int i = 0; i < 100 && !handed_off; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_TRUE(handed_off);
+    }
+    close(listener);
+    unlink(path.c_str());
+}
+
+TEST(HandoffTest, FirstStartFindsNoListener) {
+    std::string path = test_path("missing");
+    unlink(path.c_str());
+    EXPECT_FALSE(take_listener(path, "node-a"));
+
+    // Без передачи файл сокета убирается при остановке.
+    sockaddr_in address{};
+    int listener = listening_socket(address);
+    {
+        ListenerHandoff handoff(path, listener, "node-a", [] {}, [] {});
+        struct stat info{};
+        ASSERT_EQ(stat(path.c_str(), &info), 0);
+        EXPECT_EQ(info.st_mode & 0777, 0600u);
+    }
+    EXPECT_NE(access(path.c_str(), F_OK), 0);
+    close(listener);
+}
+
+TEST(HandoffTest, PeerOfTheSameExecutableIsTrusted) {
+    int channel[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+    EXPECT_TRUE(trusted_peer(channel[0]));
+    close(channel[0]);
+    close(channel[1]);
+
+    // Не Unix-сокет: собеседника не узнать.
+    int pipe_fds[2];
+    ASSERT_EQ(pipe(pipe_fds), 0);
+    EXPECT_FALSE(trusted_peer(pipe_fds[0]));
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST(HandoffTest, SocketLivesInPrivateDirectory) {
+    std::string runtime = std::getenv("XDG_RUNTIME_DIR") ? std::getenv("XDG_RUNTIME_DIR") : "";
+    setenv("XDG_RUNTIME_DIR", "/run/user/test", 1);
+    EXPECT_EQ(handoff_path("ssl_server.handoff"), "/run/user/test/ssl_server.handoff");
+
+    unsetenv("XDG_RUNTIME_DIR");
+    std::string path = handoff_path("ssl_server.handoff");
+    std::string directory = path.substr(0, path.rfind('/'));
+    EXPECT_EQ(directory, "/tmp/ssl_server-" + std::to_string(geteuid()));
+    struct stat info{};
+    ASSERT_EQ(stat(directory.c_str(), &info), 0);
+    EXPECT_EQ(info.st_mode & 0777, 0700u);
+    EXPECT_EQ(info.st_uid, geteuid());
+    if (!runtime.empty()) {
+        setenv("XDG_RUNTIME_DIR", runtime.c_str(), 1);
+    }
+}
@@ -0,0 +1,132 @@
+/**
+ * @file ktls_bench.cpp
+ * @brief Пропускная способность отправки TLS: asio::ssl::stream против KtlsStream с шифрованием в ядре.
+ *
+ * Запуск из каталога сборки: ktls_bench [МиБ на прогон] [размер кадра]. Сервер пишет кадры
+ * через loopback клиенту на asio::ssl::stream; время процессора считается для всего процесса,
+ * поэтому включает и расшифровку на клиенте, одинаковую в обоих прогонах.
+ */
+
+#include "ktls_stream.h"
+#include <sys/resource.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace asio = boost::asio;
+namespace ssl = asio::ssl;
+using tcp = asio::ip::tcp;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double cpu_seconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto seconds = [](const timeval& t) { return static_cast<double>(t.tv_sec) + t.tv_usec / 1e6; };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+std::string find_certificate_dir() {
+    for (std::string dir : {"../", "./", "../../"}) {
+        if (std::ifstream(dir + "server.pem") && std::ifstream(dir + "server.key")) {
+            return dir;
+        }
+    }
+    return {};
+}
+
+ssl::context make_server_context(const std::string& dir, bool kernel_tls) {
+    ssl::context context(ssl::context::tlsv12_server);
+    context.use_certificate_chain_file(dir + "server.pem");
+    context.use_private_key_file(dir + "server.key", ssl::context::pem);
+    if (kernel_tls) {
+        enable_kernel_tls(context);
+    } else {
+        // Тот же набор шифров, что выбирает режим kTLS, чтобы сравнивался только путь записи.
+        SSL_CTX_set_cipher_list(context.native_handle(), "ECDHE+AESGCM:AESGCM:DEFAULT");
+    }
+    return context;
+}
+
+/**
+ * @brief Клиент в отдельном потоке: читает всё до закрытия соединения.
+ */
+std::thread start_reader(unsigned short port, std::size_t total) {
+    return std::thread([port, total] {
+        asio::io_context ioc;
+        ssl::context context(ssl::context::tlsv12_client);
+        context.set_verify_mode(ssl::verify_none);
+        ssl::stream<tcp::socket> stream(ioc, context);
+        stream.next_layer().connect({asio::ip::address_v4::loopback(), port});
+        stream.handshake(ssl::stream_base::client);
+        std::string buffer(256 * 1024, '\0');
+        std::size_t received = 0;
+        boost::system::error_code ec;
+        while (received < total && !ec) {
+            received += stream.read_some(asio::buffer(buffer), ec);
+        }
+    });
+}
+
+template <typename Stream>
+void run(const char* name, ssl::context& context, std::size_t total, std::size_t frame_size) {
+    asio::io_context ioc;
+    tcp::acceptor acceptor(ioc, {asio::ip::address_v4::loopback(), 0});
+    std::thread reader = start_reader(acceptor.local_endpoint().port(), total);
+    Stream stream(ioc.get_executor(), context);
+    acceptor.accept(stream.next_layer());
+
+    const std::string frame(frame_size, 'm');
+    double elapsed = 0;
+    double cpu = 0;
+    bool offloaded = false;
+    asio::co_spawn(ioc, [&]() -> asio::awaitable<void> {
+        co_await stream.async_handshake(ssl::stream_base::server, asio::use_awaitable);
+        if constexpr (std::is_same_v<Stream, KtlsStream>) {
+            offloaded = stream.send_offloaded();
+        }
+        double cpu_start = cpu_seconds();
+        auto start = clock_type::now();
+        for (std::size_t sent = 0; sent < total; sent += frame.size()) {
+            co_await asio::async_write(stream, asio::buffer(frame), asio::use_awaitable);
+        }
+        elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+        cpu = cpu_seconds() - cpu_start;
+    }, asio::detached);
+    ioc.run();
+    reader.join();
+
+    double mib = static_cast<double>(total) / (1024 * 1024);
+    std::cout << name << (offloaded ? " (kernel)" : "") << ": " << static_cast<std::size_t>(mib / elapsed) << " MiB/s, "
+              << cpu / mib * 1000 << " ms CPU per MiB\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::size_t total = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 512) * 1024 * 1024;
+    std::size_t frame_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16 * 1024;
+    std::string dir = find_certificate_dir();
+    if (dir.empty()) {
+        std::cerr << "server.pem and server.key not found\n";
+        return EXIT_FAILURE;
+    }
+
+    ssl::context user_space = make_server_context(dir, false);
+    run<ssl::stream<tcp::socket>>("asio::ssl::stream", user_space, total, frame_size);
+    ssl::context user_space_fd = make_server_context(dir, false);
+    run<KtlsStream>("KtlsStream, kTLS off", user_space_fd, total, frame_size);
+    if (kernel_tls_available()) {
+        ssl::context kernel = make_server_context(dir, true);
+        run<KtlsStream>("KtlsStream, kTLS on", kernel, total, frame_size);
+    } else {
+        std::cout << "kTLS on: skipped, kernel tls module not available\n";
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file ktls_stream.cpp
+ * @brief Реализация потока TLS с шифрованием в ядре.
+ */
+
+#include "ktls_stream.h"
+#include <cerrno>
+#include <new>
+#include <openssl/err.h>
+#include <unistd.h>
+
+namespace asio = boost::asio;
+namespace ssl = asio::ssl;
+
+bool kernel_tls_available() {
+#if defined(OPENSSL_NO_KTLS) || OPENSSL_VERSION_NUMBER < 0x30000000L
+    return false;
+#else
+    // Модуль tls появляется в /sys/module, когда загружен или встроен в ядро.
+    return access("/sys/module/tls", F_OK) == 0;
+#endif
+}
+
+void enable_kernel_tls(ssl::context& context) {
+    SSL_CTX* ctx = context.native_handle();
+#if !defined(OPENSSL_NO_KTLS) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+    // Ядро не умеет пересогласование; AES-GCM предпочитается, остальные наборы остаются запасными.
+    SSL_CTX_set_options(ctx, SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE);
+    SSL_CTX_set_cipher_list(ctx, "ECDHE+AESGCM:AESGCM:DEFAULT");
+}
+
+void KtlsStream::init() {
+    if (!ssl_) {
+        throw std::bad_alloc();
+    }
+    // Повтор записи после WANT_WRITE идёт с тем же буфером, но операция может вернуть часть данных.
+    SSL_set_mode(ssl_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+}
+
+KtlsStream::~KtlsStream() {
+    SSL_free(ssl_);
+}
+
+void KtlsStream::attach(ssl::stream_base::handshake_type type) {
+    socket_.non_blocking(true);
+    // BIO сокета не закрывает дескриптор: им владеет socket_.
+    SSL_set_fd(ssl_, static_cast<int>(socket_.native_handle()));
+    if (type == ssl::stream_base::server) {
+        SSL_set_accept_state(ssl_);
+    } else {
+        SSL_set_connect_state(ssl_);
+    }
+}
+
+bool KtlsStream::send_offloaded() const {
+#if !defined(OPENSSL_NO_KTLS) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#else
+    return false;
+#endif
+}
+
+bool KtlsStream::receive_offloaded() const {
+#if !defined(OPENSSL_NO_KTLS) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+#else
+    return false;
+#endif
+}
+
+void KtlsStream::clear_errors() {
+    ERR_clear_error();
+    errno = 0;
+}
+
+bool KtlsStream::finished(int result, asio::ip::tcp::socket::wait_type& wait, boost::system::error_code& ec) {
+    if (result > 0) {
+        ec = {};
+        return true;
+    }
+    int error = SSL_get_error(ssl_, result);
+    switch (error) {
+    case SSL_ERROR_WANT_READ:
+        wait = asio::ip::tcp::socket::wait_read;
+        return false;
+    case SSL_ERROR_WANT_WRITE:
+        wait = asio::ip::tcp::socket::wait_write;
+        return false;
+    case SSL_ERROR_ZERO_RETURN:
+        ec = asio::error::eof;
+        return true;
+    case SSL_ERROR_SYSCALL:
+        // Без errno - соединение оборвано без close_notify.
+        ec = errno != 0 ? boost::system::error_code(errno, boost::system::system_category())
+                        : boost::system::error_code(ssl::error::stream_truncated);
+        ERR_clear_error();
+        return true;
+    default:
+        ec = boost::system::error_code(static_cast<int>(ERR_get_error()), asio::error::get_ssl_category());
+        ERR_clear_error();
+        return true;
+    }
+}
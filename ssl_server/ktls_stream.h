@@ -0,0 +1,176 @@
+/**
+ * @file ktls_stream.h
+ * @brief Поток TLS поверх сокета с передачей шифрования записей ядру (kTLS).
+ */
+
+#ifndef KTLS_STREAM_H
+#define KTLS_STREAM_H
+
+#include <utility> // Boost 1.74 использует std::exchange в awaitable.hpp, не подключая <utility>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <cstddef>
+#include <type_traits>
+#include <openssl/ssl.h>
+
+/**
+ * @brief Доступно ли шифрование записей в ядре: OpenSSL 3 собран с kTLS и в ядре есть модуль tls.
+ */
+bool kernel_tls_available();
+
+/**
+ * @brief Включает kTLS в контексте: SSL_OP_ENABLE_KTLS, запрет пересогласования и
+ * предпочтение наборов AES-GCM, которые умеет шифровать ядро.
+ */
+void enable_kernel_tls(boost::asio::ssl::context& context);
+
+/**
+ * @brief Поток TLS, в котором OpenSSL работает прямо с дескриптором сокета.
+ *
+ * asio::ssl::stream ведёт OpenSSL через пару BIO в памяти, и ядро не может принять шифрование
+ * на себя. Здесь SSL связан с сокетом (SSL_set_fd), поэтому при включённом SSL_OP_ENABLE_KTLS
+ * после рукопожатия OpenSSL передаёт ключи ядру: SSL_write пишет открытый текст в сокет, и
+ * шифрует уже ядро, без копии в пространстве пользователя. Если ядро или набор шифров kTLS не
+ * поддерживают, тот же поток продолжает шифровать в OpenSSL.
+ *
+ * Интерфейс совпадает с используемой сервером частью asio::ssl::stream: async_handshake,
+ * async_read_some, async_write_some, lowest_layer. Сокет работает в неблокирующем режиме;
+ * операции ждут готовности сокета и повторяют вызов OpenSSL. Не более одного чтения и одной
+ * записи одновременно, из одного strand.
+ */
+class KtlsStream {
+public:
+    using executor_type = boost::asio::ip::tcp::socket::executor_type;
+    using next_layer_type = boost::asio::ip::tcp::socket;
+    using lowest_layer_type = boost::asio::ip::tcp::socket::lowest_layer_type;
+
+    /**
+     * @param executor Исполнитель сокета (strand сессии).
+     * @param context Настроенный контекст TLS (сертификат, enable_kernel_tls): SSL создаётся сразу.
+     */
+    template <typename Executor>
+    KtlsStream(const Executor& executor, boost::asio::ssl::context& context)
+        : socket_(executor), ssl_(SSL_new(context.native_handle())) {
+        init();
+    }
+
+    ~KtlsStream();
+
+    KtlsStream(const KtlsStream&) = delete;
+    KtlsStream& operator=(const KtlsStream&) = delete;
+
+    executor_type get_executor() { return socket_.get_executor(); }
+    next_layer_type& next_layer() { return socket_; }
+    lowest_layer_type& lowest_layer() { return socket_.lowest_layer(); }
+    SSL* native_handle() { return ssl_; }
+
+    /**
+     * @brief Шифрование отправки выполняет ядро.
+     */
+    bool send_offloaded() const;
+
+    /**
+     * @brief Расшифровку приёма выполняет ядро.
+     */
+    bool receive_offloaded() const;
+
+    /**
+     * @brief Рукопожатие TLS на принятом сокете. Обработчик: void(error_code).
+     */
+    template <typename CompletionToken>
+    auto async_handshake(boost::asio::ssl::stream_base::handshake_type type, CompletionToken&& token) {
+        attach(type);
+        return async_ssl<void(boost::system::error_code)>([this](std::size_t&) {
+            return SSL_do_handshake(ssl_);
+        }, std::forward<CompletionToken>(token));
+    }
+
+    template <typename MutableBufferSequence, typename CompletionToken>
+    auto async_read_some(const MutableBufferSequence& buffers, CompletionToken&& token) {
+        auto buffer = first_buffer<boost::asio::mutable_buffer>(buffers);
+        return async_ssl<void(boost::system::error_code, std::size_t)>([this, buffer](std::size_t& n) {
+            return buffer.size() == 0 ? 1 : SSL_read_ex(ssl_, buffer.data(), buffer.size(), &n);
+        }, std::forward<CompletionToken>(token));
+    }
+
+    template <typename ConstBufferSequence, typename CompletionToken>
+    auto async_write_some(const ConstBufferSequence& buffers, CompletionToken&& token) {
+        auto buffer = first_buffer<boost::asio::const_buffer>(buffers);
+        return async_ssl<void(boost::system::error_code, std::size_t)>([this, buffer](std::size_t& n) {
+            return buffer.size() == 0 ? 1 : SSL_write_ex(ssl_, buffer.data(), buffer.size(), &n);
+        }, std::forward<CompletionToken>(token));
+    }
+
+private:
+    boost::asio::ip::tcp::socket socket_;
+    SSL* ssl_;
+
+    void init();
+
+    /**
+     * @brief Связывает SSL с принятым сокетом и переводит сокет в неблокирующий режим.
+     */
+    void attach(boost::asio::ssl::stream_base::handshake_type type);
+
+    /**
+     * @brief Очищает очередь ошибок OpenSSL и errno перед вызовом OpenSSL.
+     */
+    static void clear_errors();
+
+    /**
+     * @brief Переводит результат вызова OpenSSL в код ошибки; пустой код означает "подождать сокет".
+     * @param result Результат вызова.
+     * @param wait Событие сокета, которого нужно дождаться.
+     * @return Истина, если операция завершена (успешно или с ошибкой ec).
+     */
+    bool finished(int result, boost::asio::ip::tcp::socket::wait_type& wait, boost::system::error_code& ec);
+
+    template <typename Buffer, typename Buffers>
+    static Buffer first_buffer(const Buffers& buffers) {
+        for (auto it = boost::asio::buffer_sequence_begin(buffers); it != boost::asio::buffer_sequence_end(buffers); ++it) {
+            if (Buffer buffer(*it); buffer.size() != 0) {
+                return buffer;
+            }
+        }
+        return Buffer();
+    }
+
+    /**
+     * @brief Повторяет вызов OpenSSL, пока он не завершится, дожидаясь готовности сокета.
+     *
+     * Если вызов завершился сразу, обработчик вызывается через post, а не изнутри инициирующей
+     * функции: иначе цикл чтения Beast рос бы в глубину стека на каждом готовом куске данных.
+     */
+    template <typename Signature, typename Operation, typename CompletionToken>
+    auto async_ssl(Operation operation, CompletionToken&& token) {
+        return boost::asio::async_compose<CompletionToken, Signature>(
+            [this, operation, started = false, done = false, result = boost::system::error_code(), n = std::size_t(0)](
+                auto& self, boost::system::error_code ec = {}) mutable {
+                if (!done) {
+                    boost::asio::ip::tcp::socket::wait_type wait{};
+                    if (!ec) {
+                        clear_errors();
+                        if (!finished(operation(n), wait, ec)) {
+                            started = true;
+                            socket_.async_wait(wait, std::move(self));
+                            return;
+                        }
+                    }
+                    done = true;
+                    result = ec;
+                    if (!started) {
+                        boost::asio::post(socket_.get_executor(), std::move(self));
+                        return;
+                    }
+                }
+                if constexpr (std::is_same_v<Signature, void(boost::system::error_code)>) {
+                    self.complete(result);
+                } else {
+                    self.complete(result, result ? 0 : n);
+                }
+            },
+            token, socket_);
+    }
+};
+
+#endif // KTLS_STREAM_H
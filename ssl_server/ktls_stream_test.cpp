@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include "ktls_stream.h"
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace asio = boost::asio;
+namespace ssl = asio::ssl;
+namespace beast = boost::beast;
+namespace http = beast::http;
+using tcp = asio::ip::tcp;
+
+namespace {
+
+// Тесты запускаются из каталога сборки рядом с исходниками, как и сервер.
+std::string find_certificate_dir() {
+    for (std::string dir : {"../", "./", "../../"}) {
+        if (std::ifstream(dir + "server.pem") && std::ifstream(dir + "server.key")) {
+            return dir;
+        }
+    }
+    return {};
+}
+
+// Контекст настраивается до создания потока: SSL_new копирует из него сертификат и параметры.
+ssl::context make_server_context(const std::string& dir) {
+    ssl::context context(ssl::context::tlsv12_server);
+    context.use_certificate_chain_file(dir + "server.pem");
+    context.use_private_key_file(dir + "server.key", ssl::context::pem);
+    enable_kernel_tls(context);
+    return context;
+}
+
+struct Loopback {
+    asio::io_context ioc;
+    ssl::context server_context;
+    ssl::context client_context{ssl::context::tlsv12_client};
+    tcp::acceptor acceptor{ioc, {asio::ip::address_v4::loopback(), 0}};
+    KtlsStream server{ioc.get_executor(), server_context};
+    ssl::stream<tcp::socket> client{ioc, client_context};
+
+    explicit Loopback(const std::string& dir) : server_context(make_server_context(dir)) {}
+
+    asio::awaitable<void> accept() {
+        co_await acceptor.async_accept(server.next_layer(), asio::use_awaitable);
+        co_await server.async_handshake(ssl::stream_base::server, asio::use_awaitable);
+    }
+
+    asio::awaitable<void> connect() {
+        co_await client.next_layer().async_connect(acceptor.local_endpoint(), asio::use_awaitable);
+        co_await client.async_handshake(ssl::stream_base::client, asio::use_awaitable);
+    }
+
+    template <typename Awaitable>
+    void spawn(Awaitable awaitable) {
+        asio::co_spawn(ioc, std::move(awaitable), [](std::exception_ptr error) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        });
+    }
+};
+
+} // namespace
+
+TEST(KtlsStreamTest, ExchangesHttpMessagesWithAsioClient) {
+    std::string dir = find_certificate_dir();
+    if (dir.empty()) {
+        GTEST_SKIP() << "server.pem not found";
+    }
+    Loopback loop(dir);
+    std::string received_by_server;
+    std::string received_by_client;
+
+    loop.spawn([&]() -> asio::awaitable<void> {
+        co_await loop.accept();
+        beast::flat_buffer buffer;
+        http::request<http::string_body> request;
+        co_await http::async_read(loop.server, buffer, request, asio::use_awaitable);
+        received_by_server = request.body();
+
+        // Ответ больше записи TLS и буфера сокета: запись идёт частями с ожиданием сокета.
+        http::response<http::string_body> response(http::status::ok, 11);
+        response.body() = std::string(1 << 20, 'x');
+        response.prepare_payload();
+        co_await http::async_write(loop.server, response, asio::use_awaitable);
+    }());
+    loop.spawn([&]() -> asio::awaitable<void> {
+        co_await loop.connect();
+        http::request<http::string_body> request(http::verb::post, "/", 11);
+        request.body() = "alice secret";
+        request.prepare_payload();
+        co_await http::async_write(loop.client, request, asio::use_awaitable);
+
+        beast::flat_buffer buffer;
+        http::response<http::string_body> response;
+        co_await http::async_read(loop.client, buffer, response, asio::use_awaitable);
+        received_by_client = response.body();
+    }());
+    loop.ioc.run();
+
+    EXPECT_EQ(received_by_server, "alice secret");
+    EXPECT_EQ(received_by_client, std::string(1 << 20, 'x'));
+}
+
+TEST(KtlsStreamTest, ReportsEndOfStreamWhenPeerCloses) {
+    std::string dir = find_certificate_dir();
+    if (dir.empty()) {
+        GTEST_SKIP() << "server.pem not found";
+    }
+    Loopback loop(dir);
+    boost::system::error_code read_error;
+
+    loop.spawn([&]() -> asio::awaitable<void> {
+        co_await loop.accept();
+        char byte;
+        co_await loop.server.async_read_some(asio::buffer(&byte, 1), asio::redirect_error(asio::use_awaitable, read_error));
+        loop.server.lowest_layer().close();
+    }());
+    loop.spawn([&]() -> asio::awaitable<void> {
+        co_await loop.connect();
+        // Ответного close_notify не будет: сервер просто закрывает сокет.
+        boost::system::error_code ignored;
+        co_await loop.client.async_shutdown(asio::redirect_error(asio::use_awaitable, ignored));
+    }());
+    loop.ioc.run();
+
+    EXPECT_EQ(read_error, asio::error::eof);
+}
+
+TEST(KtlsStreamTest, FailsHandshakeWithPlainTextClient) {
+    std::string dir = find_certificate_dir();
+    if (dir.empty()) {
+        GTEST_SKIP() << "server.pem not found";
+    }
+    Loopback loop(dir);
+    boost::system::error_code handshake_error;
+
+    loop.spawn([&]() -> asio::awaitable<void> {
+        co_await loop.acceptor.async_accept(loop.server.next_layer(), asio::use_awaitable);
+        co_await loop.server.async_handshake(ssl::stream_base::server, asio::redirect_error(asio::use_awaitable, handshake_error));
+        loop.server.lowest_layer().close();
+    }());
+    loop.spawn([&]() -> asio::awaitable<void> {
+        tcp::socket plain(loop.ioc);
+        co_await plain.async_connect(loop.acceptor.local_endpoint(), asio::use_awaitable);
+        co_await asio::async_write(plain, asio::buffer(std::string("GET / HTTP/1.1\r\n\r\n")), asio::use_awaitable);
+        char byte;
+        boost::system::error_code ignored;
+        co_await plain.async_read_some(asio::buffer(&byte, 1), asio::redirect_error(asio::use_awaitable, ignored));
+    }());
+    loop.ioc.run();
+
+    EXPECT_TRUE(handshake_error);
+    EXPECT_FALSE(loop.server.send_offloaded());
+}
@@ -0,0 +1,305 @@
+/**
+ * @file logger.cpp
+ * @brief Реализация асинхронного журнала.
+ */
+
+#include "logger.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+
+namespace {
+
+std::atomic<uint64_t> next_logger_id{1};
+
+/**
+ * @brief Буферы, созданные потоком для каждого журнала; помечаются завершёнными при выходе потока.
+ */
+struct ThreadRings {
+    std::vector<std::pair<uint64_t, std::shared_ptr<LogRing>>> rings;
+
+    ~ThreadRings() {
+        for (auto& [id, ring] : rings) {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadRings thread_rings;
+thread_local uint32_t sample_counter = 0;
+
+/**
+ * @brief Пишет в буфер фиксированного размера, обрезая то, что не помещается.
+ */
+class EntryWriter {
+public:
+    EntryWriter(char* begin, char* end) : pos_(begin), end_(end) {}
+
+    void put(char c) {
+        if (pos_ != end_) {
+            *pos_++ = c;
+        }
+    }
+
+    void put(std::string_view text) {
+        std::size_t n = std::min<std::size_t>(text.size(), end_ - pos_);
+        pos_ = std::copy_n(text.data(), n, pos_);
+    }
+
+    void put_number(int64_t value) {
+        char digits[24];
+        auto end = std::to_chars(std::begin(digits), std::end(digits), value).ptr;
+        put(std::string_view(digits, end - digits));
+    }
+
+    // Значения с пробелами, кавычками и управляющими символами заключаются в кавычки.
+    void put_value(std::string_view value) {
+        bool quote = value.empty() || std::any_of(value.begin(), value.end(), [](char c) {
+            return c == ' ' || c == '"' || c == '=' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+        });
+        if (!quote) {
+            put(value);
+            return;
+        }
+        put('"');
+        for (char c : value) {
+            switch (c) {
+            case '"': put("\\\""); break;
+            case '\\': put("\\\\"); break;
+            case '\n': put("\\n"); break;
+            case '\r': put("\\r"); break;
+            case '\t': put("\\t"); break;
+            default: put(c);
+            }
+        }
+        put('"');
+    }
+
+    char* pos() const { return pos_; }
+
+private:
+    char* pos_;
+    char* end_;
+};
+
+void append_timestamp(std::string& out, std::chrono::system_clock::time_point time) {
+    auto since_epoch = time.time_since_epoch();
+    std::time_t seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count();
+    int millis = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch).count() % 1000);
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    char text[32];
+    std::size_t n = std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(text + n, sizeof(text) - n, ".%03dZ", millis);
+    out.append(text);
+}
+
+} // namespace
+
+std::string_view log_level_name(LogLevel level) {
+    switch (level) {
+    case LogLevel::debug: return "debug";
+    case LogLevel::info: return "info";
+    case LogLevel::warn: return "warn";
+    case LogLevel::error: return "error";
+    case LogLevel::off: return "off";
+    }
+    return "unknown";
+}
+
+bool parse_log_level(std::string_view name, LogLevel& level) {
+    for (LogLevel candidate : {LogLevel::debug, LogLevel::info, LogLevel::warn, LogLevel::error, LogLevel::off}) {
+        if (log_level_name(candidate) == name) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+Logger::Logger(std::ostream& out, std::chrono::milliseconds flush_interval)
+    : out_(out), flush_interval_(flush_interval), id_(next_logger_id.fetch_add(1)) {
+    writer_ = std::thread([this] { writer_loop(); });
+}
+
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    writer_.join();
+}
+
+Logger& Logger::instance() {
+    static Logger logger(std::cout);
+    return logger;
+}
+
+LogRing& Logger::local_ring() {
+    for (auto& [id, ring] : thread_rings.rings) {
+        if (id == id_) {
+            return *ring;
+        }
+    }
+    auto ring = std::make_shared<LogRing>();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(ring);
+    }
+    thread_rings.rings.emplace_back(id_, ring);
+    return *ring;
+}
+
+void Logger::log(LogLevel level, std::string_view event, std::initializer_list<LogField> fields) {
+    if (!enabled(level)) {
+        return;
+    }
+
+    LogRing& ring = local_ring();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == kLogRingCapacity) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogRing::Entry& entry = ring.entries[head % kLogRingCapacity];
+    entry.time = std::chrono::system_clock::now();
+    entry.level = level;
+
+    EntryWriter writer(entry.text, entry.text + kLogEntrySize);
+    writer.put("event=");
+    writer.put(event);
+    for (const LogField& field : fields) {
+        writer.put(' ');
+        writer.put(field.key);
+        writer.put('=');
+        if (field.is_number) {
+            writer.put_number(field.number);
+        } else {
+            writer.put_value(field.text);
+        }
+    }
+    entry.size = static_cast<uint16_t>(writer.pos() - entry.text);
+
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+bool Logger::sample() {
+    return sample_counter++ % sample_every_.load(std::memory_order_relaxed) == 0;
+}
+
+void Logger::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t ticket = ++flush_requests_;
+    cv_.notify_all();
+    cv_.wait(lock, [&] { return flushed_ >= ticket; });
+}
+
+void Logger::writer_loop() {
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait_for(lock, flush_interval_, [this] { return stopping_ || flush_requests_ != flushed_; });
+        uint64_t requested = flush_requests_;
+        bool stopping = stopping_;
+
+        lock.unlock();
+        batch.clear();
+        if (drain(batch)) {
+            out_ << batch;
+            out_.flush();
+        }
+        lock.lock();
+
+        // Буферы завершившихся потоков удаляются после того, как из них всё прочитано.
+        rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [](const std::shared_ptr<LogRing>& ring) {
+            return ring->retired.load(std::memory_order_acquire) &&
+                   ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed);
+        }), rings_.end());
+
+        flushed_ = requested;
+        cv_.notify_all();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+bool Logger::drain(std::string& batch) {
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings = rings_;
+    }
+
+    std::vector<const LogRing::Entry*> pending;
+    std::vector<uint64_t> heads(rings.size());
+    for (std::size_t i = 0; i < rings.size(); ++i) {
+        heads[i] = rings[i]->head.load(std::memory_order_acquire);
+        for (uint64_t pos = rings[i]->tail.load(std::memory_order_relaxed); pos != heads[i]; ++pos) {
+            pending.push_back(&rings[i]->entries[pos % kLogRingCapacity]);
+        }
+    }
+    if (pending.empty()) {
+        return false;
+    }
+
+    // Записи разных потоков выводятся в порядке времени их создания.
+    std::stable_sort(pending.begin(), pending.end(), [](const LogRing::Entry* a, const LogRing::Entry* b) {
+        return a->time < b->time;
+    });
+    for (const LogRing::Entry* entry : pending) {
+        batch.append("ts=");
+        append_timestamp(batch, entry->time);
+        batch.append(" level=").append(log_level_name(entry->level));
+        batch.push_back(' ');
+        batch.append(entry->text, entry->size);
+        batch.push_back('\n');
+    }
+
+    for (std::size_t i = 0; i < rings.size(); ++i) {
+        rings[i]->tail.store(heads[i], std::memory_order_release);
+    }
+    return true;
+}
+
+std::string apply_log_settings(Logger& logger, std::string_view query) {
+    while (!query.empty()) {
+        std::size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+
+        std::size_t eq = pair.find('=');
+        if (eq == std::string_view::npos) {
+            continue;
+        }
+        std::string_view key = pair.substr(0, eq);
+        std::string_view value = pair.substr(eq + 1);
+
+        if (key == "level") {
+            LogLevel level;
+            if (parse_log_level(value, level)) {
+                logger.set_level(level);
+            }
+        } else if (key == "content") {
+            if (value == "on" || value == "off") {
+                logger.set_message_content(value == "on");
+            }
+        } else if (key == "sample") {
+            uint32_t every = 0;
+            if (std::from_chars(value.data(), value.data() + value.size(), every).ec == std::errc()) {
+                logger.set_sample_every(every);
+            }
+        }
+    }
+
+    std::string settings = "level=";
+    settings.append(log_level_name(logger.level()));
+    settings.append(" content=").append(logger.message_content() ? "on" : "off");
+    settings.append(" sample=").append(std::to_string(logger.sample_every()));
+    settings.push_back('\n');
+    return settings;
+}
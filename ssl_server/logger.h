@@ -0,0 +1,199 @@
+/**
+ * @file logger.h
+ * @brief Асинхронный структурированный журнал событий сервера.
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Уровень важности записи.
+ */
+enum class LogLevel : uint8_t { debug, info, warn, error, off };
+
+/**
+ * @brief Имя уровня ("debug", "info", ...).
+ */
+std::string_view log_level_name(LogLevel level);
+
+/**
+ * @brief Разбирает имя уровня.
+ * @param name Имя уровня.
+ * @param level Результат разбора.
+ * @return true, если имя известно.
+ */
+bool parse_log_level(std::string_view name, LogLevel& level);
+
+/**
+ * @brief Поле записи: ключ и строковое или целочисленное значение.
+ *
+ * Поле только ссылается на данные вызывающего и копируется в буфер потока при записи.
+ */
+struct LogField {
+    std::string_view key;
+    std::string_view text;
+    int64_t number = 0;
+    bool is_number = false;
+
+    LogField(std::string_view k, std::string_view v) : key(k), text(v) {}
+    LogField(std::string_view k, const char* v) : key(k), text(v) {}
+    LogField(std::string_view k, const std::string& v) : key(k), text(v) {}
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    LogField(std::string_view k, T v) : key(k), number(static_cast<int64_t>(v)), is_number(true) {}
+};
+
+/**
+ * @brief Максимальная длина одной записи без метки времени и уровня; более длинные обрезаются.
+ */
+constexpr std::size_t kLogEntrySize = 240;
+
+/**
+ * @brief Число записей в буфере одного потока.
+ */
+constexpr std::size_t kLogRingCapacity = 128;
+
+/**
+ * @brief Кольцевой буфер одного потока: один писатель (поток) и один читатель (фоновый поток журнала).
+ */
+struct LogRing {
+    struct Entry {
+        std::chrono::system_clock::time_point time;
+        LogLevel level;
+        uint16_t size;
+        char text[kLogEntrySize];
+    };
+
+    std::array<Entry, kLogRingCapacity> entries;
+    std::atomic<uint64_t> head{0};    ///< Следующая запись писателя.
+    std::atomic<uint64_t> tail{0};    ///< Следующая запись читателя.
+    std::atomic<bool> retired{false}; ///< Поток-владелец завершился.
+};
+
+/**
+ * @brief Асинхронный журнал в формате logfmt.
+ *
+ * Поток форматирует запись в свой кольцевой буфер без блокировок и системных вызовов;
+ * фоновый поток периодически забирает записи всех потоков, упорядочивает по времени
+ * и выводит одним блоком. При переполнении буфера запись отбрасывается и учитывается в dropped().
+ */
+class Logger {
+public:
+    /**
+     * @brief Создаёт журнал и запускает фоновый поток вывода.
+     * @param out Поток вывода.
+     * @param flush_interval Период опроса буферов.
+     */
+    explicit Logger(std::ostream& out, std::chrono::milliseconds flush_interval = std::chrono::milliseconds(20));
+
+    /**
+     * @brief Выводит оставшиеся записи и останавливает фоновый поток.
+     */
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /**
+     * @brief Журнал сервера, пишет в std::cout.
+     */
+    static Logger& instance();
+
+    /**
+     * @brief Проверяет, будет ли записано событие данного уровня.
+     */
+    bool enabled(LogLevel level) const {
+        return level >= level_.load(std::memory_order_relaxed) && level != LogLevel::off;
+    }
+
+    /**
+     * @brief Записывает событие.
+     * @param level Уровень.
+     * @param event Имя события.
+     * @param fields Поля события.
+     */
+    void log(LogLevel level, std::string_view event, std::initializer_list<LogField> fields = {});
+
+    /**
+     * @brief Решает, писать ли очередное частое событие (каждое N-е в потоке, см. set_sample_every()).
+     */
+    bool sample();
+
+    /**
+     * @brief Минимальный записываемый уровень.
+     */
+    void set_level(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Разрешает или запрещает писать в журнал текст сообщений пользователей.
+     */
+    void set_message_content(bool enabled) { message_content_.store(enabled, std::memory_order_relaxed); }
+    bool message_content() const { return message_content_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Для частых событий пишется только каждое N-е; 1 - писать все.
+     */
+    void set_sample_every(uint32_t n) { sample_every_.store(n ? n : 1, std::memory_order_relaxed); }
+    uint32_t sample_every() const { return sample_every_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Дожидается вывода всех записей, сделанных до вызова.
+     */
+    void flush();
+
+    /**
+     * @brief Число записей, отброшенных из-за переполнения буферов.
+     */
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    std::ostream& out_;
+    std::chrono::milliseconds flush_interval_;
+    uint64_t id_;
+
+    std::atomic<LogLevel> level_{LogLevel::info};
+    std::atomic<bool> message_content_{true};
+    std::atomic<uint32_t> sample_every_{1};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::shared_ptr<LogRing>> rings_;
+    uint64_t flush_requests_ = 0;
+    uint64_t flushed_ = 0;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    LogRing& local_ring();
+    void writer_loop();
+    bool drain(std::string& batch);
+};
+
+/**
+ * @brief Меняет настройки журнала по строке запроса вида "level=warn&content=off&sample=100".
+ *
+ * Неизвестные ключи и значения игнорируются.
+ * @param logger Журнал.
+ * @param query Строка запроса без '?'.
+ * @return Текущие настройки после изменения.
+ */
+std::string apply_log_settings(Logger& logger, std::string_view query);
+
+#endif // LOGGER_H
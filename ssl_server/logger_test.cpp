@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "logger.h"
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::size_t count_lines(const std::string& text) {
+    return static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+}
+
+} // namespace
+
+TEST(LoggerTest, WritesStructuredEntries) {
+    std::ostringstream out;
+    Logger logger(out);
+    logger.log(LogLevel::info, "client_connected", {{"user", "alice"}, {"bytes", 42}, {"text", "hi \"there\""}});
+    logger.flush();
+
+    std::string line = out.str();
+    EXPECT_EQ(line.rfind("ts=", 0), 0u);
+    EXPECT_NE(line.find(" level=info event=client_connected user=alice bytes=42 text=\"hi \\\"there\\\"\"\n"),
+              std::string::npos);
+}
+
+TEST(LoggerTest, FiltersByLevel) {
+    std::ostringstream out;
+    Logger logger(out);
+    logger.set_level(LogLevel::warn);
+    logger.log(LogLevel::info, "skipped");
+    logger.log(LogLevel::error, "kept");
+    logger.flush();
+
+    EXPECT_EQ(out.str().find("skipped"), std::string::npos);
+    EXPECT_NE(out.str().find("level=error event=kept"), std::string::npos);
+}
+
+TEST(LoggerTest, CollectsEntriesFromAllThreads) {
+    std::ostringstream out;
+    Logger logger(out);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&logger, t] {
+            for (int i = 0; i < 50; ++i) {
+                logger.log(LogLevel::info, "tick", {{"thread", t}, {"i", i}});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    logger.flush();
+
+    EXPECT_EQ(count_lines(out.str()) + logger.dropped(), 200u);
+}
+
+TEST(LoggerTest, DropsWhenThreadBufferIsFull) {
+    std::ostringstream out;
+    Logger logger(out, std::chrono::hours(1));
+    for (std::size_t i = 0; i < kLogRingCapacity + 10; ++i) {
+        logger.log(LogLevel::info, "burst");
+    }
+    logger.flush();
+
+    EXPECT_EQ(logger.dropped(), 10u);
+    EXPECT_EQ(count_lines(out.str()), kLogRingCapacity);
+}
+
+TEST(LoggerTest, AppliesRuntimeSettings) {
+    std::ostringstream out;
+    Logger logger(out);
+
+    EXPECT_EQ(apply_log_settings(logger, "level=warn&content=off&sample=100"), "level=warn content=off sample=100\n");
+    EXPECT_FALSE(logger.message_content());
+    EXPECT_FALSE(logger.enabled(LogLevel::info));
+
+    int sampled = 0;
+    for (int i = 0; i < 1000; ++i) {
+        sampled += logger.sample();
+    }
+    EXPECT_EQ(sampled, 10);
+
+    EXPECT_EQ(apply_log_settings(logger, "level=bogus&sample=x"), "level=warn content=off sample=100\n");
+}
@@ -0,0 +1,608 @@
+/**
+ * @file message_log.cpp
+ * @brief Реализация журнала сообщений на отображаемых в память сегментах.
+ */
+
+#include "message_log.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint16_t kFlagSystem = 1;
+
+/**
+ * @brief Заголовок записи в сегменте. Нулевой size означает конец данных сегмента.
+ */
+struct RecordHeader {
+    uint32_t size;      ///< Размер полезной нагрузки (имя + текст).
+    uint32_t checksum;  ///< FNV-1a по полям заголовка и полезной нагрузке.
+    uint64_t offset;    ///< Логическое смещение записи.
+    uint16_t name_size; ///< Длина имени отправителя.
+    uint16_t flags;     ///< Флаги записи.
+    uint32_t reserved;
+};
+
+static_assert(sizeof(RecordHeader) == 24, "RecordHeader must be packed to 24 bytes");
+
+std::size_t record_span(std::size_t payload) {
+    return (sizeof(RecordHeader) + payload + 7) & ~static_cast<std::size_t>(7);
+}
+
+uint32_t fnv1a(uint32_t hash, const void* data, std::size_t size) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t record_checksum(const RecordHeader& header, const char* payload) {
+    uint32_t hash = 2166136261u;
+    hash = fnv1a(hash, &header.offset, sizeof(header.offset));
+    hash = fnv1a(hash, &header.name_size, sizeof(header.name_size));
+    hash = fnv1a(hash, &header.flags, sizeof(header.flags));
+    return fnv1a(hash, payload, header.size);
+}
+
+std::string segment_path(const std::string& dir, uint64_t base) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%020llu.log", static_cast<unsigned long long>(base));
+    return dir + "/" + name;
+}
+
+std::runtime_error io_error(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " '" + path + "': " + std::strerror(errno));
+}
+
+/**
+ * @brief Берёт исключительную блокировку каталога журнала, не дожидаясь её.
+ * @return Дескриптор файла блокировки; блокировка снимается его закрытием.
+ */
+int lock_directory(const std::string& dir) {
+    std::string path = dir + "/LOCK";
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw io_error("Can't open log lock", path);
+    }
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        auto error = errno == EWOULDBLOCK ? std::runtime_error("Message log '" + dir + "' is used by another process")
+                                          : io_error("Can't lock log", path);
+        ::close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+} // namespace
+
+/**
+ * @brief Файл сегмента фиксированного размера, целиком отображённый в память.
+ */
+class LogSegment {
+public:
+    LogSegment(std::string file, uint64_t base_offset, std::size_t size)
+        : path(std::move(file)), base(base_offset) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw io_error("Can't open log segment", path);
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw io_error("Can't stat log segment", path);
+        }
+        capacity = st.st_size > 0 ? static_cast<std::size_t>(st.st_size) : size;
+        if (st.st_size == 0 && ::ftruncate(fd, static_cast<off_t>(capacity)) != 0) {
+            ::close(fd);
+            throw io_error("Can't allocate log segment", path);
+        }
+        void* mapping = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            throw io_error("Can't map log segment", path);
+        }
+        data = static_cast<char*>(mapping);
+    }
+
+    ~LogSegment() {
+        ::munmap(data, capacity);
+        ::close(fd);
+    }
+
+    LogSegment(const LogSegment&) = delete;
+    LogSegment& operator=(const LogSegment&) = delete;
+
+    RecordHeader header_at(std::size_t pos) const {
+        RecordHeader header;
+        std::memcpy(&header, data + pos, sizeof(header));
+        return header;
+    }
+
+    void sync(std::size_t from, std::size_t to) {
+        static const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::size_t start = from & ~(page - 1);
+        if (to > start) {
+            ::msync(data + start, to - start, MS_SYNC);
+        }
+    }
+
+    std::string path;
+    uint64_t base;
+    std::size_t capacity = 0;
+    char* data = nullptr;
+    int fd = -1;
+    std::atomic<std::size_t> end{0}; ///< Граница опубликованных для чтения записей.
+    std::size_t synced = 0;          ///< Граница сброшенных на диск данных (только для фонового потока).
+    bool sealed = false;             ///< Сегмент заполнен и больше не изменяется.
+    bool compacted = false;          ///< Сегмент получен уплотнением и повторно не обрабатывается.
+    std::vector<std::pair<uint64_t, uint32_t>> index; ///< Смещение записи -> позиция в сегменте.
+};
+
+MessageLog::MessageLog(const std::string& dir, std::size_t segment_size, std::size_t max_segments,
+                       std::chrono::milliseconds commit_interval)
+    : dir_(dir), segment_size_(segment_size), max_segments_(std::max<std::size_t>(max_segments, 1)),
+      commit_interval_(commit_interval) {
+    fs::create_directories(dir_);
+    lock_fd_ = lock_directory(dir_);
+    try {
+        recover();
+    } catch (...) {
+        ::close(lock_fd_);
+        throw;
+    }
+    committer_ = std::thread(&MessageLog::commit_loop, this);
+    compactor_ = std::thread(&MessageLog::compaction_loop, this);
+}
+
+MessageLog::~MessageLog() {
+    close();
+}
+
+void MessageLog::close() {
+    {
+        // Дописывающий поток либо успел до закрытия, и запись попадёт в последний сброс, либо получит исключение.
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(commit_mutex_);
+        stopping_ = true;
+    }
+    commit_cv_.notify_one();
+    compact_cv_.notify_one();
+    committer_.join();
+    compactor_.join();
+    {
+        // Читатели, уже получившие сегменты, держат их отображения до конца обхода.
+        std::lock_guard<std::mutex> guard(compact_mutex_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        segments_.clear();
+    }
+    ::close(lock_fd_);
+    lock_fd_ = -1;
+}
+
+std::shared_ptr<LogSegment> MessageLog::open_segment(uint64_t base) {
+    return std::make_shared<LogSegment>(segment_path(dir_, base), base, segment_size_);
+}
+
+void MessageLog::recover() {
+    std::vector<std::pair<uint64_t, std::string>> files;
+    for (const auto& entry : fs::directory_iterator(dir_)) {
+        const auto& path = entry.path();
+        if (path.extension() == ".compact") {
+            fs::remove(path); // Незавершённое уплотнение: исходные сегменты ещё на месте.
+        } else if (path.extension() == ".log") {
+            // Сегменты называются смещением первой записи; посторонние файлы не трогаются.
+            std::string stem = path.stem().string();
+            uint64_t base = 0;
+            auto [end, ec] = std::from_chars(stem.data(), stem.data() + stem.size(), base);
+            if (stem.empty() || ec != std::errc() || end != stem.data() + stem.size()) {
+                Logger::instance().log(LogLevel::warn, "log_file_ignored", {{"path", path.string()}});
+                continue;
+            }
+            files.emplace_back(base, path.string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    uint64_t expected = 0;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        const auto& [base, path] = files[i];
+        auto segment = std::make_shared<LogSegment>(path, base, segment_size_);
+        std::size_t pos = 0;
+        while (pos + sizeof(RecordHeader) <= segment->capacity) {
+            RecordHeader header = segment->header_at(pos);
+            std::size_t span = record_span(header.size);
+            if (header.size == 0 || pos + span > segment->capacity ||
+                header.checksum != record_checksum(header, segment->data + pos + sizeof(RecordHeader))) {
+                break;
+            }
+            // После прерванного уплотнения записи могут дублироваться в соседних сегментах.
+            if (header.offset >= expected) {
+                segment->index.emplace_back(header.offset, static_cast<uint32_t>(pos));
+                expected = header.offset + 1;
+            }
+            pos += span;
+        }
+        if (segment->index.empty() && i + 1 < files.size()) {
+            fs::remove(path);
+            continue;
+        }
+        segment->end.store(pos, std::memory_order_release);
+        segment->synced = pos;
+        segment->sealed = true;
+        segments_.push_back(std::move(segment));
+    }
+
+    if (segments_.empty()) {
+        segments_.push_back(open_segment(0));
+    }
+
+    // Хвост активного сегмента мог остаться от оборванной записи.
+    auto& active = segments_.back();
+    std::size_t tail = active->end.load(std::memory_order_relaxed);
+    std::memset(active->data + tail, 0, active->capacity - tail);
+    active->sealed = false;
+
+    next_offset_ = expected;
+    durable_end_ = expected;
+}
+
+uint64_t MessageLog::append(std::string_view name, std::string_view text, bool system, bool durable) {
+    if (name.size() > UINT16_MAX || record_span(name.size() + text.size()) > segment_size_) {
+        throw std::length_error("Message is too large for the log segment");
+    }
+
+    RecordHeader header{};
+    header.size = static_cast<uint32_t>(name.size() + text.size());
+    header.name_size = static_cast<uint16_t>(name.size());
+    header.flags = system ? kFlagSystem : 0;
+    std::size_t span = record_span(header.size);
+
+    bool rotated = false;
+    std::optional<uint64_t> retained; // Первое смещение после удаления старых сегментов
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (closed_) {
+            throw std::logic_error("Message log is closed");
+        }
+        auto segment = segments_.back();
+        std::size_t pos = segment->end.load(std::memory_order_relaxed);
+        if (pos + span > segment->capacity) {
+            segment->sealed = true;
+            segment = open_segment(next_offset_);
+            segments_.push_back(segment);
+            if (enforce_retention()) {
+                retained = segments_.front()->base;
+            }
+            pos = 0;
+            rotated = true;
+        }
+
+        header.offset = next_offset_++;
+        char* dst = segment->data + pos;
+        std::memcpy(dst + sizeof(RecordHeader), name.data(), name.size());
+        std::memcpy(dst + sizeof(RecordHeader) + name.size(), text.data(), text.size());
+        header.checksum = record_checksum(header, dst + sizeof(RecordHeader));
+        std::memcpy(dst, &header, sizeof(header));
+
+        segment->index.emplace_back(header.offset, static_cast<uint32_t>(pos));
+        segment->end.store(pos + span, std::memory_order_release);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(commit_mutex_);
+        dirty_ = true;
+        needs_compaction_ = needs_compaction_ || rotated;
+    }
+    commit_cv_.notify_one();
+    if (rotated) {
+        compact_cv_.notify_one();
+    }
+    if (retained && retention_observer_) {
+        retention_observer_(*retained);
+    }
+
+    if (durable) {
+        wait_durable(header.offset);
+    }
+    return header.offset;
+}
+
+void MessageLog::wait_durable(uint64_t offset) {
+    std::unique_lock<std::mutex> lock(commit_mutex_);
+    durable_cv_.wait(lock, [&] { return durable_end_ > offset || stopping_; });
+}
+
+void MessageLog::when_durable(uint64_t offset, std::function<void()> callback) {
+    std::unique_lock<std::mutex> lock(commit_mutex_);
+    // Пока фоновый поток вызывает ждущих, новый вызов встаёт за ними, чтобы не обогнать их.
+    if ((durable_end_ > offset || stopping_) && !notifying_ && durable_waiters_.empty()) {
+        lock.unlock();
+        callback();
+        return;
+    }
+    durable_waiters_.emplace(offset, std::move(callback));
+}
+
+void MessageLog::flush() {
+    uint64_t target = next_offset();
+    std::unique_lock<std::mutex> lock(commit_mutex_);
+    dirty_ = true;
+    commit_cv_.notify_one();
+    durable_cv_.wait(lock, [&] { return durable_end_ >= target || stopping_; });
+}
+
+std::size_t MessageLog::replay(uint64_t from, const std::function<bool(const LogRecord&)>& visitor) const {
+    struct Range {
+        std::shared_ptr<LogSegment> segment;
+        std::size_t begin;
+        std::size_t end;
+    };
+    std::vector<Range> plan;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = std::upper_bound(segments_.begin(), segments_.end(), from,
+                                   [](uint64_t value, const auto& segment) { return value < segment->base; });
+        if (it != segments_.begin()) {
+            --it;
+        }
+        for (; it != segments_.end(); ++it) {
+            const auto& index = (*it)->index;
+            auto entry = std::lower_bound(index.begin(), index.end(), from,
+                                          [](const auto& e, uint64_t value) { return e.first < value; });
+            if (entry != index.end()) {
+                plan.push_back({*it, entry->second, (*it)->end.load(std::memory_order_acquire)});
+            }
+        }
+    }
+
+    // Сегменты удерживаются через shared_ptr, поэтому обход идёт без блокировки.
+    std::size_t visited = 0;
+    uint64_t next = from;
+    for (const auto& range : plan) {
+        const char* data = range.segment->data;
+        for (std::size_t pos = range.begin; pos < range.end;) {
+            RecordHeader header = range.segment->header_at(pos);
+            const char* payload = data + pos + sizeof(RecordHeader);
+            pos += record_span(header.size);
+            if (header.offset < next) {
+                continue;
+            }
+            next = header.offset + 1;
+            LogRecord record{header.offset, (header.flags & kFlagSystem) != 0,
+                             std::string_view(payload, header.name_size),
+                             std::string_view(payload + header.name_size, header.size - header.name_size)};
+            ++visited;
+            if (!visitor(record)) {
+                return visited;
+            }
+        }
+    }
+    return visited;
+}
+
+uint64_t MessageLog::next_offset() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return next_offset_;
+}
+
+bool MessageLog::empty() const {
+    return next_offset() == 0;
+}
+
+// Вызывается под уникальной блокировкой mutex_. Возвращает истину, если сегменты удалены.
+bool MessageLog::enforce_retention() {
+    bool removed = false;
+    while (segments_.size() > max_segments_) {
+        ::unlink(segments_.front()->path.c_str());
+        segments_.erase(segments_.begin());
+        removed = true;
+    }
+    return removed;
+}
+
+void MessageLog::on_retention(std::function<void(uint64_t first_offset)> observer) {
+    retention_observer_ = std::move(observer);
+}
+
+void MessageLog::compact() {
+    std::lock_guard<std::mutex> guard(compact_mutex_);
+
+    std::vector<std::shared_ptr<LogSegment>> sealed;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        for (const auto& segment : segments_) {
+            if (segment->sealed && !segment->compacted) {
+                sealed.push_back(segment);
+            }
+        }
+    }
+
+    // Закрытые сегменты неизменяемы, поэтому их можно читать без блокировки.
+    bool has_system = false;
+    std::size_t live_bytes = 0;
+    for (const auto& segment : sealed) {
+        std::size_t end = segment->end.load(std::memory_order_acquire);
+        for (std::size_t pos = 0; pos < end;) {
+            RecordHeader header = segment->header_at(pos);
+            if (header.flags & kFlagSystem) {
+                has_system = true;
+            } else {
+                live_bytes += record_span(header.size);
+            }
+            pos += record_span(header.size);
+        }
+    }
+    if (!has_system && (sealed.size() < 2 || live_bytes > (sealed.size() - 1) * segment_size_)) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<LogSegment>> output;
+    std::size_t out_pos = 0;
+    for (const auto& segment : sealed) {
+        std::size_t end = segment->end.load(std::memory_order_acquire);
+        for (std::size_t pos = 0; pos < end;) {
+            RecordHeader header = segment->header_at(pos);
+            std::size_t span = record_span(header.size);
+            if (!(header.flags & kFlagSystem)) {
+                if (output.empty() || out_pos + span > output.back()->capacity) {
+                    output.push_back(std::make_shared<LogSegment>(
+                        segment_path(dir_, header.offset) + ".compact", header.offset, segment_size_));
+                    output.back()->sealed = true;
+                    output.back()->compacted = true;
+                    out_pos = 0;
+                }
+                auto& out = output.back();
+                std::memcpy(out->data + out_pos, segment->data + pos, span);
+                out->index.emplace_back(header.offset, static_cast<uint32_t>(out_pos));
+                out_pos += span;
+                out->end.store(out_pos, std::memory_order_relaxed);
+                out->synced = out_pos;
+            }
+            pos += span;
+        }
+    }
+    for (const auto& out : output) {
+        out->sync(0, out->synced);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // Переименование атомарно заменяет одноимённый старый сегмент; остальные удаляются после.
+    std::vector<std::string> final_paths;
+    for (const auto& out : output) {
+        std::string final_path = segment_path(dir_, out->base);
+        if (std::rename(out->path.c_str(), final_path.c_str()) != 0) {
+            throw io_error("Can't install compacted segment", final_path);
+        }
+        out->path = final_path;
+        final_paths.push_back(final_path);
+    }
+
+    // Уплотнённые ранее сегменты старше входных, остальные (включая активный) новее.
+    std::vector<std::shared_ptr<LogSegment>> result;
+    for (const auto& segment : segments_) {
+        if (std::find(sealed.begin(), sealed.end(), segment) == sealed.end()) {
+            if (segment->base > sealed.front()->base && !output.empty()) {
+                result.insert(result.end(), output.begin(), output.end());
+                output.clear();
+            }
+            result.push_back(segment);
+        } else if (std::find(final_paths.begin(), final_paths.end(), segment->path) == final_paths.end()) {
+            ::unlink(segment->path.c_str());
+        }
+    }
+    result.insert(result.end(), output.begin(), output.end());
+    segments_ = std::move(result);
+    if (enforce_retention()) {
+        uint64_t first = segments_.front()->base;
+        lock.unlock();
+        if (retention_observer_) {
+            retention_observer_(first);
+        }
+    }
+}
+
+uint64_t MessageLog::sync_segments() {
+    std::vector<std::pair<std::shared_ptr<LogSegment>, std::size_t>> pending;
+    uint64_t covered;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        covered = next_offset_;
+        for (const auto& segment : segments_) {
+            std::size_t end = segment->end.load(std::memory_order_acquire);
+            if (end > segment->synced) {
+                pending.emplace_back(segment, end);
+            }
+        }
+    }
+    for (auto& [segment, end] : pending) {
+        segment->sync(segment->synced, end);
+        segment->synced = end;
+    }
+    return covered;
+}
+
+void MessageLog::commit_loop() {
+    std::unique_lock<std::mutex> lock(commit_mutex_);
+    while (true) {
+        commit_cv_.wait(lock, [this] { return dirty_ || stopping_; });
+        if (!stopping_) {
+            // Даём другим потокам присоединиться к текущей группе записей.
+            commit_cv_.wait_for(lock, commit_interval_, [this] { return stopping_; });
+        }
+        dirty_ = false;
+
+        lock.unlock();
+        uint64_t covered = sync_segments();
+        lock.lock();
+        durable_end_ = std::max(durable_end_, covered);
+        durable_cv_.notify_all();
+        notify_durable(lock);
+
+        if (stopping_) {
+            break;
+        }
+    }
+}
+
+// Вызывается фоновым потоком сброса под commit_mutex_; обратные вызовы выполняются без него.
+void MessageLog::notify_durable(std::unique_lock<std::mutex>& lock) {
+    notifying_ = true;
+    while (!durable_waiters_.empty() && (durable_waiters_.begin()->first < durable_end_ || stopping_)) {
+        auto end = stopping_ ? durable_waiters_.end() : durable_waiters_.lower_bound(durable_end_);
+        std::vector<std::function<void()>> ready;
+        for (auto it = durable_waiters_.begin(); it != end; ++it) {
+            ready.push_back(std::move(it->second));
+        }
+        durable_waiters_.erase(durable_waiters_.begin(), end);
+
+        lock.unlock();
+        for (auto& callback : ready) {
+            callback();
+        }
+        lock.lock();
+    }
+    notifying_ = false;
+}
+
+void MessageLog::compaction_loop() {
+    std::unique_lock<std::mutex> lock(commit_mutex_);
+    while (true) {
+        compact_cv_.wait(lock, [this] { return needs_compaction_ || stopping_; });
+        if (stopping_) {
+            break;
+        }
+        needs_compaction_ = false;
+
+        lock.unlock();
+        try {
+            compact();
+        } catch (const std::exception& e) {
+            Logger::instance().log(LogLevel::error, "log_compaction_failed", {{"error", e.what()}});
+        }
+        lock.lock();
+    }
+}
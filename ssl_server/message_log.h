@@ -0,0 +1,186 @@
+/**
+ * @file message_log.h
+ * @brief Журнал сообщений чата только на дозапись, хранящийся в отображаемых в память сегментах.
+ */
+
+#ifndef MESSAGE_LOG_H
+#define MESSAGE_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Запись журнала. Поля name и text указывают прямо в отображённую память сегмента.
+ */
+struct LogRecord {
+    uint64_t offset;       ///< Логическое смещение записи в журнале.
+    bool system;           ///< Служебная запись (подключение или отключение клиента).
+    std::string_view name; ///< Имя отправителя, пустое для служебных записей.
+    std::string_view text; ///< Текст сообщения.
+};
+
+class LogSegment;
+
+/**
+ * @brief Журнал сообщений из сегментов фиксированного размера, отображённых в память.
+ *
+ * Каждая запись получает монотонно растущее логическое смещение. Для каждого сегмента
+ * в памяти строится индекс смещение -> позиция, поэтому чтение с произвольного смещения
+ * не требует просмотра предыдущих сегментов. Запись на диск выполняется фоновым потоком
+ * группами (group commit): один msync подтверждает все записи, накопленные за интервал.
+ * Заполненный сегмент закрывается и открывается новый; самые старые сегменты удаляются.
+ * Закрытые сегменты со служебными записями уплотняются (служебные записи удаляются). Сервер
+ * больше не пишет служебных записей, так что уплотнение лишь очищает сегменты прежних версий
+ * и перенесённую из базы историю; на новых данных оно ничего не переписывает.
+ */
+class MessageLog {
+public:
+    /**
+     * @brief Открывает журнал в каталоге dir, восстанавливая уже записанные сегменты.
+     *
+     * На время работы журнал держит исключительную блокировку flock файла LOCK в каталоге:
+     * второй экземпляр на том же каталоге, в этом или другом процессе, не откроется.
+     * @param dir Каталог с файлами сегментов (создаётся при необходимости).
+     * @param segment_size Размер одного сегмента в байтах.
+     * @param max_segments Максимальное число хранимых сегментов.
+     * @param commit_interval Интервал группового сброса на диск.
+     * @throws std::runtime_error если каталог занят другим экземпляром журнала или недоступен.
+     */
+    explicit MessageLog(const std::string& dir,
+                        std::size_t segment_size = 8 * 1024 * 1024,
+                        std::size_t max_segments = 64,
+                        std::chrono::milliseconds commit_interval = std::chrono::milliseconds(2));
+
+    /**
+     * @brief Сбрасывает несохранённые записи и останавливает фоновый поток.
+     */
+    ~MessageLog();
+
+    /**
+     * @brief Сбрасывает записи на диск, останавливает фоновые потоки и снимает блокировку каталога.
+     *
+     * После закрытия append бросает исключение, replay ничего не возвращает, а ждущие сброса
+     * вызываются сразу. Повторный вызов ничего не делает.
+     */
+    void close();
+
+    MessageLog(const MessageLog&) = delete;
+    MessageLog& operator=(const MessageLog&) = delete;
+
+    /**
+     * @brief Дописывает сообщение в конец журнала.
+     * @param name Имя отправителя.
+     * @param text Текст сообщения.
+     * @param system Признак служебной записи.
+     * @param durable Если истина, ждёт, пока запись будет сброшена на диск.
+     * @return Смещение добавленной записи.
+     * @throws std::length_error если запись не помещается в сегмент.
+     * @throws std::logic_error если журнал закрыт.
+     */
+    uint64_t append(std::string_view name, std::string_view text, bool system = false, bool durable = true);
+
+    /**
+     * @brief Блокирует поток, пока запись с указанным смещением не окажется на диске.
+     * @param offset Смещение записи.
+     */
+    void wait_durable(uint64_t offset);
+
+    /**
+     * @brief Вызывает callback, когда запись с указанным смещением окажется на диске, не блокируя поток.
+     *
+     * Если запись уже на диске, callback вызывается сразу в вызывающем потоке, иначе - в фоновом
+     * потоке сброса после msync. Обратные вызовы выполняются по возрастанию смещений, для одного
+     * смещения - в порядке регистрации. callback не должен ждать сброса журнала.
+     * @param offset Смещение записи.
+     * @param callback Обратный вызов.
+     */
+    void when_durable(uint64_t offset, std::function<void()> callback);
+
+    /**
+     * @brief Последовательно обходит записи, начиная со смещения from, без копирования данных.
+     * @param from Первое смещение, которое нужно вернуть.
+     * @param visitor Функция, вызываемая для каждой записи; возврат false прекращает обход.
+     * @return Количество переданных в visitor записей.
+     */
+    std::size_t replay(uint64_t from, const std::function<bool(const LogRecord&)>& visitor) const;
+
+    /**
+     * @brief Смещение, которое получит следующая запись.
+     */
+    uint64_t next_offset() const;
+
+    /**
+     * @brief Возвращает истину, если в журнале нет ни одной записи.
+     */
+    bool empty() const;
+
+    /**
+     * @brief Уплотняет закрытые сегменты со служебными записями (наследие прежних версий) и удаляет
+     * самые старые сверх лимита.
+     */
+    void compact();
+
+    /**
+     * @brief Задаёт обработчик удаления старых сегментов по сроку хранения.
+     *
+     * Вызывается без блокировок журнала со смещением первой оставшейся записи: записи до него
+     * больше не читаются. Задаётся до начала записи в журнал.
+     * @param observer Обработчик.
+     */
+    void on_retention(std::function<void(uint64_t first_offset)> observer);
+
+    /**
+     * @brief Немедленно сбрасывает все записи на диск.
+     */
+    void flush();
+
+private:
+    std::string dir_;
+    std::size_t segment_size_;
+    std::size_t max_segments_;
+    std::chrono::milliseconds commit_interval_;
+
+    mutable std::shared_mutex mutex_;                  ///< Защищает список сегментов и их индексы.
+    std::vector<std::shared_ptr<LogSegment>> segments_; ///< Сегменты по возрастанию смещений.
+    uint64_t next_offset_ = 0;
+    bool closed_ = false;                               ///< Журнал закрыт (close), записи не принимаются.
+    int lock_fd_ = -1;                                  ///< Файл LOCK под блокировкой flock.
+
+    std::mutex compact_mutex_;
+
+    std::mutex commit_mutex_;
+    std::condition_variable commit_cv_;
+    std::condition_variable durable_cv_;
+    std::condition_variable compact_cv_;
+    uint64_t durable_end_ = 0;    ///< Все смещения меньше этого значения уже на диске.
+    std::multimap<uint64_t, std::function<void()>> durable_waiters_; ///< Ждущие сброса, по смещению.
+    bool notifying_ = false;      ///< Фоновый поток вызывает ждущих сброса.
+    bool dirty_ = false;
+    bool needs_compaction_ = false;
+    bool stopping_ = false;
+    std::function<void(uint64_t)> retention_observer_;
+    std::thread committer_;
+    std::thread compactor_;
+
+    void recover();
+    std::shared_ptr<LogSegment> open_segment(uint64_t base);
+    bool enforce_retention();
+    uint64_t sync_segments();
+    void commit_loop();
+    void notify_durable(std::unique_lock<std::mutex>& lock);
+    void compaction_loop();
+};
+
+#endif // MESSAGE_LOG_H
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include "message_log.h"
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+class MessageLogTest : public ::testing::Test {
+protected:
+    std::string dir;
+
+    void SetUp() override {
+        dir = (fs::temp_directory_path() / ("message_log_test_" + std::to_string(::getpid()))).string();
+        fs::remove_all(dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    static std::vector<std::string> texts(const MessageLog& log, uint64_t from) {
+        std::vector<std::string> result;
+        log.replay(from, [&](const LogRecord& record) {
+            result.emplace_back(record.text);
+            return true;
+        });
+        return result;
+    }
+};
+
+TEST_F(MessageLogTest, AppendAndReplayFromOffset) {
+    MessageLog log(dir, 4096);
+    EXPECT_TRUE(log.empty());
+    EXPECT_EQ(log.append("alice", "hello"), 0u);
+    EXPECT_EQ(log.append("bob", "hi"), 1u);
+    EXPECT_EQ(log.append("", "[+]\tNew client carol connected.", true), 2u);
+
+    EXPECT_EQ(texts(log, 0), (std::vector<std::string>{"hello", "hi", "[+]\tNew client carol connected."}));
+    EXPECT_EQ(texts(log, 2), (std::vector<std::string>{"[+]\tNew client carol connected."}));
+    EXPECT_TRUE(texts(log, 3).empty());
+
+    log.replay(1, [](const LogRecord& record) {
+        EXPECT_EQ(record.offset, 1u);
+        EXPECT_EQ(record.name, "bob");
+        EXPECT_FALSE(record.system);
+        return false;
+    });
+}
+
+TEST_F(MessageLogTest, RotatesSegmentsAndRecovers) {
+    {
+        MessageLog log(dir, 256);
+        for (int i = 0; i < 20; ++i) {
+            log.append("user", "message " + std::to_string(i), false, false);
+        }
+        log.flush();
+    }
+    EXPECT_GT(std::count_if(fs::directory_iterator(dir), fs::directory_iterator{},
+                            [](const fs::directory_entry& entry) { return entry.path().extension() == ".log"; }),
+              1);
+
+    MessageLog reopened(dir, 256);
+    EXPECT_EQ(reopened.next_offset(), 20u);
+    EXPECT_EQ(texts(reopened, 18), (std::vector<std::string>{"message 18", "message 19"}));
+    EXPECT_EQ(reopened.append("user", "after restart"), 20u);
+}
+
+TEST_F(MessageLogTest, RecoveryIgnoresForeignLogFiles) {
+    {
+        MessageLog log(dir, 256);
+        log.append("user", "kept", false, false);
+        log.flush();
+    }
+    std::ofstream(fs::path(dir) / "notes.log") << "not a segment";
+    std::ofstream(fs::path(dir) / "12abc.log") << "not a segment";
+
+    MessageLog reopened(dir, 256);
+    EXPECT_EQ(reopened.next_offset(), 1u);
+    EXPECT_EQ(texts(reopened, 0), (std::vector<std::string>{"kept"}));
+    EXPECT_TRUE(fs::exists(fs::path(dir) / "notes.log"));
+}
+
+TEST_F(MessageLogTest, CompactionDropsSystemRecordsAndKeepsOffsets) {
+    MessageLog log(dir, 256);
+    for (int i = 0; i < 12; ++i) {
+        log.append("", "join", true, false);
+        log.append("user", "text " + std::to_string(i), false, false);
+    }
+    log.compact();
+
+    std::vector<uint64_t> offsets;
+    log.replay(0, [&](const LogRecord& record) {
+        offsets.push_back(record.offset);
+        return true;
+    });
+    ASSERT_FALSE(offsets.empty());
+    EXPECT_EQ(offsets.back(), 23u);
+    EXPECT_TRUE(std::is_sorted(offsets.begin(), offsets.end()));
+    EXPECT_LT(offsets.size(), 24u);
+    EXPECT_EQ(texts(log, 23), (std::vector<std::string>{"text 11"}));
+}
+
+TEST_F(MessageLogTest, SecondInstanceOnSameDirectoryIsRefused) {
+    auto first = std::make_unique<MessageLog>(dir, 4096);
+    first->append("alice", "from the old process", false, false);
+    EXPECT_THROW({ MessageLog blocked(dir, 4096); }, std::runtime_error);
+
+    // Закрытый журнал сброшен на диск и отпускает каталог; дописать в него больше нельзя.
+    first->close();
+    EXPECT_THROW(first->append("alice", "too late"), std::logic_error);
+    MessageLog second(dir, 4096);
+    EXPECT_EQ(second.next_offset(), 1u);
+    EXPECT_EQ(second.append("bob", "from the new process"), 1u);
+    EXPECT_EQ(texts(second, 0), (std::vector<std::string>{"from the old process", "from the new process"}));
+
+    first.reset();
+    EXPECT_THROW({ MessageLog blocked(dir, 4096); }, std::runtime_error);
+}
+
+TEST_F(MessageLogTest, RejectsRecordLargerThanSegment) {
+    MessageLog log(dir, 128);
+    EXPECT_THROW(log.append("user", std::string(512, 'x')), std::length_error);
+}
+
+TEST_F(MessageLogTest, NotifiesDurableRecordsInOffsetOrder) {
+    // Длинный интервал группы: все ждущие регистрируются до сброса.
+    MessageLog log(dir, 4096, 64, std::chrono::milliseconds(200));
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<int> calls;
+    auto record = [&](int value) {
+        return [&, value] {
+            std::lock_guard<std::mutex> lock(mutex);
+            calls.push_back(value);
+            done.notify_all();
+        };
+    };
+
+    uint64_t first = log.append("alice", "one", false, false);
+    uint64_t second = log.append("bob", "two", false, false);
+    log.when_durable(second, record(2));
+    log.when_durable(first, record(1));
+    log.when_durable(second, record(3)); // То же смещение: после зарегистрированного раньше
+
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(done.wait_for(lock, std::chrono::seconds(5), [&] { return calls.size() == 3; }));
+    EXPECT_EQ(calls, (std::vector<int>{1, 2, 3}));
+    lock.unlock();
+
+    // Запись уже на диске: вызов сразу, в этом же потоке.
+    bool called = false;
+    log.when_durable(first, [&] { called = true; });
+    EXPECT_TRUE(called);
+}
+
+TEST_F(MessageLogTest, ReportsFirstOffsetAfterRetention) {
+    MessageLog log(dir, 256, 2);
+    std::vector<uint64_t> reported;
+    log.on_retention([&](uint64_t first) { reported.push_back(first); });
+    for (int i = 0; i < 20; ++i) {
+        log.append("user", "message " + std::to_string(i), false, false);
+    }
+    ASSERT_FALSE(reported.empty());
+    EXPECT_TRUE(std::is_sorted(reported.begin(), reported.end()));
+
+    uint64_t first = 0;
+    log.replay(0, [&](const LogRecord& record) {
+        first = record.offset;
+        return false;
+    });
+    EXPECT_EQ(reported.back(), first);
+}
@@ -0,0 +1,236 @@
+/**
+ * @file metrics.cpp
+ * @brief Реализация реестра метрик и вывода в текстовом формате Prometheus.
+ */
+
+#include "metrics.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * @brief Шард потока: регистрируется при первом обращении и сливается в общий при завершении потока.
+ */
+struct ShardHolder {
+    MetricsShard shard;
+
+    ShardHolder() {
+        MetricsRegistry::instance().attach(&shard);
+    }
+
+    ~ShardHolder() {
+        MetricsRegistry::instance().detach(&shard);
+    }
+};
+
+void add_relaxed(std::atomic<uint64_t>& cell, uint64_t n) {
+    cell.fetch_add(n, std::memory_order_relaxed);
+}
+
+std::string format_bound(double bound) {
+    std::ostringstream out;
+    out << bound;
+    return out.str();
+}
+
+} // namespace
+
+std::vector<double> latency_buckets() {
+    return {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5};
+}
+
+void Counter::inc(uint64_t n) {
+    add_relaxed(MetricsRegistry::instance().local_shard().counters[slot_], n);
+}
+
+uint64_t Counter::value() const {
+    return MetricsRegistry::instance().sum_counter(slot_);
+}
+
+void Gauge::add(int64_t delta) {
+    // Значение хранится в дополнительном коде, поэтому сумма по шардам корректна и для уменьшений.
+    add_relaxed(MetricsRegistry::instance().local_shard().counters[slot_], static_cast<uint64_t>(delta));
+}
+
+int64_t Gauge::value() const {
+    return static_cast<int64_t>(MetricsRegistry::instance().sum_counter(slot_));
+}
+
+void Histogram::observe(double value) {
+    auto& cells = MetricsRegistry::instance().local_shard().histograms[slot_];
+    std::size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    add_relaxed(cells.buckets[bucket], 1);
+    cells.sum.store(cells.sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::count() const {
+    uint64_t total = 0;
+    for (std::size_t bucket = 0; bucket <= bounds_.size(); ++bucket) {
+        total += MetricsRegistry::instance().sum_bucket(slot_, bucket);
+    }
+    return total;
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsShard& MetricsRegistry::local_shard() {
+    thread_local ShardHolder holder;
+    return holder.shard;
+}
+
+void MetricsRegistry::attach(MetricsShard* shard) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shards_.push_back(shard);
+}
+
+void MetricsRegistry::detach(MetricsShard* shard) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < kMaxCounterSlots; ++i) {
+        add_relaxed(retired_.counters[i], shard->counters[i].load(std::memory_order_relaxed));
+    }
+    for (std::size_t h = 0; h < kMaxHistograms; ++h) {
+        auto& from = shard->histograms[h];
+        auto& to = retired_.histograms[h];
+        for (std::size_t b = 0; b <= kMaxHistogramBounds; ++b) {
+            add_relaxed(to.buckets[b], from.buckets[b].load(std::memory_order_relaxed));
+        }
+        to.sum.store(to.sum.load(std::memory_order_relaxed) + from.sum.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    }
+    shards_.erase(std::remove(shards_.begin(), shards_.end(), shard), shards_.end());
+}
+
+const MetricsRegistry::Definition* MetricsRegistry::find(const std::string& name) const {
+    for (const auto& definition : definitions_) {
+        if (definition.name == name) {
+            return &definition;
+        }
+    }
+    return nullptr;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto existing = find(name); existing && existing->kind == Kind::counter) {
+        return counters_[existing->index];
+    }
+    if (next_counter_slot_ == kMaxCounterSlots) {
+        throw std::length_error("Too many counters: " + name);
+    }
+    counters_.emplace_back(next_counter_slot_++);
+    definitions_.push_back({name, help, Kind::counter, counters_.size() - 1, {}});
+    return counters_.back();
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto existing = find(name); existing && existing->kind == Kind::gauge) {
+        return gauges_[existing->index];
+    }
+    if (next_counter_slot_ == kMaxCounterSlots) {
+        throw std::length_error("Too many gauges: " + name);
+    }
+    gauges_.emplace_back(next_counter_slot_++);
+    definitions_.push_back({name, help, Kind::gauge, gauges_.size() - 1, {}});
+    return gauges_.back();
+}
+
+void MetricsRegistry::gauge_callback(const std::string& name, const std::string& help, std::function<double()> read) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    definitions_.push_back({name, help, Kind::callback, 0, std::move(read)});
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, std::vector<double> bounds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto existing = find(name); existing && existing->kind == Kind::histogram) {
+        return histograms_[existing->index];
+    }
+    if (histograms_.size() == kMaxHistograms || bounds.size() > kMaxHistogramBounds) {
+        throw std::length_error("Too many histograms or buckets: " + name);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    histograms_.emplace_back(histograms_.size(), std::move(bounds));
+    definitions_.push_back({name, help, Kind::histogram, histograms_.size() - 1, {}});
+    return histograms_.back();
+}
+
+uint64_t MetricsRegistry::sum_counter(std::size_t slot) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t total = retired_.counters[slot].load(std::memory_order_relaxed);
+    for (const auto* shard : shards_) {
+        total += shard->counters[slot].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t MetricsRegistry::sum_bucket(std::size_t slot, std::size_t bucket) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t total = retired_.histograms[slot].buckets[bucket].load(std::memory_order_relaxed);
+    for (const auto* shard : shards_) {
+        total += shard->histograms[slot].buckets[bucket].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// Вызывается под mutex_.
+double MetricsRegistry::sum_histogram(std::size_t slot) const {
+    double total = retired_.histograms[slot].sum.load(std::memory_order_relaxed);
+    for (const auto* shard : shards_) {
+        total += shard->histograms[slot].sum.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::string MetricsRegistry::render() const {
+    std::ostringstream out;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto sum_slot = [this](std::size_t slot) {
+        uint64_t total = retired_.counters[slot].load(std::memory_order_relaxed);
+        for (const auto* shard : shards_) {
+            total += shard->counters[slot].load(std::memory_order_relaxed);
+        }
+        return total;
+    };
+
+    for (const auto& definition : definitions_) {
+        out << "# HELP " << definition.name << ' ' << definition.help << '\n';
+        switch (definition.kind) {
+        case Kind::counter:
+            out << "# TYPE " << definition.name << " counter\n"
+                << definition.name << ' ' << sum_slot(counters_[definition.index].slot_) << '\n';
+            break;
+        case Kind::gauge:
+            out << "# TYPE " << definition.name << " gauge\n"
+                << definition.name << ' ' << static_cast<int64_t>(sum_slot(gauges_[definition.index].slot_)) << '\n';
+            break;
+        case Kind::callback:
+            out << "# TYPE " << definition.name << " gauge\n"
+                << definition.name << ' ' << definition.read() << '\n';
+            break;
+        case Kind::histogram: {
+            const Histogram& histogram = histograms_[definition.index];
+            out << "# TYPE " << definition.name << " histogram\n";
+            uint64_t cumulative = 0;
+            for (std::size_t bucket = 0; bucket <= histogram.bounds_.size(); ++bucket) {
+                uint64_t count = retired_.histograms[histogram.slot_].buckets[bucket].load(std::memory_order_relaxed);
+                for (const auto* shard : shards_) {
+                    count += shard->histograms[histogram.slot_].buckets[bucket].load(std::memory_order_relaxed);
+                }
+                cumulative += count;
+                std::string le = bucket < histogram.bounds_.size() ? format_bound(histogram.bounds_[bucket]) : "+Inf";
+                out << definition.name << "_bucket{le=\"" << le << "\"} " << cumulative << '\n';
+            }
+            out << definition.name << "_sum " << sum_histogram(histogram.slot_) << '\n'
+                << definition.name << "_count " << cumulative << '\n';
+            break;
+        }
+        }
+    }
+    return out.str();
+}
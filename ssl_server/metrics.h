@@ -0,0 +1,234 @@
+/**
+ * @file metrics.h
+ * @brief Счётчики и гистограммы сервера с пошардовым хранением по потокам.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Максимальное число счётчиков и датчиков (общий пул слотов).
+ */
+constexpr std::size_t kMaxCounterSlots = 128;
+
+/**
+ * @brief Максимальное число гистограмм.
+ */
+constexpr std::size_t kMaxHistograms = 32;
+
+/**
+ * @brief Максимальное число границ корзин одной гистограммы.
+ */
+constexpr std::size_t kMaxHistogramBounds = 24;
+
+/**
+ * @brief Значения метрик, накопленные одним потоком.
+ *
+ * Каждый поток пишет только в свой шард, поэтому запись - это неконкурентный relaxed-инкремент.
+ * Атомики нужны лишь для того, чтобы чтение из потока эндпоинта было корректным.
+ */
+struct MetricsShard {
+    struct HistogramCells {
+        std::array<std::atomic<uint64_t>, kMaxHistogramBounds + 1> buckets{};
+        std::atomic<double> sum{0};
+    };
+
+    std::array<std::atomic<uint64_t>, kMaxCounterSlots> counters{};
+    std::array<HistogramCells, kMaxHistograms> histograms{};
+};
+
+/**
+ * @brief Монотонно растущий счётчик.
+ */
+class Counter {
+public:
+    explicit Counter(std::size_t slot) : slot_(slot) {}
+
+    /**
+     * @brief Увеличивает счётчик.
+     * @param n Величина приращения.
+     */
+    void inc(uint64_t n = 1);
+
+    /**
+     * @brief Текущее значение, сложенное по всем потокам.
+     */
+    uint64_t value() const;
+
+private:
+    friend class MetricsRegistry;
+    std::size_t slot_;
+};
+
+/**
+ * @brief Датчик, значение которого складывается из приращений всех потоков (например, число сессий).
+ */
+class Gauge {
+public:
+    explicit Gauge(std::size_t slot) : slot_(slot) {}
+
+    /**
+     * @brief Изменяет значение датчика на delta.
+     */
+    void add(int64_t delta);
+
+    /**
+     * @brief Текущее значение, сложенное по всем потокам.
+     */
+    int64_t value() const;
+
+private:
+    friend class MetricsRegistry;
+    std::size_t slot_;
+};
+
+/**
+ * @brief Гистограмма с фиксированными границами корзин.
+ */
+class Histogram {
+public:
+    Histogram(std::size_t slot, std::vector<double> bounds) : slot_(slot), bounds_(std::move(bounds)) {}
+
+    /**
+     * @brief Добавляет наблюдение.
+     * @param value Наблюдаемое значение (для длительностей - в секундах).
+     */
+    void observe(double value);
+
+    /**
+     * @brief Границы корзин по возрастанию.
+     */
+    const std::vector<double>& bounds() const { return bounds_; }
+
+    /**
+     * @brief Общее число наблюдений по всем потокам.
+     */
+    uint64_t count() const;
+
+private:
+    friend class MetricsRegistry;
+    std::size_t slot_;
+    std::vector<double> bounds_;
+};
+
+/**
+ * @brief Замеряет время жизни объекта и записывает его в гистограмму в секундах.
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram), started_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        histogram_.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point started_;
+};
+
+/**
+ * @brief Стандартные границы корзин для длительностей: от 100 мкс до 5 с.
+ */
+std::vector<double> latency_buckets();
+
+/**
+ * @brief Реестр метрик процесса: описания метрик и шарды всех потоков.
+ */
+class MetricsRegistry {
+public:
+    /**
+     * @brief Глобальный реестр.
+     */
+    static MetricsRegistry& instance();
+
+    /**
+     * @brief Регистрирует счётчик или возвращает уже зарегистрированный с тем же именем.
+     * @param name Имя метрики в формате Prometheus.
+     * @param help Описание метрики.
+     * @throws std::length_error если закончились слоты.
+     */
+    Counter& counter(const std::string& name, const std::string& help);
+
+    /**
+     * @brief Регистрирует датчик или возвращает уже зарегистрированный с тем же именем.
+     */
+    Gauge& gauge(const std::string& name, const std::string& help);
+
+    /**
+     * @brief Регистрирует датчик, значение которого вычисляется при чтении.
+     * @param read Функция, возвращающая текущее значение.
+     */
+    void gauge_callback(const std::string& name, const std::string& help, std::function<double()> read);
+
+    /**
+     * @brief Регистрирует гистограмму или возвращает уже зарегистрированную с тем же именем.
+     * @param bounds Верхние границы корзин по возрастанию.
+     */
+    Histogram& histogram(const std::string& name, const std::string& help, std::vector<double> bounds);
+
+    /**
+     * @brief Собирает значения всех шардов в текстовый формат Prometheus.
+     */
+    std::string render() const;
+
+    /**
+     * @brief Шард текущего потока.
+     */
+    MetricsShard& local_shard();
+
+    /**
+     * @brief Сумма слота счётчика по всем шардам.
+     */
+    uint64_t sum_counter(std::size_t slot) const;
+
+    /**
+     * @brief Сумма корзины гистограммы по всем шардам.
+     */
+    uint64_t sum_bucket(std::size_t slot, std::size_t bucket) const;
+
+    void attach(MetricsShard* shard);
+    void detach(MetricsShard* shard);
+
+private:
+    enum class Kind { counter, gauge, callback, histogram };
+
+    struct Definition {
+        std::string name;
+        std::string help;
+        Kind kind;
+        std::size_t index; ///< Позиция в соответствующем контейнере.
+        std::function<double()> read;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Definition> definitions_;
+    std::deque<Counter> counters_;
+    std::deque<Gauge> gauges_;
+    std::deque<Histogram> histograms_;
+    std::size_t next_counter_slot_ = 0;
+
+    std::vector<MetricsShard*> shards_; ///< Шарды живых потоков.
+    MetricsShard retired_;              ///< Значения завершившихся потоков.
+
+    MetricsRegistry() = default;
+    const Definition* find(const std::string& name) const;
+    double sum_histogram(std::size_t slot) const;
+};
+
+#endif // METRICS_H
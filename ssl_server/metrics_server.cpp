@@ -0,0 +1,87 @@
+/**
+ * @file metrics_server.cpp
+ * @brief Реализация HTTP-эндпоинта метрик.
+ */
+
+#include "metrics_server.h"
+#include "logger.h"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+MetricsServer::MetricsServer(MetricsRegistry& registry, const std::string& address, unsigned short port)
+    : registry_(registry), acceptor_(ioc_, {asio::ip::make_address(address), port}) {
+    accept();
+    thread_ = std::thread([this] { ioc_.run(); });
+}
+
+MetricsServer::~MetricsServer() {
+    ioc_.stop();
+    thread_.join();
+}
+
+unsigned short MetricsServer::port() const {
+    return acceptor_.local_endpoint().port();
+}
+
+void MetricsServer::handle(const std::string& path, Handler handler) {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    handlers_[path] = std::move(handler);
+}
+
+void MetricsServer::accept() {
+    acceptor_.async_accept([this](beast::error_code ec, tcp::socket socket) {
+        if (!ec) {
+            serve(socket);
+        }
+        if (ec != asio::error::operation_aborted) {
+            accept();
+        }
+    });
+}
+
+void MetricsServer::serve(tcp::socket& socket) {
+    // Запросы редкие и короткие, поэтому обслуживаются синхронно на потоке эндпоинта.
+    try {
+        beast::flat_buffer buffer;
+        http::request<http::empty_body> request;
+        http::read(socket, buffer, request);
+
+        http::response<http::string_body> response;
+        response.version(request.version());
+        response.keep_alive(false);
+        std::string_view target(request.target().data(), request.target().size());
+        std::size_t question = target.find('?');
+        std::string_view path = target.substr(0, question);
+        std::string_view query = question == std::string_view::npos ? std::string_view() : target.substr(question + 1);
+
+        Handler handler;
+        {
+            std::lock_guard<std::mutex> lock(handlers_mutex_);
+            if (auto it = handlers_.find(path); it != handlers_.end()) {
+                handler = it->second;
+            }
+        }
+
+        if (request.method() == http::verb::get && path == "/metrics") {
+            response.result(http::status::ok);
+            response.set(http::field::content_type, "text/plain; version=0.0.4");
+            response.body() = registry_.render();
+        } else if (handler) {
+            response.result(http::status::ok);
+            response.set(http::field::content_type, "text/plain");
+            response.body() = handler(query);
+        } else {
+            response.result(http::status::not_found);
+            response.set(http::field::content_type, "text/plain");
+            response.body() = "Not found";
+        }
+        response.prepare_payload();
+        http::write(socket, response);
+        socket.shutdown(tcp::socket::shutdown_send);
+    } catch (const std::exception& e) {
+        Logger::instance().log(LogLevel::warn, "metrics_request_failed", {{"error", e.what()}});
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ * @file metrics_server.h
+ * @brief Локальный HTTP-эндпоинт /metrics в текстовом формате Prometheus.
+ */
+
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <utility> // Boost 1.74 использует std::exchange в awaitable.hpp, не подключая <utility>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "metrics.h"
+
+/**
+ * @brief Обслуживает GET /metrics и служебные обработчики на отдельном потоке и отдельном io_context.
+ *
+ * Эндпоинт работает без TLS и по умолчанию слушает только loopback-интерфейс.
+ */
+class MetricsServer {
+public:
+    /**
+     * @brief Служебный обработчик: получает строку запроса после '?' и возвращает текст ответа.
+     */
+    using Handler = std::function<std::string(std::string_view query)>;
+
+    /**
+     * @brief Открывает порт и запускает поток обслуживания.
+     * @param registry Реестр метрик.
+     * @param address Адрес для прослушивания.
+     * @param port Порт для прослушивания.
+     */
+    MetricsServer(MetricsRegistry& registry, const std::string& address, unsigned short port);
+
+    /**
+     * @brief Останавливает обслуживание.
+     */
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    /**
+     * @brief Порт, на котором фактически принимаются соединения.
+     */
+    unsigned short port() const;
+
+    /**
+     * @brief Регистрирует служебный обработчик пути.
+     * @param path Путь без строки запроса, например "/log".
+     * @param handler Обработчик.
+     */
+    void handle(const std::string& path, Handler handler);
+
+private:
+    MetricsRegistry& registry_;
+    std::mutex handlers_mutex_;
+    std::map<std::string, Handler, std::less<>> handlers_;
+    boost::asio::io_context ioc_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::thread thread_;
+
+    void accept();
+    void serve(boost::asio::ip::tcp::socket& socket);
+};
+
+#endif // METRICS_SERVER_H
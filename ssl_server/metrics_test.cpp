@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "metrics.h"
+#include <thread>
+#include <vector>
+
+TEST(MetricsTest, CounterMergesThreadShards) {
+    Counter& counter = MetricsRegistry::instance().counter("test_merge_total", "Test counter");
+    uint64_t before = counter.value();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&counter] {
+            for (int i = 0; i < 1000; ++i) {
+                counter.inc();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Потоки завершились, их шарды слиты в общий, значения не потеряны.
+    EXPECT_EQ(counter.value() - before, 4000u);
+}
+
+TEST(MetricsTest, GaugeSupportsDecrementsFromOtherThreads) {
+    Gauge& gauge = MetricsRegistry::instance().gauge("test_sessions", "Test gauge");
+    std::thread([&gauge] { gauge.add(3); }).join();
+    gauge.add(-2);
+
+    EXPECT_EQ(gauge.value(), 1);
+}
+
+TEST(MetricsTest, RegistrationIsIdempotent) {
+    Counter& a = MetricsRegistry::instance().counter("test_same_total", "Test counter");
+    Counter& b = MetricsRegistry::instance().counter("test_same_total", "Test counter");
+    EXPECT_EQ(&a, &b);
+}
+
+TEST(MetricsTest, RendersPrometheusHistogram) {
+    Histogram& histogram = MetricsRegistry::instance().histogram("test_latency_seconds", "Test histogram", {0.1, 1});
+    histogram.observe(0.05);
+    histogram.observe(0.5);
+    histogram.observe(5);
+    MetricsRegistry::instance().gauge_callback("test_queue_depth", "Test callback", [] { return 7.0; });
+
+    std::string text = MetricsRegistry::instance().render();
+    EXPECT_NE(text.find("# TYPE test_latency_seconds histogram"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"0.1\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"1\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"+Inf\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_count 3\n"), std::string::npos);
+    EXPECT_NE(text.find("test_queue_depth 7\n"), std::string::npos);
+    EXPECT_EQ(histogram.count(), 3u);
+}
@@ -0,0 +1,166 @@
+/**
+ * @file password_hasher.cpp
+ * @brief Реализация хеширования паролей scrypt и пула потоков хеширования.
+ */
+
+#include "password_hasher.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+namespace {
+
+constexpr std::size_t kSaltSize = 16;
+constexpr std::size_t kKeySize = 32;
+constexpr uint64_t kMaxMemory = 256ull * 1024 * 1024;
+
+std::string to_hex(const unsigned char* data, std::size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(size * 2);
+    for (std::size_t i = 0; i < size; ++i) {
+        hex += digits[data[i] >> 4];
+        hex += digits[data[i] & 0x0f];
+    }
+    return hex;
+}
+
+bool from_hex(const std::string& hex, std::vector<unsigned char>& out) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    auto value = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    out.clear();
+    for (std::size_t i = 0; i < hex.size(); i += 2) {
+        int hi = value(hex[i]), lo = value(hex[i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        out.push_back(static_cast<unsigned char>(hi << 4 | lo));
+    }
+    return true;
+}
+
+bool derive(const std::string& password, const unsigned char* salt, std::size_t salt_size,
+            const ScryptParams& params, unsigned char* key, std::size_t key_size) {
+    return EVP_PBE_scrypt(password.data(), password.size(), salt, salt_size,
+                          uint64_t(1) << params.log2_n, params.r, params.p, kMaxMemory,
+                          key, key_size) == 1;
+}
+
+} // namespace
+
+std::string hash_password(const std::string& password, const ScryptParams& params) {
+    unsigned char salt[kSaltSize];
+    unsigned char key[kKeySize];
+    if (RAND_bytes(salt, sizeof(salt)) != 1 || !derive(password, salt, sizeof(salt), params, key, sizeof(key))) {
+        throw std::runtime_error("Can't hash password");
+    }
+    std::ostringstream out;
+    out << "scrypt$" << params.log2_n << '$' << params.r << '$' << params.p << '$'
+        << to_hex(salt, sizeof(salt)) << '$' << to_hex(key, sizeof(key));
+    return out.str();
+}
+
+bool is_password_hash(const std::string& stored) {
+    return stored.rfind("scrypt$", 0) == 0;
+}
+
+bool verify_password(const std::string& password, const std::string& stored) {
+    if (!is_password_hash(stored)) {
+        // Старый формат: в базе лежит MD5-дайджест, присланный клиентом.
+        return password.size() == stored.size() &&
+               CRYPTO_memcmp(password.data(), stored.data(), stored.size()) == 0;
+    }
+
+    std::vector<std::string> parts;
+    std::istringstream in(stored);
+    for (std::string part; std::getline(in, part, '$');) {
+        parts.push_back(part);
+    }
+    ScryptParams params;
+    std::vector<unsigned char> salt, expected;
+    try {
+        if (parts.size() != 6) {
+            return false;
+        }
+        params.log2_n = std::stoul(parts[1]);
+        params.r = std::stoul(parts[2]);
+        params.p = std::stoul(parts[3]);
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (params.log2_n == 0 || params.log2_n > 24 || !from_hex(parts[4], salt) ||
+        !from_hex(parts[5], expected) || expected.empty()) {
+        return false;
+    }
+
+    std::vector<unsigned char> key(expected.size());
+    if (!derive(password, salt.data(), salt.size(), params, key.data(), key.size())) {
+        return false;
+    }
+    return CRYPTO_memcmp(key.data(), expected.data(), key.size()) == 0;
+}
+
+HashWorkerPool::HashWorkerPool(std::size_t threads, std::size_t max_queue) : max_queue_(max_queue) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i) {
+        workers_.emplace_back(&HashWorkerPool::run, this);
+    }
+}
+
+HashWorkerPool::~HashWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::size_t HashWorkerPool::queue_depth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+uint64_t HashWorkerPool::rejected() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rejected_;
+}
+
+bool HashWorkerPool::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() >= max_queue_) {
+            ++rejected_;
+            return false;
+        }
+        queue_.push_back(std::move(job));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void HashWorkerPool::run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        task();
+    }
+}
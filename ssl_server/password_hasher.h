@@ -0,0 +1,143 @@
+/**
+ * @file password_hasher.h
+ * @brief Хеширование паролей функцией scrypt и пул потоков для ресурсоёмких вычислений.
+ */
+
+#ifndef PASSWORD_HASHER_H
+#define PASSWORD_HASHER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Параметры scrypt: N = 2^log2_n, r - размер блока, p - степень параллелизма.
+ */
+struct ScryptParams {
+    unsigned log2_n = 14;
+    unsigned r = 8;
+    unsigned p = 1;
+};
+
+/**
+ * @brief Хеширует пароль scrypt со случайной солью.
+ * @param password Пароль (на сервер приходит уже MD5-дайджест от клиента).
+ * @param params Параметры scrypt.
+ * @return Строка вида "scrypt$log2_n$r$p$соль$хеш" (соль и хеш в hex).
+ * @throws std::runtime_error при ошибке OpenSSL.
+ */
+std::string hash_password(const std::string& password, const ScryptParams& params = {});
+
+/**
+ * @brief Проверяет пароль по сохранённой строке, сравнивая хеши за постоянное время.
+ * @param password Проверяемый пароль.
+ * @param stored Строка из базы: хеш scrypt или пароль старого формата.
+ * @return Истина, если пароль подходит.
+ */
+bool verify_password(const std::string& password, const std::string& stored);
+
+/**
+ * @brief Определяет, записан ли пароль в формате scrypt.
+ * @param stored Строка из базы.
+ * @return Ложь для паролей старого формата, которые нужно перехешировать.
+ */
+bool is_password_hash(const std::string& stored);
+
+/**
+ * @brief Ограниченный пул потоков для хеширования паролей, отделённый от потоков ввода-вывода.
+ *
+ * Очередь задач имеет предельную глубину: если она заполнена, try_submit сразу отказывает,
+ * и вызывающий код должен сообщить клиенту о перегрузке вместо того, чтобы ждать.
+ */
+class HashWorkerPool {
+public:
+    /**
+     * @brief Запускает рабочие потоки.
+     * @param threads Число рабочих потоков.
+     * @param max_queue Максимальное число ожидающих задач.
+     */
+    HashWorkerPool(std::size_t threads, std::size_t max_queue);
+
+    /**
+     * @brief Дожидается выполнения поставленных задач и останавливает потоки.
+     */
+    ~HashWorkerPool();
+
+    HashWorkerPool(const HashWorkerPool&) = delete;
+    HashWorkerPool& operator=(const HashWorkerPool&) = delete;
+
+    /**
+     * @brief Ставит задачу в очередь, если в ней есть место.
+     * @param task Вызываемый объект без аргументов.
+     * @return future с результатом задачи или std::nullopt, если очередь заполнена.
+     */
+    template <typename F>
+    auto try_submit(F&& task) -> std::optional<std::future<std::invoke_result_t<F>>> {
+        using R = std::invoke_result_t<F>;
+        auto job = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        auto future = job->get_future();
+        if (!enqueue([job] { (*job)(); })) {
+            return std::nullopt;
+        }
+        return future;
+    }
+
+    /**
+     * @brief Ставит задачу в очередь, если в ней есть место, и не ждёт её выполнения.
+     *
+     * done вызывается в рабочем потоке; вызывающий код сам передаёт результат туда, где его ждут.
+     * @param task Копируемый вызываемый объект без аргументов, возвращающий значение.
+     * @param done Копируемый вызываемый объект (std::exception_ptr, результат); исключение задачи
+     * передаётся первым аргументом, результат тогда построен по умолчанию.
+     * @return Ложь, если очередь заполнена: тогда done не вызывается.
+     */
+    template <typename F, typename Done>
+    bool try_submit(F&& task, Done&& done) {
+        using R = std::invoke_result_t<F>;
+        return enqueue([task = std::forward<F>(task), done = std::forward<Done>(done)]() mutable {
+            R result{};
+            std::exception_ptr error;
+            try {
+                result = task();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            done(error, std::move(result));
+        });
+    }
+
+    /**
+     * @brief Текущее число задач, ожидающих в очереди.
+     */
+    std::size_t queue_depth() const;
+
+    /**
+     * @brief Число задач, отклонённых из-за заполненной очереди.
+     */
+    uint64_t rejected() const;
+
+private:
+    std::size_t max_queue_;
+    std::deque<std::function<void()>> queue_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    uint64_t rejected_ = 0;
+    std::vector<std::thread> workers_;
+
+    bool enqueue(std::function<void()> job);
+    void run();
+};
+
+#endif // PASSWORD_HASHER_H
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include "password_hasher.h"
+#include <chrono>
+#include <future>
+#include <stdexcept>
+
+namespace {
+// Уменьшенные параметры, чтобы тесты выполнялись быстро.
+const ScryptParams kFastParams{10, 8, 1};
+}
+
+TEST(PasswordHasherTest, HashAndVerify) {
+    std::string stored = hash_password("5f4dcc3b5aa765d61d8327deb882cf99", kFastParams);
+
+    EXPECT_TRUE(is_password_hash(stored));
+    EXPECT_TRUE(verify_password("5f4dcc3b5aa765d61d8327deb882cf99", stored));
+    EXPECT_FALSE(verify_password("5f4dcc3b5aa765d61d8327deb882cf98", stored));
+}
+
+TEST(PasswordHasherTest, UsesRandomSalt) {
+    EXPECT_NE(hash_password("secret", kFastParams), hash_password("secret", kFastParams));
+}
+
+TEST(PasswordHasherTest, AcceptsLegacyPlainDigest) {
+    EXPECT_FALSE(is_password_hash("5f4dcc3b5aa765d61d8327deb882cf99"));
+    EXPECT_TRUE(verify_password("5f4dcc3b5aa765d61d8327deb882cf99", "5f4dcc3b5aa765d61d8327deb882cf99"));
+    EXPECT_FALSE(verify_password("5f4dcc3b5aa765d61d8327deb882cf99", "other"));
+}
+
+TEST(PasswordHasherTest, RejectsMalformedHash) {
+    EXPECT_FALSE(verify_password("secret", "scrypt$x$8$1$00$00"));
+    EXPECT_FALSE(verify_password("secret", "scrypt$10$8$1$zz$00"));
+    EXPECT_FALSE(verify_password("secret", "scrypt$10$8"));
+}
+
+TEST(HashWorkerPoolTest, RunsTasks) {
+    HashWorkerPool pool(2, 8);
+    auto future = pool.try_submit([] { return 42; });
+    ASSERT_TRUE(future.has_value());
+    EXPECT_EQ(future->get(), 42);
+}
+
+TEST(HashWorkerPoolTest, RejectsWhenQueueIsFull) {
+    HashWorkerPool pool(1, 1);
+    std::promise<void> release;
+    std::shared_future<void> gate = release.get_future().share();
+
+    auto running = pool.try_submit([gate] { gate.wait(); });
+    ASSERT_TRUE(running.has_value());
+    while (pool.queue_depth() != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto queued = pool.try_submit([gate] { gate.wait(); });
+    ASSERT_TRUE(queued.has_value());
+
+    EXPECT_FALSE(pool.try_submit([] {}).has_value());
+    EXPECT_EQ(pool.rejected(), 1u);
+
+    release.set_value();
+    running->get();
+    queued->get();
+}
+
+TEST(HashWorkerPoolTest, ReportsResultToCallback) {
+    HashWorkerPool pool(1, 4);
+    std::promise<int> value;
+    std::promise<std::exception_ptr> failure;
+    ASSERT_TRUE(pool.try_submit([] { return 42; }, [&value](std::exception_ptr, int result) { value.set_value(result); }));
+    ASSERT_TRUE(pool.try_submit([]() -> int { throw std::runtime_error("scrypt"); },
+                                [&failure](std::exception_ptr error, int) { failure.set_value(error); }));
+    EXPECT_EQ(value.get_future().get(), 42);
+    EXPECT_NE(failure.get_future().get(), nullptr);
+}
+
+TEST(HashWorkerPoolTest, CallbackSubmitRejectsWhenQueueIsFull) {
+    HashWorkerPool pool(1, 0);
+    bool called = false;
+    EXPECT_FALSE(pool.try_submit([] { return 1; }, [&called](std::exception_ptr, int) { called = true; }));
+    EXPECT_FALSE(called);
+    EXPECT_EQ(pool.rejected(), 1u);
+}
@@ -0,0 +1,122 @@
+/**
+ * @file presence.cpp
+ * @brief Реализация трекера присутствия.
+ */
+
+#include "presence.h"
+
+std::string PresenceDelta::encode() const {
+    std::string out;
+    for (const auto& user : joined) {
+        out.append("+").append(user).append("\n");
+    }
+    for (const auto& user : left) {
+        out.append("-").append(user).append("\n");
+    }
+    for (const auto& user : typing) {
+        out.append("~").append(user).append("\n");
+    }
+    return out;
+}
+
+PresenceTracker::PresenceTracker(Publish publish, std::chrono::milliseconds interval)
+    : publish_(std::move(publish)), interval_(interval) {
+    publisher_ = std::thread([this] { publish_loop(); });
+}
+
+PresenceTracker::~PresenceTracker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    publisher_.join();
+}
+
+// Вызывается под mutex_. Запоминается только состояние до первого изменения в интервале.
+void PresenceTracker::note_change(const std::string& user, bool was_online) {
+    changed_.emplace(user, was_online);
+}
+
+void PresenceTracker::join(const std::string& user) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t& count = connections_[user];
+    if (count++ == 0) {
+        note_change(user, false);
+    }
+}
+
+void PresenceTracker::leave(const std::string& user) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = connections_.find(user);
+    if (it == connections_.end()) {
+        return;
+    }
+    if (--it->second == 0) {
+        connections_.erase(it);
+        note_change(user, true);
+        typing_.erase(user);
+    }
+}
+
+void PresenceTracker::typing(const std::string& user) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connections_.count(user)) {
+        typing_.insert(user);
+    }
+}
+
+std::string PresenceTracker::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    for (const auto& [user, count] : connections_) {
+        out.append(user).append("\n");
+    }
+    return out;
+}
+
+std::size_t PresenceTracker::online() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return connections_.size();
+}
+
+PresenceDelta PresenceTracker::take_delta() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return take_delta_locked();
+}
+
+PresenceDelta PresenceTracker::take_delta_locked() {
+    PresenceDelta delta;
+    for (const auto& [user, was_online] : changed_) {
+        bool online = connections_.count(user) != 0;
+        if (online && !was_online) {
+            delta.joined.push_back(user);
+        } else if (!online && was_online) {
+            delta.left.push_back(user);
+        }
+    }
+    delta.typing.assign(typing_.begin(), typing_.end());
+    changed_.clear();
+    typing_.clear();
+    return delta;
+}
+
+void PresenceTracker::flush() {
+    PresenceDelta delta = take_delta();
+    if (!delta.empty()) {
+        publish_(delta.encode());
+    }
+}
+
+void PresenceTracker::publish_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, interval_, [this] { return stopping_; })) {
+        PresenceDelta delta = take_delta_locked();
+        if (delta.empty()) {
+            continue;
+        }
+        lock.unlock();
+        publish_(delta.encode());
+        lock.lock();
+    }
+}
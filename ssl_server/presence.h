@@ -0,0 +1,114 @@
+/**
+ * @file presence.h
+ * @brief Список пользователей в сети и рассылка его изменений пакетами.
+ */
+
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Изменения присутствия за один интервал.
+ */
+struct PresenceDelta {
+    std::vector<std::string> joined;
+    std::vector<std::string> left;
+    std::vector<std::string> typing;
+
+    bool empty() const { return joined.empty() && left.empty() && typing.empty(); }
+
+    /**
+     * @brief Кодирует изменения строками "+имя", "-имя" и "~имя" (печатает).
+     */
+    std::string encode() const;
+};
+
+/**
+ * @brief Отслеживает пользователей в сети и рассылает изменения не чаще раза в интервал.
+ *
+ * Изменения внутри интервала схлопываются: вход и выход одного пользователя до рассылки
+ * взаимно уничтожаются, повторные уведомления о наборе текста объединяются.
+ */
+class PresenceTracker {
+public:
+    /**
+     * @brief Рассылает закодированный пакет изменений.
+     */
+    using Publish = std::function<void(const std::string& delta)>;
+
+    /**
+     * @param publish Функция рассылки; вызывается из потока трекера без удержания его мьютекса.
+     * @param interval Минимальный интервал между рассылками.
+     */
+    explicit PresenceTracker(Publish publish, std::chrono::milliseconds interval = std::chrono::milliseconds(250));
+
+    /**
+     * @brief Останавливает поток рассылки.
+     */
+    ~PresenceTracker();
+
+    PresenceTracker(const PresenceTracker&) = delete;
+    PresenceTracker& operator=(const PresenceTracker&) = delete;
+
+    /**
+     * @brief Учитывает новое соединение пользователя; о входе сообщается только для первого соединения.
+     */
+    void join(const std::string& user);
+
+    /**
+     * @brief Учитывает закрытие соединения; о выходе сообщается после закрытия последнего.
+     */
+    void leave(const std::string& user);
+
+    /**
+     * @brief Отмечает, что пользователь набирает сообщение.
+     */
+    void typing(const std::string& user);
+
+    /**
+     * @brief Текущий список пользователей в сети, по одному имени в строке.
+     */
+    std::string snapshot() const;
+
+    /**
+     * @brief Число пользователей в сети.
+     */
+    std::size_t online() const;
+
+    /**
+     * @brief Забирает накопленные изменения.
+     */
+    PresenceDelta take_delta();
+
+    /**
+     * @brief Рассылает накопленные изменения немедленно.
+     */
+    void flush();
+
+private:
+    Publish publish_;
+    std::chrono::milliseconds interval_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::map<std::string, std::size_t> connections_; ///< Число соединений каждого пользователя в сети.
+    std::map<std::string, bool> changed_;            ///< Был ли пользователь в сети на начало интервала.
+    std::set<std::string> typing_;
+    bool stopping_ = false;
+    std::thread publisher_;
+
+    void note_change(const std::string& user, bool was_online);
+    PresenceDelta take_delta_locked();
+    void publish_loop();
+};
+
+#endif // PRESENCE_H
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "presence.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+PresenceTracker::Publish ignore() {
+    return [](const std::string&) {};
+}
+
+} // namespace
+
+TEST(PresenceTest, ReportsFirstJoinAndLastLeave) {
+    PresenceTracker presence(ignore(), 1h);
+    presence.join("alice");
+    presence.join("alice");
+    presence.join("bob");
+
+    PresenceDelta delta = presence.take_delta();
+    EXPECT_EQ(delta.joined, (std::vector<std::string>{"alice", "bob"}));
+    EXPECT_EQ(presence.snapshot(), "alice\nbob\n");
+
+    presence.leave("alice");
+    EXPECT_TRUE(presence.take_delta().empty());
+    presence.leave("alice");
+    EXPECT_EQ(presence.take_delta().left, (std::vector<std::string>{"alice"}));
+    EXPECT_EQ(presence.online(), 1u);
+}
+
+TEST(PresenceTest, CoalescesChangesWithinInterval) {
+    PresenceTracker presence(ignore(), 1h);
+    presence.join("bob");
+    presence.take_delta();
+
+    // Вход и выход до рассылки, переподключение и повторный набор текста схлопываются.
+    presence.join("alice");
+    presence.leave("alice");
+    presence.leave("bob");
+    presence.join("bob");
+    presence.typing("bob");
+    presence.typing("bob");
+    presence.typing("carol");
+
+    PresenceDelta delta = presence.take_delta();
+    EXPECT_TRUE(delta.joined.empty());
+    EXPECT_TRUE(delta.left.empty());
+    EXPECT_EQ(delta.typing, (std::vector<std::string>{"bob"}));
+    EXPECT_EQ(delta.encode(), "~bob\n");
+}
+
+TEST(PresenceTest, PublishesBatchesInBackground) {
+    std::atomic<int> batches{0};
+    std::string last;
+    std::mutex mutex;
+    PresenceTracker presence([&](const std::string& delta) {
+        std::lock_guard<std::mutex> lock(mutex);
+        last = delta;
+        ++batches;
+    }, 20ms);
+
+    for (int i = 0; i < 100; ++i) {
+        presence.join("user" + std::to_string(i % 10));
+    }
+    for (int i = 0; i < 50 && batches == 0; ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    std::this_thread::sleep_for(60ms);
+
+    EXPECT_EQ(batches.load(), 1);
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(std::count(last.begin(), last.end(), '+'), 10);
+}
@@ -0,0 +1,73 @@
+/**
+ * @file rate_limiter.cpp
+ * @brief Реализация вёдер токенов и контроля допуска.
+ */
+
+#include "rate_limiter.h"
+#include <algorithm>
+
+TokenBucket::TokenBucket(RateLimit limit, clock::time_point now)
+    : limit_(limit), tokens_(limit.burst), updated_(now) {}
+
+void TokenBucket::refill(clock::time_point now) {
+    if (now <= updated_) {
+        return;
+    }
+    double elapsed = std::chrono::duration<double>(now - updated_).count();
+    tokens_ = std::min(limit_.burst, tokens_ + elapsed * limit_.per_second);
+    updated_ = now;
+}
+
+bool TokenBucket::try_take(clock::time_point now) {
+    refill(now);
+    if (tokens_ < 1) {
+        return false;
+    }
+    tokens_ -= 1;
+    return true;
+}
+
+TokenBucket::clock::duration TokenBucket::wait_time(clock::time_point now) {
+    refill(now);
+    if (tokens_ >= 1) {
+        return clock::duration::zero();
+    }
+    return std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>((1 - tokens_) / limit_.per_second));
+}
+
+bool TokenBucket::full(clock::time_point now) {
+    refill(now);
+    return tokens_ >= limit_.burst;
+}
+
+UserRateLimiter::UserRateLimiter(RateLimit limit, std::size_t sweep_every)
+    : limit_(limit), sweep_every_(std::max<std::size_t>(1, sweep_every)) {}
+
+bool UserRateLimiter::try_acquire(const std::string& user) {
+    auto now = TokenBucket::clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (++calls_ % sweep_every_ == 0) {
+        for (auto it = buckets_.begin(); it != buckets_.end();) {
+            it = it->second.full(now) ? buckets_.erase(it) : std::next(it);
+        }
+    }
+
+    auto it = buckets_.try_emplace(user, limit_, now).first;
+    return it->second.try_take(now);
+}
+
+std::size_t UserRateLimiter::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buckets_.size();
+}
+
+AdmissionController::AdmissionController(Probe send_backlog, std::size_t max_send_backlog,
+                                         Probe db_backlog, std::size_t max_db_backlog)
+    : send_backlog_(std::move(send_backlog)), max_send_backlog_(max_send_backlog),
+      db_backlog_(std::move(db_backlog)), max_db_backlog_(max_db_backlog) {}
+
+bool AdmissionController::admit() const {
+    return send_backlog_() <= max_send_backlog_ && db_backlog_() <= max_db_backlog_;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file rate_limiter.h
+ * @brief Ограничение частоты сообщений и сброс нагрузки при перегрузке сервера.
+ */
+
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Параметры ведра токенов: скорость пополнения и максимальный запас (всплеск).
+ */
+struct RateLimit {
+    double per_second = 5;
+    double burst = 10;
+};
+
+/**
+ * @brief Ведро токенов. Не потокобезопасно.
+ */
+class TokenBucket {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Создаёт полное ведро.
+     * @param limit Скорость пополнения и ёмкость.
+     * @param now Текущее время.
+     */
+    explicit TokenBucket(RateLimit limit, clock::time_point now = clock::now());
+
+    /**
+     * @brief Забирает токен, если он есть.
+     * @param now Текущее время.
+     * @return Истина, если токен получен.
+     */
+    bool try_take(clock::time_point now = clock::now());
+
+    /**
+     * @brief Время, через которое появится токен; ноль, если он уже есть.
+     */
+    clock::duration wait_time(clock::time_point now = clock::now());
+
+    /**
+     * @brief Проверяет, что ведро пополнено до конца (такое ведро можно забыть без потери состояния).
+     */
+    bool full(clock::time_point now = clock::now());
+
+private:
+    RateLimit limit_;
+    double tokens_;
+    clock::time_point updated_;
+
+    void refill(clock::time_point now);
+};
+
+/**
+ * @brief Вёдра токенов по именам пользователей, общие для всех соединений пользователя.
+ *
+ * Полностью пополненные вёдра периодически удаляются, чтобы таблица не росла с числом когда-либо писавших пользователей.
+ */
+class UserRateLimiter {
+public:
+    /**
+     * @param limit Ограничение на одного пользователя.
+     * @param sweep_every Через сколько обращений удалять неактивные вёдра.
+     */
+    explicit UserRateLimiter(RateLimit limit, std::size_t sweep_every = 1024);
+
+    /**
+     * @brief Забирает токен из ведра пользователя.
+     * @param user Имя пользователя.
+     * @return Истина, если сообщение можно принять.
+     */
+    bool try_acquire(const std::string& user);
+
+    /**
+     * @brief Число вёдер в таблице.
+     */
+    std::size_t size() const;
+
+private:
+    RateLimit limit_;
+    std::size_t sweep_every_;
+    std::size_t calls_ = 0;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, TokenBucket> buckets_;
+};
+
+/**
+ * @brief Глобальный контроль допуска: отказывает в приёме сообщений, когда очереди отправки или базы данных переполнены.
+ */
+class AdmissionController {
+public:
+    using Probe = std::function<std::size_t()>;
+
+    /**
+     * @param send_backlog Текущий объём очередей отправки (например, байт во всех SendQueue).
+     * @param max_send_backlog Порог объёма очередей отправки.
+     * @param db_backlog Текущее число запросов к базе, ожидающих или выполняющихся.
+     * @param max_db_backlog Порог очереди базы данных.
+     */
+    AdmissionController(Probe send_backlog, std::size_t max_send_backlog,
+                        Probe db_backlog, std::size_t max_db_backlog);
+
+    /**
+     * @brief Решает, принять ли очередное сообщение.
+     */
+    bool admit() const;
+
+private:
+    Probe send_backlog_;
+    std::size_t max_send_backlog_;
+    Probe db_backlog_;
+    std::size_t max_db_backlog_;
+};
+
+#endif // RATE_LIMITER_H
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "rate_limiter.h"
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST(RateLimiterTest, BucketAllowsBurstThenRefills) {
+    auto start = TokenBucket::clock::now();
+    TokenBucket bucket({2, 3}, start);
+
+    EXPECT_TRUE(bucket.try_take(start));
+    EXPECT_TRUE(bucket.try_take(start));
+    EXPECT_TRUE(bucket.try_take(start));
+    EXPECT_FALSE(bucket.try_take(start));
+
+    // При скорости 2 токена в секунду следующий появится через 500 мс.
+    EXPECT_EQ(std::chrono::duration_cast<std::chrono::milliseconds>(bucket.wait_time(start)), 500ms);
+    EXPECT_FALSE(bucket.try_take(start + 400ms));
+    EXPECT_TRUE(bucket.try_take(start + 500ms));
+    EXPECT_FALSE(bucket.full(start + 500ms));
+    EXPECT_TRUE(bucket.full(start + 10s));
+}
+
+TEST(RateLimiterTest, UserLimitIsSharedAndIndependentPerUser) {
+    UserRateLimiter limiter({0.001, 2});
+
+    EXPECT_TRUE(limiter.try_acquire("alice"));
+    EXPECT_TRUE(limiter.try_acquire("alice"));
+    EXPECT_FALSE(limiter.try_acquire("alice"));
+    EXPECT_TRUE(limiter.try_acquire("bob"));
+    EXPECT_EQ(limiter.size(), 2u);
+}
+
+TEST(RateLimiterTest, SweepForgetsRefilledBuckets) {
+    UserRateLimiter limiter({1000000, 1}, 4);
+    limiter.try_acquire("alice");
+    limiter.try_acquire("bob");
+    limiter.try_acquire("carol");
+    std::this_thread::sleep_for(1ms);
+    limiter.try_acquire("dave");
+
+    // На четвёртом обращении вёдра первых трёх уже пополнены и удалены.
+    EXPECT_EQ(limiter.size(), 1u);
+}
+
+TEST(RateLimiterTest, AdmissionShedsAboveEitherThreshold) {
+    std::size_t sends = 0;
+    std::size_t queries = 0;
+    AdmissionController admission([&] { return sends; }, 10, [&] { return queries; }, 5);
+
+    EXPECT_TRUE(admission.admit());
+    sends = 11;
+    EXPECT_FALSE(admission.admit());
+    sends = 10;
+    queries = 6;
+    EXPECT_FALSE(admission.admit());
+    queries = 5;
+    EXPECT_TRUE(admission.admit());
+}
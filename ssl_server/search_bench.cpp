@@ -0,0 +1,111 @@
+/**
+ * @file search_bench.cpp
+ * @brief Нагрузочный тест полнотекстового индекса: скорость построения и поиска.
+ *
+ * Запуск: search_bench [число сообщений] [число запросов]. Сообщения генерируются из словаря
+ * с распределением Ципфа, как в живой переписке: немного частых слов и длинный хвост редких.
+ */
+
+#include "search_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+std::vector<std::string> make_vocabulary(std::size_t size) {
+    std::vector<std::string> words;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::uniform_int_distribution<int> length(3, 10);
+    for (std::size_t i = 0; i < size; ++i) {
+        std::string word;
+        for (int n = length(rng); n > 0; --n) {
+            word.push_back(static_cast<char>(letter(rng)));
+        }
+        words.push_back(word + std::to_string(i)); // Суффикс делает слова различными
+    }
+    return words;
+}
+
+void report_queries(const char* name, const SearchIndex& index, const std::vector<std::string>& queries) {
+    std::vector<double> latencies;
+    std::size_t hits = 0;
+    auto start = clock_type::now();
+    for (const auto& query : queries) {
+        auto begin = clock_type::now();
+        hits += index.search(query).total;
+        latencies.push_back(seconds_since(begin) * 1000);
+    }
+    double total = seconds_since(start);
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(p * latencies.size()))]; };
+    std::cout << name << ": " << static_cast<std::size_t>(queries.size() / total) << " queries/s"
+              << ", p50 " << percentile(0.5) << " ms, p99 " << percentile(0.99) << " ms"
+              << ", max " << latencies.back() << " ms"
+              << ", avg hits " << hits / queries.size() << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::size_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::size_t query_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000;
+
+    const std::vector<std::string> vocabulary = make_vocabulary(50000);
+    std::vector<double> weights;
+    for (std::size_t rank = 1; rank <= vocabulary.size(); ++rank) {
+        weights.push_back(1.0 / rank);
+    }
+    std::mt19937 rng(42);
+    std::discrete_distribution<std::size_t> zipf(weights.begin(), weights.end());
+    std::uniform_int_distribution<int> length(3, 15);
+
+    std::vector<std::string> corpus;
+    corpus.reserve(messages);
+    std::size_t bytes = 0;
+    for (std::size_t i = 0; i < messages; ++i) {
+        std::string text;
+        for (int n = length(rng); n > 0; --n) {
+            text.append(vocabulary[zipf(rng)]).push_back(' ');
+        }
+        bytes += text.size();
+        corpus.push_back(std::move(text));
+    }
+
+    SearchIndex index;
+    auto start = clock_type::now();
+    for (std::size_t i = 0; i < corpus.size(); ++i) {
+        index.add(i, corpus[i]);
+    }
+    double build = seconds_since(start);
+    std::cout << "build: " << messages << " messages (" << bytes / (1024 * 1024) << " MiB) in " << build << " s, "
+              << static_cast<std::size_t>(messages / build) << " messages/s, " << index.terms() << " terms\n";
+
+    auto pick = [&](std::size_t from, std::size_t to) {
+        return vocabulary[std::uniform_int_distribution<std::size_t>(from, to)(rng)];
+    };
+    std::vector<std::string> rare, mid, pairs, common;
+    for (std::size_t i = 0; i < query_count; ++i) {
+        rare.push_back(pick(5000, vocabulary.size() - 1));
+        mid.push_back(pick(100, 1000));
+        pairs.push_back(pick(10, 200) + " " + pick(10, 200));
+        common.push_back(pick(0, 9));
+    }
+    report_queries("rare word", index, rare);
+    report_queries("mid word", index, mid);
+    report_queries("two words", index, pairs);
+    report_queries("common word", index, common);
+    return EXIT_SUCCESS;
+}
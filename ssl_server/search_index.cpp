@@ -0,0 +1,227 @@
+/**
+ * @file search_index.cpp
+ * @brief Реализация полнотекстового индекса.
+ */
+
+#include "search_index.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace {
+
+constexpr double kK1 = 1.2;
+constexpr double kB = 0.75;
+constexpr std::size_t kMaxTokenBytes = 64;
+
+// Длина разделителя слов в позиции pos или 0, если там символ слова. Разделители - ASCII кроме
+// букв и цифр, U+0080-U+00BF (неразрывный пробел, кавычки-ёлочки) и U+2000-U+206F (тире, многоточие).
+std::size_t separator_length(std::string_view text, std::size_t pos) {
+    auto c = static_cast<unsigned char>(text[pos]);
+    if (c < 0x80) {
+        bool word = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        return word ? 0 : 1;
+    }
+    auto next = pos + 1 < text.size() ? static_cast<unsigned char>(text[pos + 1]) : 0;
+    if (c == 0xC2) {
+        return 2;
+    }
+    if (c == 0xE2 && (next == 0x80 || next == 0x81)) {
+        return 3;
+    }
+    return 0;
+}
+
+// Приводит к нижнему регистру кириллическую букву из двух байт UTF-8 (lead, next).
+void append_cyrillic_lower(std::string& out, unsigned char lead, unsigned char next) {
+    if (lead == 0xD0 && next == 0x81) {          // Ё -> е
+        lead = 0xD0, next = 0xB5;
+    } else if (lead == 0xD1 && next == 0x91) {   // ё -> е
+        lead = 0xD0, next = 0xB5;
+    } else if (lead == 0xD0 && next >= 0x90 && next <= 0x9F) { // А-П -> а-п
+        next += 0x20;
+    } else if (lead == 0xD0 && next >= 0xA0 && next <= 0xAF) { // Р-Я -> р-я
+        lead = 0xD1, next -= 0x20;
+    }
+    out.push_back(static_cast<char>(lead));
+    out.push_back(static_cast<char>(next));
+}
+
+} // namespace
+
+std::vector<std::string> tokenize(std::string_view text) {
+    std::vector<std::string> tokens;
+    std::string token;
+    auto finish = [&] {
+        if (!token.empty()) {
+            if (token.size() <= kMaxTokenBytes) {
+                tokens.push_back(std::move(token));
+            }
+            token.clear();
+        }
+    };
+
+    for (std::size_t pos = 0; pos < text.size();) {
+        if (std::size_t skip = separator_length(text, pos)) {
+            finish();
+            pos += skip;
+            continue;
+        }
+        auto c = static_cast<unsigned char>(text[pos]);
+        if (c < 0x80) {
+            token.push_back(static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c));
+            ++pos;
+        } else if ((c == 0xD0 || c == 0xD1) && pos + 1 < text.size()) {
+            append_cyrillic_lower(token, c, static_cast<unsigned char>(text[pos + 1]));
+            pos += 2;
+        } else {
+            token.push_back(static_cast<char>(c));
+            ++pos;
+        }
+    }
+    finish();
+    return tokens;
+}
+
+void SearchIndex::add(uint64_t offset, std::string_view text) {
+    // Разбор текста идёт до захвата блокировки.
+    std::vector<std::string> tokens = tokenize(text);
+    std::sort(tokens.begin(), tokens.end());
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto doc = static_cast<uint32_t>(first_doc_ + offsets_.size());
+    offsets_.push_back(offset);
+    lengths_.push_back(static_cast<uint32_t>(tokens.size()));
+    total_length_ += tokens.size();
+
+    for (std::size_t i = 0; i < tokens.size();) {
+        std::size_t j = i + 1;
+        while (j < tokens.size() && tokens[j] == tokens[i]) {
+            ++j;
+        }
+        postings_[std::move(tokens[i])].push_back({doc, static_cast<uint32_t>(j - i)});
+        i = j;
+    }
+}
+
+void SearchIndex::remove_before(uint64_t offset) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // Документы добавляются почти по порядку журнала: удаляется начало до первого оставшегося.
+    auto live = std::find_if(offsets_.begin(), offsets_.end(), [offset](uint64_t doc) { return doc >= offset; });
+    auto removed = static_cast<std::size_t>(live - offsets_.begin());
+    if (removed == 0) {
+        return;
+    }
+    for (std::size_t i = 0; i < removed; ++i) {
+        total_length_ -= lengths_[i];
+    }
+    offsets_.erase(offsets_.begin(), live);
+    lengths_.erase(lengths_.begin(), lengths_.begin() + static_cast<std::ptrdiff_t>(removed));
+    first_doc_ += static_cast<uint32_t>(removed);
+
+    for (auto it = postings_.begin(); it != postings_.end();) {
+        auto& list = it->second;
+        auto keep = std::lower_bound(list.begin(), list.end(), first_doc_,
+                                     [](const Posting& p, uint32_t doc) { return p.doc < doc; });
+        list.erase(list.begin(), keep);
+        if (list.empty()) {
+            it = postings_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+SearchResult SearchIndex::search(std::string_view query, std::size_t page, std::size_t page_size) const {
+    std::vector<std::string> words = tokenize(query);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    SearchResult result;
+    if (words.empty() || page_size == 0) {
+        return result;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<const std::vector<Posting>*> lists;
+    for (const auto& word : words) {
+        auto it = postings_.find(word);
+        if (it == postings_.end()) {
+            return result;
+        }
+        lists.push_back(&it->second);
+    }
+    // Пересечение начинается с самого короткого списка.
+    std::sort(lists.begin(), lists.end(), [](const auto* a, const auto* b) { return a->size() < b->size(); });
+
+    const double documents = static_cast<double>(offsets_.size());
+    const double length_weight = kB / (static_cast<double>(total_length_) / documents);
+    std::vector<double> idf;
+    for (const auto* list : lists) {
+        double df = static_cast<double>(list->size());
+        idf.push_back(std::log(1 + (documents - df + 0.5) / (df + 0.5)));
+    }
+    auto term_score = [&](std::size_t term, const Posting& posting) {
+        double tf = posting.tf;
+        double norm = kK1 * (1 - kB + length_weight * lengths_[posting.doc - first_doc_]);
+        return idf[term] * tf * (kK1 + 1) / (tf + norm);
+    };
+
+    // Совпадений не больше, чем в самом коротком списке: страница дальше него пуста, и куча
+    // для неё не строится. Проверка делением не переполняется при любом номере страницы.
+    const bool in_range = page <= (lists[0]->size() - 1) / page_size;
+    // Лучшие limit совпадений держатся в куче с худшим на вершине: полная сортировка не нужна.
+    const std::size_t begin = in_range ? page * page_size : 0;
+    const std::size_t limit = in_range ? begin + page_size : 0;
+    using Match = std::pair<double, uint32_t>;
+    auto better = [](const Match& a, const Match& b) { return a.first != b.first ? a.first > b.first : a.second > b.second; };
+    std::vector<Match> top;
+    top.reserve(limit + 1);
+    std::vector<std::vector<Posting>::const_iterator> cursors;
+    for (const auto* list : lists) {
+        cursors.push_back(list->begin());
+    }
+    for (const Posting& first : *lists[0]) {
+        double score = term_score(0, first);
+        std::size_t t = 1;
+        for (; t < lists.size(); ++t) {
+            auto& cursor = cursors[t];
+            cursor = std::lower_bound(cursor, lists[t]->end(), first.doc,
+                                      [](const Posting& p, uint32_t doc) { return p.doc < doc; });
+            if (cursor == lists[t]->end() || cursor->doc != first.doc) {
+                break;
+            }
+            score += term_score(t, *cursor);
+        }
+        if (t == lists.size()) {
+            ++result.total;
+            Match match{score, first.doc};
+            if (top.size() < limit) {
+                top.push_back(match);
+                std::push_heap(top.begin(), top.end(), better);
+            } else if (!top.empty() && better(match, top.front())) {
+                std::pop_heap(top.begin(), top.end(), better);
+                top.back() = match;
+                std::push_heap(top.begin(), top.end(), better);
+            }
+        } else if (cursors[t] == lists[t]->end()) {
+            break; // Один из списков исчерпан: дальше совпадений нет
+        }
+    }
+
+    std::sort_heap(top.begin(), top.end(), better);
+    for (std::size_t i = begin; i < top.size(); ++i) {
+        result.hits.push_back({offsets_[top[i].second - first_doc_], top[i].first});
+    }
+    return result;
+}
+
+std::size_t SearchIndex::documents() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return offsets_.size();
+}
+
+std::size_t SearchIndex::terms() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return postings_.size();
+}
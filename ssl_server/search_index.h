@@ -0,0 +1,99 @@
+/**
+ * @file search_index.h
+ * @brief Полнотекстовый поиск по истории чата: инвертированный индекс в памяти процесса.
+ */
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Разбивает текст на слова в нижнем регистре.
+ *
+ * Словом считается последовательность букв и цифр; латиница и кириллица приводятся к нижнему
+ * регистру, "ё" заменяется на "е". Прочие символы UTF-8 входят в слово как есть.
+ */
+std::vector<std::string> tokenize(std::string_view text);
+
+/**
+ * @brief Найденное сообщение.
+ */
+struct SearchHit {
+    uint64_t offset; ///< Смещение сообщения в журнале.
+    double score;    ///< Релевантность по BM25.
+};
+
+/**
+ * @brief Страница результатов поиска.
+ */
+struct SearchResult {
+    std::vector<SearchHit> hits; ///< Сообщения страницы по убыванию релевантности, при равенстве - новые первыми.
+    std::size_t total = 0;       ///< Число сообщений, содержащих все слова запроса.
+};
+
+/**
+ * @brief Инвертированный индекс сообщений, пополняемый по мере их записи в журнал.
+ *
+ * Для каждого слова хранится список (документ, число вхождений) в порядке добавления, поэтому
+ * пересечение списков идёт слиянием с двоичным поиском по более длинному списку.
+ * Поиск выполняется под разделяемой блокировкой и не мешает другим поискам.
+ */
+class SearchIndex {
+public:
+    /**
+     * @brief Добавляет сообщение в индекс. Сообщения добавляются в порядке журнала.
+     * @param offset Смещение сообщения в журнале.
+     * @param text Текст сообщения.
+     */
+    void add(uint64_t offset, std::string_view text);
+
+    /**
+     * @brief Удаляет из индекса сообщения до указанного смещения (их сегменты журнала удалены).
+     *
+     * Удаляются документы от начала индекса до первого со смещением не меньше offset.
+     * @param offset Первое смещение, оставшееся в журнале.
+     */
+    void remove_before(uint64_t offset);
+
+    /**
+     * @brief Ищет сообщения, содержащие все слова запроса.
+     *
+     * Страница дальше последнего возможного совпадения возвращается пустой, с числом совпадений.
+     * @param query Строка запроса.
+     * @param page Номер страницы, начиная с 0.
+     * @param page_size Число результатов на странице.
+     */
+    SearchResult search(std::string_view query, std::size_t page = 0, std::size_t page_size = 20) const;
+
+    /**
+     * @brief Число проиндексированных сообщений.
+     */
+    std::size_t documents() const;
+
+    /**
+     * @brief Число различных слов в индексе.
+     */
+    std::size_t terms() const;
+
+private:
+    struct Posting {
+        uint32_t doc; ///< Номер документа в порядке добавления.
+        uint32_t tf;  ///< Число вхождений слова в документ.
+    };
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, std::vector<Posting>> postings_;
+    std::vector<uint64_t> offsets_; ///< Смещение в журнале для каждого документа, начиная с first_doc_.
+    std::vector<uint32_t> lengths_; ///< Число слов в каждом документе, начиная с first_doc_.
+    uint32_t first_doc_ = 0;        ///< Номер первого оставшегося документа.
+    uint64_t total_length_ = 0;
+};
+
+#endif // SEARCH_INDEX_H
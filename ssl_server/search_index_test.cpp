@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "search_index.h"
+#include <limits>
+
+TEST(SearchIndexTest, TokenizesLatinAndCyrillicCaseInsensitively) {
+    EXPECT_EQ(tokenize("Hello, WORLD!"), (std::vector<std::string>{"hello", "world"}));
+    EXPECT_EQ(tokenize("Привет — ЁЖИК и ёлка"), (std::vector<std::string>{"привет", "ежик", "и", "елка"}));
+    EXPECT_EQ(tokenize("«Сервер» 42"), (std::vector<std::string>{"сервер", "42"}));
+}
+
+TEST(SearchIndexTest, MatchesAllWordsAndRanksByRelevance) {
+    SearchIndex index;
+    index.add(10, "deploy the server tonight");
+    index.add(11, "the server is down, server restart needed");
+    index.add(12, "lunch anyone?");
+    index.add(13, "Server deploy finished");
+
+    SearchResult server = index.search("SERVER");
+    EXPECT_EQ(server.total, 3u);
+    ASSERT_EQ(server.hits.size(), 3u);
+    EXPECT_EQ(server.hits[0].offset, 11u); // Два вхождения
+
+    SearchResult both = index.search("deploy server");
+    EXPECT_EQ(both.total, 2u);
+    ASSERT_EQ(both.hits.size(), 2u);
+    EXPECT_EQ(both.hits[0].offset, 13u); // Короче документ - выше оценка
+    EXPECT_EQ(both.hits[1].offset, 10u);
+
+    EXPECT_EQ(index.search("deploy lunch").total, 0u);
+    EXPECT_EQ(index.search("missing").total, 0u);
+    EXPECT_EQ(index.search("  ").total, 0u);
+}
+
+TEST(SearchIndexTest, PaginatesNewestFirstOnEqualScores) {
+    SearchIndex index;
+    for (uint64_t offset = 0; offset < 25; ++offset) {
+        index.add(offset, "ping");
+    }
+    SearchResult first = index.search("ping", 0, 10);
+    EXPECT_EQ(first.total, 25u);
+    ASSERT_EQ(first.hits.size(), 10u);
+    EXPECT_EQ(first.hits[0].offset, 24u);
+
+    SearchResult last = index.search("ping", 2, 10);
+    ASSERT_EQ(last.hits.size(), 5u);
+    EXPECT_EQ(last.hits.back().offset, 0u);
+    EXPECT_TRUE(index.search("ping", 3, 10).hits.empty());
+    EXPECT_EQ(index.documents(), 25u);
+    EXPECT_EQ(index.terms(), 1u);
+}
+
+TEST(SearchIndexTest, OutOfRangePageIsEmptyWithoutOverflow) {
+    SearchIndex index;
+    for (uint64_t offset = 0; offset < 5; ++offset) {
+        index.add(offset, "ping");
+    }
+    SearchResult huge = index.search("ping", std::numeric_limits<std::size_t>::max(), 20);
+    EXPECT_TRUE(huge.hits.empty());
+    EXPECT_EQ(huge.total, 5u);
+
+    SearchResult wrapped = index.search("ping", std::numeric_limits<std::size_t>::max() / 20 + 1, 20);
+    EXPECT_TRUE(wrapped.hits.empty());
+    EXPECT_EQ(wrapped.total, 5u);
+}
+
+TEST(SearchIndexTest, RemovesMessagesOfDroppedSegments) {
+    SearchIndex index;
+    index.add(0, "deploy old");
+    index.add(1, "deploy old again");
+    index.add(2, "deploy new");
+    index.add(3, "lunch");
+
+    index.remove_before(2);
+    EXPECT_EQ(index.documents(), 2u);
+    EXPECT_EQ(index.search("old").total, 0u);
+    EXPECT_EQ(index.terms(), 3u); // deploy, new, lunch
+
+    SearchResult deploy = index.search("deploy");
+    ASSERT_EQ(deploy.hits.size(), 1u);
+    EXPECT_EQ(deploy.hits[0].offset, 2u);
+
+    index.add(4, "deploy again");
+    SearchResult again = index.search("deploy again");
+    ASSERT_EQ(again.hits.size(), 1u);
+    EXPECT_EQ(again.hits[0].offset, 4u);
+    EXPECT_EQ(index.search("deploy").total, 2u);
+}
@@ -0,0 +1,240 @@
+/**
+ * @file send_queue.cpp
+ * @brief Реализация очереди исходящих кадров.
+ */
+
+#include "send_queue.h"
+#include <algorithm>
+#include <utility>
+
+namespace asio = boost::asio;
+
+SendQueue::SendQueue(executor_type strand, std::size_t high_water, std::size_t limit)
+    : strand_(strand), high_water_(high_water), limit_(limit), ready_(strand), space_(strand) {}
+
+SendQueue::~SendQueue() {
+    release(bytes_, frames_);
+}
+
+namespace {
+
+constexpr std::size_t lane_index(SendQueue::Lane lane) {
+    return static_cast<std::size_t>(lane);
+}
+
+} // namespace
+
+bool SendQueue::enqueue(Frame frame, Lane lane) {
+    bool accepted = false;
+    bool parked = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_ || finishing_) {
+            return false;
+        }
+        // Получатель, отставший на limit байт, отключается: догнать он сможет, переподключившись с последнего номера.
+        if (bytes_ + frame->size() > limit_) {
+            closed_ = true;
+        } else {
+            account(frame->size(), 1);
+            lanes_[lane_index(lane)].push_back({std::move(frame), clock::now()});
+            accepted = true;
+        }
+        // Будить нужно только запись, уснувшую на ready_: иначе она сама заберёт кадр, вернувшись за следующим.
+        parked = std::exchange(waiting_, false);
+    }
+    if (parked) {
+        wake(ready_);
+    }
+    return accepted;
+}
+
+asio::awaitable<void> SendQueue::push(Frame frame, Lane lane) {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_ || finishing_) {
+                co_return;
+            }
+            if (bytes_ < high_water_) {
+                account(frame->size(), 1);
+                lanes_[lane_index(lane)].push_back({std::move(frame), clock::now()});
+                break;
+            }
+        }
+        // Таймер отменяет pop() из того же strand, поэтому пробуждение не может потеряться.
+        space_.expires_at(asio::steady_timer::time_point::max());
+        boost::system::error_code ec;
+        co_await space_.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+    ready_.cancel();
+}
+
+asio::awaitable<SendQueue::Frame> SendQueue::pop() {
+    std::vector<Frame> batch;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_) {
+                co_return nullptr;
+            }
+            for (auto& frames : lanes_) {
+                if (frames.empty()) {
+                    continue;
+                }
+                std::size_t taken = 0;
+                take(&frames - lanes_.data(), batch, taken);
+                release(taken, batch.size());
+                if (bytes_ < high_water_) {
+                    space_.cancel();
+                }
+                break;
+            }
+            if (batch.empty() && finishing_) {
+                closed_ = true;
+                co_return nullptr;
+            }
+            waiting_ = batch.empty();
+        }
+        if (!batch.empty()) {
+            report_delays();
+            co_return std::move(batch.front());
+        }
+        ready_.expires_at(asio::steady_timer::time_point::max());
+        boost::system::error_code ec;
+        co_await ready_.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+}
+
+asio::awaitable<bool> SendQueue::pop_batch(std::vector<Frame>& batch, std::size_t max_bytes) {
+    batch.clear();
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_) {
+                co_return false;
+            }
+            std::size_t taken = 0;
+            // Служебные кадры короткие и редкие: они не ждут бюджета.
+            auto& control = lanes_[lane_index(Lane::control)];
+            while (!control.empty() && (batch.empty() || taken + control.front().frame->size() <= max_bytes)) {
+                take(lane_index(Lane::control), batch, taken);
+            }
+            // Каждая непустая полоса получает на ход свою долю; полоса, опустевшая за ход, теряет остаток.
+            for (Lane lane : {Lane::chat, Lane::bulk}) {
+                std::size_t index = lane_index(lane);
+                auto& frames = lanes_[index];
+                if (frames.empty()) {
+                    deficit_[index] = 0;
+                    continue;
+                }
+                deficit_[index] += lane == Lane::bulk ? std::max<std::size_t>(max_bytes / kBulkShare, 1) : max_bytes;
+                while (!frames.empty() && frames.front().frame->size() <= deficit_[index]
+                       && (batch.empty() || taken + frames.front().frame->size() <= max_bytes)) {
+                    deficit_[index] -= frames.front().frame->size();
+                    take(index, batch, taken);
+                }
+                if (frames.empty()) {
+                    deficit_[index] = 0;
+                }
+            }
+            // Кадр длиннее бюджета не копит его несколько ходов, если больше отправлять нечего.
+            if (batch.empty()) {
+                for (Lane lane : {Lane::chat, Lane::bulk}) {
+                    std::size_t index = lane_index(lane);
+                    if (!lanes_[index].empty()) {
+                        deficit_[index] = 0;
+                        take(index, batch, taken);
+                        break;
+                    }
+                }
+            }
+            if (!batch.empty()) {
+                release(taken, batch.size());
+                if (bytes_ < high_water_) {
+                    space_.cancel();
+                }
+            } else if (finishing_) {
+                closed_ = true;
+                co_return false;
+            }
+            waiting_ = batch.empty();
+        }
+        if (!batch.empty()) {
+            report_delays();
+            co_return true;
+        }
+        ready_.expires_at(asio::steady_timer::time_point::max());
+        boost::system::error_code ec;
+        co_await ready_.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+}
+
+void SendQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        for (auto& frames : lanes_) {
+            frames.clear();
+        }
+        release(bytes_, frames_);
+    }
+    wake(ready_);
+    wake(space_);
+}
+
+void SendQueue::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+    }
+    wake(ready_);
+    wake(space_);
+}
+
+std::size_t SendQueue::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+bool SendQueue::closed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_ || finishing_;
+}
+
+void SendQueue::take(std::size_t lane, std::vector<Frame>& batch, std::size_t& taken) {
+    Entry& entry = lanes_[lane].front();
+    taken += entry.frame->size();
+    if (delay_observer_) {
+        delays_.emplace_back(static_cast<Lane>(lane), clock::now() - entry.queued);
+    }
+    batch.push_back(std::move(entry.frame));
+    lanes_[lane].pop_front();
+}
+
+void SendQueue::report_delays() {
+    // Наблюдатель вызывается вне мьютекса: гистограммы не задерживают enqueue() рассылок.
+    for (const auto& [lane, delay] : delays_) {
+        delay_observer_(lane, delay);
+    }
+    delays_.clear();
+}
+
+void SendQueue::wake(asio::steady_timer& timer) {
+    // Таймеры не потокобезопасны, поэтому отмена выполняется в strand очереди.
+    asio::post(strand_, [self = shared_from_this(), &timer] { timer.cancel(); });
+}
+
+void SendQueue::account(std::size_t bytes, std::size_t frames) {
+    bytes_ += bytes;
+    frames_ += frames;
+    total_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    total_frames_.fetch_add(frames, std::memory_order_relaxed);
+}
+
+void SendQueue::release(std::size_t bytes, std::size_t frames) {
+    bytes_ -= bytes;
+    frames_ -= frames;
+    total_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    total_frames_.fetch_sub(frames, std::memory_order_relaxed);
+}
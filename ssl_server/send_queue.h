@@ -0,0 +1,229 @@
+/**
+ * @file send_queue.h
+ * @brief Очередь исходящих кадров соединения, которую разбирает корутина записи сессии.
+ */
+
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include <utility> // Boost 1.74 использует std::exchange в awaitable.hpp, не подключая <utility>
+#include <boost/asio.hpp>
+#include <boost/beast/core/buffers_range.hpp>
+#include <boost/beast/http.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Очередь готовых к отправке кадров (сериализованных HTTP-ответов) одного соединения.
+ *
+ * Кадр рассылки сериализуется один раз и разделяется очередями всех получателей.
+ * Рассылки кладут кадры из любого потока через enqueue() без ожидания, сама сессия - через
+ * push(), который ждёт, пока очередь не опустеет ниже порога: так длинная история не
+ * копится в памяти целиком. Корутина записи забирает кадры через pop() или пачками через
+ * pop_batch(). pop(), pop_batch() и push() вызываются только из strand сессии.
+ *
+ * Кадры разложены по полосам (Lane). Служебные кадры уходят первыми; чат и объёмные данные
+ * делят пачку взвешенным круговым обходом с бюджетом байт на ход (deficit round-robin):
+ * длинная история не задерживает строки чата, а сама не простаивает, пока чат пуст.
+ */
+class SendQueue : public std::enable_shared_from_this<SendQueue> {
+public:
+    using Frame = std::shared_ptr<const std::string>;
+    using executor_type = boost::asio::strand<boost::asio::io_context::executor_type>;
+
+    /**
+     * @brief Полоса очереди: определяет очерёдность кадра при выборке пачки.
+     */
+    enum class Lane : uint8_t {
+        control = 0, ///< Подтверждения, уведомления, присутствие, пинги; уходят раньше остальных.
+        chat = 1,    ///< Сообщения чата и личные сообщения.
+        bulk = 2,    ///< История и результаты поиска.
+    };
+    static constexpr std::size_t kLanes = 3;
+
+    /**
+     * @brief Доля бюджета хода на полосу: чат получает max_bytes, объёмные данные - max_bytes / kBulkShare.
+     */
+    static constexpr std::size_t kBulkShare = 4;
+
+    /**
+     * @brief Получает время ожидания каждого забранного кадра в очереди; вызывается из strand сессии.
+     */
+    using DelayObserver = std::function<void(Lane lane, std::chrono::steady_clock::duration delay)>;
+
+    /**
+     * @param strand Strand сессии.
+     * @param high_water Объём кадров в очереди, выше которого push() ждёт.
+     * @param limit Объём, при превышении которого enqueue() закрывает очередь (получатель не успевает читать).
+     */
+    SendQueue(executor_type strand, std::size_t high_water = 256 * 1024, std::size_t limit = 4 * 1024 * 1024);
+    ~SendQueue();
+
+    /**
+     * @brief Кладёт кадр в очередь без ожидания. Потокобезопасен.
+     * @return Ложь, если очередь закрыта или переполнена (тогда она закрывается).
+     */
+    bool enqueue(Frame frame, Lane lane = Lane::chat);
+
+    /**
+     * @brief Кладёт кадр в очередь, сначала дождавшись, пока объём очереди не станет ниже high_water.
+     */
+    boost::asio::awaitable<void> push(Frame frame, Lane lane = Lane::chat);
+
+    /**
+     * @brief Забирает следующий кадр самой срочной непустой полосы, ожидая его появления.
+     * @return nullptr, если очередь закрыта.
+     */
+    boost::asio::awaitable<Frame> pop();
+
+    /**
+     * @brief Забирает все накопившиеся кадры, но не больше max_bytes (хотя бы один), ожидая первого.
+     *
+     * Сначала берутся служебные кадры, затем чат и объёмные данные в пределах бюджетов своих
+     * полос; неизрасходованный бюджет непустой полосы переходит на следующий ход. Внутри полосы
+     * порядок кадров сохраняется.
+     * @param batch Заполняется кадрами по порядку отправки; прежнее содержимое удаляется.
+     * @param max_bytes Предельный объём пачки.
+     * @return Ложь, если очередь закрыта.
+     */
+    boost::asio::awaitable<bool> pop_batch(std::vector<Frame>& batch, std::size_t max_bytes);
+
+    /**
+     * @brief Закрывает очередь: pop() возвращает nullptr, новые кадры отбрасываются. Потокобезопасен.
+     */
+    void close();
+
+    /**
+     * @brief Завершает очередь мягко: новые кадры отбрасываются, уже поставленные отправляются,
+     * после чего pop() и pop_batch() сообщают о закрытии. Потокобезопасен.
+     */
+    void finish();
+
+    /**
+     * @brief Объём кадров в очереди, байт.
+     */
+    std::size_t bytes() const;
+
+    /**
+     * @brief Объём кадров во всех очередях процесса, байт. Потокобезопасен.
+     */
+    static std::size_t total_bytes() { return total_bytes_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Число кадров во всех очередях процесса. Потокобезопасен.
+     */
+    static std::size_t total_frames() { return total_frames_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Закрыта ли очередь: тогда длинную отправку (например, вложения) можно прекратить. Потокобезопасен.
+     */
+    bool closed() const;
+
+    /**
+     * @brief Задаёт получателя времени ожидания кадров; вызывается до начала записи.
+     */
+    void set_delay_observer(DelayObserver observer) { delay_observer_ = std::move(observer); }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Кадр в полосе и момент его постановки.
+     */
+    struct Entry {
+        Frame frame;
+        clock::time_point queued;
+    };
+
+
+    executor_type strand_;
+    std::size_t high_water_;
+    std::size_t limit_;
+    boost::asio::steady_timer ready_; ///< Отменяется, когда в очереди появляется кадр.
+    boost::asio::steady_timer space_; ///< Отменяется, когда объём опускается ниже high_water.
+    mutable std::mutex mutex_;
+    std::array<std::deque<Entry>, kLanes> lanes_;
+    std::array<std::size_t, kLanes> deficit_{}; ///< Неизрасходованный бюджет полосы; только в strand.
+    std::size_t bytes_ = 0;
+    std::size_t frames_ = 0;
+    bool closed_ = false;
+    bool finishing_ = false; ///< После finish(): очередь закроется, когда опустеет.
+    bool waiting_ = false;   ///< Запись ждёт на ready_ и её нужно разбудить; выставляется под mutex_.
+
+    DelayObserver delay_observer_;
+    std::vector<std::pair<Lane, clock::duration>> delays_; ///< Задержки текущей пачки; только в strand.
+
+    // Сумма bytes_ и frames_ всех очередей: по ней судят о перегрузке отправки в целом.
+    static inline std::atomic<std::size_t> total_bytes_{0};
+    static inline std::atomic<std::size_t> total_frames_{0};
+
+    void wake(boost::asio::steady_timer& timer);
+    void take(std::size_t lane, std::vector<Frame>& batch, std::size_t& taken);
+    void account(std::size_t bytes, std::size_t frames);
+    void release(std::size_t bytes, std::size_t frames);
+    void report_delays();
+};
+
+/**
+ * @brief Сериализует HTTP-сообщение в кадр для SendQueue.
+ *
+ * Сообщение сериализуется в буфер потока, переиспользуемый между вызовами, поэтому
+ * в установившемся режиме куча нужна только самому кадру: он создаётся один раз на рассылку,
+ * а не на получателя.
+ */
+template <bool isRequest, typename Body, typename Fields>
+SendQueue::Frame make_frame(const boost::beast::http::message<isRequest, Body, Fields>& message) {
+    thread_local std::string scratch;
+    scratch.clear();
+    boost::beast::http::serializer<isRequest, Body, Fields> serializer(message);
+    boost::beast::error_code ec;
+    do {
+        serializer.next(ec, [&](boost::beast::error_code&, const auto& buffers) {
+            std::size_t size = 0;
+            for (auto buffer : boost::beast::buffers_range_ref(buffers)) {
+                scratch.append(static_cast<const char*>(buffer.data()), buffer.size());
+                size += buffer.size();
+            }
+            serializer.consume(size);
+        });
+    } while (!ec && !serializer.is_done());
+    if (ec) {
+        throw boost::system::system_error(ec);
+    }
+    return std::make_shared<const std::string>(scratch);
+}
+
+/**
+ * @brief Записывает пачку кадров одной операцией записи.
+ *
+ * Несколько кадров склеиваются в buffer: потоки TLS шифруют за одну операцию только первый
+ * буфер последовательности, а одна склеенная запись - это одна запись TLS и один системный
+ * вызов вместо вызова на каждый кадр рассылки.
+ * @param stream Поток соединения.
+ * @param frames Кадры в порядке отправки.
+ * @param buffer Буфер склейки, переиспользуемый между вызовами.
+ */
+template <typename AsyncWriteStream>
+boost::asio::awaitable<void> write_frames(AsyncWriteStream& stream, const std::vector<SendQueue::Frame>& frames,
+                                          std::string& buffer) {
+    if (frames.size() == 1) {
+        co_await boost::asio::async_write(stream, boost::asio::buffer(*frames.front()), boost::asio::use_awaitable);
+        co_return;
+    }
+    buffer.clear();
+    for (const auto& frame : frames) {
+        buffer.append(*frame);
+    }
+    co_await boost::asio::async_write(stream, boost::asio::buffer(buffer), boost::asio::use_awaitable);
+}
+
+#endif // SEND_QUEUE_H
@@ -0,0 +1,266 @@
+#include <gtest/gtest.h>
+#include "send_queue.h"
+#include <thread>
+#include <vector>
+
+namespace asio = boost::asio;
+
+namespace {
+
+SendQueue::Frame frame(std::string text) {
+    return std::make_shared<const std::string>(std::move(text));
+}
+
+/**
+ * @brief Поток записи в строку; как поток TLS, за операцию пишет только первый буфер.
+ */
+struct StringStream {
+    using executor_type = asio::io_context::executor_type;
+    executor_type executor;
+    std::string data;
+    std::size_t writes = 0;
+
+    executor_type get_executor() { return executor; }
+
+    template <typename ConstBufferSequence, typename CompletionToken>
+    auto async_write_some(const ConstBufferSequence& buffers, CompletionToken&& token) {
+        return asio::async_initiate<CompletionToken, void(boost::system::error_code, std::size_t)>(
+            [this](auto handler, const ConstBufferSequence& buffers) {
+                asio::const_buffer first = *asio::buffer_sequence_begin(buffers);
+                data.append(static_cast<const char*>(first.data()), first.size());
+                ++writes;
+                asio::post(executor, [handler = std::move(handler), n = first.size()]() mutable { handler({}, n); });
+            },
+            token, buffers);
+    }
+};
+
+} // namespace
+
+TEST(SendQueueTest, PopWaitsForFramesEnqueuedFromOtherThreads) {
+    asio::io_context ioc;
+    auto queue = std::make_shared<SendQueue>(asio::make_strand(ioc));
+    std::vector<std::string> received;
+
+    asio::co_spawn(asio::make_strand(ioc), [&]() -> asio::awaitable<void> {
+        while (auto next = co_await queue->pop()) {
+            received.push_back(*next);
+        }
+    }, asio::detached);
+
+    std::thread producer([&] {
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_TRUE(queue->enqueue(frame(std::to_string(i))));
+        }
+        queue->enqueue(frame("last"));
+    });
+    std::thread runner([&] { ioc.run_for(std::chrono::seconds(5)); });
+    producer.join();
+    while (queue->bytes() > 0) {
+        std::this_thread::yield();
+    }
+    queue->close();
+    runner.join();
+
+    ASSERT_EQ(received.size(), 101u);
+    EXPECT_EQ(received.front(), "0");
+    EXPECT_EQ(received[99], "99");
+    EXPECT_EQ(received.back(), "last");
+}
+
+TEST(SendQueueTest, PushWaitsBelowHighWater) {
+    asio::io_context ioc;
+    auto strand = asio::make_strand(ioc);
+    auto queue = std::make_shared<SendQueue>(strand, 10);
+    std::size_t max_bytes = 0;
+    std::size_t popped = 0;
+
+    asio::co_spawn(strand, [&]() -> asio::awaitable<void> {
+        for (int i = 0; i < 20; ++i) {
+            co_await queue->push(frame("12345"));
+            max_bytes = std::max(max_bytes, queue->bytes());
+        }
+        queue->close();
+    }, asio::detached);
+    asio::co_spawn(strand, [&]() -> asio::awaitable<void> {
+        while (auto next = co_await queue->pop()) {
+            ++popped;
+        }
+    }, asio::detached);
+    ioc.run_for(std::chrono::seconds(5));
+
+    EXPECT_LE(max_bytes, 15u); // Ниже порога плюс один кадр
+    EXPECT_GE(popped, 18u);    // Кадры, оставшиеся в очереди при закрытии, отбрасываются
+}
+
+TEST(SendQueueTest, OverflowClosesQueue) {
+    asio::io_context ioc;
+    auto queue = std::make_shared<SendQueue>(asio::make_strand(ioc), 4, 8);
+    EXPECT_TRUE(queue->enqueue(frame("1234")));
+    EXPECT_TRUE(queue->enqueue(frame("5678")));
+    EXPECT_FALSE(queue->enqueue(frame("9")));
+    EXPECT_FALSE(queue->enqueue(frame("a")));
+
+    bool closed = false;
+    asio::co_spawn(asio::make_strand(ioc), [&]() -> asio::awaitable<void> {
+        closed = (co_await queue->pop()) == nullptr;
+    }, asio::detached);
+    ioc.run_for(std::chrono::seconds(5));
+    EXPECT_TRUE(closed);
+}
+
+TEST(SendQueueTest, PopBatchTakesQueuedFramesUpToLimitAndWritesThemOnce) {
+    asio::io_context ioc;
+    auto strand = asio::make_strand(ioc);
+    auto queue = std::make_shared<SendQueue>(strand);
+    for (const char* text : {"aa", "bb", "cc", "dddddddd", "e"}) {
+        queue->enqueue(frame(text));
+    }
+
+    std::vector<std::vector<std::string>> batches;
+    StringStream stream{ioc.get_executor(), {}, 0};
+    asio::co_spawn(strand, [&]() -> asio::awaitable<void> {
+        std::vector<SendQueue::Frame> batch;
+        std::string buffer;
+        while (co_await queue->pop_batch(batch, 6)) {
+            batches.emplace_back();
+            for (const auto& next : batch) {
+                batches.back().push_back(*next);
+            }
+            co_await write_frames(stream, batch, buffer);
+            if (queue->bytes() == 0) {
+                queue->close();
+            }
+        }
+    }, asio::detached);
+    ioc.run_for(std::chrono::seconds(5));
+
+    // Кадр длиннее предела уходит отдельной пачкой целиком.
+    ASSERT_EQ(batches.size(), 3u);
+    EXPECT_EQ(batches[0], (std::vector<std::string>{"aa", "bb", "cc"}));
+    EXPECT_EQ(batches[1], (std::vector<std::string>{"dddddddd"}));
+    EXPECT_EQ(batches[2], (std::vector<std::string>{"e"}));
+    EXPECT_EQ(stream.data, "aabbccdddddddde");
+    EXPECT_EQ(stream.writes, 3u); // По операции записи на пачку
+}
+
+TEST(SendQueueTest, FinishDeliversQueuedFramesThenCloses) {
+    asio::io_context ioc;
+    auto queue = std::make_shared<SendQueue>(asio::make_strand(ioc));
+    queue->enqueue(frame("a"));
+    queue->enqueue(frame("b"));
+    queue->finish();
+    EXPECT_FALSE(queue->enqueue(frame("c")));
+
+    std::vector<std::string> received;
+    asio::co_spawn(asio::make_strand(ioc), [&]() -> asio::awaitable<void> {
+        while (auto next = co_await queue->pop()) {
+            received.push_back(*next);
+        }
+    }, asio::detached);
+    ioc.run_for(std::chrono::seconds(5));
+
+    EXPECT_EQ(received, (std::vector<std::string>{"a", "b"}));
+}
+
+TEST(SendQueueTest, MakeFrameSerializesResponse) {
+    boost::beast::http::response<boost::beast::http::string_body> response(boost::beast::http::status::ok, 11);
+    response.set("X-Ack", "7");
+    response.body() = "hi";
+    response.prepare_payload();
+
+    SendQueue::Frame serialized = make_frame(response);
+    EXPECT_EQ(*serialized, "HTTP/1.1 200 OK\r\nX-Ack: 7\r\nContent-Length: 2\r\n\r\nhi");
+}
+
+TEST(SendQueueTest, ControlAndChatOvertakeQueuedHistoryWithinBudget) {
+    asio::io_context ioc;
+    auto strand = asio::make_strand(ioc);
+    auto queue = std::make_shared<SendQueue>(strand);
+    for (int i = 0; i < 4; ++i) {
+        queue->enqueue(frame("h" + std::to_string(i) + std::string(998, '.')), SendQueue::Lane::bulk);
+    }
+    queue->enqueue(frame("chat"));
+    queue->enqueue(frame("ack"), SendQueue::Lane::control);
+
+    std::vector<std::vector<std::string>> batches;
+    asio::co_spawn(strand, [&]() -> asio::awaitable<void> {
+        std::vector<SendQueue::Frame> batch;
+        while (co_await queue->pop_batch(batch, 4000)) {
+            batches.emplace_back();
+            for (const auto& next : batch) {
+                batches.back().push_back(next->substr(0, 4));
+            }
+            if (queue->bytes() == 0) {
+                queue->close();
+            } else if (batches.size() == 1) {
+                queue->enqueue(frame("late"));
+            }
+        }
+    }, asio::detached);
+    ioc.run_for(std::chrono::seconds(5));
+
+    // За ход история получает четверть бюджета, чат - весь; служебный кадр уходит первым.
+    ASSERT_EQ(batches.size(), 4u);
+    EXPECT_EQ(batches[0], (std::vector<std::string>{"ack", "chat", "h0.."}));
+    EXPECT_EQ(batches[1], (std::vector<std::string>{"late", "h1.."}));
+    EXPECT_EQ(batches[2], (std::vector<std::string>{"h2.."}));
+    EXPECT_EQ(batches[3], (std::vector<std::string>{"h3.."}));
+}
+
+TEST(SendQueueTest, ReportsQueueingDelayPerLane) {
+    asio::io_context ioc;
+    auto strand = asio::make_strand(ioc);
+    auto queue = std::make_shared<SendQueue>(strand);
+    std::vector<SendQueue::Lane> lanes;
+    queue->set_delay_observer([&](SendQueue::Lane lane, std::chrono::steady_clock::duration delay) {
+        EXPECT_GE(delay.count(), 0);
+        lanes.push_back(lane);
+    });
+    queue->enqueue(frame("history"), SendQueue::Lane::bulk);
+    queue->enqueue(frame("line"));
+    queue->enqueue(frame("ping"), SendQueue::Lane::control);
+
+    asio::co_spawn(strand, [&]() -> asio::awaitable<void> {
+        std::vector<SendQueue::Frame> batch;
+        co_await queue->pop_batch(batch, 1024);
+        EXPECT_EQ(batch.size(), 3u);
+    }, asio::detached);
+    ioc.run_for(std::chrono::seconds(5));
+
+    EXPECT_EQ(lanes, (std::vector<SendQueue::Lane>{SendQueue::Lane::control, SendQueue::Lane::chat, SendQueue::Lane::bulk}));
+}
+
+TEST(SendQueueTest, TotalsCoverEveryQueueOfTheProcess) {
+    asio::io_context ioc;
+    auto strand = asio::make_strand(ioc);
+    std::size_t bytes = SendQueue::total_bytes();
+    std::size_t frames = SendQueue::total_frames();
+    auto first = std::make_shared<SendQueue>(strand);
+    auto second = std::make_shared<SendQueue>(strand);
+    first->enqueue(frame("hello"));
+    first->enqueue(frame("world"), SendQueue::Lane::bulk);
+    second->enqueue(frame("ping"), SendQueue::Lane::control);
+    EXPECT_EQ(SendQueue::total_bytes(), bytes + 14);
+    EXPECT_EQ(SendQueue::total_frames(), frames + 3);
+
+    asio::co_spawn(strand, [&]() -> asio::awaitable<void> {
+        std::vector<SendQueue::Frame> batch;
+        co_await first->pop_batch(batch, 1024);
+        EXPECT_EQ(batch.size(), 2u);
+    }, asio::detached);
+    ioc.run_for(std::chrono::seconds(5));
+    EXPECT_EQ(SendQueue::total_bytes(), bytes + 4);
+    EXPECT_EQ(SendQueue::total_frames(), frames + 1);
+
+    // Кадры закрытой или уничтоженной очереди из суммы уходят.
+    second->close();
+    EXPECT_EQ(SendQueue::total_bytes(), bytes);
+    second = std::make_shared<SendQueue>(strand);
+    second->enqueue(frame("left"));
+    second.reset();
+    ioc.restart();
+    ioc.poll(); // Пробуждение из enqueue() держит очередь до своего выполнения.
+    EXPECT_EQ(SendQueue::total_bytes(), bytes);
+    EXPECT_EQ(SendQueue::total_frames(), frames);
+}
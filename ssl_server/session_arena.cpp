@@ -0,0 +1,34 @@
+/**
+ * @file session_arena.cpp
+ * @brief Реализация пула памяти сессии.
+ */
+
+#include "session_arena.h"
+
+namespace {
+
+std::pmr::pool_options arena_options(std::size_t largest_block) {
+    std::pmr::pool_options options;
+    options.largest_required_pool_block = largest_block;
+    return options;
+}
+
+} // namespace
+
+SessionArena::SessionArena(std::pmr::memory_resource* upstream, std::size_t largest_block)
+    : pool_(arena_options(largest_block), upstream), buffer_(arena_allocator(&pool_)) {}
+
+arena_response SessionArena::make_response(http::status status) {
+    arena_response response(std::piecewise_construct, std::make_tuple(allocator()), std::make_tuple(allocator()));
+    response.result(status);
+    response.version(11);
+    return response;
+}
+
+arena_allocator SessionArena::allocator() {
+    return arena_allocator(&pool_);
+}
+
+std::pmr::memory_resource* SessionArena::resource() {
+    return &pool_;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file session_arena.h
+ * @brief Пул памяти сессии: разбор запросов и формирование ответов без обращений к куче.
+ */
+
+#ifndef SESSION_ARENA_H
+#define SESSION_ARENA_H
+
+#include <utility> // Boost 1.74 использует std::exchange в awaitable.hpp, не подключая <utility>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <tuple>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+/**
+ * @brief Аллокатор, берущий память из пула сессии.
+ */
+using arena_allocator = std::pmr::polymorphic_allocator<char>;
+
+/**
+ * @brief Заголовки HTTP, размещаемые в пуле сессии.
+ */
+using arena_fields = http::basic_fields<arena_allocator>;
+
+/**
+ * @brief Тело HTTP-сообщения в виде строки из пула сессии.
+ */
+using arena_string_body = http::basic_string_body<char, std::char_traits<char>, arena_allocator>;
+
+using arena_request = http::request<arena_string_body, arena_fields>;
+using arena_response = http::response<arena_string_body, arena_fields>;
+
+/**
+ * @brief Буфер чтения, размещаемый в пуле сессии.
+ */
+using arena_buffer = beast::basic_flat_buffer<arena_allocator>;
+
+/**
+ * @brief Пул памяти одной сессии, переиспользуемый от сообщения к сообщению.
+ *
+ * Парсер, заголовки и тело каждого запроса размещаются в unsynchronized_pool_resource.
+ * После разбора следующего запроса память предыдущего возвращается в пул, поэтому
+ * в установившемся режиме чтение (async_read) и ответы из make_response() не обращаются
+ * к системной куче. Сериализованный кадр (make_frame()) в пул не входит: он живёт, пока
+ * его не отправят все получатели.
+ * Объект не потокобезопасен и принадлежит одной сессии (её strand).
+ */
+class SessionArena {
+public:
+    /**
+     * @brief Создаёт пул сессии.
+     * @param upstream Источник памяти для пополнения пула.
+     * @param largest_block Наибольший размер блока, который пул хранит у себя для повторного использования.
+     */
+    explicit SessionArena(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource(),
+                          std::size_t largest_block = 1024 * 1024);
+
+    SessionArena(const SessionArena&) = delete;
+    SessionArena& operator=(const SessionArena&) = delete;
+
+    /**
+     * @brief Асинхронно читает следующий запрос в корутине, освобождая память предыдущего.
+     *
+     * Сама не корутина: возвращает операцию чтения, поэтому не заводит своего кадра корутины
+     * (asio держит для повторного использования только один кадр на поток).
+     * @param stream Поток, из которого читается запрос.
+     * @return Число прочитанных байт; разобранный запрос доступен через request() до следующего чтения.
+     * @throws boost::system::system_error при ошибке чтения.
+     */
+    template <typename AsyncReadStream>
+    boost::asio::awaitable<std::size_t> async_read(AsyncReadStream& stream) {
+        parser_.reset();
+        parser_.emplace(std::piecewise_construct, std::make_tuple(allocator()), std::make_tuple(allocator()));
+        return http::async_read(stream, buffer_, *parser_, boost::asio::use_awaitable);
+    }
+
+    /**
+     * @brief Последний прочитанный запрос.
+     */
+    arena_request& request() { return parser_->get(); }
+
+    /**
+     * @brief Создаёт пустой ответ, размещаемый в пуле сессии.
+     * @param status Код ответа.
+     * @return Ответ с версией HTTP/1.1.
+     */
+    arena_response make_response(http::status status);
+
+    /**
+     * @brief Аллокатор пула сессии.
+     */
+    arena_allocator allocator();
+
+    /**
+     * @brief Ресурс памяти пула сессии.
+     */
+    std::pmr::memory_resource* resource();
+
+private:
+    std::pmr::unsynchronized_pool_resource pool_;
+    arena_buffer buffer_;
+    std::optional<http::request_parser<arena_string_body, arena_allocator>> parser_;
+};
+
+#endif // SESSION_ARENA_H
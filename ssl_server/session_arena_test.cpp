@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include "session_arena.h"
+#include "send_queue.h"
+#include "client_registry.h"
+#include <boost/asio.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// Подсчёт обращений к глобальной куче на время проверяемого участка. Замена operator new
+// действует на всю программу, поэтому тест собирается отдельным исполняемым файлом.
+namespace {
+std::atomic<bool> counting{false};
+std::atomic<std::size_t> heap_allocations{0};
+
+void* allocate(std::size_t size) {
+    if (counting.load(std::memory_order_relaxed)) {
+        heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Не встраивается: иначе GCC видит free() для памяти, полученной через operator new,
+// и предупреждает -Wmismatched-new-delete, хотя обе стороны заменены парой malloc/free.
+[[gnu::noinline]] void deallocate(void* p) noexcept {
+    std::free(p);
+}
+}
+
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    deallocate(p);
+}
+
+void operator delete[](void* p) noexcept {
+    deallocate(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    deallocate(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    deallocate(p);
+}
+
+namespace {
+
+/**
+ * @brief Асинхронный поток, отдающий заранее подготовленные байты.
+ */
+class ScriptedStream {
+public:
+    using executor_type = boost::asio::io_context::executor_type;
+
+    ScriptedStream(boost::asio::io_context& ioc, std::string data) : executor_(ioc.get_executor()), data_(std::move(data)) {}
+
+    executor_type get_executor() { return executor_; }
+
+    template <typename MutableBufferSequence, typename ReadHandler>
+    auto async_read_some(const MutableBufferSequence& buffers, ReadHandler&& handler) {
+        return boost::asio::async_initiate<ReadHandler, void(beast::error_code, std::size_t)>(
+            [this, buffers](auto handler) {
+                beast::error_code ec;
+                std::size_t n = 0;
+                if (pos_ == data_.size()) {
+                    ec = boost::asio::error::eof;
+                } else {
+                    n = boost::asio::buffer_copy(buffers, boost::asio::buffer(data_.data() + pos_, data_.size() - pos_));
+                    pos_ += n;
+                }
+                boost::asio::post(executor_, beast::bind_front_handler(std::move(handler), ec, n));
+            },
+            handler);
+    }
+
+    template <typename ConstBufferSequence, typename WriteHandler>
+    auto async_write_some(const ConstBufferSequence& buffers, WriteHandler&& handler) {
+        return boost::asio::async_initiate<WriteHandler, void(beast::error_code, std::size_t)>(
+            [this, buffers](auto handler) {
+                std::size_t n = boost::asio::buffer_size(buffers);
+                boost::asio::post(executor_, beast::bind_front_handler(std::move(handler), beast::error_code(), n));
+            },
+            handler);
+    }
+
+private:
+    executor_type executor_;
+    std::string data_;
+    std::size_t pos_ = 0;
+};
+
+std::string make_requests(int count) {
+    std::string wire;
+    for (int i = 0; i < count; ++i) {
+        std::string body = "message number " + std::to_string(i) + std::string(i % 200, 'x');
+        wire += "POST / HTTP/1.1\r\nHost: 185.178.45.18\r\nUser-Agent: Boost.Beast\r\nContent-Length: " +
+                std::to_string(body.size()) + "\r\n\r\n" + body;
+    }
+    return wire;
+}
+
+/**
+ * @brief Выполняет корутину до завершения и пробрасывает её исключение.
+ */
+void run(boost::asio::io_context& ioc, boost::asio::awaitable<void> coroutine) {
+    std::exception_ptr failure;
+    boost::asio::co_spawn(ioc, std::move(coroutine), [&](std::exception_ptr error) { failure = error; });
+    ioc.run();
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+} // namespace
+
+TEST(SessionArenaTest, ParsesRequestsAndBodies) {
+    boost::asio::io_context ioc;
+    ScriptedStream stream(ioc, make_requests(3));
+    SessionArena arena;
+
+    run(ioc, [&]() -> boost::asio::awaitable<void> {
+        for (int i = 0; i < 3; ++i) {
+            co_await arena.async_read(stream);
+            arena_request& request = arena.request();
+            EXPECT_EQ(request.target(), "/");
+            EXPECT_EQ(request[http::field::host], "185.178.45.18");
+            EXPECT_EQ(std::string_view(request.body()).substr(0, 16), "message number " + std::to_string(i));
+        }
+    }());
+}
+
+TEST(SessionArenaTest, SteadyStateReadAndResponseMakeNoHeapAllocations) {
+    constexpr int warmup = 256;
+    constexpr int measured = 1000;
+    boost::asio::io_context ioc;
+    ScriptedStream stream(ioc, make_requests(warmup + measured));
+    SessionArena arena;
+    std::size_t written = 0;
+
+    run(ioc, [&]() -> boost::asio::awaitable<void> {
+        for (int i = 0; i < warmup + measured; ++i) {
+            if (i == warmup) {
+                heap_allocations = 0;
+                counting = true;
+            }
+            co_await arena.async_read(stream);
+            arena_request& request = arena.request();
+            arena_response response = arena.make_response(http::status::ok);
+            response.set(http::field::content_type, "text/plain");
+            response.set("X-Log-Offset", "12345");
+            response.body().append("alice: ");
+            response.body().append(request.body());
+            response.prepare_payload();
+            written += response.body().size();
+        }
+        counting = false;
+    }());
+
+    EXPECT_EQ(heap_allocations.load(), 0u);
+    EXPECT_GT(written, 0u);
+}
+
+TEST(SessionArenaTest, BroadcastFrameIsTheOnlyAllocation) {
+    constexpr int warmup = 300;
+    constexpr int measured = 1000;
+    SessionArena arena;
+    std::size_t bytes = 0;
+
+    for (int i = 0; i < warmup + measured; ++i) {
+        if (i == warmup) {
+            heap_allocations = 0;
+            counting = true;
+        }
+        arena_response response = arena.make_response(http::status::ok);
+        response.set(http::field::content_type, "text/plain");
+        response.set("X-Log-Offset", "12345");
+        response.body().append("alice: ").append(std::string_view("message body ")).append(static_cast<std::size_t>(i % 300), 'x');
+        response.prepare_payload();
+        SendQueue::Frame frame = make_frame(response);
+        bytes += frame->size();
+    }
+    counting = false;
+
+    // Кадр - это блок shared_ptr со строкой и буфер строки; сериализация сама кучу не трогает.
+    EXPECT_LE(heap_allocations.load(), 2u * measured);
+    EXPECT_GT(bytes, 0u);
+}
+
+TEST(SessionArenaTest, BroadcastFanOutToBusyWritersMakesNoHeapAllocations) {
+    constexpr int recipients = 64;
+    boost::asio::io_context ioc;
+    ClientRegistry registry;
+    for (int i = 0; i < recipients; ++i) {
+        registry.add({std::make_shared<SendQueue>(boost::asio::make_strand(ioc)), "user" + std::to_string(i), nullptr});
+    }
+    SendQueue::Frame frame = std::make_shared<const std::string>("alice: hello");
+    uint64_t sender = registry.all().front().id;
+
+    // Тот же обход, что write_to_clients_locked: записи получателей заняты, будить их не нужно.
+    heap_allocations = 0;
+    counting = true;
+    std::size_t delivered = 0;
+    for (const auto& client : registry.all()) {
+        if (client.id != sender && client.queue->enqueue(frame)) {
+            ++delivered;
+        }
+    }
+    counting = false;
+
+    EXPECT_EQ(heap_allocations.load(), 0u);
+    EXPECT_EQ(delivered, static_cast<std::size_t>(recipients - 1));
+    EXPECT_EQ(ioc.poll(), 0u);
+}
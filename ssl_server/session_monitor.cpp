@@ -0,0 +1,195 @@
+/**
+ * @file session_monitor.cpp
+ * @brief Реализация монитора сессий.
+ */
+
+#include "session_monitor.h"
+#include <algorithm>
+
+namespace {
+
+using clock_type = TimerWheel::clock;
+
+int64_t to_ns(clock_type::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+clock_type::time_point from_ns(int64_t ns) {
+    return clock_type::time_point(std::chrono::duration_cast<clock_type::duration>(std::chrono::nanoseconds(ns)));
+}
+
+} // namespace
+
+SessionWatch::SessionWatch(Kill kill) : kill_(std::move(kill)) {
+    touch();
+}
+
+void SessionWatch::touch() {
+    last_read_.store(to_ns(clock_type::now()), std::memory_order_relaxed);
+}
+
+void SessionWatch::begin_write() {
+    write_started_.store(to_ns(clock_type::now()), std::memory_order_relaxed);
+}
+
+void SessionWatch::end_write() {
+    write_started_.store(0, std::memory_order_relaxed);
+}
+
+SessionMonitor::SessionMonitor(HeartbeatConfig config)
+    : config_(config),
+      wheel_(config.tick, static_cast<std::size_t>(std::max(config.idle_timeout, config.login_timeout) / config.tick) + 1) {
+    reaper_ = std::thread([this] { reap_loop(); });
+    pinger_ = std::thread([this] { ping_loop(); });
+}
+
+SessionMonitor::~SessionMonitor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    reaper_.join();
+    pinger_.join();
+
+    // Последние ссылки на наблюдения снимают их с колеса под mutex_, поэтому освобождаются без него.
+    std::deque<std::shared_ptr<SessionWatch>> pings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pings.swap(pings_);
+    }
+}
+
+std::shared_ptr<SessionWatch> SessionMonitor::watch(SessionWatch::Kill kill) {
+    std::shared_ptr<SessionWatch> watch(new SessionWatch(std::move(kill)), [this](SessionWatch* w) {
+        release(w);
+        delete w;
+    });
+    std::lock_guard<std::mutex> lock(mutex_);
+    wheel_.arm(*watch, clock_type::now() + config_.login_timeout);
+    return watch;
+}
+
+void SessionMonitor::enable_heartbeat(SessionWatch& watch, SessionWatch::Ping ping) {
+    watch.touch();
+    std::lock_guard<std::mutex> lock(mutex_);
+    watch.ping_ = std::move(ping);
+    watch.ping_sent_ = false;
+    wheel_.arm(watch, clock_type::now() + std::min(config_.idle_timeout, config_.write_timeout));
+}
+
+std::size_t SessionMonitor::watched() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return wheel_.size();
+}
+
+void SessionMonitor::release(SessionWatch* watch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wheel_.cancel(*watch);
+}
+
+// Вызывается под mutex_.
+void SessionMonitor::check(SessionWatch& watch, clock_type::time_point now,
+                           std::vector<std::pair<std::shared_ptr<SessionWatch>, std::string_view>>& kills) {
+    if (!watch.alive()) {
+        return;
+    }
+
+    auto kill = [&](std::string_view reason) {
+        // Если ссылок уже нет, сессия завершается сама.
+        if (auto self = watch.weak_from_this().lock()) {
+            watch.alive_.store(false, std::memory_order_release);
+            kills.emplace_back(std::move(self), reason);
+        }
+    };
+
+    // Запись проверяется не реже раза в write_timeout, поэтому зависшая запись обнаруживается не позже чем через два срока.
+    auto next_write_check = now + config_.write_timeout;
+    int64_t write_started = watch.write_started_.load(std::memory_order_relaxed);
+    if (write_started != 0 && now - from_ns(write_started) >= config_.write_timeout) {
+        kill("write_timeout");
+        return;
+    }
+
+    auto last_read = from_ns(watch.last_read_.load(std::memory_order_relaxed));
+    if (!watch.ping_) {
+        if (now - last_read >= config_.login_timeout) {
+            kill("login_timeout");
+        } else {
+            wheel_.arm(watch, std::min(last_read + config_.login_timeout, next_write_check));
+        }
+        return;
+    }
+
+    // Любые данные от клиента после ping считаются ответом на него.
+    if (watch.ping_sent_ && last_read >= watch.ping_sent_at_) {
+        watch.ping_sent_ = false;
+    }
+
+    if (now - last_read < config_.idle_timeout) {
+        wheel_.arm(watch, std::min(last_read + config_.idle_timeout, next_write_check));
+        return;
+    }
+
+    if (!watch.ping_sent_) {
+        if (auto self = watch.weak_from_this().lock()) {
+            watch.ping_sent_ = true;
+            watch.ping_sent_at_ = now;
+            pings_.push_back(std::move(self));
+            cv_.notify_all();
+        }
+    } else if (now - watch.ping_sent_at_ >= config_.pong_timeout) {
+        kill("heartbeat_timeout");
+        return;
+    }
+    wheel_.arm(watch, std::min(watch.ping_sent_at_ + config_.pong_timeout, next_write_check));
+}
+
+void SessionMonitor::reap_loop() {
+    std::vector<TimerWheel::Entry*> expired;
+    std::vector<std::pair<std::shared_ptr<SessionWatch>, std::string_view>> kills;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, config_.tick, [this] { return stopping_; })) {
+        auto now = clock_type::now();
+        expired.clear();
+        wheel_.advance(now, expired);
+        for (TimerWheel::Entry* entry : expired) {
+            check(static_cast<SessionWatch&>(*entry), now, kills);
+        }
+
+        if (!kills.empty()) {
+            lock.unlock();
+            for (auto& [watch, reason] : kills) {
+                watch->kill_(reason);
+            }
+            kills.clear();
+            lock.lock();
+        }
+    }
+}
+
+void SessionMonitor::ping_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || !pings_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        std::shared_ptr<SessionWatch> watch = std::move(pings_.front());
+        pings_.pop_front();
+        SessionWatch::Ping ping = watch->ping_;
+        lock.unlock();
+
+        if (watch->alive() && ping) {
+            try {
+                ping();
+            } catch (const std::exception&) {
+                // Если запись не удалась, сессию отключит срок ответа на ping.
+            }
+        }
+        ping = nullptr;
+        watch.reset();
+        lock.lock();
+    }
+}
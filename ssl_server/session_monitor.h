@@ -0,0 +1,149 @@
+/**
+ * @file session_monitor.h
+ * @brief Сроки чтения и записи, проверка живости клиентов и отключение зависших соединений.
+ */
+
+#ifndef SESSION_MONITOR_H
+#define SESSION_MONITOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "timer_wheel.h"
+
+/**
+ * @brief Сроки, по которым отключаются клиенты.
+ */
+struct HeartbeatConfig {
+    std::chrono::milliseconds login_timeout{15000}; ///< Срок на запрос входа.
+    std::chrono::milliseconds idle_timeout{30000};  ///< Молчание клиента, после которого отправляется ping.
+    std::chrono::milliseconds pong_timeout{10000};  ///< Срок ответа на ping.
+    std::chrono::milliseconds write_timeout{10000}; ///< Максимальная длительность одной записи клиенту.
+    std::chrono::milliseconds tick{100};            ///< Такт колеса таймеров.
+};
+
+class SessionMonitor;
+
+/**
+ * @brief Наблюдение за одной сессией.
+ *
+ * Поток сессии отмечает чтение и запись атомарными операциями без блокировок;
+ * решения об отправке ping и отключении принимает поток монитора по срабатыванию таймера.
+ */
+class SessionWatch : private TimerWheel::Entry, public std::enable_shared_from_this<SessionWatch> {
+public:
+    /**
+     * @brief Причина отключения: "login_timeout", "heartbeat_timeout" или "write_timeout".
+     */
+    using Kill = std::function<void(std::string_view reason)>;
+
+    /**
+     * @brief Отправляет клиенту ping.
+     */
+    using Ping = std::function<void()>;
+
+    /**
+     * @brief Отмечает запись клиенту на время жизни объекта.
+     */
+    class WriteScope {
+    public:
+        explicit WriteScope(SessionWatch& watch) : watch_(watch) { watch_.begin_write(); }
+        ~WriteScope() { watch_.end_write(); }
+        WriteScope(const WriteScope&) = delete;
+        WriteScope& operator=(const WriteScope&) = delete;
+
+    private:
+        SessionWatch& watch_;
+    };
+
+    /**
+     * @brief Отмечает, что от клиента пришли данные.
+     */
+    void touch();
+
+    void begin_write();
+    void end_write();
+
+    /**
+     * @brief Ложь, если соединение признано мёртвым; писать в него больше не нужно.
+     */
+    bool alive() const { return alive_.load(std::memory_order_acquire); }
+
+private:
+    friend class SessionMonitor;
+
+    Kill kill_;
+    Ping ping_;                                  ///< Задаётся после входа, под мьютексом монитора.
+    std::atomic<int64_t> last_read_{0};          ///< Время последнего чтения, нс steady_clock.
+    std::atomic<int64_t> write_started_{0};      ///< Начало текущей записи, 0 если записи нет.
+    std::atomic<bool> alive_{true};
+    bool ping_sent_ = false;                     ///< Только поток монитора.
+    std::chrono::steady_clock::time_point ping_sent_at_;  ///< Только поток монитора.
+
+    explicit SessionWatch(Kill kill);
+};
+
+/**
+ * @brief Монитор сессий: колесо таймеров, поток-жнец и поток отправки ping.
+ *
+ * Таймер каждой сессии переставляется только при срабатывании, поэтому чтение и запись
+ * не обращаются к колесу. Ping пишется отдельным потоком, чтобы запись в зависший сокет
+ * не остановила проверку остальных сессий.
+ */
+class SessionMonitor {
+public:
+    explicit SessionMonitor(HeartbeatConfig config = {});
+
+    /**
+     * @brief Останавливает потоки монитора.
+     */
+    ~SessionMonitor();
+
+    SessionMonitor(const SessionMonitor&) = delete;
+    SessionMonitor& operator=(const SessionMonitor&) = delete;
+
+    /**
+     * @brief Начинает наблюдение за сессией; до вызова enable_heartbeat действует срок входа.
+     * @param kill Закрывает соединение; вызывается из потока монитора не более одного раза.
+     * @return Наблюдение; наблюдение снимается при уничтожении последней ссылки.
+     */
+    std::shared_ptr<SessionWatch> watch(SessionWatch::Kill kill);
+
+    /**
+     * @brief Переводит сессию на проверку живости через ping/pong.
+     * @param watch Наблюдение за сессией.
+     * @param ping Отправляет клиенту ping.
+     */
+    void enable_heartbeat(SessionWatch& watch, SessionWatch::Ping ping);
+
+    /**
+     * @brief Число наблюдаемых сессий.
+     */
+    std::size_t watched() const;
+
+private:
+    HeartbeatConfig config_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    TimerWheel wheel_;
+    std::deque<std::shared_ptr<SessionWatch>> pings_;
+    bool stopping_ = false;
+    std::thread reaper_;
+    std::thread pinger_;
+
+    void release(SessionWatch* watch);
+    void reap_loop();
+    void ping_loop();
+    void check(SessionWatch& watch, TimerWheel::clock::time_point now,
+               std::vector<std::pair<std::shared_ptr<SessionWatch>, std::string_view>>& kills);
+};
+
+#endif // SESSION_MONITOR_H
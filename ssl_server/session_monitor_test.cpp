@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include "session_monitor.h"
+#include <atomic>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+HeartbeatConfig fast_config() {
+    HeartbeatConfig config;
+    config.login_timeout = 100ms;
+    config.idle_timeout = 100ms;
+    config.pong_timeout = 100ms;
+    config.write_timeout = 100ms;
+    config.tick = 5ms;
+    return config;
+}
+
+/**
+ * @brief Запоминает причину отключения.
+ */
+struct KillRecorder {
+    std::mutex mutex;
+    std::string reason;
+    std::atomic<int> calls{0};
+
+    SessionWatch::Kill callback() {
+        return [this](std::string_view r) {
+            std::lock_guard<std::mutex> lock(mutex);
+            reason = std::string(r);
+            ++calls;
+        };
+    }
+
+    bool wait_for_kill(std::chrono::milliseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (calls == 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(5ms);
+        }
+        return calls > 0;
+    }
+};
+
+} // namespace
+
+TEST(SessionMonitorTest, KillsSessionsThatNeverLogIn) {
+    SessionMonitor monitor(fast_config());
+    KillRecorder killed;
+    auto watch = monitor.watch(killed.callback());
+
+    ASSERT_TRUE(killed.wait_for_kill(1s));
+    EXPECT_EQ(killed.reason, "login_timeout");
+    EXPECT_FALSE(watch->alive());
+    EXPECT_EQ(killed.calls, 1);
+}
+
+TEST(SessionMonitorTest, AnsweredPingsKeepSessionAlive) {
+    SessionMonitor monitor(fast_config());
+    KillRecorder killed;
+    std::atomic<int> pings{0};
+    auto watch = monitor.watch(killed.callback());
+    SessionWatch* raw = watch.get();
+    monitor.enable_heartbeat(*watch, [&pings, raw] {
+        ++pings;
+        raw->touch(); // клиент сразу отвечает pong
+    });
+
+    std::this_thread::sleep_for(500ms);
+    EXPECT_EQ(killed.calls, 0);
+    EXPECT_GE(pings.load(), 2);
+    EXPECT_TRUE(watch->alive());
+}
+
+TEST(SessionMonitorTest, KillsSessionsThatMissPong) {
+    SessionMonitor monitor(fast_config());
+    KillRecorder killed;
+    std::atomic<int> pings{0};
+    auto watch = monitor.watch(killed.callback());
+    monitor.enable_heartbeat(*watch, [&pings] { ++pings; });
+
+    ASSERT_TRUE(killed.wait_for_kill(1s));
+    EXPECT_EQ(killed.reason, "heartbeat_timeout");
+    EXPECT_EQ(pings.load(), 1);
+}
+
+TEST(SessionMonitorTest, KillsStuckWrites) {
+    SessionMonitor monitor(fast_config());
+    KillRecorder killed;
+    auto watch = monitor.watch(killed.callback());
+    SessionWatch* raw = watch.get();
+    monitor.enable_heartbeat(*watch, [raw] { raw->touch(); });
+
+    watch->begin_write();
+    ASSERT_TRUE(killed.wait_for_kill(1s));
+    EXPECT_EQ(killed.reason, "write_timeout");
+}
+
+TEST(SessionMonitorTest, ReleasesWatchesWithLastReference) {
+    SessionMonitor monitor(fast_config());
+    KillRecorder killed;
+    {
+        auto watch = monitor.watch(killed.callback());
+        EXPECT_EQ(monitor.watched(), 1u);
+    }
+    EXPECT_EQ(monitor.watched(), 0u);
+    std::this_thread::sleep_for(200ms);
+    EXPECT_EQ(killed.calls, 0);
+}
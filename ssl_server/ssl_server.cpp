@@ -3,12 +3,13 @@
  * @brief Реализация серверной части SSL-чата с использованием Boost.Asio и Boost.Beast.
  */
 
+#include <utility> // Boost 1.74 использует std::exchange в awaitable.hpp, не подключая <utility>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/asio.hpp>
-#include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <mutex>
@@ -17,7 +18,31 @@
 #include <algorithm>
 #include <pqxx/pqxx>
 #include <stdexcept>
+#include <atomic>
+#include <charconv>
+#include <optional>
+#include <random>
+#include <csignal>
+#include <cstring>
+#include <cctype>
 #include "scipher.h"
+#include "message_log.h"
+#include "auth_service.h"
+#include "password_hasher.h"
+#include "session_arena.h"
+#include "metrics.h"
+#include "metrics_server.h"
+#include "logger.h"
+#include "compression.h"
+#include "search_index.h"
+#include "async_database.h"
+#include "send_queue.h"
+#include "ktls_stream.h"
+#include "handoff.h"
+#include "tls_context.h"
+#include "cluster_bus.h"
+#include "blob_store.h"
+#include "traffic_trace.h"
 #include "ssl_server.h"
 
 namespace beast = boost::beast;
@@ -26,162 +51,1373 @@ namespace asio = boost::asio;
 namespace ip = asio::ip;
 namespace ssl = asio::ssl;
 
-DatabaseManager db("host=hse-server.tw1.ru dbname=chat_db user=main password=w^fw&*U267");
-std::vector<Client> clients;
+namespace {
+
+const char* const kDatabaseConnection = "host=hse-server.tw1.ru dbname=chat_db user=main password=w^fw&*U267";
+
+// Отказ в сообщении после передачи сокета: журнал уже у нового процесса.
+constexpr std::string_view kRestartNotice = "[!]\tСообщение не доставлено: сервер перезапускается, отправьте его после переподключения.";
+
+} // namespace
+
+asio::io_context ioc;
+asio::thread_pool blocking_pool(4);
+asio::thread_pool blob_pool(2);
+DatabaseManager db(kDatabaseConnection);
+AsyncDatabase async_db(ioc, kDatabaseConnection);
+HashWorkerPool hash_pool(std::max(1u, std::thread::hardware_concurrency() / 2), 64);
+AuthService auth(db, hash_pool, blocking_pool);
+std::unique_ptr<MessageLog> message_log;
+SearchIndex search_index;
+ClientRegistry clients;
 std::mutex clients_mutex;
+std::unique_ptr<BlobStore> blobs;
+
+namespace {
+
+// Рассылки, ожидающие clients_mutex.
+std::atomic<std::size_t> broadcast_backlog{0};
+
+// Клиенты, согласовавшие сжатие.
+std::atomic<std::size_t> compressing_clients{0};
+
+// Слушающий сокет передан новому процессу: сессии разгружаются.
+std::atomic<bool> draining{false};
+
+// Связь с другими узлами; пуста, если сервер работает один.
+std::unique_ptr<BrokerBus> cluster;
+
+// Трасса входящего трафика; пуста, если запись не включена.
+std::unique_ptr<TraceWriter> capture;
+
+// Ограничение частоты входов по всему серверу.
+std::mutex login_mutex;
+TokenBucket login_bucket(kLoginRateLimit);
+std::atomic<std::size_t> logins_pending{0}; // Входы и регистрации, ждущие базу или пул хеширования.
+
+} // namespace
+
+UserRateLimiter user_rate_limiter(kUserRateLimit);
+SessionMonitor session_monitor;
+DeflateCodec codec;
+PresenceTracker presence(broadcast_presence);
+AdmissionController admission([] { return SendQueue::total_bytes(); }, kMaxQueuedSendBytes,
+                              [] { return db.backlog() + async_db.in_flight(); }, 128);
+
+namespace {
+
+MetricsRegistry& metrics = MetricsRegistry::instance();
+Logger& logger = Logger::instance();
+Counter& accepts_total = metrics.counter("chat_accepts_total", "Accepted TCP connections");
+Counter& handshakes_total = metrics.counter("chat_handshakes_total", "Completed TLS handshakes");
+Counter& handshake_failures_total = metrics.counter("chat_handshake_failures_total", "Failed TLS handshakes");
+Counter& ktls_send_total = metrics.counter("chat_ktls_send_offloaded_total", "Sessions whose record encryption moved to the kernel");
+Counter& ktls_fallback_total = metrics.counter("chat_ktls_fallback_total", "kTLS sessions left with user-space encryption (kernel or cipher unsupported)");
+Gauge& active_sessions = metrics.gauge("chat_active_sessions", "Logged in sessions");
+Counter& messages_in_total = metrics.counter("chat_messages_in_total", "Chat messages received from clients");
+Counter& messages_out_total = metrics.counter("chat_messages_out_total", "Responses written to clients by broadcasts");
+Counter& writes_total = metrics.counter("chat_writes_total", "Batched socket writes by session writers");
+Counter& send_failures_total = metrics.counter("chat_send_failures_total", "Failed writes and frames dropped by overflowing send queues");
+Histogram& broadcast_seconds = metrics.histogram("chat_broadcast_seconds", "Broadcast fan-out time", latency_buckets());
+Counter& messages_delayed_total = metrics.counter("chat_messages_delayed_total", "Messages delayed by the per-connection rate limit");
+Counter& messages_dropped_rate_total = metrics.counter("chat_messages_dropped_rate_total", "Messages dropped by the per-user rate limit");
+Counter& messages_dropped_overload_total = metrics.counter("chat_messages_dropped_overload_total", "Messages shed by admission control");
+Counter& sessions_reaped_total = metrics.counter("chat_sessions_reaped_total", "Connections closed by read, write or heartbeat deadlines");
+Counter& pings_total = metrics.counter("chat_pings_total", "Heartbeat pings sent");
+Counter& presence_batches_total = metrics.counter("chat_presence_batches_total", "Coalesced presence updates broadcast");
+Counter& db_insert_failures_total = metrics.counter("chat_db_insert_failures_total", "Messages the database failed to store");
+Counter& direct_messages_total = metrics.counter("chat_direct_messages_total", "Direct messages delivered to at least one session of the recipient");
+Counter& direct_messages_offline_total = metrics.counter("chat_direct_messages_offline_total", "Direct messages to users with no active session");
+Counter& cluster_out_total = metrics.counter("chat_cluster_published_total", "Messages published to other cluster nodes");
+Counter& cluster_in_total = metrics.counter("chat_cluster_delivered_total", "Messages from other cluster nodes delivered to local sessions");
+Counter& acks_total = metrics.counter("chat_acks_total", "Sequence acknowledgements received from clients");
+Histogram& send_delay_control_seconds = metrics.histogram("chat_send_delay_control_seconds", "Time control frames wait in session send queues", latency_buckets());
+Histogram& send_delay_chat_seconds = metrics.histogram("chat_send_delay_chat_seconds", "Time chat frames wait in session send queues", latency_buckets());
+Histogram& send_delay_bulk_seconds = metrics.histogram("chat_send_delay_bulk_seconds", "Time history and search frames wait in session send queues", latency_buckets());
+Histogram& search_seconds = metrics.histogram("chat_search_seconds", "Full-text search latency", latency_buckets());
+Counter& history_records_total = metrics.counter("chat_history_records_total", "Log records replayed to logging in clients");
+Counter& logins_throttled_total = metrics.counter("chat_logins_throttled_total", "Logins refused by the server-wide login rate limit");
+Counter& attachment_bytes_in_total = metrics.counter("chat_attachment_bytes_in_total", "Attachment bytes received from clients");
+Counter& attachment_bytes_out_total = metrics.counter("chat_attachment_bytes_out_total", "Attachment bytes sent to clients");
+Counter& attachments_stored_total = metrics.counter("chat_attachments_stored_total", "Attachments fully uploaded and verified");
+Counter& sessions_drained_total = metrics.counter("chat_sessions_drained_total", "Sessions asked to reconnect to the new process after a handoff");
+
+/**
+ * @brief Журналирует исключение, вылетевшее из корутины, вместо того чтобы остановить цикл событий.
+ */
+void log_coroutine_exception(std::exception_ptr error) {
+    if (!error) {
+        return;
+    }
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::exception& e) {
+        logger.log(LogLevel::error, "coroutine_failed", {{"error", e.what()}});
+    }
+}
+
+/**
+ * @brief Выполняет блокирующий вызов в пуле pool; корутина продолжается в своём strand.
+ */
+template <typename Function>
+asio::awaitable<std::invoke_result_t<Function>> offload(Function function, asio::thread_pool& pool = blocking_pool) {
+    co_return co_await asio::co_spawn(pool, [function = std::move(function)]() mutable
+            -> asio::awaitable<std::invoke_result_t<Function>> { co_return function(); }, asio::use_awaitable);
+}
+
+/**
+ * @brief Забирает токен из общего ведра входов.
+ */
+bool admit_login() {
+    std::lock_guard<std::mutex> lock(login_mutex);
+    return login_bucket.try_take();
+}
+
+/**
+ * @brief Место среди входов и регистраций, ждущих базу или пул хеширования; освобождается деструктором.
+ *
+ * Ведро входов ограничивает частоту, а это место - число одновременно ждущих: при медленной
+ * базе входы не копятся в очереди blocking_pool без предела, а получают 503.
+ */
+class PendingLogin {
+public:
+    PendingLogin() : admitted_(logins_pending.fetch_add(1, std::memory_order_relaxed) < kMaxPendingLogins) {}
+    ~PendingLogin() { logins_pending.fetch_sub(1, std::memory_order_relaxed); }
+    PendingLogin(const PendingLogin&) = delete;
+    PendingLogin& operator=(const PendingLogin&) = delete;
+
+    explicit operator bool() const { return admitted_; }
+
+private:
+    bool admitted_;
+};
+
+/**
+ * @brief Забирает токен ведра соединения, сначала дождавшись его, если ведро пусто.
+ *
+ * Пока сессия ждёт, она не читает, и слишком частый клиент упирается в окно TCP.
+ * @return Истина, если пришлось ждать.
+ */
+asio::awaitable<bool> take_token(TokenBucket& bucket, asio::steady_timer& delay) {
+    bool delayed = false;
+    if (auto wait = bucket.wait_time(); wait != TokenBucket::clock::duration::zero()) {
+        delay.expires_after(wait);
+        co_await delay.async_wait(asio::use_awaitable);
+        delayed = true;
+    }
+    bucket.try_take();
+    co_return delayed;
+}
+
+/**
+ * @brief Записывает время ожидания кадра в очереди сессии в гистограмму его полосы.
+ */
+void observe_send_delay(SendQueue::Lane lane, std::chrono::steady_clock::duration delay) {
+    Histogram& histogram = lane == SendQueue::Lane::control ? send_delay_control_seconds
+                           : lane == SendQueue::Lane::chat  ? send_delay_chat_seconds
+                                                            : send_delay_bulk_seconds;
+    histogram.observe(std::chrono::duration<double>(delay).count());
+}
+
+/**
+ * @brief Задержка переподключения для разгружаемой сессии, равномерно в пределах kDrainSpread.
+ */
+std::chrono::milliseconds drain_delay() {
+    thread_local std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<long> spread(0, std::chrono::duration_cast<std::chrono::milliseconds>(kDrainSpread).count());
+    return std::chrono::milliseconds(spread(rng));
+}
+
+/**
+ * @brief Просит клиента переподключиться и закрывает его очередь после уже поставленных кадров.
+ */
+void drain_session(SendQueue& queue) {
+    send_reconnect(queue, drain_delay());
+    queue.finish();
+    sessions_drained_total.inc();
+}
+
+/**
+ * @brief Разгружает сессии после передачи слушающего сокета и останавливает цикл событий,
+ * когда они закончатся или выйдет kDrainTimeout.
+ */
+asio::awaitable<void> drain_sessions() {
+    std::vector<std::shared_ptr<SendQueue>> queues;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        for (const auto& client : clients.all()) {
+            queues.push_back(client.queue);
+        }
+    }
+    logger.log(LogLevel::info, "drain_started", {{"sessions", queues.size()}});
+    for (const auto& queue : queues) {
+        drain_session(*queue);
+    }
+
+    asio::steady_timer timer(ioc);
+    auto deadline = std::chrono::steady_clock::now() + kDrainTimeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            if (clients.empty()) {
+                break;
+            }
+        }
+        timer.expires_after(std::chrono::milliseconds(100));
+        co_await timer.async_wait(asio::use_awaitable);
+    }
+    logger.log(LogLevel::info, "drain_finished", {});
+    logger.flush();
+    ioc.stop();
+}
+
+/**
+ * @brief Перечитывает сертификат и ключ по SIGHUP.
+ */
+asio::awaitable<void> reload_on_hangup(asio::signal_set& signals, ServerTlsContext& tls) {
+    while (true) {
+        co_await signals.async_wait(asio::use_awaitable);
+        try {
+            tls.reload();
+            logger.log(LogLevel::info, "certificate_reloaded", {});
+        } catch (const std::exception& e) {
+            logger.log(LogLevel::error, "certificate_reload_failed", {{"error", e.what()}});
+        }
+    }
+}
+
+/**
+ * @brief Открывает эндпоинт метрик; после передачи сокета порт освобождается старым процессом не сразу.
+ */
+void start_metrics_server(std::optional<MetricsServer>& server, unsigned short port) {
+    for (int attempt = 0;; ++attempt) {
+        try {
+            server.emplace(metrics, "127.0.0.1", port);
+            server->handle("/log", [](std::string_view query) { return apply_log_settings(logger, query); });
+            return;
+        } catch (const boost::system::system_error& e) {
+            if (e.code() != asio::error::address_in_use || attempt == 50) {
+                throw;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
+
+/**
+ * @brief Пишет ответ прямо в сокет; используется до запуска корутины записи.
+ */
+template <typename Stream>
+asio::awaitable<void> write_reply(Stream& socket, http::status status, std::string_view text) {
+    http::response<http::string_body> response(status, 11);
+    response.set(http::field::content_type, "text/plain");
+    response.body() = text;
+    response.prepare_payload();
+    co_await http::async_write(socket, response, asio::use_awaitable);
+}
+
+} // namespace
 
 int main() {
     try {
-        asio::io_context ioc;
-        ssl::context ssl_context(ssl::context::tlsv12_server);
-        ssl_context.use_certificate_chain_file("../server.pem");
-        ssl_context.use_private_key_file("../server.key", ssl::context::pem);
+        // Цикл событий держится, пока жив work: в нём работают и сессии, и клиент базы.
+        auto work = asio::make_work_guard(ioc);
+        // kTLS включается явно: шифрование в ядре меняет путь записи всех сессий.
+        bool kernel_tls = std::getenv(kKernelTlsEnv) != nullptr;
+        if (kernel_tls && !kernel_tls_available()) {
+            logger.log(LogLevel::warn, "ktls_unavailable", {{"reason", "no kernel tls module or OpenSSL without kTLS"}});
+            kernel_tls = false;
+        }
+        // Сертификат перечитывается по SIGHUP без перезапуска.
+        ServerTlsContext tls("../server.pem", "../server.key", kernel_tls);
+        const NodeConfig node = node_config_from_env();
+        // Если работает прежний процесс, слушающий сокет забирается у него: соединения не отвергаются
+        // ни на миг, а прежний процесс разгружает свои сессии.
+        tcp::acceptor acceptor(asio::make_strand(ioc));
+        const std::string handoff_socket = handoff_path(node.handoff_name());
+        if (std::optional<int> inherited = take_listener(handoff_socket, node.identity())) {
+            acceptor.assign(tcp::v4(), *inherited);
+            logger.log(LogLevel::info, "listener_inherited", {});
+        } else {
+            tcp::endpoint endpoint(tcp::v4(), node.port);
+            acceptor.open(endpoint.protocol());
+            acceptor.set_option(asio::socket_base::reuse_address(true));
+            acceptor.bind(endpoint);
+            acceptor.listen();
+        }
+        // Журнал и вложения открываются только после передачи: прежний процесс к этому времени закрыл журнал,
+        // а блокировка каталога не даст открыть его двум процессам сразу.
+        message_log = std::make_unique<MessageLog>(node.log_dir);
+        blobs = std::make_unique<BlobStore>(node.attachment_dir, attachment_chunk_bytes(std::getenv(kAttachmentChunkEnv)),
+                                            kMaxAttachmentBytes, kAttachmentStoreBytes, kPartialUploadTtl);
+        async_db.prepare("insert_message", "INSERT INTO messages (name, message) VALUES ($1, $2)");
+        // Сообщения из удалённых по сроку хранения сегментов уходят и из поискового индекса.
+        message_log->on_retention([](uint64_t first_offset) { search_index.remove_before(first_offset); });
+        import_history_from_db();
+        train_compression_dictionary();
+        build_search_index();
 
-        tcp::acceptor acceptor(ioc, {tcp::v4(), 3202});
-        while (true) {
-            auto socket = std::make_shared<ssl_socket>(ioc, ssl_context);
-            acceptor.accept(socket->next_layer());
-            socket->handshake(ssl::stream_base::server);
-            std::thread(&handle_session, socket).detach();
+        metrics.gauge_callback("chat_logins_pending", "Logins and registrations waiting for the database or the hash pool",
+                               [] { return static_cast<double>(logins_pending.load(std::memory_order_relaxed)); });
+        metrics.gauge_callback("chat_hash_queue_depth", "Password hashing tasks waiting for a worker",
+                               [] { return static_cast<double>(hash_pool.queue_depth()); });
+        metrics.gauge_callback("chat_send_queue_depth", "Frames waiting in session send queues",
+                               [] { return static_cast<double>(SendQueue::total_frames()); });
+        metrics.gauge_callback("chat_send_queue_bytes", "Bytes waiting in session send queues",
+                               [] { return static_cast<double>(SendQueue::total_bytes()); });
+        metrics.gauge_callback("chat_broadcast_backlog", "Broadcasts waiting for the clients lock",
+                               [] { return static_cast<double>(broadcast_backlog.load(std::memory_order_relaxed)); });
+        metrics.gauge_callback("chat_db_backlog", "Database queries waiting for or holding the connection",
+                               [] { return static_cast<double>(db.backlog()); });
+        metrics.gauge_callback("chat_db_async_in_flight", "Queries in the async database pipeline",
+                               [] { return static_cast<double>(async_db.in_flight()); });
+        metrics.gauge_callback("chat_watched_sessions", "Sessions tracked by the heartbeat monitor",
+                               [] { return static_cast<double>(session_monitor.watched()); });
+        metrics.gauge_callback("chat_online_users", "Distinct users online",
+                               [] { return static_cast<double>(presence.online()); });
+        metrics.gauge_callback("chat_attachment_store_bytes", "Bytes of stored and partial attachments",
+                               [] { return static_cast<double>(blobs->used_bytes()); });
+        metrics.gauge_callback("chat_search_indexed", "Messages in the full-text index",
+                               [] { return static_cast<double>(search_index.documents()); });
+        metrics.gauge_callback("chat_log_dropped", "Log entries dropped because a thread buffer was full",
+                               [] { return static_cast<double>(logger.dropped()); });
+
+        std::optional<MetricsServer> metrics_server;
+        start_metrics_server(metrics_server, node.metrics_port);
+
+        // В кластере рассылки и личные сообщения уходят через брокер остальным узлам.
+        if (!node.cluster.empty()) {
+            cluster = std::make_unique<BrokerBus>(ioc, node.cluster, deliver_cluster_batch);
+            cluster->start();
+            logger.log(LogLevel::info, "cluster_joined", {{"broker", node.cluster}, {"node", cluster->node_id()}});
+        }
+
+        // Запись трассы для chat_replay; без разрешения писать текст сообщений в журнал текст заменяется.
+        if (const char* path = std::getenv(kCaptureEnv)) {
+            capture = std::make_unique<TraceWriter>(path, kCaptureMaxBytes);
+            metrics.gauge_callback("chat_capture_bytes", "Bytes recorded to the traffic trace",
+                                   [] { return static_cast<double>(capture->bytes()); });
+            logger.log(LogLevel::info, "capture_started", {{"path", path}});
+        }
+
+        // Перед отправкой сокета процесс перестаёт принимать сообщения и закрывает журнал: новый процесс
+        // откроет его, получив сокет. Флаг ставится под clients_mutex, под которым идут все записи в журнал.
+        auto release_log = [] {
+            {
+                std::lock_guard<std::mutex> lock(clients_mutex);
+                draining = true;
+            }
+            message_log->close();
+            logger.log(LogLevel::info, "message_log_released", {});
+        };
+        ListenerHandoff handoff(handoff_socket, acceptor.native_handle(), node.identity(), release_log, [&acceptor, &metrics_server] {
+            metrics_server.reset();
+            asio::post(acceptor.get_executor(), [&acceptor] {
+                beast::error_code ec;
+                acceptor.close(ec);
+            });
+            asio::co_spawn(ioc, drain_sessions(), log_coroutine_exception);
+        });
+        asio::signal_set hangup(ioc, SIGHUP);
+        asio::co_spawn(ioc, reload_on_hangup(hangup, tls), log_coroutine_exception);
+        asio::co_spawn(acceptor.get_executor(), accept_loop(acceptor, tls, kernel_tls), log_coroutine_exception);
+
+        // Пул потоков по числу ядер; главный поток - один из них.
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < std::max(1u, std::thread::hardware_concurrency()); ++i) {
+            threads.emplace_back([] { ioc.run(); });
+        }
+        ioc.run();
+        for (auto& thread : threads) {
+            thread.join();
         }
     } catch (const std::exception& e) {
-        std::cerr << "Main exception: " << e.what() << std::endl;
+        logger.log(LogLevel::error, "server_failed", {{"error", e.what()}});
+        logger.flush();
         return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
 }
 
-void send_chat_history(const std::shared_ptr<ssl_socket>& socket, const std::string& clientName) {
+void import_history_from_db() {
+    if (!message_log->empty()) {
+        return;
+    }
     auto messages = db.fetch("SELECT name, message FROM messages");
     for (const auto& row : messages) {
         std::string name = row[0].as<std::string>();
-        std::string message = row[1].as<std::string>();
-        std::string full_message = "";
+        message_log->append(name, row[1].as<std::string>(), name.empty(), false);
+    }
+    message_log->flush();
+}
+
+namespace {
 
-        if (name == clientName) {
-            name = "You";
+/**
+ * @brief Заменяет тело ответа сжатым, если сжатие выгодно. Вызывается до prepare_payload().
+ */
+template <typename Response>
+void compress_body(Response& response) {
+    thread_local std::string compressed;
+    const auto& body = response.body();
+    if (codec.compress(std::string_view(body.data(), body.size()), compressed)) {
+        response.body().assign(compressed.data(), compressed.size());
+        response.set(http::field::content_encoding, "deflate");
+    }
+}
+
+} // namespace
+
+asio::awaitable<void> send_chat_history(SendQueue& queue, const std::string& clientName, uint64_t fromOffset,
+                                        uint64_t toOffset, bool compress) {
+    // Записи отправляются пачками по строке на сообщение; пачка покрывает номера с X-Log-From по X-Log-Offset,
+    // включая пропущенные служебные записи, чтобы клиент видел историю без пропусков.
+    http::response<http::string_body> response(http::status::ok, 11);
+    response.set(http::field::content_type, "text/plain");
+    std::string& batch = response.body();
+    bool full = true;
+
+    // Обход журнала прерывается на каждой полной пачке: пока она ждёт места в очереди,
+    // следующая не собирается.
+    while (full) {
+        full = false;
+        uint64_t first_offset = fromOffset;
+        message_log->replay(fromOffset, [&](const LogRecord& record) {
+            // Записи с toOffset клиент получает рассылками: он уже в списке клиентов.
+            if (record.offset >= toOffset) {
+                return false;
+            }
+            fromOffset = record.offset + 1;
+            // Старые служебные записи о входе и выходе не пересылаются: состояние сети приходит снимком присутствия.
+            if (record.system) {
+                return true;
+            }
+            if (!batch.empty()) {
+                batch.push_back('\n');
+            }
+            if (!record.name.empty()) {
+                batch.append(record.name == clientName ? std::string_view("You") : record.name);
+                batch.append(": ");
+            }
+            batch.append(record.text);
+            history_records_total.inc();
+
+            full = batch.size() >= kHistoryBatchBytes;
+            return !full;
+        });
+        // Журнал до toOffset пройден: номера, записи которых удалены по сроку хранения, тоже покрыты.
+        if (!full) {
+            fromOffset = std::max(fromOffset, toOffset);
+        }
+        if (fromOffset <= first_offset) {
+            break;
         }
+        response.erase(http::field::content_encoding);
+        if (compress) {
+            compress_body(response);
+        }
+        response.set("X-Log-From", std::to_string(first_offset));
+        response.set("X-Log-Offset", std::to_string(fromOffset - 1));
+        response.prepare_payload();
+        co_await queue.push(make_frame(response), SendQueue::Lane::bulk);
+        batch.clear();
+    }
+}
 
-        if (name == "") {
-            full_message = message;
-        } else {
-            full_message = name + ": " + message;
+void train_compression_dictionary() {
+    // Словарь строится по последним сообщениям журнала.
+    constexpr uint64_t kSampleRecords = 5000;
+    uint64_t next = message_log->next_offset();
+    std::vector<std::string> texts;
+    message_log->replay(next > kSampleRecords ? next - kSampleRecords : 0, [&](const LogRecord& record) {
+        if (!record.system) {
+            texts.emplace_back(record.text);
         }
+        return true;
+    });
+    std::vector<std::string_view> samples(texts.begin(), texts.end());
+    codec.set_dictionary(train_dictionary(samples));
+}
 
+void build_search_index() {
+    message_log->replay(0, [](const LogRecord& record) {
+        if (!record.system) {
+            search_index.add(record.offset, record.text);
+        }
+        return true;
+    });
+}
+
+asio::awaitable<void> send_search_results(SendQueue& queue, std::string_view query, std::size_t page) {
+    if (query.size() > kMaxSearchQueryBytes || page > kMaxSearchPage) {
+        send_notice(queue, "[!]\tПоиск не выполнен: слишком длинный запрос или далёкая страница.");
+        co_return;
+    }
+    SendQueue::Frame frame = co_await offload([query, page] {
+        SearchResult result;
         http::response<http::string_body> response(http::status::ok, 11);
         response.set(http::field::content_type, "text/plain");
-        response.body() = full_message;
+        {
+            ScopedTimer timer(search_seconds);
+            result = search_index.search(query, page, kSearchPageSize);
+        }
+        // Строка результата: "смещение имя: текст"; переводы строк в тексте заменяются пробелами.
+        std::string& body = response.body();
+        for (const SearchHit& hit : result.hits) {
+            message_log->replay(hit.offset, [&](const LogRecord& record) {
+                if (record.offset != hit.offset) {
+                    return false; // Сегмент уже удалён по сроку хранения
+                }
+                std::size_t start = body.size();
+                body.append(std::to_string(record.offset)).append(" ").append(record.name).append(": ").append(record.text);
+                std::replace(body.begin() + static_cast<std::ptrdiff_t>(start), body.end(), '\n', ' ');
+                body.push_back('\n');
+                return false;
+            });
+        }
+        response.set("X-Search", "results");
+        response.set("X-Search-Total", std::to_string(result.total));
+        response.set("X-Search-Page", std::to_string(page));
         response.prepare_payload();
-        http::write(*socket, response);
+        return make_frame(response);
+    });
+    queue.enqueue(std::move(frame), SendQueue::Lane::bulk);
+}
+
+std::size_t attachment_chunk_bytes(const char* value) {
+    std::size_t bytes = 0;
+    if (!value || std::from_chars(value, value + std::strlen(value), bytes).ec != std::errc()) {
+        return kAttachmentChunkBytes;
+    }
+    return std::clamp<std::size_t>(bytes, 4 * 1024, 1024 * 1024);
+}
+
+std::string NodeConfig::handoff_name() const {
+    return name.empty() ? std::string(kHandoffName) : "ssl_server." + name + ".handoff";
+}
+
+std::string NodeConfig::identity() const {
+    return cluster + "/" + name + "/" + std::to_string(port);
+}
+
+NodeConfig node_config_from_env() {
+    auto port = [](const char* variable, unsigned short fallback) {
+        const char* value = std::getenv(variable);
+        if (!value) {
+            return fallback;
+        }
+        unsigned short parsed = 0;
+        const char* end = value + std::strlen(value);
+        auto [last, ec] = std::from_chars(value, end, parsed);
+        if (ec != std::errc() || last != end || parsed == 0) {
+            throw std::invalid_argument(std::string(variable) + " is not a port: " + value);
+        }
+        return parsed;
+    };
+    auto text = [](const char* variable, const char* fallback) {
+        const char* value = std::getenv(variable);
+        return std::string(value && *value ? value : fallback);
+    };
+
+    NodeConfig node;
+    node.name = text(kNodeEnv, "");
+    bool valid_name = std::all_of(node.name.begin(), node.name.end(), [](unsigned char c) {
+        return std::isalnum(c) || c == '-' || c == '_';
+    });
+    if (!valid_name) {
+        throw std::invalid_argument(std::string(kNodeEnv) + " may contain only letters, digits, '-' and '_': " + node.name);
+    }
+    node.port = port(kPortEnv, node.port);
+    node.metrics_port = port(kMetricsPortEnv, node.metrics_port);
+    node.log_dir = text(kLogDirEnv, node.log_dir.c_str());
+    node.attachment_dir = text(kAttachmentDirEnv, kAttachmentDir);
+    node.cluster = text(kClusterEnv, "");
+    return node;
+}
+
+asio::awaitable<std::string> receive_attachment_chunk(const arena_request& request, SendQueue& queue,
+                                                      std::vector<std::string>& uploads) {
+    auto header = [&](beast::string_view name) {
+        auto value = request[name];
+        return std::string_view(value.data(), value.size());
+    };
+    auto number = [&](beast::string_view name) {
+        uint64_t value = 0;
+        std::string_view text = header(name);
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
+    };
+    std::string id(header("X-Blob"));
+    uint64_t size = number("X-Blob-Size");
+    uint64_t offset = number("X-Blob-Offset");
+    std::string_view chunk(request.body().data(), request.body().size());
+
+    // Каждая незавершённая загрузка держит на диске недогруженный файл: сессия не копит их без предела.
+    auto known = std::find(uploads.begin(), uploads.end(), id);
+    UploadState state{UploadStatus::busy, 0};
+    if (known != uploads.end() || uploads.size() < kMaxSessionUploads) {
+        state = co_await offload([&] { return blobs->append(id, size, offset, chunk); }, blob_pool);
+        known = std::find(uploads.begin(), uploads.end(), id);
+    }
+    if (state.status == UploadStatus::partial && known == uploads.end()) {
+        uploads.push_back(id);
+    } else if ((state.status == UploadStatus::complete || state.status == UploadStatus::rejected) && known != uploads.end()) {
+        uploads.erase(known);
+    }
+    if ((state.status == UploadStatus::partial || state.status == UploadStatus::complete) && !chunk.empty() &&
+        state.stored == offset + chunk.size()) {
+        attachment_bytes_in_total.inc(chunk.size());
+    }
+
+    http::response<http::string_body> response(http::status::ok, 11);
+    response.set(http::field::content_type, "text/plain");
+    response.set("X-Upload", id);
+    response.set("X-Upload-Status", state.status == UploadStatus::complete ? "complete"
+                                    : state.status == UploadStatus::partial ? "partial"
+                                    : state.status == UploadStatus::busy    ? "busy"
+                                                                            : "rejected");
+    response.set("X-Blob-Offset", std::to_string(state.stored));
+    response.set("X-Chunk-Size", std::to_string(blobs->chunk_bytes()));
+    if (state.status == UploadStatus::rejected) {
+        response.body() = "[!]\tФайл не принят: неверный размер или содержимое.";
+    } else if (state.status == UploadStatus::busy) {
+        response.body() = "[!]\tФайл не принят: хранилище заполнено или идёт много загрузок. Повторите позже.";
+    }
+    response.prepare_payload();
+    queue.enqueue(make_frame(response), SendQueue::Lane::control);
+
+    // Завершённая загрузка, как и файл, уже лежащий в хранилище, объявляется в чате обычным сообщением.
+    if (state.status != UploadStatus::complete) {
+        co_return std::string();
+    }
+    if (!chunk.empty()) {
+        attachments_stored_total.inc();
+    }
+    std::string name(header("X-File-Name").substr(0, 255));
+    std::replace_if(name.begin(), name.end(), [](char c) { return c == '\n' || c == '\r' || c == '\t'; }, ' ');
+    co_return "[файл] " + (name.empty() ? std::string("без имени") : name) + " (" + std::to_string(size) + " байт) " + id;
+}
+
+asio::awaitable<void> send_attachment(std::shared_ptr<SendQueue> queue, std::string id, uint64_t offset) {
+    std::optional<uint64_t> size = co_await offload([&] { return blobs->size(id); }, blob_pool);
+    if (!size) {
+        send_notice(*queue, "[!]\tФайл не найден: " + id);
+        co_return;
     }
+    // Часть читается в один буфер и дописывается к заголовку кадра: копия файла целиком не создаётся.
+    std::string chunk;
+    const std::string total = std::to_string(*size);
+    while (offset < *size && !queue->closed()) {
+        if (!co_await offload([&] { return blobs->read(id, offset, chunk); }, blob_pool) || chunk.empty()) {
+            break;
+        }
+        http::response<http::empty_body> header(http::status::ok, 11);
+        header.set(http::field::content_type, "application/octet-stream");
+        header.set("X-Blob", id);
+        header.set("X-Blob-Offset", std::to_string(offset));
+        header.set("X-Blob-Size", total);
+        header.content_length(chunk.size());
+        std::ostringstream out;
+        out << header;
+        auto frame = std::make_shared<std::string>(std::move(out).str());
+        frame->append(chunk);
+        // push ждёт места в очереди: следующая часть читается, только когда клиент принял предыдущие.
+        co_await queue->push(std::move(frame), SendQueue::Lane::bulk);
+        attachment_bytes_out_total.inc(chunk.size());
+        offset += chunk.size();
+    }
+}
+
+void send_compression_dictionary(SendQueue& queue) {
+    http::response<http::string_body> response(http::status::ok, 11);
+    response.set(http::field::content_type, "application/octet-stream");
+    response.set("X-Compression", "deflate");
+    response.set("X-Compression-Dictionary-Id", std::to_string(dictionary_id(codec.dictionary())));
+    response.body() = codec.dictionary();
+    response.prepare_payload();
+    // Словарь уходит служебной полосой: раньше любого сжатого кадра.
+    queue.enqueue(make_frame(response), SendQueue::Lane::control);
 }
 
-void broadcast_message(const std::string& message, const std::string& senderName, const std::string& type) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    for (auto& client : clients) {
-        if (client.name != senderName) {
-            http::response<http::string_body> response(http::status::ok, 11);
-            response.set(http::field::server, "Boost.Beast");
-            response.set(http::field::content_type, "text/plain");
-            response.keep_alive(true);
+namespace {
+
+/**
+ * @brief Захватывает clients_mutex, учитывая ожидающих в очереди рассылок.
+ */
+std::unique_lock<std::mutex> lock_clients() {
+    broadcast_backlog.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(clients_mutex);
+    broadcast_backlog.fetch_sub(1, std::memory_order_relaxed);
+    return lock;
+}
 
-            if (type == "connect") {
-                response.body() = "[+]\tNew client '" + senderName + "' connected.";
-            } else if (type == "disconnect") {
-                response.body() = "[-]\tClient '" + senderName + "' disconnected.";
-            } else if (type == "common") {
-                response.body() = senderName + ": " + message;
+/**
+ * @brief Кладёт кадр в очередь клиента. Вызывается под clients_mutex.
+ *
+ * Соединения, признанные мёртвыми, пропускаются: их сессии уже завершаются. Очередь клиента,
+ * который не успевает читать, закрывается, и его сессия завершается.
+ * @return Ложь, если кадр не поставлен в очередь.
+ */
+bool write_to_client_locked(const Client& client, const SendQueue::Frame& frame, SendQueue::Lane lane = SendQueue::Lane::chat) {
+    if (!client.watch->alive()) {
+        return false;
+    }
+    if (!client.queue->enqueue(frame, lane)) {
+        send_failures_total.inc();
+        logger.log(LogLevel::warn, "send_queue_overflow", {{"user", client.name}});
+        return false;
+    }
+    messages_out_total.inc();
+    return true;
+}
+
+/**
+ * @brief Кладёт готовый кадр в очереди всех клиентов, кроме сессии exceptId. Вызывается под clients_mutex.
+ *
+ * Клиенты, согласовавшие сжатие, получают compressed, если он передан.
+ */
+void write_to_clients_locked(const SendQueue::Frame& frame, const SendQueue::Frame& compressed, uint64_t exceptId,
+                             SendQueue::Lane lane = SendQueue::Lane::chat) {
+    ScopedTimer timer(broadcast_seconds);
+    for (const auto& client : clients.all()) {
+        if (client.id != exceptId) {
+            write_to_client_locked(client, client.compress && compressed ? compressed : frame, lane);
+        }
+    }
+}
+
+void write_to_clients(const SendQueue::Frame& frame, const SendQueue::Frame& compressed, uint64_t exceptId,
+                      SendQueue::Lane lane = SendQueue::Lane::chat) {
+    auto lock = lock_clients();
+    write_to_clients_locked(frame, compressed, exceptId, lane);
+}
+
+/**
+ * @brief Сообщение чата, готовое к рассылке: ответ и его сжатая копия.
+ */
+struct ChatFrames {
+    arena_response response;
+    std::optional<arena_response> compressed;
+};
+
+ChatFrames make_chat_frames(SessionArena& arena, std::string_view message, std::string_view senderName) {
+    ChatFrames chat{arena.make_response(http::status::ok), std::nullopt};
+    arena_response& response = chat.response;
+    response.set(http::field::server, "Boost.Beast");
+    response.set(http::field::content_type, "text/plain");
+    response.keep_alive(true);
+    response.body().append(senderName).append(": ").append(message);
+
+    // Сжатая копия готовится один раз, только если её есть кому отправить и сообщение длиннее порога.
+    if (compressing_clients.load(std::memory_order_relaxed) > 0 && response.body().size() >= codec.threshold()) {
+        chat.compressed.emplace(response);
+        compress_body(*chat.compressed);
+        chat.compressed->prepare_payload();
+    }
+    response.prepare_payload();
+    return chat;
+}
+
+/**
+ * @brief Назначает сообщению номер журнала и кладёт его в очереди клиентов узла, кроме сессии exceptId.
+ *
+ * Вызывается под clients_mutex: каждый клиент получает сообщения строго по возрастанию номеров.
+ * @return Номер сообщения.
+ */
+uint64_t log_and_fan_out_locked(ChatFrames& chat, std::string_view message, const std::string& senderName, uint64_t exceptId) {
+    // Сброс на диск под мьютексом не ждём: он сериализовал бы все рассылки и не дал бы группировать записи.
+    uint64_t seq = message_log->append(senderName, message, false, false);
+    char seq_text[24];
+    auto seq_end = std::to_chars(std::begin(seq_text), std::end(seq_text), seq).ptr;
+    beast::string_view seq_value(seq_text, seq_end - seq_text);
+    chat.response.set("X-Log-Offset", seq_value);
+    if (chat.compressed) {
+        chat.compressed->set("X-Log-Offset", seq_value);
+    }
+    write_to_clients_locked(make_frame(chat.response), chat.compressed ? make_frame(*chat.compressed) : nullptr, exceptId);
+    return seq;
+}
+
+/**
+ * @brief Отправляет отправителю номер его сообщения (заголовок X-Ack).
+ */
+void send_ack(SendQueue& queue, const std::string& name, uint64_t seq) {
+    http::response<http::empty_body> ack(http::status::ok, 11);
+    ack.set("X-Ack", std::to_string(seq));
+    ack.prepare_payload();
+    if (!queue.enqueue(make_frame(ack), SendQueue::Lane::control)) {
+        send_failures_total.inc();
+        logger.log(LogLevel::warn, "send_queue_overflow", {{"user", name}});
+    }
+}
+
+SendQueue::Frame make_direct_frame(std::string_view senderName, std::string_view recipient, std::string_view text) {
+    http::response<http::string_body> response(http::status::ok, 11);
+    response.set(http::field::content_type, "text/plain");
+    response.set("X-Direct", beast::string_view(senderName.data(), senderName.size()));
+    response.body().append("[ЛС] ").append(senderName).append(" -> ").append(recipient).append(": ").append(text);
+    response.prepare_payload();
+    return make_frame(response);
+}
+
+/**
+ * @brief Кладёт личное сообщение в очереди сессий получателя и других сессий отправителя, кроме exceptId.
+ *
+ * Вызывается под clients_mutex. Сессии находятся по индексу имён.
+ * @return Число сессий получателя, получивших сообщение.
+ */
+std::size_t deliver_direct_locked(const SendQueue::Frame& frame, std::string_view recipient, std::string_view senderName,
+                                  uint64_t exceptId) {
+    std::size_t delivered = 0;
+    clients.for_each_session(recipient, [&](const Client& client) {
+        if (client.id != exceptId && write_to_client_locked(client, frame)) {
+            ++delivered;
+        }
+    });
+    if (recipient != senderName) {
+        clients.for_each_session(senderName, [&](const Client& client) {
+            if (client.id != exceptId) {
+                write_to_client_locked(client, frame);
             }
+        });
+    }
+    return delivered;
+}
+
+} // namespace
 
-            response.prepare_payload();
+std::optional<uint64_t> broadcast_message(std::string_view message, const Client& sender, bool echo) {
+    // Ответ собирается один раз в пуле потока отправителя и сериализуется в кадр, общий для всех получателей.
+    thread_local SessionArena broadcast_arena;
+    ChatFrames chat = make_chat_frames(broadcast_arena, message, sender.name);
 
-            try {
-                http::write(*client.socket, response);
-            } catch (const std::exception& e) {
-                std::cerr << "Failed to send message: " << e.what() << std::endl;
+    // Номер назначается под тем же мьютексом, под которым пишется рассылка: клиенты получают номера по порядку.
+    uint64_t seq = 0;
+    {
+        auto lock = lock_clients();
+        // Журнал отпущен новому процессу (draining ставится под этим же мьютексом).
+        if (draining) {
+            return std::nullopt;
+        }
+        seq = log_and_fan_out_locked(chat, message, sender.name, echo ? 0 : sender.id);
+    }
+
+    // Отправитель не получает своё сообщение, только его номер. Подтверждение означает, что сообщение
+    // на диске, и уходит из потока сброса журнала: ни мьютекс, ни поток цикла событий сброса не ждут.
+    if (!echo) {
+        message_log->when_durable(seq, [queue = sender.queue, name = sender.name, seq] { send_ack(*queue, name, seq); });
+    }
+
+    search_index.add(seq, message);
+    if (cluster) {
+        cluster->publish(ClusterKind::chat, sender.name, message);
+        cluster_out_total.inc();
+    }
+    return seq;
+}
+
+std::size_t send_direct_message(std::string_view body, const Client& sender) {
+    auto space = body.find(' ');
+    std::string_view recipient = body.substr(0, space);
+    std::string_view text = space == std::string_view::npos ? std::string_view() : body.substr(space + 1);
+    if (recipient.empty() || text.empty()) {
+        send_notice(*sender.queue, "[!]\tЛичное сообщение: /dm имя текст");
+        return 0;
+    }
+
+    SendQueue::Frame frame = make_direct_frame(sender.name, recipient, text);
+    std::size_t delivered = 0;
+    {
+        auto lock = lock_clients();
+        delivered = deliver_direct_locked(frame, recipient, sender.name, sender.id);
+    }
+    // Сессии получателя и другие устройства отправителя могут быть и на других узлах.
+    if (cluster) {
+        cluster->publish(ClusterKind::direct, sender.name, body);
+        cluster_out_total.inc();
+    } else if (delivered == 0) {
+        direct_messages_offline_total.inc();
+        send_notice(*sender.queue, "[!]\tСообщение не доставлено: " + std::string(recipient) + " не в сети.");
+        return 0;
+    }
+    direct_messages_total.inc();
+    return delivered;
+}
+
+void deliver_cluster_batch(std::vector<ClusterMessage>& batch) {
+    // Кадры собираются до захвата мьютекса; вся пачка от другого узла раскладывается за один захват.
+    thread_local SessionArena cluster_arena;
+    std::vector<ChatFrames> chats;
+    std::vector<SendQueue::Frame> directs;
+    for (const auto& message : batch) {
+        if (message.kind == ClusterKind::chat) {
+            chats.push_back(make_chat_frames(cluster_arena, message.body, message.sender));
+        } else if (message.kind == ClusterKind::direct) {
+            std::string_view body(message.body);
+            auto space = body.find(' ');
+            directs.push_back(space == std::string_view::npos
+                                  ? nullptr
+                                  : make_direct_frame(message.sender, body.substr(0, space), body.substr(space + 1)));
+        }
+    }
+
+    std::vector<uint64_t> seqs;
+    {
+        auto lock = lock_clients();
+        // После передачи журнала сообщения других узлов получает и пишет новый процесс.
+        if (draining) {
+            return;
+        }
+        std::size_t chat = 0, direct = 0;
+        for (const auto& message : batch) {
+            if (message.kind == ClusterKind::chat) {
+                // Сообщение другого узла пишется в журнал этого узла: история здесь полная, номера - свои.
+                seqs.push_back(log_and_fan_out_locked(chats[chat++], message.body, message.sender, 0));
+            } else if (message.kind == ClusterKind::direct) {
+                if (const auto& frame = directs[direct++]) {
+                    std::string_view body(message.body);
+                    deliver_direct_locked(frame, body.substr(0, body.find(' ')), message.sender, 0);
+                }
             }
         }
     }
+    std::size_t chat = 0;
+    for (const auto& message : batch) {
+        if (message.kind == ClusterKind::chat) {
+            search_index.add(seqs[chat++], message.body);
+        }
+    }
+    cluster_in_total.inc(batch.size());
+}
+
+void broadcast_presence(const std::string& delta) {
+    http::response<http::string_body> response(http::status::ok, 11);
+    response.set(http::field::content_type, "text/plain");
+    response.set("X-Presence", "delta");
+    response.body() = delta;
+    response.prepare_payload();
+
+    presence_batches_total.inc();
+    write_to_clients(make_frame(response), nullptr, 0, SendQueue::Lane::control);
+}
+
+void send_presence_snapshot(SendQueue& queue) {
+    http::response<http::string_body> response(http::status::ok, 11);
+    response.set(http::field::content_type, "text/plain");
+    response.set("X-Presence", "snapshot");
+    response.body() = presence.snapshot();
+    response.prepare_payload();
+    queue.enqueue(make_frame(response), SendQueue::Lane::control);
+}
+
+void send_notice(SendQueue& queue, std::string_view text, std::string_view ack) {
+    http::response<http::string_body> response(http::status::ok, 11);
+    response.set(http::field::content_type, "text/plain");
+    if (!ack.empty()) {
+        response.set("X-Ack", beast::string_view(ack.data(), ack.size()));
+    }
+    response.body() = text;
+    response.prepare_payload();
+    queue.enqueue(make_frame(response), SendQueue::Lane::control);
+}
+
+void send_drop_notice(SendQueue& queue, std::string_view text, std::optional<uint64_t> after) {
+    if (!after) {
+        send_notice(queue, text, "dropped");
+        return;
+    }
+    // Клиент сопоставляет X-Ack с отправленными сообщениями по порядку, поэтому отказ ждёт
+    // подтверждения предыдущего сообщения.
+    message_log->when_durable(*after, [queue = queue.shared_from_this(), text = std::string(text)] {
+        send_notice(*queue, text, "dropped");
+    });
 }
 
-void extractLoginAndPassword(const std::string& input, std::string& login, std::string& password) {
-    std::istringstream iss(input);
+void send_reconnect(SendQueue& queue, std::chrono::milliseconds delay) {
+    http::response<http::empty_body> response(http::status::ok, 11);
+    response.set("X-Reconnect", std::to_string(delay.count()));
+    response.prepare_payload();
+    queue.enqueue(make_frame(response), SendQueue::Lane::control);
+}
+
+void send_ping(SendQueue& queue) {
+    http::response<http::empty_body> response(http::status::ok, 11);
+    response.set("X-Heartbeat", "ping");
+    response.prepare_payload();
+    if (queue.enqueue(make_frame(response), SendQueue::Lane::control)) {
+        pings_total.inc();
+    }
+}
+
+void extractLoginAndPassword(std::string_view input, std::string& login, std::string& password) {
+    std::istringstream iss{std::string(input)};
     iss >> login >> password;
 }
 
-void handle_session(std::shared_ptr<ssl_socket> socket) {
+uint64_t extractHistoryOffset(const arena_request& request) {
+    uint64_t offset = 0;
+    auto value = request["X-History-Offset"];
+    std::from_chars(value.data(), value.data() + value.size(), offset);
+    return offset;
+}
+
+void record_ack(std::string_view body) {
+    uint64_t seq = 0;
+    auto [end, ec] = std::from_chars(body.data(), body.data() + body.size(), seq);
+    if (ec == std::errc() && end != body.data()) {
+        acks_total.inc();
+    }
+}
+
+namespace {
+
+/**
+ * @return Ложь, если приём остановлен (слушающий сокет передан новому процессу).
+ */
+template <typename Stream>
+asio::awaitable<bool> accept_one(tcp::acceptor& acceptor, ServerTlsContext& tls) {
+    auto strand = asio::make_strand(ioc);
+    // SSL держит ссылку на свой SSL_CTX, поэтому перезагрузка сертификата не мешает сессии.
+    auto socket = std::make_shared<Stream>(strand, *tls.current());
+    beast::error_code ec;
+    co_await acceptor.async_accept(socket->next_layer(), asio::redirect_error(asio::use_awaitable, ec));
+    if (ec == asio::error::operation_aborted || !acceptor.is_open()) {
+        co_return false;
+    }
+    if (ec) {
+        // Например, исчерпаны дескрипторы: приём продолжается, уже открытые сессии не страдают.
+        logger.log(LogLevel::warn, "accept_failed", {{"error", ec.message()}});
+        co_return true;
+    }
+    accepts_total.inc();
+    asio::co_spawn(strand, handle_session(socket, strand), log_coroutine_exception);
+    co_return true;
+}
+
+/**
+ * @brief Учитывает, удалось ли передать шифрование сессии ядру.
+ */
+template <typename Stream>
+void note_kernel_tls(Stream& socket) {
+    if constexpr (std::is_same_v<Stream, KtlsStream>) {
+        if (socket.send_offloaded()) {
+            ktls_send_total.inc();
+        } else {
+            ktls_fallback_total.inc();
+        }
+    }
+}
+
+} // namespace
+
+asio::awaitable<void> accept_loop(tcp::acceptor& acceptor, ServerTlsContext& tls, bool kernel_tls) {
+    while (kernel_tls ? co_await accept_one<KtlsStream>(acceptor, tls) : co_await accept_one<ssl_socket>(acceptor, tls)) {
+    }
+    logger.log(LogLevel::info, "accept_stopped", {});
+}
+
+template <typename Stream>
+asio::awaitable<void> write_loop(std::shared_ptr<Stream> socket, std::shared_ptr<SendQueue> queue,
+                                 std::shared_ptr<SessionWatch> watch) {
+    // Кадры, накопившиеся за время предыдущей записи, уходят одной записью TLS.
+    std::vector<SendQueue::Frame> batch;
+    std::string buffer;
+    try {
+        while (co_await queue->pop_batch(batch, kWriteBatchBytes)) {
+            SessionWatch::WriteScope writing(*watch);
+            co_await write_frames(*socket, batch, buffer);
+            writes_total.inc();
+        }
+    } catch (const beast::system_error& e) {
+        send_failures_total.inc();
+        logger.log(LogLevel::warn, "send_failed", {{"error", e.what()}});
+    }
+    // Очередь закрыта (сессия завершилась или получатель не успевал читать) либо запись сорвалась:
+    // закрытие сокета прерывает чтение сессии.
+    queue->close();
+    beast::error_code ec;
+    socket->lowest_layer().shutdown(tcp::socket::shutdown_both, ec);
+}
+
+template <typename Stream>
+asio::awaitable<void> handle_session(std::shared_ptr<Stream> socket, SendQueue::executor_type strand) {
     std::string login, password;
 
-    beast::flat_buffer buffer;
-    http::request<http::string_body> request;
+    // Парсер, буфер и тела запросов живут в пуле сессии и переиспользуются между сообщениями
+    SessionArena arena;
 
-    // Read the first request which is expected to be the client's name
-    http::read(*socket, buffer, request);
+    // Монитор закрывает сокет, если клиент молчит дольше срока или запись к нему зависла:
+    // ожидающие чтение и запись сессии при этом завершаются ошибкой. Срок входа включает рукопожатие.
+    std::shared_ptr<SessionWatch> watch = session_monitor.watch([socket, strand](std::string_view reason) {
+        sessions_reaped_total.inc();
+        logger.log(LogLevel::info, "session_reaped", {{"reason", reason}});
+        asio::post(strand, [socket] {
+            beast::error_code ec;
+            socket->lowest_layer().shutdown(tcp::socket::shutdown_both, ec);
+        });
+    });
+
+    try {
+        co_await socket->async_handshake(ssl::stream_base::server, asio::use_awaitable);
+    } catch (const beast::system_error& e) {
+        handshake_failures_total.inc();
+        logger.log(LogLevel::warn, "handshake_failed", {{"error", e.what()}});
+        co_return;
+    }
+    handshakes_total.inc();
+    note_kernel_tls(*socket);
 
-    std::string target_url = request.target().to_string();
+    // Read the first request which is expected to be the client's name
+    arena_request* first = nullptr;
+    try {
+        co_await arena.async_read(*socket);
+        first = &arena.request();
+    } catch (const beast::system_error& e) {
+        logger.log(LogLevel::info, "session_closed_before_login", {{"error", e.what()}});
+        co_return;
+    }
+    arena_request& request = *first;
+    watch->touch();
 
-    if (target_url == "/reg") {
+    if (request.target() == "/reg") {
         extractLoginAndPassword(request.body(), login, password);
-        buffer.consume(buffer.size());
-        auto isExist = db.execute("SELECT EXISTS (SELECT 1 FROM users WHERE name ='" + login + "');");
-        if (login.empty() || login == "You" || (!isExist.empty() && isExist[0][0].as<bool>())) {
-                http::response<http::string_body> response(http::status::ok, 11);
-                response.set(http::field::content_type, "text/plain");
-                response.body() = "Выберите другое имя пользователя!";
-                response.prepare_payload();
-                http::write(*socket, response);
-        } else {
-                db.execute("INSERT INTO users (name, password) VALUES ('" + login + "', '" + password + "')");
-                http::response<http::string_body> response(http::status::ok, 11);
-                response.set(http::field::content_type, "text/plain");
-                response.body() = "Ok";
-                response.prepare_payload();
-                http::write(*socket, response);
+        PendingLogin pending;
+        AuthStatus status = login.empty() || login == "You" ? AuthStatus::rejected
+                            : !pending                      ? AuthStatus::busy
+                                                            : co_await auth.register_user(login, password);
+        try {
+            if (status == AuthStatus::busy || status == AuthStatus::unavailable) {
+                co_await write_reply(*socket, http::status::service_unavailable, "Сервер перегружен, попробуйте позже.");
+            } else if (status == AuthStatus::rejected) {
+                co_await write_reply(*socket, http::status::ok, "Выберите другое имя пользователя!");
+            } else {
+                co_await write_reply(*socket, http::status::ok, "Ok");
+            }
+        } catch (const beast::system_error& e) {
+            logger.log(LogLevel::info, "session_closed_before_login", {{"error", e.what()}});
         }
-    } else {
+        co_return;
+    }
+
+    // Клиент, приславший X-Accept-Encoding: deflate, сначала получает словарь, затем сжатые кадры.
+    bool compress = request["X-Accept-Encoding"].find("deflate") != beast::string_view::npos;
+    extractLoginAndPassword(request.body(), login, password);
+    // Общее ведро входов растягивает волну переподключений после перезапуска во времени.
+    if (!admit_login()) {
+        logins_throttled_total.inc();
         try {
-                extractLoginAndPassword(request.body(), login, password);
-                buffer.consume(buffer.size());
-
-                auto isExist = db.execute("SELECT EXISTS (SELECT 1 FROM users WHERE name ='" + login + "' and password='" + password + "');");
-
-                if (login.empty() || !(!isExist.empty() && isExist[0][0].as<bool>())) {
-                        http::response<http::string_body> response(http::status::bad_request, 11);
-                        response.set(http::field::content_type, "text/plain");
-                        response.body() = "Invalid username.";
-                        response.prepare_payload();
-                        http::write(*socket, response);
-                        return;
+            co_await write_reply(*socket, http::status::service_unavailable, "Server busy.");
+        } catch (const beast::system_error&) {
+        }
+        co_return;
+    }
+    // Запрос к базе уходит в blocking_pool, хеширование - в hash_pool; поток цикла событий не ждёт ни того, ни другого.
+    AuthStatus status = AuthStatus::busy;
+    if (PendingLogin pending; pending) {
+        status = co_await auth.verify(login, password);
+    } else {
+        logins_throttled_total.inc();
+    }
+    try {
+        if (status == AuthStatus::busy || status == AuthStatus::unavailable) {
+            co_await write_reply(*socket, http::status::service_unavailable, "Server busy.");
+            co_return;
+        }
+        if (status != AuthStatus::ok) {
+            co_await write_reply(*socket, http::status::bad_request, "Invalid username.");
+            co_return;
+        }
+    } catch (const beast::system_error& e) {
+        logger.log(LogLevel::info, "session_closed_before_login", {{"error", e.what()}});
+        co_return;
+    }
+
+    auto queue = std::make_shared<SendQueue>(strand);
+    queue->set_delay_observer(observe_send_delay);
+    asio::co_spawn(strand, write_loop(socket, queue, watch), log_coroutine_exception);
+    uint64_t from_offset = extractHistoryOffset(request);
+    if (compress) {
+        send_compression_dictionary(*queue);
+        compressing_clients.fetch_add(1, std::memory_order_relaxed);
+    }
+    Client self{queue, login, watch, compress, 0};
+    uint64_t history_end = 0;
+    {
+        // Журнал пополняется под clients_mutex: всё до history_end придёт историей, всё после - рассылками.
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        self.id = clients.add(self);
+        history_end = message_log->next_offset();
+    }
+    active_sessions.add(1);
+    // Вход, начатый до передачи сокета, сразу получает просьбу переподключиться к новому процессу.
+    if (draining) {
+        drain_session(*queue);
+    }
+    session_monitor.enable_heartbeat(*watch, [queue] { send_ping(*queue); });
+    // Вход и выход больше не пишутся в историю: клиенты узнают о них из рассылок присутствия.
+    presence.join(login);
+    uint32_t trace_session = capture ? capture->login(login, compress) : 0;
+    try {
+        co_await send_chat_history(*queue, login, from_offset, history_end, compress);
+        send_presence_snapshot(*queue);
+        logger.log(LogLevel::info, "client_connected", {{"user", login}});
+
+        TokenBucket connection_bucket(kConnectionRateLimit);
+        TokenBucket upload_bucket(kUploadChunkRateLimit);
+        // Номер последнего сообщения, ждущего X-Ack: отказ по следующему не должен его обогнать.
+        std::optional<uint64_t> last_seq;
+        asio::steady_timer delay(strand);
+        auto downloading = std::make_shared<bool>(false); // Только в strand сессии.
+        std::vector<std::string> uploads;                 // Незавершённые загрузки сессии.
+        while (true) {
+            // Память предыдущего запроса возвращается в пул сессии при чтении следующего
+            co_await arena.async_read(*socket);
+            arena_request& next = arena.request();
+            watch->touch();
+            // Пинги - ответ на запросы сервера, а вложения привязаны к хранилищу узла: в трассу не пишутся.
+            if (capture && next.target() != "/pong" && next.target() != "/upload" && next.target() != "/download") {
+                std::string_view target(next.target().data(), next.target().size());
+                std::string_view body(next.body().data(), next.body().size());
+                capture->request(trace_session, target, logger.message_content() ? body : std::string_view(redact_trace_body(target, body)));
+            }
+            // Ответ на ping и явное подтверждение несут номер последнего полученного сообщения.
+            if (next.target() == "/pong" || next.target() == "/ack") {
+                record_ack(std::string_view(next.body().data(), next.body().size()));
+                continue;
+            }
+            if (next.target() == "/typing") {
+                presence.typing(login);
+                continue;
+            }
+            // Вложение отдаётся отдельной корутиной, чтобы сессия продолжала читать; одновременно - одно.
+            if (next.target() == "/download") {
+                if (*downloading) {
+                    send_notice(*queue, "[!]\tДождитесь окончания предыдущей загрузки файла.");
+                    continue;
                 }
+                uint64_t offset = 0;
+                auto value = next["X-Blob-Offset"];
+                std::from_chars(value.data(), value.data() + value.size(), offset);
+                *downloading = true;
+                asio::co_spawn(strand, send_attachment(queue, std::string(next.body().data(), next.body().size()), offset),
+                               [downloading](std::exception_ptr error) {
+                                   *downloading = false;
+                                   log_coroutine_exception(error);
+                               });
+                continue;
+            }
+            // Части вложения с данными ограничены своим ведром: клиент шлёт следующую, получив ответ, а объём
+            // ограничен хранилищем и числом незавершённых загрузок сессии. Пустая часть ничего не стоит
+            // клиенту, но обращается к диску, поэтому платит как сообщение.
+            // После передачи сокета журналом и вложениями владеет новый процесс: сообщение, поиск и загрузка
+            // не принимаются, клиент повторит их после переподключения.
+            if (draining) {
+                if (next.target() == "/upload" || next.target() == "/dm" || next.target() == "/search") {
+                    send_notice(*queue, kRestartNotice);
+                } else {
+                    send_drop_notice(*queue, kRestartNotice, last_seq);
+                }
+                continue;
+            }
+            std::string announcement;
+            if (next.target() == "/upload") {
+                co_await take_token(next.body().empty() ? connection_bucket : upload_bucket, delay);
+                announcement = co_await receive_attachment_chunk(next, *queue, uploads);
+                if (announcement.empty()) {
+                    continue;
+                }
+            }
+            const auto& body = next.body();
+            std::string_view message = announcement.empty() ? std::string_view(body.data(), body.size()) : announcement;
+            // Поиск стоит дороже сообщения, поэтому проходит те же ограничения частоты и перегрузки.
+            bool search = next.target() == "/search";
+            if (!search) {
+                messages_in_total.inc();
+            }
+
+            // Слишком частые сообщения соединения задерживаются.
+            if (co_await take_token(connection_bucket, delay)) {
+                messages_delayed_total.inc();
+            }
 
-                clients.push_back({socket, login});
-                db.execute("INSERT INTO messages (name, message) VALUES ('', '[+]\tNew client " + login + " connected.')");
-                send_chat_history(socket, login);
-                std::cout << "New client " << login << " connected.\n";
-                broadcast_message("", login, "connect");
-
-                while (true) {
-                        http::request<http::string_body> request;  // Создаем новый объект запроса для каждого сообщения
-                        http::read(*socket, buffer, request);
-                        std::string message = request.body();
-                        db.execute("INSERT INTO messages (name, message) VALUES ('" + login + "', '" + message + "')");
-                        std::cout << "Received message from " << login << ": " << message << std::endl;
-
-                        broadcast_message(message, login, "common");
-                        buffer.consume(buffer.size());  // Очищаем буфер после каждого чтения
+            // Личные сообщения и сообщения о файлах не ждут номера, поэтому отказ по ним приходит без X-Ack.
+            bool direct = next.target() == "/dm";
+            auto refuse = [&](std::string_view text) {
+                if (direct || search || !announcement.empty()) {
+                    send_notice(*queue, text);
+                } else {
+                    send_drop_notice(*queue, text, last_seq);
                 }
-        } catch (const beast::system_error& e) {
-                if (e.code() != beast::errc::not_connected) {
-                        std::cerr << "Error in session: " << e.what() << std::endl;
+            };
+            if (!user_rate_limiter.try_acquire(login)) {
+                messages_dropped_rate_total.inc();
+                refuse("[!]\tСообщение не доставлено: слишком частая отправка.");
+                continue;
+            }
+            if (!admission.admit()) {
+                messages_dropped_overload_total.inc();
+                refuse("[!]\tСообщение не доставлено: сервер перегружен.");
+                continue;
+            }
+            if (search) {
+                std::size_t page = 0;
+                auto value = next["X-Search-Page"];
+                std::from_chars(value.data(), value.data() + value.size(), page);
+                co_await send_search_results(*queue, message, page);
+                continue;
+            }
+            // Личные сообщения не пишутся ни в базу, ни в журнал.
+            if (direct) {
+                send_direct_message(message, self);
+                continue;
+            }
+            // Запись в базу уходит в конвейер асинхронного клиента: сессия не ждёт ответа сервера базы.
+            async_db.execute_prepared("insert_message", {login, std::string(message)}, [login](const QueryResult& result) {
+                if (!result.ok()) {
+                    db_insert_failures_total.inc();
+                    logger.log(LogLevel::warn, "db_insert_failed", {{"user", login}, {"error", result.error}});
                 }
+            });
+            if (logger.enabled(LogLevel::info) && logger.sample()) {
+                if (logger.message_content()) {
+                    logger.log(LogLevel::info, "message_received", {{"user", login}, {"text", message}});
+                } else {
+                    logger.log(LogLevel::info, "message_received", {{"user", login}, {"bytes", message.size()}});
+                }
+            }
 
-                // Handle client disconnection
-                db.execute("INSERT INTO messages (name, message) VALUES ('', '[-]\tClient " + login + " disconnected.')");
-                broadcast_message("", login, "disconnect");
-                std::lock_guard<std::mutex> lock(clients_mutex);
-                clients.erase(std::remove_if(clients.begin(), clients.end(),
-                [&socket](const Client& c) { return c.socket == socket; }), clients.end());
-                std::cout << "Client disconnected: " << login << std::endl;
+            // Сообщение о файле отправитель получает как все: клиент не знает его текста заранее.
+            std::optional<uint64_t> seq = broadcast_message(message, self, !announcement.empty());
+            if (!seq) {
+                refuse(kRestartNotice);
+            } else if (announcement.empty()) {
+                last_seq = seq;
+            }
+        }
+    } catch (const beast::system_error& e) {
+        if (e.code() != beast::errc::not_connected) {
+            logger.log(LogLevel::warn, "session_error", {{"user", login}, {"error", e.what()}});
         }
+    } catch (const std::exception& e) {
+        logger.log(LogLevel::error, "session_error", {{"user", login}, {"error", e.what()}});
+    }
+
+    // Handle client disconnection
+    queue->close();
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        clients.remove(self.id);
+    }
+    presence.leave(login);
+    if (capture) {
+        capture->disconnect(trace_session);
+    }
+    if (compress) {
+        compressing_clients.fetch_sub(1, std::memory_order_relaxed);
     }
-}
\ No newline at end of file
+    active_sessions.add(-1);
+    logger.log(LogLevel::info, "client_disconnected", {{"user", login}});
+}
+
+template asio::awaitable<void> handle_session(std::shared_ptr<ssl_socket>, SendQueue::executor_type);
+template asio::awaitable<void> handle_session(std::shared_ptr<KtlsStream>, SendQueue::executor_type);
@@ -1,6 +1,7 @@
 #ifndef SSL_SERVER_H
 #define SSL_SERVER_H
 
+#include <utility> // Boost 1.74 использует std::exchange в awaitable.hpp, не подключая <utility>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/asio/ip/tcp.hpp>
@@ -16,6 +17,24 @@
 #include <pqxx/pqxx>
 #include <stdexcept>
 #include "scipher.h"
+#include "message_log.h"
+#include "database_manager.h"
+#include "async_database.h"
+#include "auth_service.h"
+#include "password_hasher.h"
+#include "session_arena.h"
+#include "rate_limiter.h"
+#include "session_monitor.h"
+#include "presence.h"
+#include "compression.h"
+#include "search_index.h"
+#include "send_queue.h"
+#include "client_registry.h"
+#include "cluster_bus.h"
+#include "blob_store.h"
+#include "traffic_trace.h"
+#include "ktls_stream.h"
+#include "tls_context.h"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -34,85 +53,443 @@ using tcp = ip::tcp;
 using ssl_socket = ssl::stream<tcp::socket>;
 
 /**
- * @brief Класс для управления подключением к базе данных PostgreSQL.
+ * @brief Цикл событий сервера: приём соединений, корутины сессий и асинхронный клиент базы.
+ * Выполняется пулом потоков по числу ядер; каждая сессия работает в своём strand.
  */
-class DatabaseManager {
-private:
-    pqxx::connection conn;
+extern asio::io_context ioc;
 
-public:
-    /**
-     * @brief Конструктор класса DatabaseManager.
-     * @param conn_str Строка подключения к базе данных.
-    */
-    DatabaseManager(const std::string& conn_str);
+/**
+ * @brief Пул для блокирующих вызовов сессий (запросы входа и регистрации к DatabaseManager, поиск).
+ */
+extern asio::thread_pool blocking_pool;
+
+/**
+ * @brief Пул для чтения и записи вложений: медленный диск не задерживает входы.
+ */
+extern asio::thread_pool blob_pool;
+extern DatabaseManager db;
+extern AsyncDatabase async_db;
+extern HashWorkerPool hash_pool;
+extern AuthService auth;
+/**
+ * @brief Журнал сообщений узла; открывается в main, после передачи слушающего сокета.
+ */
+extern std::unique_ptr<MessageLog> message_log;
+extern SearchIndex search_index;
+extern ClientRegistry clients;
+extern std::mutex clients_mutex;
+extern UserRateLimiter user_rate_limiter;
+extern AdmissionController admission;
+extern SessionMonitor session_monitor;
+extern PresenceTracker presence;
+extern DeflateCodec codec;
+/**
+ * @brief Хранилище вложений узла; открывается в main вместе с журналом.
+ */
+extern std::unique_ptr<BlobStore> blobs;
+
+/**
+ * @brief Переменная окружения, включающая шифрование записей TLS в ядре (kTLS), если ядро его поддерживает.
+ */
+constexpr const char* kKernelTlsEnv = "CHAT_KTLS";
+
+/**
+ * @brief Переменная окружения с адресом брокера кластера ("unix:/путь" или "tcp:адрес:порт");
+ * без неё сервер работает один.
+ */
+constexpr const char* kClusterEnv = "CHAT_CLUSTER";
+
+/**
+ * @brief Переменная окружения с путём файла трассы: сервер записывает в него входы, запросы
+ * и отключения сессий для воспроизведения программой chat_replay.
+ */
+constexpr const char* kCaptureEnv = "CHAT_CAPTURE";
+
+/**
+ * @brief Наибольший размер трассы; дальше запись прекращается.
+ */
+constexpr uint64_t kCaptureMaxBytes = 1024ull * 1024 * 1024;
+
+/**
+ * @brief Имя Unix-сокета, через который новый процесс забирает слушающий сокет у прежнего;
+ * файл лежит в личном каталоге пользователя (handoff_path). У именованного узла - NodeConfig::handoff_name().
+ */
+constexpr const char* kHandoffName = "ssl_server.handoff";
+
+/**
+ * @brief Переменная окружения с именем узла. Узлы на одном хосте должны различаться именем:
+ * оно входит в имя сокета передачи, и процесс забирает слушающий сокет только у своего узла.
+ */
+constexpr const char* kNodeEnv = "CHAT_NODE";
+
+/**
+ * @brief Переменная окружения с портом чата (по умолчанию 3202).
+ */
+constexpr const char* kPortEnv = "CHAT_PORT";
+
+/**
+ * @brief Переменная окружения с портом метрик на 127.0.0.1 (по умолчанию 9202).
+ */
+constexpr const char* kMetricsPortEnv = "CHAT_METRICS_PORT";
+
+/**
+ * @brief Переменная окружения с каталогом журнала сообщений (по умолчанию message_log).
+ */
+constexpr const char* kLogDirEnv = "CHAT_LOG_DIR";
+
+/**
+ * @brief Переменная окружения с каталогом хранилища вложений (по умолчанию kAttachmentDir).
+ */
+constexpr const char* kAttachmentDirEnv = "CHAT_ATTACHMENT_DIR";
+
+/**
+ * @brief Настройки, которые различаются у узлов, работающих на одном хосте.
+ */
+struct NodeConfig {
+    std::string name;                        ///< Имя узла (kNodeEnv); пусто у единственного узла.
+    unsigned short port = 3202;              ///< Порт чата.
+    unsigned short metrics_port = 9202;      ///< Порт метрик.
+    std::string log_dir = "message_log";     ///< Каталог журнала сообщений.
+    std::string attachment_dir = "attachments"; ///< Каталог хранилища вложений.
+    std::string cluster;                     ///< Адрес брокера (kClusterEnv); пусто без кластера.
 
     /**
-     * @brief Выполняет запрос к базе данных.
-     * @param query SQL-запрос.
-    */
-    pqxx::result execute(const std::string& query);
+     * @brief Имя сокета передачи: kHandoffName у безымянного узла, иначе "ssl_server.<имя>.handoff".
+     */
+    std::string handoff_name() const;
 
     /**
-     * @brief Выполняет запрос к базе данных и возвращает результат.
-     * @param query SQL-запрос.
-     * @return Результат выполнения запроса.
-    */
-    pqxx::result fetch(const std::string& query);
+     * @brief Описание узла для передачи слушающего сокета: брокер, имя и порт.
+     *
+     * Прежний процесс отдаёт сокет только процессу с тем же описанием.
+     */
+    std::string identity() const;
 };
 
-DatabaseManager::DatabaseManager(const std::string& conn_str) : conn(conn_str) {
-    if (conn.is_open()) {
-        std::cout << "Opened database successfully: " << conn.dbname() << std::endl;
-    } else {
-        throw std::runtime_error("Can't open database");
-    }
-}
+/**
+ * @brief Читает настройки узла из переменных окружения.
+ * @throws std::invalid_argument, если порт не число от 1 до 65535 или имя узла содержит символы,
+ * кроме латинских букв, цифр, '-' и '_'.
+ */
+NodeConfig node_config_from_env();
 
-pqxx::result DatabaseManager::execute(const std::string& query) {
-    pqxx::work W(conn);
-    pqxx::result result = W.exec(query);
-    W.commit();
-    return result;
-}
+/**
+ * @brief Интервал, по которому разносятся переподключения разгружаемых сессий.
+ */
+constexpr std::chrono::seconds kDrainSpread{20};
 
-pqxx::result DatabaseManager::fetch(const std::string& query) {
-    pqxx::nontransaction N(conn);
-    return N.exec(query);
-}
+/**
+ * @brief Наибольшее время разгрузки; оставшиеся сессии закрываются вместе с процессом.
+ */
+constexpr std::chrono::seconds kDrainTimeout{30};
 
 /**
- * @brief Структура для хранения информации о подключенном клиенте.
+ * @brief Ограничение частоты входов по всему серверу; превышение отвечает 503, клиент повторяет позже.
  */
-struct Client {
-    std::shared_ptr<ssl_socket> socket;
-    std::string name;
-};
+constexpr RateLimit kLoginRateLimit{200, 400};
 
-extern DatabaseManager db;
-extern std::vector<Client> clients;
-extern std::mutex clients_mutex;
+/**
+ * @brief Наибольшее число входов и регистраций, одновременно ждущих базу или пул хеширования;
+ * следующие получают 503.
+ */
+constexpr std::size_t kMaxPendingLogins = 256;
+
+/**
+ * @brief Размер пачки истории, после которого она отправляется клиенту.
+ */
+constexpr std::size_t kHistoryBatchBytes = 32 * 1024;
+
+/**
+ * @brief Наибольший объём кадров, склеиваемых корутиной записи в одну запись.
+ */
+constexpr std::size_t kWriteBatchBytes = 64 * 1024;
+
+/**
+ * @brief Объём кадров во всех очередях отправки, выше которого новые сообщения отклоняются (контроль допуска).
+ */
+constexpr std::size_t kMaxQueuedSendBytes = 64 * 1024 * 1024;
+
+/**
+ * @brief Каталог хранилища вложений по умолчанию (см. kAttachmentDirEnv).
+ */
+constexpr const char* kAttachmentDir = "attachments";
+
+/**
+ * @brief Размер части вложения по умолчанию: столько памяти занимает одна загрузка или отдача.
+ */
+constexpr std::size_t kAttachmentChunkBytes = 64 * 1024;
+
+/**
+ * @brief Переменная окружения с размером части вложения в байтах (от 4 КиБ до 1 МиБ - предела тела запроса).
+ */
+constexpr const char* kAttachmentChunkEnv = "CHAT_ATTACHMENT_CHUNK";
+
+/**
+ * @brief Наибольший размер вложения.
+ */
+constexpr uint64_t kMaxAttachmentBytes = 256 * 1024 * 1024;
+
+/**
+ * @brief Наибольший объём хранилища вложений (готовые и недогруженные файлы).
+ */
+constexpr uint64_t kAttachmentStoreBytes = 16ull * 1024 * 1024 * 1024;
+
+/**
+ * @brief Срок, после которого недогруженное вложение без новых частей удаляется.
+ */
+constexpr std::chrono::hours kPartialUploadTtl{24};
+
+/**
+ * @brief Наибольшее число незавершённых загрузок одной сессии.
+ */
+constexpr std::size_t kMaxSessionUploads = 2;
 
 /**
- * @brief Отправляет историю чата подключенному клиенту.
- * @param socket SSL-сокет клиента.
+ * @brief Число результатов поиска на странице.
+ */
+constexpr std::size_t kSearchPageSize = 20;
+
+/**
+ * @brief Наибольший номер страницы поиска: более далёкие страницы не ранжируются.
+ */
+constexpr std::size_t kMaxSearchPage = 50;
+
+/**
+ * @brief Наибольшая длина строки поискового запроса, байт.
+ */
+constexpr std::size_t kMaxSearchQueryBytes = 256;
+
+/**
+ * @brief Ограничение частоты сообщений одного соединения; превышение задерживает чтение.
+ */
+constexpr RateLimit kConnectionRateLimit{5, 10};
+
+/**
+ * @brief Ограничение частоты частей вложения одного соединения; превышение задерживает чтение.
+ *
+ * Части идут по одной: сессия отвечает на часть, записав её. Пустые части (запрос, с какого
+ * места продолжить) ограничиваются kConnectionRateLimit, как сообщения.
+ */
+constexpr RateLimit kUploadChunkRateLimit{64, 8};
+
+/**
+ * @brief Ограничение частоты сообщений одного пользователя по всем его соединениям; превышение отбрасывает сообщение.
+ */
+constexpr RateLimit kUserRateLimit{10, 20};
+
+/**
+ * @brief Переносит историю из таблицы messages в журнал сообщений, если журнал пуст.
+ */
+void import_history_from_db();
+
+/**
+ * @brief Отправляет историю чата подключенному клиенту пачками сообщений.
+ *
+ * Каждая пачка ждёт места в очереди клиента, поэтому история не копится в памяти целиком.
+ * Пачка несёт X-Log-From и X-Log-Offset - первый и последний номер записей, которые она покрывает.
+ * @param queue Очередь отправки клиента.
  * @param clientName Имя клиента.
+ * @param fromOffset Смещение в журнале, начиная с которого нужна история.
+ * @param toOffset Смещение, на котором история заканчивается: следующее сообщение клиент получит рассылкой.
+ * Берётся под clients_mutex вместе с добавлением клиента в список.
+ * @param compress Сжимать пачки (клиент согласовал сжатие).
+ */
+asio::awaitable<void> send_chat_history(SendQueue& queue, const std::string& clientName, uint64_t fromOffset,
+                                        uint64_t toOffset, bool compress = false);
+
+/**
+ * @brief Обучает словарь сжатия на последних сообщениях журнала.
+ */
+void train_compression_dictionary();
+
+/**
+ * @brief Строит полнотекстовый индекс по всем сообщениям журнала.
+ */
+void build_search_index();
+
+/**
+ * @brief Ищет сообщения и отправляет клиенту страницу результатов.
+ *
+ * Ответ несёт заголовки X-Search: results, X-Search-Total и X-Search-Page; тело - по строке
+ * "смещение имя: текст" на сообщение. Поиск и чтение найденных сообщений из журнала выполняются
+ * в blocking_pool. Запрос длиннее kMaxSearchQueryBytes или страница дальше kMaxSearchPage
+ * отклоняются уведомлением.
+ * @param queue Очередь отправки клиента.
+ * @param query Строка запроса; ищутся сообщения со всеми словами.
+ * @param page Номер страницы, начиная с 0.
+ */
+asio::awaitable<void> send_search_results(SendQueue& queue, std::string_view query, std::size_t page);
+
+/**
+ * @brief Размер части вложения из значения переменной kAttachmentChunkEnv.
+ * @param value Значение переменной или nullptr.
+ * @return kAttachmentChunkBytes, если значение не задано или не число; иначе значение в допустимых пределах.
+ */
+std::size_t attachment_chunk_bytes(const char* value);
+
+/**
+ * @brief Принимает часть вложения (запрос POST /upload) и отвечает, с какого места продолжать.
+ *
+ * Заголовки запроса: X-Blob - SHA-256 файла, X-Blob-Size - его размер, X-Blob-Offset - смещение
+ * части, X-File-Name - имя для сообщения в чат; тело - часть не длиннее blobs->chunk_bytes().
+ * Ответ несёт X-Upload с хешем, X-Upload-Status (partial, complete, rejected или busy), X-Blob-Offset
+ * и X-Chunk-Size. Запись на диск и проверка хеша выполняются в blob_pool. busy означает, что
+ * хранилище заполнено или у сессии уже kMaxSessionUploads незавершённых загрузок.
+ * @param request Запрос.
+ * @param queue Очередь отправки клиента.
+ * @param uploads Незавершённые загрузки сессии; обновляется по итогу части.
+ * @return Текст сообщения о файле "[файл] имя (размер байт) хеш" для чата, если файл целиком
+ * в хранилище; иначе пустая строка.
+ */
+asio::awaitable<std::string> receive_attachment_chunk(const arena_request& request, SendQueue& queue,
+                                                      std::vector<std::string>& uploads);
+
+/**
+ * @brief Отправляет клиенту вложение частями начиная с offset.
+ *
+ * Каждая часть - кадр с заголовками X-Blob, X-Blob-Offset и X-Blob-Size; она читается с диска
+ * только когда в очереди есть место, поэтому в памяти не больше одной части на вложение.
+ * Прерывается, когда очередь клиента закрывается.
+ * @param queue Очередь отправки клиента.
+ * @param id Хеш вложения.
+ * @param offset Смещение, с которого продолжить отдачу.
+ */
+asio::awaitable<void> send_attachment(std::shared_ptr<SendQueue> queue, std::string id, uint64_t offset);
+
+/**
+ * @brief Отправляет клиенту словарь сжатия (заголовки X-Compression и X-Compression-Dictionary-Id).
+ * @param queue Очередь отправки клиента.
  */
-void send_chat_history(const std::shared_ptr<ssl_socket>& socket, const std::string& clientName);
+void send_compression_dictionary(SendQueue& queue);
 
 /**
- * @brief Широковещательная рассылка сообщения всем подключенным клиентам.
+ * @brief Записывает сообщение в журнал и рассылает его всем подключенным клиентам.
+ *
+ * В кластере сообщение публикуется и для других узлов.
+ * Номер сообщения (смещение в журнале, заголовок X-Log-Offset) назначается под clients_mutex,
+ * поэтому клиенты получают сообщения по возрастанию номеров. Кадр сериализуется один раз
+ * и кладётся в очереди всех получателей, кроме сессии отправителя; она получает подтверждение
+ * с номером (заголовок X-Ack), когда запись журнала окажется на диске; подтверждение
+ * отправляет поток сброса журнала. Другие устройства отправителя получают сообщение как все.
  * @param message Сообщение для отправки.
- * @param senderName Имя отправителя.
- * @param type Тип сообщения (connect, disconnect, common).
+ * @param sender Сессия отправителя.
+ * @param echo Сессия отправителя получает само сообщение вместо подтверждения (сообщения, составленные сервером).
+ * @return Номер сообщения; пусто, если журнал уже отпущен новому процессу и сообщение не принято.
+ */
+std::optional<uint64_t> broadcast_message(std::string_view message, const Client& sender, bool echo = false);
+
+/**
+ * @brief Доставляет личное сообщение всем сессиям получателя и другим сессиям отправителя.
+ *
+ * Сессии находятся по индексу имён, поэтому доставка не зависит от числа клиентов в сети.
+ * Сообщение не попадает в журнал и историю: получают его только подключенные сессии.
+ * Кадр несёт заголовок X-Direct с именем отправителя. Если получатель не в сети,
+ * отправитель получает уведомление; в кластере сообщение уходит и другим узлам, и
+ * уведомления нет.
+ * @param body Тело запроса /dm: "получатель текст".
+ * @param sender Сессия отправителя.
+ * @return Число сессий получателя, которым сообщение поставлено в очередь.
+ */
+std::size_t send_direct_message(std::string_view body, const Client& sender);
+
+/**
+ * @brief Доставляет клиентам узла пачку сообщений от других узлов кластера.
+ *
+ * Сообщения чата пишутся в журнал этого узла и рассылаются всем его клиентам, личные -
+ * сессиям получателя и отправителя на этом узле. Вся пачка раскладывается по очередям
+ * за один захват clients_mutex.
+ * @param batch Сообщения в порядке получения.
+ */
+void deliver_cluster_batch(std::vector<ClusterMessage>& batch);
+
+/**
+ * @brief Рассылает всем клиентам пакет изменений присутствия (заголовок X-Presence: delta).
+ * @param delta Закодированные изменения, см. PresenceDelta::encode().
+ */
+void broadcast_presence(const std::string& delta);
+
+/**
+ * @brief Отправляет клиенту список пользователей в сети (заголовок X-Presence: snapshot).
+ * @param queue Очередь отправки клиента.
+ */
+void send_presence_snapshot(SendQueue& queue);
+
+/**
+ * @brief Отправляет служебное уведомление одному клиенту.
+ * @param queue Очередь отправки клиента.
+ * @param text Текст уведомления.
+ * @param ack Значение заголовка X-Ack ("dropped" для отброшенного сообщения клиента); пусто - без заголовка.
+ */
+void send_notice(SendQueue& queue, std::string_view text, std::string_view ack = {});
+
+/**
+ * @brief Отправляет клиенту уведомление с X-Ack: dropped об отброшенном сообщении чата.
+ *
+ * Клиент сопоставляет X-Ack с отправленными сообщениями по порядку, поэтому уведомление
+ * уходит не раньше подтверждения предыдущего сообщения сессии.
+ * @param queue Очередь отправки клиента.
+ * @param text Текст уведомления.
+ * @param after Номер предыдущего сообщения сессии; пусто, если сессия ещё ничего не отправляла.
+ */
+void send_drop_notice(SendQueue& queue, std::string_view text, std::optional<uint64_t> after);
+
+/**
+ * @brief Просит клиента переподключиться через delay (заголовок X-Reconnect, миллисекунды).
+ * @param queue Очередь отправки клиента.
+ * @param delay Задержка переподключения.
+ */
+void send_reconnect(SendQueue& queue, std::chrono::milliseconds delay);
+
+/**
+ * @brief Отправляет клиенту ping; клиент отвечает запросом на /pong.
+ * @param queue Очередь отправки клиента.
+ */
+void send_ping(SendQueue& queue);
+
+/**
+ * @brief Принимает соединения и запускает для каждого корутину сессии в собственном strand,
+ * пока слушающий сокет не закроется.
+ * @param acceptor Слушающий сокет.
+ * @param tls Контекст TLS сервера; каждое соединение получает текущий.
+ * @param kernel_tls Обслуживать соединения через KtlsStream (шифрование в ядре) вместо ssl_socket.
+ */
+asio::awaitable<void> accept_loop(tcp::acceptor& acceptor, ServerTlsContext& tls, bool kernel_tls = false);
+
+/**
+ * @brief Корутина сессии клиента: рукопожатие TLS, регистрация или вход, затем приём сообщений.
+ *
+ * Инстанцируется для ssl_socket и KtlsStream.
+ * @param socket Поток TLS клиента, созданный на strand.
+ * @param strand Strand сессии; в нём выполняются чтение, запись и очередь отправки.
+ */
+template <typename Stream>
+asio::awaitable<void> handle_session(std::shared_ptr<Stream> socket, SendQueue::executor_type strand);
+
+/**
+ * @brief Корутина записи: отправляет кадры из очереди, пока очередь не закроется или запись не сорвётся.
+ * @param socket Поток TLS клиента.
+ * @param queue Очередь отправки клиента.
+ * @param watch Наблюдение за сессией клиента; запись идёт под SessionWatch::WriteScope.
+ */
+template <typename Stream>
+asio::awaitable<void> write_loop(std::shared_ptr<Stream> socket, std::shared_ptr<SendQueue> queue,
+                                 std::shared_ptr<SessionWatch> watch);
+void extractLoginAndPassword(std::string_view input, std::string& login, std::string& password);
+
+/**
+ * @brief Возвращает смещение журнала из заголовка X-History-Offset запроса входа (0, если его нет).
+ * @param request Запрос входа клиента.
+ * @return Смещение, начиная с которого клиенту нужна история.
  */
-void broadcast_message(const std::string& message, const std::string& senderName, const std::string& type);
+uint64_t extractHistoryOffset(const arena_request& request);
 
 /**
- * @brief Обрабатывает сессию клиента.
- * @param socket SSL-сокет клиента.
+ * @brief Учитывает подтверждение клиента: номер последнего полученного сообщения в теле запроса.
+ *
+ * Номер только считается в метрике: клиент сам хранит, с какого места продолжать, и присылает
+ * его в X-History-Offset, а у одного пользователя может быть несколько устройств.
+ * @param body Тело запроса /ack или /pong; пустое тело ничего не подтверждает.
  */
-void handle_session(std::shared_ptr<ssl_socket> socket);
-void extractLoginAndPassword(const std::string& input, std::string& login, std::string& password);
+void record_ack(std::string_view body);
 
 #endif // SSL_SERVER_H
\ No newline at end of file
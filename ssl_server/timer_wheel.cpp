@@ -0,0 +1,76 @@
+/**
+ * @file timer_wheel.cpp
+ * @brief Реализация колеса таймеров.
+ */
+
+#include "timer_wheel.h"
+#include <algorithm>
+
+TimerWheel::TimerWheel(clock::duration tick, std::size_t slots, clock::time_point now)
+    : tick_(tick), start_(now), slots_(std::max<std::size_t>(1, slots), nullptr) {}
+
+uint64_t TimerWheel::tick_of(clock::time_point time) const {
+    if (time <= start_) {
+        return 0;
+    }
+    // Округление вверх: таймер никогда не срабатывает раньше срока.
+    return static_cast<uint64_t>((time - start_ + tick_ - clock::duration(1)) / tick_);
+}
+
+void TimerWheel::arm(Entry& entry, clock::time_point deadline) {
+    cancel(entry);
+    entry.due_tick_ = std::max(tick_of(deadline), current_tick_ + 1);
+
+    Entry*& head = slots_[entry.due_tick_ % slots_.size()];
+    entry.prev_ = nullptr;
+    entry.next_ = head;
+    if (head) {
+        head->prev_ = &entry;
+    }
+    head = &entry;
+    entry.armed_ = true;
+    ++size_;
+}
+
+void TimerWheel::cancel(Entry& entry) {
+    if (entry.armed_) {
+        unlink(entry);
+    }
+}
+
+void TimerWheel::unlink(Entry& entry) {
+    if (entry.prev_) {
+        entry.prev_->next_ = entry.next_;
+    } else {
+        slots_[entry.due_tick_ % slots_.size()] = entry.next_;
+    }
+    if (entry.next_) {
+        entry.next_->prev_ = entry.prev_;
+    }
+    entry.prev_ = entry.next_ = nullptr;
+    entry.armed_ = false;
+    --size_;
+}
+
+void TimerWheel::advance(clock::time_point now, std::vector<Entry*>& expired) {
+    // Срабатывают только целиком прошедшие такты.
+    uint64_t target = now <= start_ ? 0 : static_cast<uint64_t>((now - start_) / tick_);
+    if (target <= current_tick_) {
+        return;
+    }
+
+    // Если прошло больше оборота, достаточно один раз обойти все слоты.
+    uint64_t steps = std::min<uint64_t>(target - current_tick_, slots_.size());
+    for (uint64_t step = 1; step <= steps; ++step) {
+        Entry* entry = slots_[(current_tick_ + step) % slots_.size()];
+        while (entry) {
+            Entry* next = entry->next_;
+            if (entry->due_tick_ <= target) {
+                unlink(*entry);
+                expired.push_back(entry);
+            }
+            entry = next;
+        }
+    }
+    current_tick_ = target;
+}
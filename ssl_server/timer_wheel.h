@@ -0,0 +1,91 @@
+/**
+ * @file timer_wheel.h
+ * @brief Хешированное колесо таймеров с постановкой и отменой за O(1).
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Колесо таймеров: срок округляется вверх до такта, таймер попадает в слот такта по модулю числа слотов.
+ *
+ * Таймеры интрузивные: владелец наследуется от TimerWheel::Entry и сам отвечает за то, чтобы
+ * отменить таймер до своего уничтожения. Класс не потокобезопасен.
+ */
+class TimerWheel {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Узел колеса, встраиваемый в объект-владелец.
+     */
+    class Entry {
+    public:
+        Entry() = default;
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        /**
+         * @brief Стоит ли таймер в колесе.
+         */
+        bool armed() const { return armed_; }
+
+    private:
+        friend class TimerWheel;
+        Entry* prev_ = nullptr;
+        Entry* next_ = nullptr;
+        uint64_t due_tick_ = 0;
+        bool armed_ = false;
+    };
+
+    /**
+     * @param tick Длительность такта (точность срабатывания).
+     * @param slots Число слотов.
+     * @param now Время нулевого такта.
+     */
+    TimerWheel(clock::duration tick, std::size_t slots, clock::time_point now = clock::now());
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * @brief Ставит или переставляет таймер.
+     * @param entry Таймер.
+     * @param deadline Срок срабатывания; прошедший срок срабатывает на ближайшем такте.
+     */
+    void arm(Entry& entry, clock::time_point deadline);
+
+    /**
+     * @brief Снимает таймер, если он стоит.
+     */
+    void cancel(Entry& entry);
+
+    /**
+     * @brief Продвигает колесо и снимает все таймеры со сроком не позже now.
+     * @param now Текущее время.
+     * @param expired Сюда добавляются сработавшие таймеры.
+     */
+    void advance(clock::time_point now, std::vector<Entry*>& expired);
+
+    /**
+     * @brief Число стоящих таймеров.
+     */
+    std::size_t size() const { return size_; }
+
+private:
+    clock::duration tick_;
+    clock::time_point start_;
+    uint64_t current_tick_ = 0;
+    std::vector<Entry*> slots_;
+    std::size_t size_ = 0;
+
+    uint64_t tick_of(clock::time_point time) const;
+    void unlink(Entry& entry);
+};
+
+#endif // TIMER_WHEEL_H
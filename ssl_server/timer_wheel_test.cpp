@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "timer_wheel.h"
+#include <algorithm>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct Timer : TimerWheel::Entry {
+    int id = 0;
+};
+
+std::vector<int> fired(TimerWheel& wheel, TimerWheel::clock::time_point now) {
+    std::vector<TimerWheel::Entry*> expired;
+    wheel.advance(now, expired);
+    std::vector<int> ids;
+    for (auto* entry : expired) {
+        ids.push_back(static_cast<Timer*>(entry)->id);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+} // namespace
+
+TEST(TimerWheelTest, FiresNoEarlierThanDeadline) {
+    auto start = TimerWheel::clock::now();
+    TimerWheel wheel(10ms, 8, start);
+    Timer a, b;
+    a.id = 1;
+    b.id = 2;
+    wheel.arm(a, start + 25ms);
+    wheel.arm(b, start + 30ms);
+
+    EXPECT_TRUE(fired(wheel, start + 20ms).empty());
+    EXPECT_TRUE(fired(wheel, start + 29ms).empty());
+    EXPECT_EQ(fired(wheel, start + 30ms), (std::vector<int>{1, 2}));
+    EXPECT_FALSE(a.armed());
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(TimerWheelTest, CancelAndRearm) {
+    auto start = TimerWheel::clock::now();
+    TimerWheel wheel(10ms, 8, start);
+    Timer a, b;
+    a.id = 1;
+    b.id = 2;
+    wheel.arm(a, start + 10ms);
+    wheel.arm(b, start + 10ms);
+    wheel.cancel(a);
+    wheel.arm(b, start + 50ms);
+
+    EXPECT_TRUE(fired(wheel, start + 40ms).empty());
+    EXPECT_EQ(fired(wheel, start + 50ms), (std::vector<int>{2}));
+}
+
+TEST(TimerWheelTest, KeepsTimersForLaterRounds) {
+    auto start = TimerWheel::clock::now();
+    TimerWheel wheel(10ms, 4, start);
+    Timer near, far;
+    near.id = 1;
+    far.id = 2;
+    // Оба таймера попадают в один слот, но дальний - на два оборота позже.
+    wheel.arm(near, start + 10ms);
+    wheel.arm(far, start + 90ms);
+
+    EXPECT_EQ(fired(wheel, start + 10ms), (std::vector<int>{1}));
+    EXPECT_TRUE(fired(wheel, start + 50ms).empty());
+    EXPECT_TRUE(far.armed());
+    EXPECT_EQ(fired(wheel, start + 1s), (std::vector<int>{2}));
+}
+
+TEST(TimerWheelTest, PastDeadlineFiresOnNextTick) {
+    auto start = TimerWheel::clock::now();
+    TimerWheel wheel(10ms, 4, start);
+    ASSERT_TRUE(fired(wheel, start + 100ms).empty());
+
+    Timer late;
+    late.id = 7;
+    wheel.arm(late, start);
+    EXPECT_TRUE(fired(wheel, start + 105ms).empty());
+    EXPECT_EQ(fired(wheel, start + 110ms), (std::vector<int>{7}));
+}
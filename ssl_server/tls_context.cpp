@@ -0,0 +1,39 @@
+/**
+ * @file tls_context.cpp
+ * @brief Реализация контекста TLS с перезагрузкой сертификата.
+ */
+
+#include "tls_context.h"
+#include "ktls_stream.h"
+#include <openssl/ssl.h>
+
+namespace ssl = boost::asio::ssl;
+
+ServerTlsContext::ServerTlsContext(std::string certificate, std::string key, bool kernel_tls)
+    : certificate_(std::move(certificate)), key_(std::move(key)), kernel_tls_(kernel_tls), current_(build()) {}
+
+std::shared_ptr<ssl::context> ServerTlsContext::current() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_;
+}
+
+void ServerTlsContext::reload() {
+    // Контекст собирается без блокировки: приём соединений не ждёт чтения файлов.
+    auto next = build();
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_ = std::move(next);
+}
+
+std::shared_ptr<ssl::context> ServerTlsContext::build() const {
+    auto context = std::make_shared<ssl::context>(ssl::context::tlsv12_server);
+    context->use_certificate_chain_file(certificate_);
+    context->use_private_key_file(key_, ssl::context::pem);
+    // Сертификат от одной пары, ключ от другой - частая ошибка при ротации.
+    if (SSL_CTX_check_private_key(context->native_handle()) != 1) {
+        throw boost::system::system_error(boost::asio::error::invalid_argument, "private key does not match certificate");
+    }
+    if (kernel_tls_) {
+        enable_kernel_tls(*context);
+    }
+    return context;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file tls_context.h
+ * @brief Контекст TLS сервера с перезагрузкой сертификата без перезапуска.
+ */
+
+#ifndef TLS_CONTEXT_H
+#define TLS_CONTEXT_H
+
+#include <boost/asio/ssl.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Текущий контекст TLS сервера.
+ *
+ * reload() собирает новый контекст из файлов и подменяет текущий; новые соединения
+ * получают новый сертификат, уже установленные продолжают работать со старым: SSL
+ * держит ссылку на свой SSL_CTX. Потокобезопасен.
+ */
+class ServerTlsContext {
+public:
+    /**
+     * @param certificate Путь к цепочке сертификатов (PEM).
+     * @param key Путь к закрытому ключу (PEM).
+     * @param kernel_tls Включать kTLS в каждом собранном контексте.
+     * @throws boost::system::system_error, если файлы не загрузились.
+     */
+    ServerTlsContext(std::string certificate, std::string key, bool kernel_tls = false);
+
+    /**
+     * @brief Контекст для нового соединения.
+     */
+    std::shared_ptr<boost::asio::ssl::context> current() const;
+
+    /**
+     * @brief Перечитывает сертификат и ключ.
+     * @throws boost::system::system_error, если файлы не загрузились или ключ не подходит; текущий контекст остаётся прежним.
+     */
+    void reload();
+
+private:
+    std::string certificate_;
+    std::string key_;
+    bool kernel_tls_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<boost::asio::ssl::context> current_;
+
+    std::shared_ptr<boost::asio::ssl::context> build() const;
+};
+
+#endif // TLS_CONTEXT_H
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include "tls_context.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+// Тесты запускаются из каталога сборки рядом с исходниками, как и сервер.
+std::string find_certificate_dir() {
+    for (std::string dir : {"../", "./", "../../"}) {
+        if (std::ifstream(dir + "server.pem") && std::ifstream(dir + "server.key")) {
+            return dir;
+        }
+    }
+    return {};
+}
+
+void copy_file(const std::string& from, const std::string& to) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+}
+
+} // namespace
+
+TEST(ServerTlsContextTest, ReloadReplacesContextAndKeepsOldOneOnBrokenFiles) {
+    std::string dir = find_certificate_dir();
+    if (dir.empty()) {
+        GTEST_SKIP() << "server.pem not found";
+    }
+    std::string prefix = "/tmp/chat_tls_" + std::to_string(getpid());
+    copy_file(dir + "server.pem", prefix + ".pem");
+    copy_file(dir + "server.key", prefix + ".key");
+
+    ServerTlsContext tls(prefix + ".pem", prefix + ".key");
+    auto first = tls.current();
+    ASSERT_TRUE(first);
+
+    tls.reload();
+    auto second = tls.current();
+    EXPECT_NE(first, second);
+
+    // Файл, перезаписанный наполовину во время ротации, не ломает приём соединений.
+    std::ofstream(prefix + ".pem", std::ios::trunc) << "-----BEGIN CERTIFICATE-----\n";
+    EXPECT_THROW(tls.reload(), boost::system::system_error);
+    EXPECT_EQ(tls.current(), second);
+
+    std::remove((prefix + ".pem").c_str());
+    std::remove((prefix + ".key").c_str());
+}
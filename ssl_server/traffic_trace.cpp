@@ -0,0 +1,362 @@
+/**
+ * @file traffic_trace.cpp
+ * @brief Реализация трассы входящего трафика и отчётов воспроизведения.
+ */
+
+#include "traffic_trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+/// Строка длиннее считается повреждением трассы: тело запроса сервера не больше 1 МиБ.
+constexpr uint64_t kMaxTraceString = 16 * 1024 * 1024;
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void put_string(std::string& out, std::string_view value) {
+    put_varint(out, value.size());
+    out.append(value);
+}
+
+bool get_varint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == std::char_traits<char>::eof()) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool get_string(std::istream& in, std::string& value) {
+    uint64_t size = 0;
+    if (!get_varint(in, size) || size > kMaxTraceString) {
+        return false;
+    }
+    value.resize(size);
+    return static_cast<bool>(in.read(value.data(), static_cast<std::streamsize>(size)));
+}
+
+/**
+ * @brief Доля part от whole; 0 при пустом whole.
+ */
+double share(uint64_t part, uint64_t whole) {
+    return whole == 0 ? 0 : static_cast<double>(part) / whole;
+}
+
+} // namespace
+
+std::string redact_trace_body(std::string_view target, std::string_view body) {
+    if (target != "/" && target != "/dm" && target != "/search") {
+        return std::string(body);
+    }
+    std::string redacted(body);
+    std::size_t from = 0;
+    if (target == "/dm") {
+        std::size_t space = body.find(' '); // Имя получателя нужно для доставки
+        from = space == std::string_view::npos ? body.size() : space + 1;
+    }
+    std::fill(redacted.begin() + from, redacted.end(), 'x');
+    return redacted;
+}
+
+TraceWriter::TraceWriter(const std::string& path, uint64_t max_bytes, std::chrono::milliseconds flush_interval)
+    : out_(path, std::ios::binary | std::ios::trunc), max_bytes_(max_bytes), flush_interval_(flush_interval),
+      started_(clock::now()) {
+    if (!out_) {
+        throw std::runtime_error("cannot create trace " + path);
+    }
+    out_.write(kTraceMagic.data(), kTraceMagic.size());
+    out_.flush();
+    bytes_ = kTraceMagic.size();
+    flusher_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            wake_.wait_for(lock, flush_interval_);
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    });
+}
+
+TraceWriter::~TraceWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    flusher_.join();
+    flush();
+}
+
+uint32_t TraceWriter::login(std::string_view user, bool compress) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t session = next_session_++;
+    append_locked(session, TraceEvent::login, user, {}, compress);
+    return session;
+}
+
+void TraceWriter::request(uint32_t session, std::string_view target, std::string_view body) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    append_locked(session, TraceEvent::request, target, body, false);
+}
+
+void TraceWriter::disconnect(uint32_t session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    append_locked(session, TraceEvent::disconnect, {}, {}, false);
+}
+
+void TraceWriter::append_locked(uint32_t session, TraceEvent event, std::string_view first, std::string_view second, bool flag) {
+    auto now = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - started_);
+    std::size_t size = 2 * 10 + 1 + 1 + 2 * 10 + first.size() + second.size(); // Верхняя оценка размера записи
+    if (bytes_.load(std::memory_order_relaxed) + size > max_bytes_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::size_t used = buffer_.size();
+    put_varint(buffer_, static_cast<uint64_t>((now - last_).count()));
+    put_varint(buffer_, session);
+    buffer_.push_back(static_cast<char>(event));
+    if (event == TraceEvent::login) {
+        buffer_.push_back(flag ? 1 : 0);
+        put_string(buffer_, first);
+    } else if (event == TraceEvent::request) {
+        put_string(buffer_, first);
+        put_string(buffer_, second);
+    }
+    last_ = now;
+    bytes_.fetch_add(buffer_.size() - used, std::memory_order_relaxed);
+}
+
+void TraceWriter::flush() {
+    std::string data;
+    std::unique_lock<std::mutex> lock(mutex_);
+    data.swap(buffer_);
+    // Блокировка файла берётся до освобождения буфера: сбросы из разных потоков пишутся по порядку.
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
+    lock.unlock();
+    if (!data.empty()) {
+        out_.write(data.data(), static_cast<std::streamsize>(data.size()));
+        out_.flush();
+    }
+}
+
+TraceReader::TraceReader(const std::string& path) : in_(path, std::ios::binary) {
+    if (!in_) {
+        throw std::runtime_error("cannot open trace " + path);
+    }
+    std::string magic(kTraceMagic.size(), '\0');
+    if (!in_.read(magic.data(), static_cast<std::streamsize>(magic.size())) || magic != kTraceMagic) {
+        throw std::runtime_error("not a chat trace: " + path);
+    }
+}
+
+std::optional<TraceRecord> TraceReader::next() {
+    if (truncated_ || in_.peek() == std::char_traits<char>::eof()) {
+        return std::nullopt;
+    }
+    TraceRecord record;
+    uint64_t delta = 0, session = 0;
+    int event = 0;
+    bool ok = get_varint(in_, delta) && get_varint(in_, session) && session <= UINT32_MAX &&
+              (event = in_.get()) != std::char_traits<char>::eof();
+    if (ok) {
+        record.event = static_cast<TraceEvent>(event);
+        switch (record.event) {
+        case TraceEvent::login: {
+            int flag = in_.get();
+            ok = flag == 0 || flag == 1;
+            record.compress = flag == 1;
+            ok = ok && get_string(in_, record.user);
+            break;
+        }
+        case TraceEvent::request:
+            ok = get_string(in_, record.target) && get_string(in_, record.body);
+            break;
+        case TraceEvent::disconnect:
+            break;
+        default:
+            ok = false;
+        }
+    }
+    if (!ok) {
+        truncated_ = true;
+        return std::nullopt;
+    }
+    time_ += std::chrono::microseconds(delta);
+    record.time = time_;
+    record.session = static_cast<uint32_t>(session);
+    return record;
+}
+
+LatencyHistogram::LatencyHistogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)), counts_(bounds_.size() + 1, 0) {}
+
+void LatencyHistogram::observe(double seconds) {
+    auto bucket = std::lower_bound(bounds_.begin(), bounds_.end(), seconds) - bounds_.begin();
+    ++counts_[bucket];
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < counts_.size() && i < other.counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (uint64_t n : counts_) {
+        total += n;
+    }
+    return total;
+}
+
+double LatencyHistogram::quantile(double q) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    double rank = q * total;
+    uint64_t below = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+        if (counts_[i] > 0 && below + counts_[i] >= rank) {
+            if (i == bounds_.size()) {
+                return bounds_.empty() ? 0 : bounds_.back(); // Корзина переполнения не имеет верхней границы
+            }
+            double lower = i == 0 ? 0 : bounds_[i - 1];
+            return lower + (bounds_[i] - lower) * (rank - below) / counts_[i];
+        }
+        below += counts_[i];
+    }
+    return bounds_.empty() ? 0 : bounds_.back();
+}
+
+double ReplayReport::messages_per_second() const {
+    return seconds > 0 ? acks / seconds : 0;
+}
+
+double ReplayReport::frames_per_second() const {
+    return seconds > 0 ? frames_received / seconds : 0;
+}
+
+std::string ReplayReport::to_text() const {
+    std::ostringstream out;
+    out.precision(9);
+    out << "seconds " << seconds << '\n'
+        << "sessions " << sessions << '\n'
+        << "login_failures " << login_failures << '\n'
+        << "messages_sent " << messages_sent << '\n'
+        << "acks " << acks << '\n'
+        << "dropped " << dropped << '\n'
+        << "frames_received " << frames_received << '\n';
+    out << "latency_bounds";
+    for (double bound : ack_latency.bounds()) {
+        out << ' ' << bound;
+    }
+    out << '\n';
+    auto counts = [&out](const char* name, const LatencyHistogram& histogram) {
+        out << name;
+        for (uint64_t n : histogram.counts()) {
+            out << ' ' << n;
+        }
+        out << '\n';
+    };
+    counts("ack_latency", ack_latency);
+    counts("login_latency", login_latency);
+    return out.str();
+}
+
+std::optional<ReplayReport> ReplayReport::parse(std::string_view text) {
+    std::istringstream in{std::string(text)};
+    std::vector<double> bounds;
+    std::vector<uint64_t> ack_counts, login_counts;
+    double seconds = 0;
+    uint64_t fields[6] = {};
+    const char* names[6] = {"sessions", "login_failures", "messages_sent", "acks", "dropped", "frames_received"};
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream words(line);
+        std::string key;
+        words >> key;
+        if (key == "seconds") {
+            words >> seconds;
+        } else if (key == "latency_bounds") {
+            for (double bound; words >> bound;) {
+                bounds.push_back(bound);
+            }
+        } else if (key == "ack_latency" || key == "login_latency") {
+            auto& counts = key == "ack_latency" ? ack_counts : login_counts;
+            for (uint64_t n; words >> n;) {
+                counts.push_back(n);
+            }
+        } else {
+            for (int i = 0; i < 6; ++i) {
+                if (key == names[i]) {
+                    words >> fields[i];
+                }
+            }
+        }
+    }
+    if (bounds.empty() || ack_counts.size() != bounds.size() + 1 || login_counts.size() != bounds.size() + 1) {
+        return std::nullopt;
+    }
+    ReplayReport report(bounds);
+    report.seconds = seconds;
+    report.sessions = fields[0];
+    report.login_failures = fields[1];
+    report.messages_sent = fields[2];
+    report.acks = fields[3];
+    report.dropped = fields[4];
+    report.frames_received = fields[5];
+    report.ack_latency.counts_ = std::move(ack_counts);
+    report.login_latency.counts_ = std::move(login_counts);
+    return report;
+}
+
+std::vector<std::string> compare_replay(const ReplayReport& baseline, const ReplayReport& current, double tolerance) {
+    std::vector<std::string> regressions;
+    auto describe = [](const char* name, double before, double after, const char* unit) {
+        char text[160];
+        std::snprintf(text, sizeof(text), "%s: %.3f -> %.3f %s (%+.1f%%)", name, before, after, unit,
+                      before > 0 ? (after - before) / before * 100 : 0.0);
+        return std::string(text);
+    };
+    auto lower_is_worse = [&](const char* name, double before, double after) {
+        if (before > 0 && after < before * (1 - tolerance)) {
+            regressions.push_back(describe(name, before, after, "/s"));
+        }
+    };
+    auto higher_is_worse = [&](const char* name, double before, double after, double floor, double scale, const char* unit) {
+        if (after > before * (1 + tolerance) && after - before > floor) {
+            regressions.push_back(describe(name, before * scale, after * scale, unit));
+        }
+    };
+    lower_is_worse("messages_per_second", baseline.messages_per_second(), current.messages_per_second());
+    lower_is_worse("frames_per_second", baseline.frames_per_second(), current.frames_per_second());
+    for (double q : {0.5, 0.99}) {
+        std::string ack = q == 0.5 ? "ack_latency_p50" : "ack_latency_p99";
+        std::string login = q == 0.5 ? "login_latency_p50" : "login_latency_p99";
+        higher_is_worse(ack.c_str(), baseline.ack_latency.quantile(q), current.ack_latency.quantile(q), 0.001, 1000, "ms");
+        higher_is_worse(login.c_str(), baseline.login_latency.quantile(q), current.login_latency.quantile(q), 0.001, 1000, "ms");
+    }
+    higher_is_worse("dropped_share", share(baseline.dropped, baseline.messages_sent),
+                    share(current.dropped, current.messages_sent), 0.01, 100, "%");
+    higher_is_worse("login_failure_share", share(baseline.login_failures, baseline.sessions),
+                    share(current.login_failures, current.sessions), 0.01, 100, "%");
+    return regressions;
+}
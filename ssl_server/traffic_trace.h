@@ -0,0 +1,250 @@
+/**
+ * @file traffic_trace.h
+ * @brief Запись входящего трафика сервера в компактную двоичную трассу и отчёты её воспроизведения.
+ */
+
+#ifndef TRAFFIC_TRACE_H
+#define TRAFFIC_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Событие сессии в трассе.
+ */
+enum class TraceEvent : uint8_t {
+    login = 1,      ///< Успешный вход: имя пользователя и согласованное сжатие.
+    request = 2,    ///< Запрос клиента: путь и тело.
+    disconnect = 3, ///< Сессия завершилась.
+};
+
+/**
+ * @brief Запись трассы.
+ */
+struct TraceRecord {
+    std::chrono::microseconds time{0}; ///< От начала записи трассы.
+    uint32_t session = 0;              ///< Номер сессии в трассе (с 1).
+    TraceEvent event = TraceEvent::request;
+    bool compress = false;             ///< Для login: клиент просил сжатие.
+    std::string user;                  ///< Для login: имя пользователя (пароль не записывается).
+    std::string target;                ///< Для request: путь запроса.
+    std::string body;                  ///< Для request: тело запроса.
+};
+
+/**
+ * @brief Заголовок файла трассы; меняется вместе с форматом.
+ */
+constexpr std::string_view kTraceMagic{"CHATTRC1"};
+
+/**
+ * @brief Заменяет текст сообщения в теле запроса символами 'x' той же длины.
+ *
+ * Для трассы, записанной с запретом писать текст сообщений в журнал: объём и число
+ * сообщений сохраняются, содержимое - нет. У личного сообщения остаётся имя получателя,
+ * служебные запросы (/ack, /typing) не меняются.
+ */
+std::string redact_trace_body(std::string_view target, std::string_view body);
+
+/**
+ * @brief Пишет трассу в файл.
+ *
+ * Запись - время от предыдущей записи в микросекундах, номер сессии и поля события;
+ * числа кодируются varint, строки - длиной и байтами, поэтому запись сообщения чата
+ * длиннее его текста на несколько байт. Методы потокобезопасны и не обращаются к диску:
+ * записи копятся в памяти и сбрасываются фоновым потоком раз в flush_interval, так что
+ * при аварийном завершении теряется не больше интервала (чтение отбрасывает оборванную
+ * последнюю запись). Когда в файле max_bytes, запись прекращается.
+ */
+class TraceWriter {
+public:
+    /**
+     * @param path Файл трассы (перезаписывается).
+     * @param max_bytes Наибольший размер трассы.
+     * @param flush_interval Интервал сброса на диск.
+     * @throws std::runtime_error, если файл нельзя создать.
+     */
+    TraceWriter(const std::string& path, uint64_t max_bytes,
+                std::chrono::milliseconds flush_interval = std::chrono::milliseconds(1000));
+
+    /**
+     * @brief Сбрасывает несохранённые записи и останавливает фоновый поток.
+     */
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    /**
+     * @brief Записывает вход и выдаёт сессии номер для следующих записей.
+     */
+    uint32_t login(std::string_view user, bool compress);
+
+    /**
+     * @brief Записывает запрос сессии.
+     */
+    void request(uint32_t session, std::string_view target, std::string_view body);
+
+    /**
+     * @brief Записывает завершение сессии.
+     */
+    void disconnect(uint32_t session);
+
+    /**
+     * @brief Сбрасывает накопленные записи на диск.
+     */
+    void flush();
+
+    /**
+     * @brief Объём трассы, включая ещё не сброшенные записи.
+     */
+    uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Записи, не попавшие в трассу из-за предела max_bytes.
+     */
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::ofstream out_;
+    uint64_t max_bytes_;
+    std::chrono::milliseconds flush_interval_;
+    clock::time_point started_;
+
+    std::mutex mutex_;              ///< Защищает buffer_, last_ и next_session_.
+    std::string buffer_;            ///< Записи, ещё не сброшенные на диск.
+    std::chrono::microseconds last_{0}; ///< Время предыдущей записи.
+    uint32_t next_session_ = 1;
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::mutex file_mutex_;         ///< Сохраняет порядок сбросов из разных потоков.
+    std::condition_variable wake_;
+    bool stopping_ = false;         ///< Под mutex_.
+    std::thread flusher_;
+
+    /**
+     * @brief Добавляет запись в буфер; вызывается под mutex_.
+     */
+    void append_locked(uint32_t session, TraceEvent event, std::string_view first, std::string_view second, bool flag);
+};
+
+/**
+ * @brief Читает трассу последовательно, не загружая её целиком.
+ */
+class TraceReader {
+public:
+    /**
+     * @throws std::runtime_error, если файл нельзя открыть или это не трасса.
+     */
+    explicit TraceReader(const std::string& path);
+
+    /**
+     * @brief Следующая запись или nullopt в конце трассы.
+     *
+     * Оборванная или повреждённая запись завершает чтение; тогда truncated() истинно.
+     */
+    std::optional<TraceRecord> next();
+
+    bool truncated() const { return truncated_; }
+
+private:
+    std::ifstream in_;
+    std::chrono::microseconds time_{0};
+    bool truncated_ = false;
+};
+
+/**
+ * @brief Гистограмма задержек для отчёта воспроизведения; границы - как у метрик сервера.
+ */
+class LatencyHistogram {
+public:
+    /**
+     * @param bounds Верхние границы корзин в секундах по возрастанию; за последней - корзина переполнения.
+     */
+    explicit LatencyHistogram(std::vector<double> bounds);
+
+    void observe(double seconds);
+
+    void merge(const LatencyHistogram& other);
+
+    uint64_t count() const;
+
+    /**
+     * @brief Оценка квантиля с линейной интерполяцией внутри корзины (как histogram_quantile в Prometheus).
+     * @param q Доля от 0 до 1.
+     * @return Задержка в секундах; 0 для пустой гистограммы.
+     */
+    double quantile(double q) const;
+
+    const std::vector<double>& bounds() const { return bounds_; }
+    const std::vector<uint64_t>& counts() const { return counts_; }
+
+private:
+    friend struct ReplayReport;
+    std::vector<double> bounds_;
+    std::vector<uint64_t> counts_; ///< bounds_.size() + 1 корзин.
+};
+
+/**
+ * @brief Итог воспроизведения трассы; сохраняется как базовый и сравнивается с ним.
+ */
+struct ReplayReport {
+    double seconds = 0;           ///< Длительность воспроизведения.
+    uint64_t sessions = 0;        ///< Сессий в трассе.
+    uint64_t login_failures = 0;  ///< Не подключились или не вошли.
+    uint64_t messages_sent = 0;   ///< Отправлено сообщений чата.
+    uint64_t acks = 0;            ///< Сообщений, получивших номер (X-Ack).
+    uint64_t dropped = 0;         ///< Сообщений, отброшенных сервером (X-Ack: dropped).
+    uint64_t frames_received = 0; ///< Записей журнала, доставленных всем сессиям (X-Log-Offset).
+    LatencyHistogram ack_latency;   ///< От отправки сообщения до его X-Ack.
+    LatencyHistogram login_latency; ///< От запроса входа до списка пользователей в сети.
+
+    explicit ReplayReport(const std::vector<double>& bounds) : ack_latency(bounds), login_latency(bounds) {}
+
+    /**
+     * @brief Подтверждённые сообщения в секунду.
+     */
+    double messages_per_second() const;
+
+    /**
+     * @brief Доставленные записи журнала в секунду.
+     */
+    double frames_per_second() const;
+
+    /**
+     * @brief Текст "ключ значение" по строке на поле; гистограммы - границы и число наблюдений в каждой корзине.
+     */
+    std::string to_text() const;
+
+    /**
+     * @brief Разбирает текст to_text().
+     * @return nullopt, если текст не разобран.
+     */
+    static std::optional<ReplayReport> parse(std::string_view text);
+};
+
+/**
+ * @brief Сравнивает воспроизведение с базовым.
+ *
+ * Ухудшением считается падение пропускной способности (сообщений и доставленных записей
+ * в секунду) больше чем на долю tolerance, рост медианы и 99-го процентиля задержек больше
+ * чем на долю tolerance и больше чем на 1 мс, рост доли отброшенных сообщений или неудачных
+ * входов больше чем на долю tolerance и больше чем на процентный пункт. Пороги в единицах
+ * не дают шуму малых величин выглядеть ухудшением.
+ * @return Описания ухудшений; пусто, если их нет.
+ */
+std::vector<std::string> compare_replay(const ReplayReport& baseline, const ReplayReport& current, double tolerance);
+
+#endif // TRAFFIC_TRACE_H
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "traffic_trace.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+class TrafficTraceTest : public ::testing::Test {
+protected:
+    std::string path;
+
+    void SetUp() override {
+        path = (fs::temp_directory_path() / ("traffic_trace_test_" + std::to_string(::getpid()))).string();
+    }
+
+    void TearDown() override {
+        fs::remove(path);
+    }
+
+    static std::vector<double> bounds() {
+        return {0.001, 0.01, 0.1, 1};
+    }
+};
+
+TEST_F(TrafficTraceTest, RecordsSessionsInOrderAndStopsAtTruncatedTail) {
+    {
+        TraceWriter writer(path, 1 << 20);
+        uint32_t alice = writer.login("alice", true);
+        uint32_t bob = writer.login("bob", false);
+        EXPECT_NE(alice, bob);
+        writer.request(alice, "/", "hello");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        writer.request(bob, "/dm", "alice hi");
+        writer.disconnect(alice);
+    }
+    // Процесс оборвался посреди записи: оборванная запись отбрасывается, предыдущие читаются.
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out.write("\x05\x01\x02\x09" "ab", 6); // Запрос с путём длиной 9, оборванный на втором байте
+    }
+
+    TraceReader reader(path);
+    std::vector<TraceRecord> records;
+    while (auto record = reader.next()) {
+        records.push_back(std::move(*record));
+    }
+    EXPECT_TRUE(reader.truncated());
+    ASSERT_EQ(records.size(), 5u);
+    EXPECT_EQ(records[0].event, TraceEvent::login);
+    EXPECT_EQ(records[0].user, "alice");
+    EXPECT_TRUE(records[0].compress);
+    EXPECT_FALSE(records[1].compress);
+    EXPECT_EQ(records[2].session, records[0].session);
+    EXPECT_EQ(records[2].target, "/");
+    EXPECT_EQ(records[2].body, "hello");
+    EXPECT_EQ(records[3].session, records[1].session);
+    EXPECT_EQ(records[3].body, "alice hi");
+    EXPECT_GE(records[3].time - records[2].time, std::chrono::milliseconds(2));
+    EXPECT_EQ(records[4].event, TraceEvent::disconnect);
+    for (std::size_t i = 1; i < records.size(); ++i) {
+        EXPECT_GE(records[i].time, records[i - 1].time);
+    }
+
+    // Запись сообщения длиннее текста лишь на несколько байт.
+    EXPECT_LT(fs::file_size(path), kTraceMagic.size() + 6 + 2 * 10 + 3 * 16);
+    EXPECT_THROW(TraceReader("/nonexistent/trace"), std::runtime_error);
+}
+
+TEST_F(TrafficTraceTest, StopsAtSizeLimitAndRedactsText) {
+    {
+        TraceWriter writer(path, 200);
+        uint32_t session = writer.login("alice", false);
+        for (int i = 0; i < 20; ++i) {
+            writer.request(session, "/", std::string(20, 'a'));
+        }
+        EXPECT_GT(writer.dropped(), 0u);
+        EXPECT_LE(writer.bytes(), 200u);
+    }
+    EXPECT_LE(fs::file_size(path), 200u);
+
+    EXPECT_EQ(redact_trace_body("/", "secret"), "xxxxxx");
+    EXPECT_EQ(redact_trace_body("/dm", "bob secret"), "bob xxxxxx");
+    EXPECT_EQ(redact_trace_body("/search", "word"), "xxxx");
+    EXPECT_EQ(redact_trace_body("/ack", "42"), "42");
+}
+
+TEST_F(TrafficTraceTest, ReportRoundTripsAndFlagsRegressions) {
+    ReplayReport baseline(bounds());
+    baseline.seconds = 10;
+    baseline.sessions = 100;
+    baseline.messages_sent = 1000;
+    baseline.acks = 1000;
+    baseline.frames_received = 50000;
+    for (int i = 0; i < 100; ++i) {
+        baseline.ack_latency.observe(0.005);
+        baseline.login_latency.observe(0.05);
+    }
+    EXPECT_NEAR(baseline.ack_latency.quantile(0.5), 0.0055, 1e-9); // Середина корзины (0.001, 0.01]
+    EXPECT_DOUBLE_EQ(baseline.messages_per_second(), 100);
+
+    auto parsed = ReplayReport::parse(baseline.to_text());
+    ASSERT_TRUE(parsed.has_value());
+    EXPECT_EQ(parsed->frames_received, 50000u);
+    EXPECT_EQ(parsed->ack_latency.counts(), baseline.ack_latency.counts());
+    EXPECT_TRUE(compare_replay(baseline, *parsed, 0.1).empty());
+    EXPECT_FALSE(ReplayReport::parse("seconds 1\n").has_value());
+
+    // Пропускная способность упала на 20%, задержка сообщений ушла в корзину (0.1, 1].
+    ReplayReport slower = *parsed;
+    slower.seconds = 12.5;
+    slower.ack_latency = LatencyHistogram(bounds());
+    for (int i = 0; i < 100; ++i) {
+        slower.ack_latency.observe(0.5);
+    }
+    auto regressions = compare_replay(baseline, slower, 0.1);
+    ASSERT_EQ(regressions.size(), 4u);
+    EXPECT_NE(regressions[0].find("messages_per_second"), std::string::npos);
+    EXPECT_NE(regressions[1].find("frames_per_second"), std::string::npos);
+    EXPECT_NE(regressions[2].find("ack_latency_p50"), std::string::npos);
+    EXPECT_NE(regressions[3].find("ack_latency_p99"), std::string::npos);
+}